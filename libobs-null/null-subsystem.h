@@ -0,0 +1,122 @@
+#pragma once
+
+#include <util/darray.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+
+/*
+ * Null graphics subsystem
+ *
+ *   Implements the graphics module interface without a GPU.  Textures and
+ * staging surfaces are plain system memory, so uploads, texture copies,
+ * staging and clears behave like they would on a real device, but draw calls
+ * are only counted and never rasterized.  Meant for measuring the rest of the
+ * pipeline on machines without a usable graphics device.
+ */
+
+struct gs_texture {
+	gs_device_t          *device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             depth;
+	uint32_t             levels;
+	uint32_t             flags;
+	uint32_t             linesize;
+	uint8_t              *data;
+};
+
+struct gs_stage_surface {
+	gs_device_t          *device;
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             linesize;
+	uint8_t              *data;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t            *device;
+	enum gs_zstencil_format format;
+	uint32_t               width;
+	uint32_t               height;
+};
+
+struct gs_sampler_state {
+	gs_device_t            *device;
+	struct gs_sampler_info info;
+};
+
+struct gs_shader_param {
+	char                      *name;
+	enum gs_shader_param_type type;
+	int                       array_count;
+	gs_texture_t              *texture;
+
+	DARRAY(uint8_t)           cur_value;
+	DARRAY(uint8_t)           def_value;
+};
+
+struct gs_shader {
+	gs_device_t                    *device;
+	enum gs_shader_type            type;
+	DARRAY(struct gs_shader_param) params;
+	gs_sparam_t                    *viewproj;
+	gs_sparam_t                    *world;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t          *device;
+	struct gs_vb_data    *data;
+	uint32_t             flags;
+};
+
+struct gs_index_buffer {
+	gs_device_t          *device;
+	enum gs_index_type   type;
+	void                 *data;
+	size_t               num;
+	uint32_t             flags;
+};
+
+struct gs_swap_chain {
+	gs_device_t          *device;
+	struct gs_init_data  info;
+};
+
+struct gs_device {
+	gs_texture_t         *cur_render_target;
+	gs_zstencil_t        *cur_zstencil_buffer;
+	int                  cur_render_side;
+	gs_texture_t         *cur_textures[GS_MAX_TEXTURES];
+	gs_samplerstate_t    *cur_samplers[GS_MAX_TEXTURES];
+	gs_vertbuffer_t      *cur_vertex_buffer;
+	gs_indexbuffer_t     *cur_index_buffer;
+	gs_shader_t          *cur_vertex_shader;
+	gs_shader_t          *cur_pixel_shader;
+	gs_swapchain_t       *cur_swap;
+
+	enum gs_cull_mode    cur_cull_mode;
+	struct gs_rect       cur_viewport;
+
+	struct matrix4       cur_proj;
+	DARRAY(struct matrix4) proj_stack;
+
+	/* totals, logged when the device is destroyed */
+	uint64_t             draw_calls;
+	uint64_t             bytes_copied;
+	uint64_t             bytes_staged;
+};
+
+static inline uint32_t null_get_linesize(enum gs_color_format format,
+		uint32_t width)
+{
+	uint32_t linesize = width * gs_get_format_bpp(format) / 8;
+	return linesize ? linesize : 1;
+}
+
+extern void null_copy_rows(uint8_t *dst, uint32_t dst_linesize,
+		const uint8_t *src, uint32_t src_linesize,
+		uint32_t row_size, uint32_t rows);
@@ -0,0 +1,389 @@
+#include <util/base.h>
+#include <util/bmem.h>
+#include <graphics/vec4.h>
+
+#include "null-subsystem.h"
+
+void null_copy_rows(uint8_t *dst, uint32_t dst_linesize,
+		const uint8_t *src, uint32_t src_linesize,
+		uint32_t row_size, uint32_t rows)
+{
+	if (dst_linesize == src_linesize && row_size == src_linesize) {
+		memcpy(dst, src, (size_t)src_linesize * rows);
+		return;
+	}
+
+	for (uint32_t y = 0; y < rows; y++) {
+		memcpy(dst, src, row_size);
+		dst += dst_linesize;
+		src += src_linesize;
+	}
+}
+
+static struct gs_texture *create_texture(gs_device_t *device,
+		enum gs_texture_type type, uint32_t width, uint32_t height,
+		uint32_t depth, enum gs_color_format color_format,
+		uint32_t levels, const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture *tex = bzalloc(sizeof(struct gs_texture));
+	size_t plane_size;
+
+	tex->device   = device;
+	tex->type     = type;
+	tex->format   = color_format;
+	tex->width    = width;
+	tex->height   = height;
+	tex->depth    = depth;
+	tex->levels   = levels;
+	tex->flags    = flags;
+	tex->linesize = null_get_linesize(color_format, width);
+
+	/* only the top mip level is kept, lower levels are never sampled */
+	plane_size = (size_t)tex->linesize * height;
+	tex->data  = bzalloc(plane_size * depth);
+
+	if (data) {
+		for (uint32_t i = 0; i < depth; i++) {
+			const uint8_t *plane = data[i * (levels ? levels : 1)];
+			if (plane)
+				memcpy(tex->data + plane_size * i, plane,
+						plane_size);
+		}
+	}
+
+	return tex;
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format,
+		uint32_t levels, const uint8_t **data, uint32_t flags)
+{
+	return create_texture(device, GS_TEXTURE_2D, width, height, 1,
+			color_format, levels, data, flags);
+}
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	return create_texture(device, GS_TEXTURE_CUBE, size, size, 6,
+			color_format, levels, data, flags);
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, uint32_t depth,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	return create_texture(device, GS_TEXTURE_3D, width, height, depth,
+			color_format, levels, data, flags);
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+static void destroy_texture(gs_texture_t *tex)
+{
+	gs_device_t *device;
+
+	if (!tex)
+		return;
+
+	device = tex->device;
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (device->cur_textures[i] == tex)
+			device->cur_textures[i] = NULL;
+	}
+	if (device->cur_render_target == tex)
+		device->cur_render_target = NULL;
+
+	bfree(tex->data);
+	bfree(tex);
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	destroy_texture(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	if (tex->type != GS_TEXTURE_2D || (tex->flags & GS_DYNAMIC) == 0) {
+		blog(LOG_ERROR, "gs_texture_map (null): Texture is not a "
+				"dynamic 2D texture");
+		return false;
+	}
+
+	*ptr      = tex->data;
+	*linesize = tex->linesize;
+	return true;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+}
+
+bool gs_texture_is_rect(const gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+	return false;
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return tex->data;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *cubetex)
+{
+	destroy_texture(cubetex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	return cubetex->width;
+}
+
+enum gs_color_format gs_cubetexture_get_color_format(
+		const gs_texture_t *cubetex)
+{
+	return cubetex->format;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	destroy_texture(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	return voltex->width;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	return voltex->height;
+}
+
+uint32_t gs_voltexture_getdepth(const gs_texture_t *voltex)
+{
+	return voltex->depth;
+}
+
+enum gs_color_format gs_voltexture_get_color_format(const gs_texture_t *voltex)
+{
+	return voltex->format;
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf = bzalloc(sizeof(*surf));
+
+	surf->device   = device;
+	surf->format   = color_format;
+	surf->width    = width;
+	surf->height   = height;
+	surf->linesize = null_get_linesize(color_format, width);
+	surf->data     = bzalloc((size_t)surf->linesize * height);
+	return surf;
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (stagesurf) {
+		bfree(stagesurf->data);
+		bfree(stagesurf);
+	}
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format gs_stagesurface_get_color_format(
+		const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+		uint32_t *linesize)
+{
+	*data     = stagesurf->data;
+	*linesize = stagesurf->linesize;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void device_copy_texture_region(gs_device_t *device,
+		gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
+		gs_texture_t *src, uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	uint32_t bpp;
+
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"Source or destination texture is NULL");
+		return;
+	}
+	if (src->type != GS_TEXTURE_2D || dst->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"Source and destination textures must be 2D");
+		return;
+	}
+	if (src->format != dst->format) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"Source and destination formats do not match");
+		return;
+	}
+
+	if (!src_w) src_w = src->width  - src_x;
+	if (!src_h) src_h = src->height - src_y;
+
+	if (src_x + src_w > src->width  || src_y + src_h > src->height ||
+	    dst_x + src_w > dst->width  || dst_y + src_h > dst->height) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"Region out of bounds");
+		return;
+	}
+
+	bpp = gs_get_format_bpp(src->format) / 8;
+
+	null_copy_rows(
+			dst->data + dst_y * dst->linesize + dst_x * bpp,
+			dst->linesize,
+			src->data + src_y * src->linesize + src_x * bpp,
+			src->linesize,
+			src_w * bpp, src_h);
+
+	device->bytes_copied += (uint64_t)src_w * bpp * src_h;
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+		gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+		gs_texture_t *src)
+{
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+				"Source or destination is NULL");
+		return;
+	}
+	if (src->type != GS_TEXTURE_2D || src->format != dst->format ||
+	    src->width != dst->width || src->height != dst->height) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+				"Source and destination must be 2D and match "
+				"in size and format");
+		return;
+	}
+
+	null_copy_rows(dst->data, dst->linesize, src->data, src->linesize,
+			src->linesize, src->height);
+
+	device->bytes_staged += (uint64_t)src->linesize * src->height;
+}
+
+static inline uint8_t color_to_byte(float val)
+{
+	if (val <= 0.0f) return 0;
+	if (val >= 1.0f) return 255;
+	return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+/* only 8-bit color formats are actually filled, clearing anything else is
+ * ignored since nothing ever samples it */
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		const struct vec4 *color, float depth, uint8_t stencil)
+{
+	gs_texture_t *target = device->cur_render_target;
+	uint8_t      pixel[4];
+	uint32_t     pixel_size;
+	uint8_t      *data;
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+
+	if (!(clear_flags & GS_CLEAR_COLOR) || !target)
+		return;
+
+	switch (target->format) {
+	case GS_RGBA:
+		pixel[0] = color_to_byte(color->x);
+		pixel[1] = color_to_byte(color->y);
+		pixel[2] = color_to_byte(color->z);
+		pixel[3] = color_to_byte(color->w);
+		pixel_size = 4;
+		break;
+	case GS_BGRA:
+	case GS_BGRX:
+		pixel[0] = color_to_byte(color->z);
+		pixel[1] = color_to_byte(color->y);
+		pixel[2] = color_to_byte(color->x);
+		pixel[3] = color_to_byte(color->w);
+		pixel_size = 4;
+		break;
+	case GS_A8:
+		pixel[0] = color_to_byte(color->w);
+		pixel_size = 1;
+		break;
+	case GS_R8:
+		pixel[0] = color_to_byte(color->x);
+		pixel_size = 1;
+		break;
+	default:
+		return;
+	}
+
+	data = target->data + (size_t)target->linesize * target->height *
+		(size_t)device->cur_render_side;
+
+	if (pixel_size == 1 || (!pixel[0] && !pixel[1] && !pixel[2] &&
+				!pixel[3])) {
+		memset(data, pixel[0], (size_t)target->linesize *
+				target->height);
+		return;
+	}
+
+	for (uint32_t x = 0; x < target->width; x++)
+		memcpy(data + x * pixel_size, pixel, pixel_size);
+	for (uint32_t y = 1; y < target->height; y++)
+		memcpy(data + y * target->linesize, data, target->linesize);
+}
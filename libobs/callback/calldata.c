@@ -17,6 +17,7 @@
 #include <string.h>
 
 #include "../util/bmem.h"
+#include "../util/base.h"
 
 #include "calldata.h"
 
@@ -37,7 +38,8 @@
  *     [size_t    0]
  *
  *   Strings and string sizes always include the null terminator to allow for
- * direct referencing.
+ * direct referencing.  Since name sizes are stored, lookups compare sizes
+ * first and only compare characters of names that could match.
  */
 
 static inline void cd_serialize(uint8_t **pos, void *ptr, size_t size)
@@ -65,7 +67,7 @@ static inline const char *cd_serialize_string(uint8_t **pos)
 }
 
 static bool cd_getparam(const calldata_t *data, const char *name,
-		uint8_t **pos)
+		size_t name_len, uint8_t **pos)
 {
 	size_t name_size;
 
@@ -80,7 +82,8 @@ static bool cd_getparam(const calldata_t *data, const char *name,
 		size_t param_size;
 
 		*pos += name_size;
-		if (strcmp(param_name, name) == 0)
+		if (name_size == name_len &&
+		    memcmp(param_name, name, name_len) == 0)
 			return true;
 
 		param_size = cd_serialize_size(pos);
@@ -116,11 +119,10 @@ static inline void cd_copy_data(uint8_t **pos, const void *in, size_t size)
 }
 
 static inline void cd_set_first_param(calldata_t *data, const char *name,
-		const void *in, size_t size)
+		size_t name_len, const void *in, size_t size)
 {
 	uint8_t *pos;
 	size_t capacity;
-	size_t name_len = strlen(name)+1;
 
 	capacity = sizeof(size_t)*3 + name_len + size;
 	data->size = capacity;
@@ -137,14 +139,22 @@ static inline void cd_set_first_param(calldata_t *data, const char *name,
 	memset(pos, 0, sizeof(size_t));
 }
 
-static inline void cd_ensure_capacity(calldata_t *data, uint8_t **pos,
+static inline bool cd_ensure_capacity(calldata_t *data, uint8_t **pos,
 		size_t new_size)
 {
 	size_t offset;
 	size_t new_capacity;
 
 	if (new_size < data->capacity)
-		return;
+		return true;
+
+	if (data->fixed) {
+		blog(LOG_ERROR, "calldata: Fixed stack of %u bytes is too "
+		                "small (%u bytes needed)",
+		                (unsigned)data->capacity,
+		                (unsigned)new_size + 1);
+		return false;
+	}
 
 	offset = *pos - data->stack;
 
@@ -156,20 +166,18 @@ static inline void cd_ensure_capacity(calldata_t *data, uint8_t **pos,
 	data->capacity = new_capacity;
 
 	*pos = data->stack + offset;
+	return true;
 }
 
 /* ------------------------------------------------------------------------- */
 
-bool calldata_get_data(const calldata_t *data, const char *name, void *out,
-		size_t size)
+static bool cd_get_data(const calldata_t *data, const char *name,
+		size_t name_len, void *out, size_t size)
 {
 	uint8_t *pos;
 	size_t data_size;
 
-	if (!data || !name || !*name)
-		return false;
-
-	if (!cd_getparam(data, name, &pos))
+	if (!cd_getparam(data, name, name_len, &pos))
 		return false;
 
 	data_size = cd_serialize_size(&pos);
@@ -180,20 +188,17 @@ bool calldata_get_data(const calldata_t *data, const char *name, void *out,
 	return true;
 }
 
-void calldata_set_data(calldata_t *data, const char *name, const void *in,
-		size_t size)
+static void cd_set_data(calldata_t *data, const char *name, size_t name_len,
+		const void *in, size_t size)
 {
 	uint8_t *pos = NULL;
 
-	if (!data || !name || !*name)
-		return;
-
 	if (!data->stack) {
-		cd_set_first_param(data, name, in, size);
+		cd_set_first_param(data, name, name_len, in, size);
 		return;
 	}
 
-	if (cd_getparam(data, name, &pos)) {
+	if (cd_getparam(data, name, name_len, &pos)) {
 		size_t cur_size;
 		memcpy(&cur_size, pos, sizeof(size_t));
 
@@ -201,7 +206,8 @@ void calldata_set_data(calldata_t *data, const char *name, const void *in,
 			size_t offset = size - cur_size;
 			size_t bytes = data->size;
 
-			cd_ensure_capacity(data, &pos, bytes + offset);
+			if (!cd_ensure_capacity(data, &pos, bytes + offset))
+				return;
 			memmove(pos+offset, pos, bytes - (pos - data->stack));
 			data->size += offset;
 
@@ -216,17 +222,53 @@ void calldata_set_data(calldata_t *data, const char *name, const void *in,
 		cd_copy_data(&pos, in, size);
 
 	} else {
-		size_t name_len = strlen(name)+1;
 		size_t offset = name_len + size + sizeof(size_t)*2;
-		cd_ensure_capacity(data, &pos, data->size + offset);
+		if (!cd_ensure_capacity(data, &pos, data->size + offset))
+			return;
 		data->size += offset;
 
-		cd_copy_string(&pos, name, 0);
+		cd_copy_string(&pos, name, name_len);
 		cd_copy_data(&pos, in, size);
 		memset(pos, 0, sizeof(size_t));
 	}
 }
 
+bool calldata_get_data(const calldata_t *data, const char *name, void *out,
+		size_t size)
+{
+	if (!data || !name || !*name)
+		return false;
+
+	return cd_get_data(data, name, strlen(name)+1, out, size);
+}
+
+void calldata_set_data(calldata_t *data, const char *name, const void *in,
+		size_t size)
+{
+	if (!data || !name || !*name)
+		return;
+
+	cd_set_data(data, name, strlen(name)+1, in, size);
+}
+
+bool calldata_get_data_key(const calldata_t *data,
+		const struct calldata_key *key, void *out, size_t size)
+{
+	if (!data || !key || key->size < 2)
+		return false;
+
+	return cd_get_data(data, key->name, key->size, out, size);
+}
+
+void calldata_set_data_key(calldata_t *data, const struct calldata_key *key,
+		const void *in, size_t size)
+{
+	if (!data || !key || key->size < 2)
+		return;
+
+	cd_set_data(data, key->name, key->size, in, size);
+}
+
 bool calldata_get_string(const calldata_t *data, const char *name,
 		const char **str)
 {
@@ -234,7 +276,7 @@ bool calldata_get_string(const calldata_t *data, const char *name,
 	if (!data || !name || !*name)
 		return false;
 
-	if (!cd_getparam(data, name, &pos))
+	if (!cd_getparam(data, name, strlen(name)+1, &pos))
 		return false;
 
 	*str = cd_serialize_string(&pos);
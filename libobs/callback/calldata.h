@@ -47,6 +47,7 @@ struct calldata {
 	size_t  size;     /* size of the stack, in bytes */
 	size_t  capacity; /* capacity of the stack, in bytes */
 	uint8_t *stack;
+	bool    fixed;    /* stack is owned by the caller and never resized */
 };
 
 typedef struct calldata calldata_t;
@@ -58,7 +59,8 @@ static inline void calldata_init(struct calldata *data)
 
 static inline void calldata_free(struct calldata *data)
 {
-	bfree(data->stack);
+	if (!data->fixed)
+		bfree(data->stack);
 }
 
 EXPORT bool calldata_get_data(const calldata_t *data, const char *name,
@@ -66,6 +68,26 @@ EXPORT bool calldata_get_data(const calldata_t *data, const char *name,
 EXPORT void calldata_set_data(calldata_t *data, const char *name,
 		const void *in, size_t new_size);
 
+/*
+ * A parameter name with its size worked out at compile time, for signals that
+ * are emitted often enough that measuring the name on every set and get adds
+ * up.  Parameters set with a key can be read back by name and vice versa:
+ *
+ *   static const struct calldata_key key_source = CALLDATA_KEY("source");
+ *   calldata_set_ptr_key(&data, &key_source, source);
+ */
+struct calldata_key {
+	const char *name;
+	size_t     size; /* including the null terminator */
+};
+
+#define CALLDATA_KEY(name) {name, sizeof(name)}
+
+EXPORT bool calldata_get_data_key(const calldata_t *data,
+		const struct calldata_key *key, void *out, size_t size);
+EXPORT void calldata_set_data_key(calldata_t *data,
+		const struct calldata_key *key, const void *in, size_t size);
+
 static inline void calldata_clear(struct calldata *data)
 {
 	if (data->stack) {
@@ -74,6 +96,21 @@ static inline void calldata_clear(struct calldata *data)
 	}
 }
 
+/*
+ * Initializes calldata on a caller-owned buffer (typically on the stack) so
+ * that emitting a signal does not touch the heap.  The buffer is never
+ * reallocated or freed; parameters that do not fit are dropped with an error,
+ * so size it for the signal being emitted.  calldata_free is optional.
+ */
+static inline void calldata_init_fixed(struct calldata *data, uint8_t *stack,
+		size_t size)
+{
+	data->stack    = stack;
+	data->capacity = size;
+	data->fixed    = true;
+	calldata_clear(data);
+}
+
 /* ------------------------------------------------------------------------- */
 /* NOTE: 'get' functions return true only if paramter exists, and is the
  *       same type.  They return false otherwise. */
@@ -179,6 +216,65 @@ static inline void calldata_set_string(calldata_t *data, const char *name,
 		calldata_set_data(data, name, NULL, 0);
 }
 
+/* ------------------------------------------------------------------------- */
+/* same as above, for parameters named with a calldata_key */
+
+static inline long long calldata_int_key(const calldata_t *data,
+		const struct calldata_key *key)
+{
+	long long val = 0;
+	calldata_get_data_key(data, key, &val, sizeof(val));
+	return val;
+}
+
+static inline double calldata_float_key(const calldata_t *data,
+		const struct calldata_key *key)
+{
+	double val = 0.0;
+	calldata_get_data_key(data, key, &val, sizeof(val));
+	return val;
+}
+
+static inline bool calldata_bool_key(const calldata_t *data,
+		const struct calldata_key *key)
+{
+	bool val = false;
+	calldata_get_data_key(data, key, &val, sizeof(val));
+	return val;
+}
+
+static inline void *calldata_ptr_key(const calldata_t *data,
+		const struct calldata_key *key)
+{
+	void *val = NULL;
+	calldata_get_data_key(data, key, &val, sizeof(val));
+	return val;
+}
+
+static inline void calldata_set_int_key   (calldata_t *data,
+		const struct calldata_key *key, long long val)
+{
+	calldata_set_data_key(data, key, &val, sizeof(val));
+}
+
+static inline void calldata_set_float_key (calldata_t *data,
+		const struct calldata_key *key, double val)
+{
+	calldata_set_data_key(data, key, &val, sizeof(val));
+}
+
+static inline void calldata_set_bool_key  (calldata_t *data,
+		const struct calldata_key *key, bool val)
+{
+	calldata_set_data_key(data, key, &val, sizeof(val));
+}
+
+static inline void calldata_set_ptr_key   (calldata_t *data,
+		const struct calldata_key *key, void *ptr)
+{
+	calldata_set_data_key(data, key, &ptr, sizeof(ptr));
+}
+
 #ifdef __cplusplus
 }
 #endif
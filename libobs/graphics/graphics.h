@@ -503,6 +503,14 @@ EXPORT gs_shader_t *gs_pixelshader_create_from_file(const char *file,
 
 EXPORT gs_texture_t *gs_texture_create_from_file(const char *file);
 
+/**
+ * Decodes an image file to memory without creating a texture, so it can be
+ * called from any thread without entering the graphics context.  Returns the
+ * pixel data (cx * 4 bytes per row), which must be freed with bfree.
+ */
+EXPORT uint8_t *gs_create_texture_file_data(const char *file,
+		enum gs_color_format *format, uint32_t *cx, uint32_t *cy);
+
 #define GS_FLIP_U (1<<0)
 #define GS_FLIP_V (1<<1)
 
@@ -16,11 +16,19 @@
 ******************************************************************************/
 
 #include <math.h>
+#include <limits.h>
 #include <inttypes.h>
 
+#if defined(_M_IX86) || defined(_M_X64) || \
+    defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define AUDIO_MIX_X86
+#endif
+
 #include "../util/threading.h"
 #include "../util/darray.h"
 #include "../util/circlebuf.h"
+#include "../util/spscbuf.h"
 #include "../util/platform.h"
 #include "../util/profiler.h"
 
@@ -46,13 +54,33 @@ static inline void audio_input_free(struct audio_input *input)
 	audio_resampler_destroy(input->resampler);
 }
 
+/* header of each packet of audio data queued in an audio line's input ring,
+ * followed by the (volume-adjusted) data of each plane */
+struct audio_line_packet {
+	uint64_t                   timestamp;
+	uint32_t                   frames;
+	uint32_t                   reserved;
+};
+
+/* input rings hold this much audio, packets past that are dropped */
+#define LINE_INPUT_BUFFER_MS 1000
+
+/* packet records are kept 16-byte aligned within the input ring */
+#define LINE_PACKET_ALIGN 16
+
 struct audio_line {
 	char                       *name;
 
 	struct audio_output        *audio;
+
+	/* the source's audio thread writes packets in to the input ring
+	 * without locking, and the audio thread drains them in to the
+	 * buffers below before mixing.  everything other than the input ring
+	 * and input_overflow is only touched by the audio thread. */
+	struct spscbuf             input;
+	bool                       input_overflow;
+
 	struct circlebuf           buffers[MAX_AV_PLANES];
-	pthread_mutex_t            mutex;
-	DARRAY(uint8_t)            volume_buffers[MAX_AV_PLANES];
 	uint64_t                   base_timestamp;
 	uint64_t                   last_timestamp;
 
@@ -72,27 +100,49 @@ struct audio_line {
 	 * the circular buffer */
 	bool                       audio_data_out_of_bounds;
 
+	/* deadline scheduling (protected by audio->block_mutex): end of the
+	 * data pushed so far, end timestamp of the block currently being
+	 * waited on, and whether this line has data up to it yet */
+	uint64_t                   pushed_end_ts;
+	uint64_t                   block_end_ts;
+	bool                       block_ready;
+
 	struct audio_line          **prev_next;
 	struct audio_line          *next;
 };
 
 static inline void audio_line_destroy_data(struct audio_line *line)
 {
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		circlebuf_free(&line->buffers[i]);
-		da_free(line->volume_buffers[i]);
-	}
 
-	pthread_mutex_destroy(&line->mutex);
+	spscbuf_free(&line->input);
 	bfree(line->name);
 	bfree(line);
 }
 
 struct audio_mix {
+	/* each mix has its own input mutex so that mixes can be output on
+	 * separate threads.  recursive, as input callbacks may disconnect
+	 * themselves. */
+	pthread_mutex_t            input_mutex;
 	DARRAY(struct audio_input) inputs;
 	DARRAY(uint8_t)            mix_buffers[MAX_AV_PLANES];
+
+	const char                 *profile_name;
 };
 
+struct audio_output_worker {
+	struct audio_output        *audio;
+	size_t                     mix_idx;
+	pthread_t                  thread;
+	os_sem_t                   *start_sem;
+	const char                 *profile_name;
+};
+
+typedef void (*mix_floats_t)(float *dst, const float *src, size_t count);
+typedef void (*clamp_floats_t)(float *data, size_t count);
+
 struct audio_output {
 	struct audio_output_info   info;
 	size_t                     block_size;
@@ -102,14 +152,36 @@ struct audio_output {
 	pthread_t                  thread;
 	os_event_t                 *stop_event;
 
+	/* when non-zero, the audio thread outputs fixed blocks of this many
+	 * frames on absolute deadlines instead of polling */
+	volatile long              block_frames;
+
+	/* lines still missing data for the next block, or LONG_MAX while no
+	 * block has been published with prepare_next_block */
+	volatile long              lines_pending;
+	os_event_t                 *wake_event;
+	pthread_mutex_t            block_mutex;
+
 	bool                       initialized;
 
 	pthread_mutex_t            line_mutex;
 	struct audio_line          *first_line;
 
-	pthread_mutex_t            input_mutex;
-
 	struct audio_mix           mixes[MAX_AUDIO_MIXES];
+
+	/* optional per-mix output workers, created by the audio thread the
+	 * first time parallel output is enabled */
+	volatile bool              parallel_output;
+	bool                       workers_initialized;
+	bool                       workers_stopping;
+	struct audio_output_worker workers[MAX_AUDIO_MIXES];
+	os_sem_t                   *workers_done_sem;
+	uint64_t                   output_timestamp;
+	uint32_t                   output_frames;
+
+	/* mixing kernels, selected according to the CPU on open */
+	mix_floats_t               mix_floats;
+	clamp_floats_t             clamp_floats;
 };
 
 static inline void audio_output_removeline(struct audio_output *audio,
@@ -211,38 +283,166 @@ static inline size_t min_size(size_t a, size_t b)
 	((val > maxval) ? maxval : ((val < minval) ? minval : val))
 #endif
 
-#define MIX_BUFFER_SIZE 256
+/* ------------------------------------------------------------------------- */
+/* mixing kernels.  all loads/stores are unaligned because mix offsets are
+ * only guaranteed to be sample-aligned. */
+
+static void mix_floats_c(float *dst, const float *src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i];
+}
+
+static void clamp_floats_c(float *data, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		float val = data[i];
+		val = (val >  1.0f) ?  1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		data[i] = val;
+	}
+}
+
+#ifdef AUDIO_MIX_X86
+
+#ifdef _MSC_VER
+#define TARGET_AVX
+#else
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+
+static void mix_floats_sse(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a0 = _mm_loadu_ps(dst + i);
+		__m128 a1 = _mm_loadu_ps(dst + i + 4);
+		__m128 b0 = _mm_loadu_ps(src + i);
+		__m128 b1 = _mm_loadu_ps(src + i + 4);
+		_mm_storeu_ps(dst + i,     _mm_add_ps(a0, b0));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(a1, b1));
+	}
+
+	mix_floats_c(dst + i, src + i, count - i);
+}
+
+static void clamp_floats_sse(float *data, size_t count)
+{
+	const __m128 max_val = _mm_set1_ps( 1.0f);
+	const __m128 min_val = _mm_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 val = _mm_loadu_ps(data + i);
+		val = _mm_min_ps(val, max_val);
+		val = _mm_max_ps(val, min_val);
+		_mm_storeu_ps(data + i, val);
+	}
+
+	clamp_floats_c(data + i, count - i);
+}
+
+static TARGET_AVX void mix_floats_avx(float *dst, const float *src,
+		size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256 a0 = _mm256_loadu_ps(dst + i);
+		__m256 a1 = _mm256_loadu_ps(dst + i + 8);
+		__m256 b0 = _mm256_loadu_ps(src + i);
+		__m256 b1 = _mm256_loadu_ps(src + i + 8);
+		_mm256_storeu_ps(dst + i,     _mm256_add_ps(a0, b0));
+		_mm256_storeu_ps(dst + i + 8, _mm256_add_ps(a1, b1));
+	}
+
+	/* avoid AVX-SSE transition penalties before the tail */
+	_mm256_zeroupper();
+	mix_floats_c(dst + i, src + i, count - i);
+}
+
+static TARGET_AVX void clamp_floats_avx(float *data, size_t count)
+{
+	const __m256 max_val = _mm256_set1_ps( 1.0f);
+	const __m256 min_val = _mm256_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 val = _mm256_loadu_ps(data + i);
+		val = _mm256_min_ps(val, max_val);
+		val = _mm256_max_ps(val, min_val);
+		_mm256_storeu_ps(data + i, val);
+	}
+
+	_mm256_zeroupper();
+	clamp_floats_c(data + i, count - i);
+}
+
+#endif
+
+static const char *select_mix_kernels(struct audio_output *audio)
+{
+#ifdef AUDIO_MIX_X86
+	uint32_t features = os_get_cpu_features();
+
+	if (features & OS_CPU_AVX) {
+		audio->mix_floats   = mix_floats_avx;
+		audio->clamp_floats = clamp_floats_avx;
+		return "AVX";
+
+	} else if (features & OS_CPU_SSE2) {
+		audio->mix_floats   = mix_floats_sse;
+		audio->clamp_floats = clamp_floats_sse;
+		return "SSE2";
+	}
+#endif
+
+	audio->mix_floats   = mix_floats_c;
+	audio->clamp_floats = clamp_floats_c;
+	return "C";
+}
+
+/* ------------------------------------------------------------------------- */
 
-/* TODO: optimize mixing */
 static void mix_float(struct audio_output *audio, struct audio_line *line,
 		size_t size, size_t time_offset, size_t plane)
 {
+	struct circlebuf *buf = &line->buffers[plane];
 	float *mixes[MAX_AUDIO_MIXES];
-	float vals[MIX_BUFFER_SIZE];
+	size_t num_mixes = 0;
+	void   *spans[2];
+	size_t span_sizes[2];
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		uint8_t *bytes = audio->mixes[mix_idx].mix_buffers[plane].array;
-		mixes[mix_idx] = (float*)&bytes[time_offset];
-	}
+		uint8_t *bytes;
 
-	while (size) {
-		size_t pop_count = min_size(size, sizeof(vals));
-		size -= pop_count;
+		/* only include this audio line in this mix if it's set
+		 * via the line's 'mixes' variable */
+		if ((line->mixers & (1 << mix_idx)) == 0)
+			continue;
 
-		circlebuf_pop_front(&line->buffers[plane], vals, pop_count);
-		pop_count /= sizeof(float);
+		bytes = audio->mixes[mix_idx].mix_buffers[plane].array;
+		mixes[num_mixes++] = (float*)&bytes[time_offset];
+	}
 
-		for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-			/* only include this audio line in this mix if it's set
-			 * via the line's 'mixes' variable */
-			if ((line->mixers & (1 << mix_idx)) == 0)
-				continue;
+	/* mix directly from the circular buffer's storage rather than
+	 * bouncing the data through an intermediate copy */
+	circlebuf_peek_front_spans(buf, size, &spans[0], &span_sizes[0],
+			&spans[1], &span_sizes[1]);
 
-			for (size_t i = 0; i < pop_count; i++) {
-				*(mixes[mix_idx]++) += vals[i];
-			}
+	for (size_t i = 0; i < 2; i++) {
+		size_t count = span_sizes[i] / sizeof(float);
+		if (!count)
+			continue;
+
+		for (size_t mix_idx = 0; mix_idx < num_mixes; mix_idx++) {
+			audio->mix_floats(mixes[mix_idx], spans[i], count);
+			mixes[mix_idx] += count;
 		}
 	}
+
+	circlebuf_pop_front(buf, NULL, size);
 }
 
 static inline bool mix_audio_line(struct audio_output *audio,
@@ -307,7 +507,7 @@ static inline void do_audio_output(struct audio_output *audio,
 	data.timestamp = timestamp;
 	data.volume = 1.0f;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	pthread_mutex_lock(&mix->input_mutex);
 
 	for (size_t i = mix->inputs.num; i > 0; i--) {
 		struct audio_input *input = mix->inputs.array+(i-1);
@@ -316,7 +516,149 @@ static inline void do_audio_output(struct audio_output *audio,
 			input->callback(input->param, mix_idx, &data);
 	}
 
-	pthread_mutex_unlock(&audio->input_mutex);
+	pthread_mutex_unlock(&mix->input_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* parallel mix output: each active mix is resampled and sent to its inputs on
+ * its own worker, and the audio thread waits for all of them before the next
+ * tick */
+
+static void *audio_output_worker_thread(void *param)
+{
+	struct audio_output_worker *worker = param;
+	struct audio_output *audio = worker->audio;
+
+	os_set_thread_name("audio-io: mix output worker");
+
+	for (;;) {
+		os_sem_wait(worker->start_sem);
+		if (audio->workers_stopping)
+			break;
+
+		profile_start(worker->profile_name);
+		do_audio_output(audio, worker->mix_idx,
+				audio->output_timestamp, audio->output_frames);
+		profile_end(worker->profile_name);
+
+		os_sem_post(audio->workers_done_sem);
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
+static bool init_output_workers(struct audio_output *audio)
+{
+	if (os_sem_init(&audio->workers_done_sem, 0) != 0)
+		return false;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		struct audio_output_worker *worker = &audio->workers[i];
+
+		worker->audio   = audio;
+		worker->mix_idx = i;
+		worker->profile_name =
+			profile_store_name(obs_get_profiler_name_store(),
+					"audio_output_worker(%s, mix %d)",
+					audio->info.name, (int)i);
+
+		if (os_sem_init(&worker->start_sem, 0) != 0)
+			return false;
+		if (pthread_create(&worker->thread, NULL,
+					audio_output_worker_thread,
+					worker) != 0) {
+			os_sem_destroy(worker->start_sem);
+			worker->start_sem = NULL;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void free_output_workers(struct audio_output *audio)
+{
+	audio->workers_stopping = true;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		struct audio_output_worker *worker = &audio->workers[i];
+		void *thread_ret;
+
+		if (!worker->start_sem)
+			continue;
+
+		os_sem_post(worker->start_sem);
+		pthread_join(worker->thread, &thread_ret);
+		os_sem_destroy(worker->start_sem);
+		worker->start_sem = NULL;
+	}
+
+	os_sem_destroy(audio->workers_done_sem);
+	audio->workers_done_sem = NULL;
+}
+
+static inline bool use_output_workers(struct audio_output *audio)
+{
+	if (!audio->parallel_output || audio->workers_stopping)
+		return false;
+
+	if (!audio->workers_initialized) {
+		audio->workers_initialized = true;
+
+		if (!init_output_workers(audio)) {
+			blog(LOG_ERROR, "audio_output: Failed to create mix "
+			                "output workers, falling back to "
+			                "serial output");
+			free_output_workers(audio);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* inputs can be connected and disconnected from any thread */
+static inline bool mix_active(struct audio_mix *mix)
+{
+	bool active;
+
+	pthread_mutex_lock(&mix->input_mutex);
+	active = mix->inputs.num != 0;
+	pthread_mutex_unlock(&mix->input_mutex);
+
+	return active;
+}
+
+static void output_mixes(struct audio_output *audio, uint64_t timestamp,
+		uint32_t frames)
+{
+	size_t active[MAX_AUDIO_MIXES];
+	size_t num_active = 0;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if (mix_active(&audio->mixes[i]))
+			active[num_active++] = i;
+	}
+
+	if (num_active > 1 && use_output_workers(audio)) {
+		audio->output_timestamp = timestamp;
+		audio->output_frames    = frames;
+
+		for (size_t i = 0; i < num_active; i++)
+			os_sem_post(audio->workers[active[i]].start_sem);
+		for (size_t i = 0; i < num_active; i++)
+			os_sem_wait(audio->workers_done_sem);
+		return;
+	}
+
+	for (size_t i = 0; i < num_active; i++) {
+		struct audio_mix *mix = &audio->mixes[active[i]];
+
+		profile_start(mix->profile_name);
+		do_audio_output(audio, active[i], timestamp, frames);
+		profile_end(mix->profile_name);
+	}
 }
 
 static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
@@ -327,23 +669,23 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		/* do not process mixing if a specific mix is inactive */
-		if (!mix->inputs.num)
+		if (!mix_active(mix))
 			continue;
 
 		for (size_t plane = 0; plane < audio->planes; plane++) {
 			float *mix_data = (float*)mix->mix_buffers[plane].array;
-			float *mix_end = &mix_data[float_size];
-
-			while (mix_data < mix_end) {
-				float val = *mix_data;
-				val = (val >  1.0f) ?  1.0f : val;
-				val = (val < -1.0f) ? -1.0f : val;
-				*(mix_data++) = val;
-			}
+			audio->clamp_floats(mix_data, float_size);
 		}
 	}
 }
 
+static void audio_line_drain(struct audio_line *line, uint64_t prev_time);
+
+static const char *mix_audio_lines_name = "mix_audio_lines";
+static const char *audio_line_drain_name = "audio_line_drain";
+static const char *clamp_audio_output_name = "clamp_audio_output";
+static const char *do_audio_output_name = "do_audio_output";
+
 static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 		uint64_t prev_time)
 {
@@ -372,9 +714,15 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 	}
 
 	/* mix audio lines */
+	profile_start(mix_audio_lines_name);
+
 	while (line) {
 		struct audio_line *next = line->next;
 
+		profile_start(audio_line_drain_name);
+		audio_line_drain(line, prev_time);
+		profile_end(audio_line_drain_name);
+
 		/* if line marked for removal, destroy and move to the next */
 		if (!line->buffers[0].size) {
 			if (!line->alive) {
@@ -384,8 +732,6 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 			}
 		}
 
-		pthread_mutex_lock(&line->mutex);
-
 		if (line->buffers[0].size && line->base_timestamp < prev_time) {
 			clear_excess_audio_data(line, prev_time);
 			line->base_timestamp = prev_time;
@@ -400,17 +746,20 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 		if (mix_audio_line(audio, line, bytes, prev_time))
 			line->base_timestamp = audio_time;
 
-		pthread_mutex_unlock(&line->mutex);
-
 		line = next;
 	}
 
+	profile_end(mix_audio_lines_name);
+
 	/* clamps audio data to -1.0..1.0 */
+	profile_start(clamp_audio_output_name);
 	clamp_audio_output(audio, bytes);
+	profile_end(clamp_audio_output_name);
 
 	/* output */
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, prev_time, frames);
+	profile_start(do_audio_output_name);
+	output_mixes(audio, prev_time, frames);
+	profile_end(do_audio_output_name);
 
 	return audio_time;
 }
@@ -418,6 +767,140 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 /* sample audio 40 times a second */
 #define AUDIO_WAIT_TIME (1000/40)
 
+static inline uint64_t line_buffered_end_ts(const struct audio_line *line)
+{
+	const struct audio_output *audio = line->audio;
+	uint32_t frames = (uint32_t)(line->buffers[0].size / audio->block_size);
+
+	return line->base_timestamp + conv_frames_to_time(audio, frames);
+}
+
+/* called from audio_line_output after a packet has been pushed.  wakes the
+ * audio thread early once every line has data up to the end of the block
+ * being waited on. */
+static void check_line_block_ready(struct audio_line *line, uint64_t end_ts)
+{
+	struct audio_output *audio = line->audio;
+
+	pthread_mutex_lock(&audio->block_mutex);
+
+	if (end_ts > line->pushed_end_ts)
+		line->pushed_end_ts = end_ts;
+
+	if (line->block_end_ts && !line->block_ready &&
+	    line->pushed_end_ts >= line->block_end_ts) {
+		line->block_ready = true;
+		if (os_atomic_dec_long(&audio->lines_pending) == 0)
+			os_event_signal(audio->wake_event);
+	}
+
+	pthread_mutex_unlock(&audio->block_mutex);
+}
+
+/* publishes the end of the next block to each line and counts the lines that
+ * do not yet have data for it.  line_mutex must be held. */
+static long prepare_next_block(struct audio_output *audio, uint64_t block_end)
+{
+	struct audio_line *line = audio->first_line;
+	long pending = 0;
+
+	pthread_mutex_lock(&audio->block_mutex);
+
+	while (line) {
+		uint64_t end_ts = line_buffered_end_ts(line);
+		if (line->pushed_end_ts > end_ts)
+			end_ts = line->pushed_end_ts;
+
+		line->block_end_ts = block_end;
+		line->block_ready  = end_ts >= block_end;
+		if (!line->block_ready)
+			pending++;
+
+		line = line->next;
+	}
+
+	audio->lines_pending = pending;
+
+	pthread_mutex_unlock(&audio->block_mutex);
+	return pending;
+}
+
+/* withdraws the published block so that nothing can wake the audio thread
+ * before the deadline.  line_mutex must be held. */
+static void clear_next_block(struct audio_output *audio)
+{
+	struct audio_line *line = audio->first_line;
+
+	pthread_mutex_lock(&audio->block_mutex);
+
+	while (line) {
+		line->block_end_ts = 0;
+		line->block_ready  = false;
+		line = line->next;
+	}
+
+	audio->lines_pending = LONG_MAX;
+
+	pthread_mutex_unlock(&audio->block_mutex);
+}
+
+/* waits until the wall-clock deadline of the block ending at block_end, or
+ * until all lines have data for that block, whichever comes first */
+static void wait_for_block(struct audio_output *audio, uint64_t block_end,
+		uint64_t buffer_time)
+{
+	uint64_t deadline = block_end + buffer_time;
+	uint64_t t;
+
+	while ((t = os_gettime_ns()) < deadline) {
+		unsigned long wait_ms =
+			(unsigned long)((deadline - t) / 1000000);
+
+		if (!wait_ms) {
+			os_sleepto_ns(deadline);
+			break;
+		}
+
+		if (os_event_timedwait(audio->wake_event, wait_ms) == 0) {
+			if (os_event_try(audio->stop_event) != EAGAIN ||
+			    os_atomic_load_long(&audio->lines_pending) <= 0)
+				break;
+		}
+	}
+}
+
+static uint64_t mix_blocks(struct audio_output *audio, uint64_t prev_time,
+		uint64_t buffer_time, uint32_t block_frames)
+{
+	uint64_t block_time = conv_frames_to_time(audio, block_frames);
+	uint64_t audio_time = os_gettime_ns() - buffer_time;
+	uint64_t block_end;
+	long pending;
+
+	/* always output at least one block: either the deadline for it has
+	 * been reached or every line already has its data */
+	do {
+		block_end = prev_time + block_time;
+		prev_time = mix_and_output(audio, block_end, prev_time);
+	} while (prev_time + block_time <= audio_time);
+
+	/* only allow waking early for the next block if that would not put
+	 * output more than one block ahead of its deadline, otherwise the
+	 * audio buffering time would effectively be eaten away */
+	if (prev_time > audio_time) {
+		clear_next_block(audio);
+		return prev_time;
+	}
+
+	pending = prepare_next_block(audio, prev_time + block_time);
+	if (!pending)
+		os_event_signal(audio->wake_event);
+
+	return prev_time;
+}
+
+static const char *line_mutex_wait_name = "line_mutex_wait";
+
 static void *audio_thread(void *param)
 {
 	struct audio_output *audio = param;
@@ -432,13 +915,31 @@ static void *audio_thread(void *param)
 				"audio_thread(%s)", audio->info.name);
 	
 	while (os_event_try(audio->stop_event) == EAGAIN) {
-		os_sleep_ms(AUDIO_WAIT_TIME);
+		uint32_t block_frames = (uint32_t)audio->block_frames;
+
+		if (block_frames)
+			wait_for_block(audio, prev_time +
+					conv_frames_to_time(audio,
+						block_frames),
+					buffer_time);
+		else
+			os_sleep_ms(AUDIO_WAIT_TIME);
 
 		profile_start(audio_thread_name);
+
+		profile_start(line_mutex_wait_name);
 		pthread_mutex_lock(&audio->line_mutex);
+		profile_end(line_mutex_wait_name);
+
+		if (block_frames) {
+			audio_time = mix_blocks(audio, prev_time, buffer_time,
+					block_frames);
+		} else {
+			audio_time = os_gettime_ns() - buffer_time;
+			audio_time = mix_and_output(audio, audio_time,
+					prev_time);
+		}
 
-		audio_time = os_gettime_ns() - buffer_time;
-		audio_time = mix_and_output(audio, audio_time, prev_time);
 		prev_time  = audio_time;
 
 		pthread_mutex_unlock(&audio->line_mutex);
@@ -506,10 +1007,11 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 
 	if (!audio || mi >= MAX_AUDIO_MIXES) return false;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	struct audio_mix *mix = &audio->mixes[mi];
+
+	pthread_mutex_lock(&mix->input_mutex);
 
 	if (audio_get_input_idx(audio, mi, callback, param) == DARRAY_INVALID) {
-		struct audio_mix *mix = &audio->mixes[mi];
 		struct audio_input input;
 		input.callback = callback;
 		input.param    = param;
@@ -536,7 +1038,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 			da_push_back(mix->inputs, &input);
 	}
 
-	pthread_mutex_unlock(&audio->input_mutex);
+	pthread_mutex_unlock(&mix->input_mutex);
 
 	return success;
 }
@@ -546,16 +1048,17 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 {
 	if (!audio || mix_idx >= MAX_AUDIO_MIXES) return;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	struct audio_mix *mix = &audio->mixes[mix_idx];
+
+	pthread_mutex_lock(&mix->input_mutex);
 
 	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param);
 	if (idx != DARRAY_INVALID) {
-		struct audio_mix *mix = &audio->mixes[mix_idx];
 		audio_input_free(mix->inputs.array+idx);
 		da_erase(mix->inputs, idx);
 	}
 
-	pthread_mutex_unlock(&audio->input_mutex);
+	pthread_mutex_unlock(&mix->input_mutex);
 }
 
 static inline bool valid_audio_params(const struct audio_output_info *info)
@@ -579,10 +1082,21 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 
 	memcpy(&out->info, info, sizeof(struct audio_output_info));
 	pthread_mutex_init_value(&out->line_mutex);
+	pthread_mutex_init_value(&out->block_mutex);
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		pthread_mutex_init_value(&out->mixes[i].input_mutex);
+		out->mixes[i].profile_name =
+			profile_store_name(obs_get_profiler_name_store(),
+					"do_audio_output(mix %d)", (int)i);
+	}
 	out->channels   = get_audio_channels(info->speakers);
 	out->planes     = planar ? out->channels : 1;
 	out->block_size = (planar ? 1 : out->channels) *
 	                  get_audio_bytes_per_channel(info->format);
+	out->lines_pending = LONG_MAX;
+
+	blog(LOG_DEBUG, "audio_output_open: using %s mixing kernels",
+			select_mix_kernels(out));
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		goto fail;
@@ -590,10 +1104,16 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail;
 	if (pthread_mutex_init(&out->line_mutex, &attr) != 0)
 		goto fail;
-	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if (pthread_mutex_init(&out->mixes[i].input_mutex, &attr) != 0)
+			goto fail;
+	}
+	if (pthread_mutex_init(&out->block_mutex, NULL) != 0)
 		goto fail;
 	if (os_event_init(&out->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
+	if (os_event_init(&out->wake_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
 	if (pthread_create(&out->thread, NULL, audio_thread, out) != 0)
 		goto fail;
 
@@ -616,9 +1136,13 @@ void audio_output_close(audio_t *audio)
 
 	if (audio->initialized) {
 		os_event_signal(audio->stop_event);
+		os_event_signal(audio->wake_event);
 		pthread_join(audio->thread, &thread_ret);
 	}
 
+	if (audio->workers_initialized)
+		free_output_workers(audio);
+
 	line = audio->first_line;
 	while (line) {
 		struct audio_line *next = line->next;
@@ -636,10 +1160,13 @@ void audio_output_close(audio_t *audio)
 			da_free(mix->mix_buffers[i]);
 
 		da_free(mix->inputs);
+		pthread_mutex_destroy(&mix->input_mutex);
 	}
 
 	os_event_destroy(audio->stop_event);
+	os_event_destroy(audio->wake_event);
 	pthread_mutex_destroy(&audio->line_mutex);
+	pthread_mutex_destroy(&audio->block_mutex);
 	bfree(audio);
 }
 
@@ -649,16 +1176,16 @@ audio_line_t *audio_output_create_line(audio_t *audio, const char *name,
 	if (!audio) return NULL;
 
 	struct audio_line *line = bzalloc(sizeof(struct audio_line));
+	size_t input_size = (size_t)audio->info.samples_per_sec *
+		audio->block_size * audio->planes * LINE_INPUT_BUFFER_MS / 1000;
+
 	line->alive = true;
 	line->audio = audio;
 	line->mixers = mixers;
 
-	if (pthread_mutex_init(&line->mutex, NULL) != 0) {
-		blog(LOG_ERROR, "audio_output_createline: Failed to create "
-		                "mutex");
-		bfree(line);
-		return NULL;
-	}
+	input_size = (input_size + LINE_PACKET_ALIGN - 1) &
+		~(size_t)(LINE_PACKET_ALIGN - 1);
+	spscbuf_init(&line->input, input_size);
 
 	pthread_mutex_lock(&audio->line_mutex);
 
@@ -681,13 +1208,12 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+/* lines are always removed by the audio thread, as it is the only thread that
+ * can tell whether data is still queued up in a line */
 void audio_line_destroy(struct audio_line *line)
 {
 	if (line) {
-		if (!line->buffers[0].size)
-			audio_output_removeline(line->audio, line);
-		else
-			line->alive = false;
+		line->alive = false;
 	}
 }
 
@@ -725,7 +1251,39 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 	return audio ? audio->info.samples_per_sec : 0;
 }
 
-/* TODO: optimize these two functions */
+void audio_output_set_block_frames(audio_t *audio, uint32_t frames)
+{
+	if (!audio) return;
+
+	/* the block the audio thread may be waiting on was sized for the
+	 * previous setting, so don't let it wake early for it */
+	pthread_mutex_lock(&audio->block_mutex);
+	audio->block_frames  = (long)frames;
+	audio->lines_pending = LONG_MAX;
+	pthread_mutex_unlock(&audio->block_mutex);
+
+	os_event_signal(audio->wake_event);
+}
+
+uint32_t audio_output_get_block_frames(const audio_t *audio)
+{
+	return audio ? (uint32_t)audio->block_frames : 0;
+}
+
+void audio_output_set_parallel_output(audio_t *audio, bool parallel)
+{
+	if (audio)
+		audio->parallel_output = parallel;
+}
+
+bool audio_output_parallel_output(const audio_t *audio)
+{
+	return audio ? audio->parallel_output : false;
+}
+
+/* ------------------------------------------------------------------------- */
+/* audio line data, consumer (audio thread) side */
+
 static inline void mul_vol_float(float *array, float volume, size_t count)
 {
 	for (size_t i = 0; i < count; i++)
@@ -733,31 +1291,21 @@ static inline void mul_vol_float(float *array, float volume, size_t count)
 }
 
 static void audio_line_place_data_pos(struct audio_line *line,
-		const struct audio_data *data, size_t position)
+		size_t input_offset, size_t frames, size_t position)
 {
-	bool   planar     = line->audio->planes > 1;
-	size_t total_num  = data->frames * (planar ? 1 : line->audio->channels);
-	size_t total_size = data->frames * line->audio->block_size;
+	size_t total_size = frames * line->audio->block_size;
 
 	for (size_t i = 0; i < line->audio->planes; i++) {
-		da_copy_array(line->volume_buffers[i], data->data[i],
-				total_size);
+		uint8_t *span1, *span2;
+		size_t size1, size2;
 
-		uint8_t *array = line->volume_buffers[i].array;
+		spscbuf_peek_spans(&line->input, input_offset + i * total_size,
+				total_size, &span1, &size1, &span2, &size2);
 
-		switch (line->audio->info.format) {
-		case AUDIO_FORMAT_FLOAT:
-		case AUDIO_FORMAT_FLOAT_PLANAR:
-			mul_vol_float((float*)array, data->volume, total_num);
-			break;
-		default:
-			blog(LOG_ERROR, "audio_line_place_data_pos: "
-			                "Unsupported or unknown format");
-			break;
-		}
-
-		circlebuf_place(&line->buffers[i], position,
-				line->volume_buffers[i].array, total_size);
+		circlebuf_place(&line->buffers[i], position, span1, size1);
+		if (size2)
+			circlebuf_place(&line->buffers[i], position + size1,
+					span2, size2);
 	}
 }
 
@@ -781,10 +1329,10 @@ static inline uint64_t smooth_ts(struct audio_line *line, uint64_t timestamp)
 }
 
 static bool audio_line_place_data(struct audio_line *line,
-		const struct audio_data *data)
+		const struct audio_line_packet *packet, size_t input_offset)
 {
 	int64_t pos;
-	uint64_t timestamp = smooth_ts(line, data->timestamp);
+	uint64_t timestamp = smooth_ts(line, packet->timestamp);
 
 	pos = ts_diff_bytes(line->audio, timestamp, line->base_timestamp);
 
@@ -793,17 +1341,18 @@ static bool audio_line_place_data(struct audio_line *line,
 	}
 
 	line->next_ts_min =
-		timestamp + conv_frames_to_time(line->audio, data->frames);
+		timestamp + conv_frames_to_time(line->audio, packet->frames);
 
 #ifdef DEBUG_AUDIO
 	blog(LOG_DEBUG, "data->timestamp: %llu, line->base_timestamp: %llu, "
 			"pos: %lu, bytes: %lu, buf size: %lu",
 			timestamp, line->base_timestamp, pos,
-			data->frames * line->audio->block_size,
+			packet->frames * line->audio->block_size,
 			line->buffers[0].size);
 #endif
 
-	audio_line_place_data_pos(line, data, (size_t)pos);
+	audio_line_place_data_pos(line, input_offset, packet->frames,
+			(size_t)pos);
 	return true;
 }
 
@@ -818,21 +1367,29 @@ static inline bool valid_timestamp_range(struct audio_line *line, uint64_t ts)
 	return ts >= line->base_timestamp && ts < max_ts;
 }
 
-void audio_line_output(audio_line_t *line, const struct audio_data *data)
+static void audio_line_insert(struct audio_line *line,
+		const struct audio_line_packet *packet, size_t input_offset,
+		uint64_t prev_time)
 {
 	bool inserted_audio = false;
 
-	if (!line || !data) return;
-
-	pthread_mutex_lock(&line->mutex);
-
 	if (!line->buffers[0].size) {
-		line->base_timestamp = data->timestamp -
+		line->base_timestamp = packet->timestamp -
 		                       line->audio->info.buffer_ms * 1000000;
-		inserted_audio = audio_line_place_data(line, data);
 
-	} else if (valid_timestamp_range(line, data->timestamp)) {
-		inserted_audio = audio_line_place_data(line, data);
+		/* the audio thread may have already output slightly past the
+		 * usual buffering point (see mix_blocks), so don't start the
+		 * line in the past when the data itself is still ahead */
+		if (line->base_timestamp < prev_time &&
+		    packet->timestamp >= prev_time)
+			line->base_timestamp = prev_time;
+
+		inserted_audio = audio_line_place_data(line, packet,
+				input_offset);
+
+	} else if (valid_timestamp_range(line, packet->timestamp)) {
+		inserted_audio = audio_line_place_data(line, packet,
+				input_offset);
 	}
 
 	if (!inserted_audio) {
@@ -849,7 +1406,7 @@ void audio_line_output(audio_line_t *line, const struct audio_data *data)
 		                "data->timestamp: %"PRIu64", "
 		                "line->base_timestamp: %"PRIu64".  This can "
 		                "sometimes happen when there's a pause in "
-		                "the threads.", line->name, data->timestamp,
+		                "the threads.", line->name, packet->timestamp,
 		                line->base_timestamp);*/
 
 	} else if (line->audio_data_out_of_bounds) {
@@ -857,8 +1414,117 @@ void audio_line_output(audio_line_t *line, const struct audio_data *data)
 		                  "out of bounds audio data.", line->name);
 		line->audio_data_out_of_bounds = false;
 	}
+}
+
+static inline size_t packet_record_size(const struct audio_output *audio,
+		uint32_t frames)
+{
+	size_t size = sizeof(struct audio_line_packet) +
+		frames * audio->block_size * audio->planes;
+
+	return (size + LINE_PACKET_ALIGN - 1) &
+		~(size_t)(LINE_PACKET_ALIGN - 1);
+}
+
+/* moves all packets queued up by the line's source in to the line buffers */
+static void audio_line_drain(struct audio_line *line, uint64_t prev_time)
+{
+	size_t size = spscbuf_size(&line->input);
+	size_t offset = 0;
+
+	while (offset < size) {
+		struct audio_line_packet packet;
+
+		spscbuf_peek(&line->input, offset, &packet, sizeof(packet));
+		audio_line_insert(line, &packet, offset + sizeof(packet),
+				prev_time);
+
+		offset += packet_record_size(line->audio, packet.frames);
+	}
+
+	if (offset)
+		spscbuf_pop(&line->input, offset);
+}
+
+/* ------------------------------------------------------------------------- */
+/* audio line data, producer (source) side */
+
+static void copy_plane_with_volume(struct audio_line *line, uint8_t *dst,
+		const uint8_t *src, size_t size, float volume)
+{
+	memcpy(dst, src, size);
+
+	switch (line->audio->info.format) {
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		mul_vol_float((float*)dst, volume, size / sizeof(float));
+		break;
+	default:
+		blog(LOG_ERROR, "audio_line_output: "
+		                "Unsupported or unknown format");
+		break;
+	}
+}
+
+static bool audio_line_push(struct audio_line *line,
+		const struct audio_data *data)
+{
+	struct audio_output *audio = line->audio;
+	struct audio_line_packet packet = {data->timestamp, data->frames, 0};
+	size_t plane_size  = data->frames * audio->block_size;
+	size_t record_size = packet_record_size(audio, data->frames);
+	size_t offset = sizeof(packet);
+
+	if (spscbuf_space(&line->input) < record_size)
+		return false;
+
+	spscbuf_write(&line->input, 0, &packet, sizeof(packet));
+
+	for (size_t i = 0; i < audio->planes; i++) {
+		const uint8_t *src = data->data[i];
+		uint8_t *span1, *span2;
+		size_t size1, size2;
+
+		spscbuf_write_spans(&line->input, offset, plane_size,
+				&span1, &size1, &span2, &size2);
+
+		copy_plane_with_volume(line, span1, src, size1, data->volume);
+		if (size2)
+			copy_plane_with_volume(line, span2, src + size1, size2,
+					data->volume);
+
+		offset += plane_size;
+	}
+
+	spscbuf_commit(&line->input, record_size);
+	return true;
+}
+
+void audio_line_output(audio_line_t *line, const struct audio_data *data)
+{
+	if (!line || !data) return;
+
+	if (!audio_line_push(line, data)) {
+		if (!line->input_overflow) {
+			blog(LOG_WARNING, "Audio line '%s' input buffer is "
+			                  "full, audio data is being dropped.  "
+			                  "The audio thread may be stalled.",
+			                  line->name);
+			line->input_overflow = true;
+		}
 
-	pthread_mutex_unlock(&line->mutex);
+	} else {
+		if (line->input_overflow) {
+			blog(LOG_WARNING, "Audio line '%s' input buffer is no "
+			                  "longer full.", line->name);
+			line->input_overflow = false;
+		}
+
+		if (line->audio->block_frames)
+			check_line_block_ready(line, data->timestamp +
+					conv_frames_to_time(line->audio,
+						data->frames));
+	}
 }
 
 void audio_line_set_mixers(audio_line_t *line, uint32_t mixers)
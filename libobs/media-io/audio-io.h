@@ -189,6 +189,25 @@ EXPORT size_t audio_output_get_block_size(const audio_t *audio);
 EXPORT size_t audio_output_get_planes(const audio_t *audio);
 EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
+
+/**
+ * Sets the number of frames the audio thread outputs per tick (for example
+ * the encoder frame size, 1024 for AAC).  When non-zero, the audio thread
+ * wakes on absolute deadlines for each block, or early once every line has
+ * data for the block, and always outputs exactly that many frames.  When
+ * zero (the default), it polls and outputs whatever has accumulated.
+ */
+EXPORT void audio_output_set_block_frames(audio_t *audio, uint32_t frames);
+EXPORT uint32_t audio_output_get_block_frames(const audio_t *audio);
+
+/**
+ * Enables outputting each mix (resampling and input callbacks, such as audio
+ * encoders) on its own worker thread.  The audio thread waits for all mixes
+ * to finish before starting the next tick.  Disabled by default; libobs
+ * enables it on machines with more than one logical core.
+ */
+EXPORT void audio_output_set_parallel_output(audio_t *audio, bool parallel);
+EXPORT bool audio_output_parallel_output(const audio_t *audio);
 EXPORT const struct audio_output_info *audio_output_get_info(
 		const audio_t *audio);
 
@@ -197,6 +216,16 @@ EXPORT audio_line_t *audio_output_create_line(audio_t *audio, const char *name,
 EXPORT void audio_line_set_mixers(audio_line_t *line, uint32_t mixers);
 EXPORT uint32_t audio_line_get_mixers(audio_line_t *line);
 EXPORT void audio_line_destroy(audio_line_t *line);
+
+/**
+ * Queues audio data on the line without blocking on the audio thread.
+ *
+ * Each line's input is a single-producer/single-consumer ring: calls for
+ * the same line must not overlap, so a line fed from more than one thread
+ * has to be serialized by the caller (sources do this with their audio
+ * mutex).  Different lines can be fed concurrently.  If the ring is full the
+ * data is dropped with a warning.
+ */
 EXPORT void audio_line_output(audio_line_t *line, const struct audio_data *data);
 
 
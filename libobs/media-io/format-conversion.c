@@ -16,8 +16,21 @@
 ******************************************************************************/
 
 #include "format-conversion.h"
+#include "../util/base.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
 #include <xmmintrin.h>
 #include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2  __attribute__((target("avx2")))
+#endif
 
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
@@ -89,7 +102,7 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
-void compress_uyvx_to_i420(
+static void compress_uyvx_to_i420_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -127,7 +140,7 @@ void compress_uyvx_to_i420(
 	}
 }
 
-void compress_uyvx_to_nv12(
+static void compress_uyvx_to_nv12_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -163,7 +176,7 @@ void compress_uyvx_to_nv12(
 	}
 }
 
-void convert_uyvx_to_i444(
+static void convert_uyvx_to_i444_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -202,7 +215,30 @@ void convert_uyvx_to_i444(
 	}
 }
 
-void decompress_420(
+/* ------------------------------------------------------------------------- */
+/* SSE2 decompression                                                        */
+
+/* stores 16 packed YUVX pixels from 16 luma values and 16 bytes each of
+ * duplicated U and V */
+#define store_yuvx_16px(output, lum, u_dup, v_dup)                            \
+do {                                                                          \
+	__m128i zero   = _mm_setzero_si128();                                 \
+	__m128i v_lo   = _mm_unpacklo_epi8(v_dup, zero);                      \
+	__m128i v_hi   = _mm_unpackhi_epi8(v_dup, zero);                      \
+	__m128i yu_lo  = _mm_unpacklo_epi8(lum, u_dup);                       \
+	__m128i yu_hi  = _mm_unpackhi_epi8(lum, u_dup);                       \
+                                                                              \
+	_mm_storeu_si128((__m128i*)(output),                                  \
+			_mm_unpacklo_epi16(yu_lo, v_lo));                     \
+	_mm_storeu_si128((__m128i*)(output) + 1,                              \
+			_mm_unpackhi_epi16(yu_lo, v_lo));                     \
+	_mm_storeu_si128((__m128i*)(output) + 2,                              \
+			_mm_unpacklo_epi16(yu_hi, v_hi));                     \
+	_mm_storeu_si128((__m128i*)(output) + 3,                              \
+			_mm_unpackhi_epi16(yu_hi, v_hi));                     \
+} while (false)
+
+static void decompress_420_sse2(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
@@ -215,29 +251,44 @@ void decompress_420(
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
 		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
 		uint32_t x;
 
 		lum0 = input[0] + y * 2 * in_linesize[0];
 		lum1 = lum0 + in_linesize[0];
-		output0 = (uint32_t*)(output + y * 2 * in_linesize[0]);
-		output1 = (uint32_t*)((uint8_t*)output0 + in_linesize[0]);
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out;
-			out = (*(chroma0++) << 8) | (*(chroma1++) << 16);
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			__m128i u = _mm_loadl_epi64(
+					(const __m128i*)(chroma0 + x));
+			__m128i v = _mm_loadl_epi64(
+					(const __m128i*)(chroma1 + x));
+			__m128i u_dup = _mm_unpacklo_epi8(u, u);
+			__m128i v_dup = _mm_unpacklo_epi8(v, v);
+
+			__m128i line0 = _mm_loadu_si128(
+					(const __m128i*)(lum0 + x*2));
+			__m128i line1 = _mm_loadu_si128(
+					(const __m128i*)(lum1 + x*2));
+
+			store_yuvx_16px(output0 + x*2, line0, u_dup, v_dup);
+			store_yuvx_16px(output1 + x*2, line1, u_dup, v_dup);
+		}
 
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
+		for (; x < width_d2; x++) {
+			uint32_t out = (chroma0[x] << 8) | (chroma1[x] << 16);
 
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
+			output0[x*2]   = lum0[x*2]   | out;
+			output0[x*2+1] = lum0[x*2+1] | out;
+			output1[x*2]   = lum1[x*2]   | out;
+			output1[x*2+1] = lum1[x*2+1] | out;
 		}
 	}
 }
 
-void decompress_nv12(
+static void decompress_nv12_sse2(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
@@ -247,10 +298,12 @@ void decompress_nv12(
 	uint32_t height_d2  = end_y/2;
 	uint32_t y;
 
+	__m128i lo_mask = _mm_set1_epi16(0x00FF);
+
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint16_t *chroma;
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
 		uint32_t x;
 
 		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
@@ -259,66 +312,854 @@ void decompress_nv12(
 		output0 = (uint32_t*)(output + y * 2 * out_linesize);
 		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out = *(chroma++) << 8;
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			__m128i uv = _mm_loadu_si128(
+					(const __m128i*)(chroma + x));
+			__m128i u  = _mm_and_si128(uv, lo_mask);
+			__m128i v  = _mm_srli_epi16(uv, 8);
+			__m128i u_dup = _mm_or_si128(u, _mm_slli_epi16(u, 8));
+			__m128i v_dup = _mm_or_si128(v, _mm_slli_epi16(v, 8));
 
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
+			__m128i line0 = _mm_loadu_si128(
+					(const __m128i*)(lum0 + x*2));
+			__m128i line1 = _mm_loadu_si128(
+					(const __m128i*)(lum1 + x*2));
 
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
+			store_yuvx_16px(output0 + x*2, line0, u_dup, v_dup);
+			store_yuvx_16px(output1 + x*2, line1, u_dup, v_dup);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = chroma[x] << 8;
+
+			output0[x*2]   = lum0[x*2]   | out;
+			output0[x*2+1] = lum0[x*2+1] | out;
+			output1[x*2]   = lum1[x*2]   | out;
+			output1[x*2+1] = lum1[x*2+1] | out;
 		}
 	}
 }
 
-void decompress_422(
+static void decompress_422_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize,
 		bool leading_lum)
 {
-	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
+	/* each input dword holds two pixels, which become two output dwords */
+	uint32_t width_d2 = min_uint32(in_linesize/4, out_linesize/8);
+	uint32_t keep     = leading_lum ? 0xFFFFFF00 : 0xFFFF00FF;
+	uint32_t fill     = leading_lum ? 0x000000FF : 0x0000FF00;
+	uint32_t y;
+
+	__m128i keep_mask = _mm_set1_epi32((int)keep);
+	__m128i fill_mask = _mm_set1_epi32((int)fill);
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32 =
+			(const uint32_t*)(input + y*in_linesize);
+		uint32_t *output32 = (uint32_t*)(output + y*out_linesize);
+		uint32_t x;
+
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m128i dw = _mm_loadu_si128(
+					(const __m128i*)(input32 + x));
+			__m128i odd = _mm_or_si128(
+					_mm_and_si128(dw, keep_mask),
+					_mm_and_si128(_mm_srli_epi32(dw, 16),
+						fill_mask));
+
+			_mm_storeu_si128((__m128i*)(output32 + x*2),
+					_mm_unpacklo_epi32(dw, odd));
+			_mm_storeu_si128((__m128i*)(output32 + x*2 + 4),
+					_mm_unpackhi_epi32(dw, odd));
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t dw = input32[x];
+
+			output32[x*2]   = dw;
+			output32[x*2+1] = (dw & keep) | ((dw >> 16) & fill);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* SSSE3 compression, 16 pixels at a time                                    */
+
+/* builds shuffle masks that gather byte 'offset' of each of the four pixels
+ * in load n into dword n of the result */
+static inline void init_gather_masks(int8_t masks[4][16], int offset)
+{
+	for (int n = 0; n < 4; n++) {
+		for (int i = 0; i < 16; i++)
+			masks[n][i] = (i / 4 == n) ?
+				(int8_t)((i % 4) * 4 + offset) : -1;
+	}
+}
+
+static TARGET_SSSE3 inline void load_gather_masks(__m128i *masks, int offset)
+{
+	int8_t vals[4][16];
+	init_gather_masks(vals, offset);
+
+	for (size_t i = 0; i < 4; i++)
+		masks[i] = _mm_loadu_si128((const __m128i*)vals[i]);
+}
+
+static TARGET_SSSE3 inline __m128i gather_16(const __m128i *line,
+		const __m128i *masks)
+{
+	return _mm_or_si128(
+		_mm_or_si128(_mm_shuffle_epi8(line[0], masks[0]),
+		             _mm_shuffle_epi8(line[1], masks[1])),
+		_mm_or_si128(_mm_shuffle_epi8(line[2], masks[2]),
+		             _mm_shuffle_epi8(line[3], masks[3])));
+}
+
+static TARGET_SSSE3 inline void store_gather_16(uint8_t *plane,
+		uint32_t pos0, uint32_t pos1, const __m128i *line1,
+		const __m128i *line2, const __m128i *masks)
+{
+	_mm_storeu_si128((__m128i*)(plane + pos0), gather_16(line1, masks));
+	_mm_storeu_si128((__m128i*)(plane + pos1), gather_16(line2, masks));
+}
+
+static TARGET_SSSE3 inline void load_16px(__m128i *line, const uint8_t *img)
+{
+	for (size_t i = 0; i < 4; i++)
+		line[i] = _mm_loadu_si128((const __m128i*)img + i);
+}
+
+/* averages the chroma of 2x2 blocks of 16x2 pixels into interleaved UV */
+static TARGET_SSSE3 inline __m128i average_uv_16(const __m128i *line1,
+		const __m128i *line2)
+{
+	__m128i uv_mask = _mm_set1_epi16(0x00FF);
+	__m128i sum[4];
+
+	for (size_t i = 0; i < 4; i++)
+		sum[i] = _mm_add_epi16(_mm_and_si128(line1[i], uv_mask),
+		                       _mm_and_si128(line2[i], uv_mask));
+
+	return _mm_packus_epi16(
+		_mm_srli_epi16(_mm_hadd_epi32(sum[0], sum[1]), 2),
+		_mm_srli_epi16(_mm_hadd_epi32(sum[2], sum[3]), 2));
+}
+
+static TARGET_SSSE3 void compress_uyvx_to_i420_ssse3(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
+	__m128i y_masks[4];
+	__m128i deinterleave = _mm_setr_epi8(
+			0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+
+	load_gather_masks(y_masks, 1);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 16 <= width; x += 16) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			__m128i line1[4], line2[4], uv;
+
+			load_16px(line1, img);
+			load_16px(line2, img + in_linesize);
+
+			store_gather_16(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, y_masks);
+
+			uv = _mm_shuffle_epi8(average_uv_16(line1, line2),
+					deinterleave);
+			_mm_storel_epi64((__m128i*)
+					(u_plane + chroma_y_pos + (x>>1)), uv);
+			_mm_storel_epi64((__m128i*)
+					(v_plane + chroma_y_pos + (x>>1)),
+					_mm_srli_si128(uv, 8));
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i*)img);
+			__m128i line2 = _mm_load_si128(
+					(const __m128i*)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_ch_2plane(u_plane, v_plane,
+					chroma_y_pos + (x>>1),
+					line1, line2, uv_mask);
+		}
+	}
+}
+
+static TARGET_SSSE3 void compress_uyvx_to_nv12_ssse3(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane    = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
+	__m128i y_masks[4];
+
+	load_gather_masks(y_masks, 1);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 16 <= width; x += 16) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			__m128i line1[4], line2[4];
+
+			load_16px(line1, img);
+			load_16px(line2, img + in_linesize);
+
+			store_gather_16(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, y_masks);
+			_mm_storeu_si128((__m128i*)
+					(chroma_plane + chroma_y_pos + x),
+					average_uv_16(line1, line2));
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i*)img);
+			__m128i line2 = _mm_load_si128(
+					(const __m128i*)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_ch_1plane(chroma_plane, chroma_y_pos + x,
+					line1, line2, uv_mask);
+		}
+	}
+}
+
+static TARGET_SSSE3 void convert_uyvx_to_i444_ssse3(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i u_mask   = _mm_set1_epi32(0x000000FF);
+	__m128i v_mask   = _mm_set1_epi32(0x00FF0000);
+	__m128i y_masks[4];
+	__m128i u_masks[4], v_masks[4];
+
+	load_gather_masks(y_masks, 1);
+	load_gather_masks(u_masks, 0);
+	load_gather_masks(v_masks, 2);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 16 <= width; x += 16) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			__m128i line1[4], line2[4];
+
+			load_16px(line1, img);
+			load_16px(line2, img + in_linesize);
+
+			store_gather_16(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, y_masks);
+			store_gather_16(u_plane, lum_pos0, lum_pos1,
+					line1, line2, u_masks);
+			store_gather_16(v_plane, lum_pos0, lum_pos1,
+					line1, line2, v_masks);
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i*)img);
+			__m128i line2 = _mm_load_si128(
+					(const __m128i*)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_val(u_plane, lum_pos0, lum_pos1,
+					line1, line2, u_mask);
+			pack_shift(v_plane, lum_pos0, lum_pos1,
+					line1, line2, v_mask, 2);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* AVX2 compression, 32 pixels at a time                                     */
+
+static TARGET_AVX2 inline void load_gather_masks_256(__m256i *masks,
+		int offset)
+{
+	int8_t vals[4][16];
+	init_gather_masks(vals, offset);
+
+	for (size_t i = 0; i < 4; i++)
+		masks[i] = _mm256_broadcastsi128_si256(
+				_mm_loadu_si128((const __m128i*)vals[i]));
+}
+
+/* shuffles operate per 128-bit lane, so results come out with the dwords of
+ * both lanes interleaved; this puts them back in pixel order */
+static TARGET_AVX2 inline __m256i lane_order_32(__m256i val)
+{
+	return _mm256_permutevar8x32_epi32(val,
+			_mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+static TARGET_AVX2 inline __m256i gather_32(const __m256i *line,
+		const __m256i *masks)
+{
+	return lane_order_32(_mm256_or_si256(
+		_mm256_or_si256(_mm256_shuffle_epi8(line[0], masks[0]),
+		                _mm256_shuffle_epi8(line[1], masks[1])),
+		_mm256_or_si256(_mm256_shuffle_epi8(line[2], masks[2]),
+		                _mm256_shuffle_epi8(line[3], masks[3]))));
+}
+
+static TARGET_AVX2 inline void store_gather_32(uint8_t *plane,
+		uint32_t pos0, uint32_t pos1, const __m256i *line1,
+		const __m256i *line2, const __m256i *masks)
+{
+	_mm256_storeu_si256((__m256i*)(plane + pos0), gather_32(line1, masks));
+	_mm256_storeu_si256((__m256i*)(plane + pos1), gather_32(line2, masks));
+}
+
+static TARGET_AVX2 inline void load_32px(__m256i *line, const uint8_t *img)
+{
+	for (size_t i = 0; i < 4; i++)
+		line[i] = _mm256_loadu_si256((const __m256i*)img + i);
+}
+
+static TARGET_AVX2 inline __m256i average_uv_32(const __m256i *line1,
+		const __m256i *line2)
+{
+	__m256i uv_mask = _mm256_set1_epi16(0x00FF);
+	__m256i sum[4];
+
+	for (size_t i = 0; i < 4; i++)
+		sum[i] = _mm256_add_epi16(
+				_mm256_and_si256(line1[i], uv_mask),
+				_mm256_and_si256(line2[i], uv_mask));
+
+	return lane_order_32(_mm256_packus_epi16(
+		_mm256_srli_epi16(_mm256_hadd_epi32(sum[0], sum[1]), 2),
+		_mm256_srli_epi16(_mm256_hadd_epi32(sum[2], sum[3]), 2)));
+}
+
+static TARGET_AVX2 void compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
+	__m256i y_masks[4];
+	__m256i deinterleave = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+			0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15));
+
+	load_gather_masks_256(y_masks, 1);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 32 <= width; x += 32) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			__m256i line1[4], line2[4], uv;
+
+			load_32px(line1, img);
+			load_32px(line2, img + in_linesize);
+
+			store_gather_32(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, y_masks);
+
+			/* U in the low half, V in the high half */
+			uv = _mm256_shuffle_epi8(average_uv_32(line1, line2),
+					deinterleave);
+			uv = _mm256_permute4x64_epi64(uv,
+					_MM_SHUFFLE(3, 1, 2, 0));
+
+			_mm_storeu_si128((__m128i*)
+					(u_plane + chroma_y_pos + (x>>1)),
+					_mm256_castsi256_si128(uv));
+			_mm_storeu_si128((__m128i*)
+					(v_plane + chroma_y_pos + (x>>1)),
+					_mm256_extracti128_si256(uv, 1));
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i*)img);
+			__m128i line2 = _mm_load_si128(
+					(const __m128i*)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_ch_2plane(u_plane, v_plane,
+					chroma_y_pos + (x>>1),
+					line1, line2, uv_mask);
+		}
+	}
+}
+
+static TARGET_AVX2 void compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane    = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
+	__m256i y_masks[4];
+
+	load_gather_masks_256(y_masks, 1);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 32 <= width; x += 32) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			__m256i line1[4], line2[4];
+
+			load_32px(line1, img);
+			load_32px(line2, img + in_linesize);
+
+			store_gather_32(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, y_masks);
+			_mm256_storeu_si256((__m256i*)
+					(chroma_plane + chroma_y_pos + x),
+					average_uv_32(line1, line2));
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i*)img);
+			__m128i line2 = _mm_load_si128(
+					(const __m128i*)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_ch_1plane(chroma_plane, chroma_y_pos + x,
+					line1, line2, uv_mask);
+		}
+	}
+}
+
+static TARGET_AVX2 void convert_uyvx_to_i444_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
 	uint32_t y;
 
-	register const uint32_t *input32;
-	register const uint32_t *input32_end;
-	register uint32_t       *output32;
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i u_mask   = _mm_set1_epi32(0x000000FF);
+	__m128i v_mask   = _mm_set1_epi32(0x00FF0000);
+	__m256i y_masks[4], u_masks[4], v_masks[4];
+
+	load_gather_masks_256(y_masks, 1);
+	load_gather_masks_256(u_masks, 0);
+	load_gather_masks_256(v_masks, 2);
 
-	if (leading_lum) {
-		for (y = start_y; y < end_y; y++) {
-			input32     = (const uint32_t*)(input + y*in_linesize);
-			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
 
-			while(input32 < input32_end) {
-				register uint32_t dw = *input32;
+		for (x = 0; x + 32 <= width; x += 32) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			__m256i line1[4], line2[4];
 
-				output32[0] = dw;
-				dw &= 0xFFFFFF00;
-				dw |= (uint8_t)(dw>>16);
-				output32[1] = dw;
+			load_32px(line1, img);
+			load_32px(line2, img + in_linesize);
 
-				output32 += 2;
-				input32++;
-			}
+			store_gather_32(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, y_masks);
+			store_gather_32(u_plane, lum_pos0, lum_pos1,
+					line1, line2, u_masks);
+			store_gather_32(v_plane, lum_pos0, lum_pos1,
+					line1, line2, v_masks);
 		}
-	} else {
-		for (y = start_y; y < end_y; y++) {
-			input32     = (const uint32_t*)(input + y*in_linesize);
-			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
-
-			while (input32 < input32_end) {
-				register uint32_t dw = *input32;
-
-				output32[0] = dw;
-				dw &= 0xFFFF00FF;
-				dw |= (dw>>16) & 0xFF00;
-				output32[1] = dw;
-
-				output32 += 2;
-				input32++;
-			}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i*)img);
+			__m128i line2 = _mm_load_si128(
+					(const __m128i*)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_val(u_plane, lum_pos0, lum_pos1,
+					line1, line2, u_mask);
+			pack_shift(v_plane, lum_pos0, lum_pos1,
+					line1, line2, v_mask, 2);
 		}
 	}
 }
+
+/* ------------------------------------------------------------------------- */
+/* AVX2 decompression                                                        */
+
+/* stores 32 packed YUVX pixels; u_dup/v_dup hold each chroma byte twice,
+ * with lane 0 covering pixels 0-15 and lane 1 pixels 16-31 */
+static TARGET_AVX2 inline void store_yuvx_32px(uint32_t *output, __m256i lum,
+		__m256i u_dup, __m256i v_dup)
+{
+	__m256i zero  = _mm256_setzero_si256();
+	__m256i v_lo  = _mm256_unpacklo_epi8(v_dup, zero);
+	__m256i v_hi  = _mm256_unpackhi_epi8(v_dup, zero);
+	__m256i yu_lo = _mm256_unpacklo_epi8(lum, u_dup);
+	__m256i yu_hi = _mm256_unpackhi_epi8(lum, u_dup);
+
+	__m256i px0 = _mm256_unpacklo_epi16(yu_lo, v_lo);
+	__m256i px1 = _mm256_unpackhi_epi16(yu_lo, v_lo);
+	__m256i px2 = _mm256_unpacklo_epi16(yu_hi, v_hi);
+	__m256i px3 = _mm256_unpackhi_epi16(yu_hi, v_hi);
+
+	_mm256_storeu_si256((__m256i*)output,
+			_mm256_permute2x128_si256(px0, px1, 0x20));
+	_mm256_storeu_si256((__m256i*)output + 1,
+			_mm256_permute2x128_si256(px2, px3, 0x20));
+	_mm256_storeu_si256((__m256i*)output + 2,
+			_mm256_permute2x128_si256(px0, px1, 0x31));
+	_mm256_storeu_si256((__m256i*)output + 3,
+			_mm256_permute2x128_si256(px2, px3, 0x31));
+}
+
+static TARGET_AVX2 inline __m256i dup_bytes(__m256i words)
+{
+	return _mm256_or_si256(words, _mm256_slli_epi16(words, 8));
+}
+
+static TARGET_AVX2 void decompress_420_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x + 16 <= width_d2; x += 16) {
+			__m256i u_dup = dup_bytes(_mm256_cvtepu8_epi16(
+					_mm_loadu_si128((const __m128i*)
+						(chroma0 + x))));
+			__m256i v_dup = dup_bytes(_mm256_cvtepu8_epi16(
+					_mm_loadu_si128((const __m128i*)
+						(chroma1 + x))));
+
+			store_yuvx_32px(output0 + x*2, _mm256_loadu_si256(
+					(const __m256i*)(lum0 + x*2)),
+					u_dup, v_dup);
+			store_yuvx_32px(output1 + x*2, _mm256_loadu_si256(
+					(const __m256i*)(lum1 + x*2)),
+					u_dup, v_dup);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = (chroma0[x] << 8) | (chroma1[x] << 16);
+
+			output0[x*2]   = lum0[x*2]   | out;
+			output0[x*2+1] = lum0[x*2+1] | out;
+			output1[x*2]   = lum1[x*2]   | out;
+			output1[x*2+1] = lum1[x*2+1] | out;
+		}
+	}
+}
+
+static TARGET_AVX2 void decompress_nv12_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	__m256i lo_mask = _mm256_set1_epi16(0x00FF);
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x + 16 <= width_d2; x += 16) {
+			__m256i uv = _mm256_loadu_si256(
+					(const __m256i*)(chroma + x));
+			__m256i u_dup = dup_bytes(
+					_mm256_and_si256(uv, lo_mask));
+			__m256i v_dup = dup_bytes(_mm256_srli_epi16(uv, 8));
+
+			store_yuvx_32px(output0 + x*2, _mm256_loadu_si256(
+					(const __m256i*)(lum0 + x*2)),
+					u_dup, v_dup);
+			store_yuvx_32px(output1 + x*2, _mm256_loadu_si256(
+					(const __m256i*)(lum1 + x*2)),
+					u_dup, v_dup);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = chroma[x] << 8;
+
+			output0[x*2]   = lum0[x*2]   | out;
+			output0[x*2+1] = lum0[x*2+1] | out;
+			output1[x*2]   = lum1[x*2]   | out;
+			output1[x*2+1] = lum1[x*2+1] | out;
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct conversion_kernels {
+	const char *name;
+
+	void (*compress_uyvx_to_i420)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output[], const uint32_t out_linesize[]);
+	void (*compress_uyvx_to_nv12)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output[], const uint32_t out_linesize[]);
+	void (*convert_uyvx_to_i444)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output[], const uint32_t out_linesize[]);
+
+	void (*decompress_nv12)(
+			const uint8_t *const input[],
+			const uint32_t in_linesize[],
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output, uint32_t out_linesize);
+	void (*decompress_420)(
+			const uint8_t *const input[],
+			const uint32_t in_linesize[],
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output, uint32_t out_linesize);
+	void (*decompress_422)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output, uint32_t out_linesize,
+			bool leading_lum);
+};
+
+static const struct conversion_kernels sse2_kernels = {
+	"SSE2",
+	compress_uyvx_to_i420_sse2,
+	compress_uyvx_to_nv12_sse2,
+	convert_uyvx_to_i444_sse2,
+	decompress_nv12_sse2,
+	decompress_420_sse2,
+	decompress_422_sse2
+};
+
+static const struct conversion_kernels ssse3_kernels = {
+	"SSSE3",
+	compress_uyvx_to_i420_ssse3,
+	compress_uyvx_to_nv12_ssse3,
+	convert_uyvx_to_i444_ssse3,
+	decompress_nv12_sse2,
+	decompress_420_sse2,
+	decompress_422_sse2
+};
+
+static const struct conversion_kernels avx2_kernels = {
+	"AVX2",
+	compress_uyvx_to_i420_avx2,
+	compress_uyvx_to_nv12_avx2,
+	convert_uyvx_to_i444_avx2,
+	decompress_nv12_avx2,
+	decompress_420_avx2,
+	decompress_422_sse2
+};
+
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+static const struct conversion_kernels *kernels = NULL;
+
+static void select_kernels(void)
+{
+	uint32_t features = os_get_cpu_features();
+
+	if (features & OS_CPU_AVX2)
+		kernels = &avx2_kernels;
+	else if (features & OS_CPU_SSSE3)
+		kernels = &ssse3_kernels;
+	else
+		kernels = &sse2_kernels;
+
+	blog(LOG_DEBUG, "format-conversion: using %s kernels", kernels->name);
+}
+
+/* chosen the first time a conversion runs, so that converting a frame only
+ * reads shared state */
+static inline const struct conversion_kernels *get_kernels(void)
+{
+	pthread_once(&kernels_once, select_kernels);
+	return kernels;
+}
+
+const char *format_conversion_get_kernels(void)
+{
+	return get_kernels()->name;
+}
+
+void format_conversion_reselect_kernels(void)
+{
+	pthread_once(&kernels_once, select_kernels);
+	select_kernels();
+}
+
+void compress_uyvx_to_i420(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_kernels()->compress_uyvx_to_i420(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void compress_uyvx_to_nv12(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_kernels()->compress_uyvx_to_nv12(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void convert_uyvx_to_i444(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_kernels()->convert_uyvx_to_i444(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void decompress_nv12(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	get_kernels()->decompress_nv12(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void decompress_420(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	get_kernels()->decompress_420(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void decompress_422(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	get_kernels()->decompress_422(input, in_linesize,
+			start_y, end_y, output, out_linesize, leading_lum);
+}
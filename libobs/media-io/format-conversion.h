@@ -58,6 +58,16 @@ EXPORT void decompress_422(
 		uint8_t *output, uint32_t out_linesize,
 		bool leading_lum);
 
+/** Returns the name of the instruction set the conversions were chosen for */
+EXPORT const char *format_conversion_get_kernels(void);
+
+/**
+ * Chooses the conversions again for the current CPU features, e.g. after
+ * os_set_cpu_features_mask.  Must not be called while frames are being
+ * converted.
+ */
+EXPORT void format_conversion_reselect_kernels(void);
+
 #ifdef __cplusplus
 }
 #endif
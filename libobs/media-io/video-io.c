@@ -29,30 +29,77 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
-
+#define DEFAULT_SCALE_THREADS 2
+#define MAX_SCALE_THREADS 8
+
+struct video_scale_group;
+
+/*
+ * Cached frames are reference counted: the dispatch queue holds one
+ * reference while a frame waits to be sent, and every input queue it is
+ * handed to holds another until that input's thread is done with it.  A slow
+ * input therefore only ever holds on to the frames in its own queue instead
+ * of stalling the video thread and every other input.
+ */
 struct cached_frame_info {
 	struct video_data frame;
+	volatile long refs;
+	struct video_scale_group *group;
+};
+
+struct queued_frame {
+	struct cached_frame_info *cfi;
+	uint64_t timestamp;
 	int count;
 };
 
-struct video_input {
+/*
+ * Inputs that request the same conversion share a scale group, so each
+ * conversion is only done once per frame.  Frames queued for a group are
+ * scaled on the scale threads, one frame of a group at a time, into the
+ * group's own reference counted frames.
+ */
+struct video_scale_group {
+	struct video_output       *video;
 	struct video_scale_info   conversion;
 	video_scaler_t            *scaler;
-	struct video_frame        frame[MAX_CONVERT_BUFFERS];
-	int                       cur_frame;
+	const char                *profile_name;
+	volatile long             refs;
+
+	pthread_mutex_t           mutex;
+	bool                      scheduled;
+	struct queued_frame       pending[MAX_CACHE_SIZE];
+	size_t                    pending_start;
+	size_t                    pending_num;
+
+	struct cached_frame_info  frames[MAX_CACHE_SIZE];
+	size_t                    free_frames[MAX_CACHE_SIZE];
+	size_t                    available_frames;
+	size_t                    num_frames;
+	struct cached_frame_info  *last_scaled;
+};
+
+struct video_input {
+	struct video_output       *video;
+	struct video_scale_info   conversion;
+	struct video_scale_group  *group;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
-};
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+	pthread_t                 thread;
+	bool                      thread_active;
+	bool                      stop;
+	os_sem_t                  *semaphore;
+
+	pthread_mutex_t           queue_mutex;
+	struct queued_frame       queue[MAX_CACHE_SIZE];
+	size_t                    queue_start;
+	size_t                    queue_num;
+
+	uint32_t                  skipped_frames;
+};
 
 struct video_output {
 	struct video_output_info   info;
@@ -69,57 +116,435 @@ struct video_output {
 	bool                       initialized;
 
 	pthread_mutex_t            input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input*) inputs;
+	DARRAY(struct video_input*) stopped_inputs;
+	size_t                     input_queue_size;
 
+	DARRAY(struct video_scale_group*) scale_groups;
+
+	pthread_mutex_t            scale_mutex;
+	os_sem_t                   *scale_semaphore;
+	DARRAY(struct video_scale_group*) scale_ready;
+
+	pthread_mutex_t            scale_thread_mutex;
+	pthread_t                  scale_threads[MAX_SCALE_THREADS];
+	size_t                     num_scale_threads;
+	size_t                     active_scale_threads;
+	bool                       scale_stop;
+
+	struct cached_frame_info   cache[MAX_CACHE_SIZE];
+	size_t                     free_frames[MAX_CACHE_SIZE];
 	size_t                     available_frames;
-	size_t                     first_added;
+	size_t                     locked_frame;
+	int                        locked_count;
 	size_t                     last_added;
-	struct cached_frame_info   cache[MAX_CACHE_SIZE];
+
+	struct queued_frame        queue[MAX_CACHE_SIZE];
+	size_t                     queue_start;
+	size_t                     queue_num;
 };
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-		struct video_data *data)
+static inline struct queued_frame *queue_back(struct queued_frame *queue,
+		size_t start, size_t num)
 {
-	bool success = true;
+	return &queue[(start + num - 1) % MAX_CACHE_SIZE];
+}
 
-	if (input->scaler) {
-		struct video_frame *frame;
+static inline void cached_frame_addref(struct cached_frame_info *cfi)
+{
+	os_atomic_inc_long(&cfi->refs);
+}
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+/* released under the owner's mutex so a frame can't be re-queued between its
+ * last reference going away and it being put on the free list */
+static inline void cached_frame_release(struct video_output *video,
+		struct cached_frame_info *cfi)
+{
+	struct video_scale_group *group = cfi->group;
 
-		frame = &input->frame[input->cur_frame];
+	if (group) {
+		pthread_mutex_lock(&group->mutex);
 
-		success = video_scaler_scale(input->scaler,
-				frame->data, frame->linesize,
-				(const uint8_t * const*)data->data,
-				data->linesize);
+		if (os_atomic_dec_long(&cfi->refs) == 0)
+			group->free_frames[group->available_frames++] =
+				(size_t)(cfi - group->frames);
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i]     = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
-		} else {
+		pthread_mutex_unlock(&group->mutex);
+		return;
+	}
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	if (os_atomic_dec_long(&cfi->refs) == 0)
+		video->free_frames[video->available_frames++] =
+			(size_t)(cfi - video->cache);
+
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
+static inline bool video_input_pop_frame(struct video_input *input,
+		struct queued_frame *qf)
+{
+	bool success = false;
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	if (input->queue_num) {
+		*qf = input->queue[input->queue_start];
+		if (++input->queue_start == MAX_CACHE_SIZE)
+			input->queue_start = 0;
+		input->queue_num--;
+		success = true;
+	}
+
+	pthread_mutex_unlock(&input->queue_mutex);
+	return success;
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input *input = param;
+	struct video_output *video = input->video;
+	struct queued_frame qf;
+
+	os_set_thread_name("video-io: input thread");
+
+	const char *input_thread_name =
+		profile_store_name(obs_get_profiler_name_store(),
+				"video_input_thread(%s)", video->info.name);
+
+	while (os_sem_wait(input->semaphore) == 0) {
+		if (input->stop)
+			break;
+		if (!video_input_pop_frame(input, &qf))
+			continue;
+
+		profile_start(input_thread_name);
+
+		for (int i = 0; i < qf.count && !input->stop; i++) {
+			struct video_data frame = qf.cfi->frame;
+			frame.timestamp = qf.timestamp;
+
+			input->callback(input->param, &frame);
+
+			qf.timestamp += video->frame_time;
+		}
+
+		cached_frame_release(video, qf.cfi);
+
+		profile_end(input_thread_name);
+
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
+/* Queues a frame for an input.  If the input has fallen too far behind, the
+ * newest queued frame is replaced and repeated instead so the input still
+ * receives one frame per interval. */
+static void video_input_push_frame(struct video_input *input,
+		struct cached_frame_info *cfi, uint64_t timestamp)
+{
+	struct video_output *video = input->video;
+	struct queued_frame *last;
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	if (input->queue_num < video->input_queue_size) {
+		last = queue_back(input->queue, input->queue_start,
+				++input->queue_num);
+		last->cfi       = cfi;
+		last->timestamp = timestamp;
+		last->count     = 1;
+
+		cached_frame_addref(cfi);
+		os_sem_post(input->semaphore);
+
+	} else {
+		last = queue_back(input->queue, input->queue_start,
+				input->queue_num);
+		if (last->cfi != cfi) {
+			cached_frame_addref(cfi);
+			cached_frame_release(video, last->cfi);
+			last->cfi = cfi;
+		}
+
+		last->count++;
+		input->skipped_frames++;
+	}
+
+	pthread_mutex_unlock(&input->queue_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void scale_group_release(struct video_scale_group *group)
+{
+	struct video_output *video = group->video;
+
+	if (os_atomic_dec_long(&group->refs) != 0)
+		return;
+
+	for (size_t i = 0; i < group->pending_num; i++) {
+		size_t idx = (group->pending_start + i) % MAX_CACHE_SIZE;
+		cached_frame_release(video, group->pending[idx].cfi);
+	}
+
+	for (size_t i = 0; i < group->num_frames; i++)
+		video_frame_free((struct video_frame*)&group->frames[i]);
+
+	video_scaler_destroy(group->scaler);
+	pthread_mutex_destroy(&group->mutex);
+	bfree(group);
+}
+
+/* called by the video thread with input_mutex held */
+static void scale_group_push_frame(struct video_scale_group *group,
+		struct cached_frame_info *cfi, uint64_t timestamp)
+{
+	struct video_output *video = group->video;
+	struct queued_frame *last = NULL;
+	bool schedule = false;
+
+	pthread_mutex_lock(&group->mutex);
+
+	if (group->pending_num)
+		last = queue_back(group->pending, group->pending_start,
+				group->pending_num);
+
+	if (last && last->cfi == cfi) {
+		last->count++;
+
+	} else if (group->pending_num >= video->input_queue_size) {
+		/* scaling can't keep up; like with an input that falls
+		 * behind, repeat the newest frame so the rest of the cache
+		 * stays free */
+		cached_frame_addref(cfi);
+		cached_frame_release(video, last->cfi);
+		last->cfi = cfi;
+		last->count++;
+
+	} else {
+		last = queue_back(group->pending, group->pending_start,
+				++group->pending_num);
+		last->cfi       = cfi;
+		last->timestamp = timestamp;
+		last->count     = 1;
+
+		cached_frame_addref(cfi);
+	}
+
+	if (!group->scheduled)
+		group->scheduled = schedule = true;
+
+	pthread_mutex_unlock(&group->mutex);
+
+	if (schedule) {
+		os_atomic_inc_long(&group->refs);
+
+		pthread_mutex_lock(&video->scale_mutex);
+		da_push_back(video->scale_ready, &group);
+		pthread_mutex_unlock(&video->scale_mutex);
+
+		os_sem_post(video->scale_semaphore);
+	}
+}
+
+static struct cached_frame_info *scale_group_get_frame(
+		struct video_scale_group *group)
+{
+	struct cached_frame_info *cfi = NULL;
+
+	pthread_mutex_lock(&group->mutex);
+
+	if (group->available_frames) {
+		size_t idx = group->free_frames[--group->available_frames];
+		cfi = &group->frames[idx];
+		cfi->refs = 1;
+
+	} else if (group->num_frames < MAX_CACHE_SIZE) {
+		cfi = &group->frames[group->num_frames++];
+		video_frame_init((struct video_frame*)cfi,
+				group->conversion.format,
+				group->conversion.width,
+				group->conversion.height);
+		cfi->group = group;
+		cfi->refs  = 1;
+
+	} else if (group->last_scaled) {
+		/* every frame is still held by the inputs, so repeat the last
+		 * one that was scaled */
+		cfi = group->last_scaled;
+		cached_frame_addref(cfi);
+	}
+
+	pthread_mutex_unlock(&group->mutex);
+
+	return cfi;
+}
+
+static void scale_group_output(struct video_scale_group *group,
+		const struct queued_frame *qf)
+{
+	struct video_output *video = group->video;
+	struct cached_frame_info *cfi = scale_group_get_frame(group);
+	struct cached_frame_info *prev_scaled = NULL;
+
+	if (!cfi)
+		return;
+
+	if (cfi != group->last_scaled) {
+		bool success;
+
+		profile_start(group->profile_name);
+		success = video_scaler_scale(group->scaler,
+				cfi->frame.data, cfi->frame.linesize,
+				(const uint8_t * const*)qf->cfi->frame.data,
+				qf->cfi->frame.linesize);
+		profile_end(group->profile_name);
+
+		if (!success) {
 			blog(LOG_WARNING, "video-io: Could not scale frame!");
+			cached_frame_release(video, cfi);
+			return;
 		}
+
+		cached_frame_addref(cfi);
+
+		pthread_mutex_lock(&group->mutex);
+		prev_scaled = group->last_scaled;
+		group->last_scaled = cfi;
+		pthread_mutex_unlock(&group->mutex);
+
+		if (prev_scaled)
+			cached_frame_release(video, prev_scaled);
 	}
 
-	return success;
+	pthread_mutex_lock(&video->input_mutex);
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array[i];
+		uint64_t timestamp = qf->timestamp;
+
+		if (input->group != group)
+			continue;
+
+		for (int j = 0; j < qf->count; j++) {
+			video_input_push_frame(input, cfi, timestamp);
+			timestamp += video->frame_time;
+		}
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	cached_frame_release(video, cfi);
+}
+
+static void scale_group_process(struct video_scale_group *group)
+{
+	struct video_output *video = group->video;
+	struct queued_frame qf;
+
+	for (;;) {
+		pthread_mutex_lock(&group->mutex);
+
+		if (!group->pending_num) {
+			group->scheduled = false;
+			pthread_mutex_unlock(&group->mutex);
+			break;
+		}
+
+		qf = group->pending[group->pending_start];
+		if (++group->pending_start == MAX_CACHE_SIZE)
+			group->pending_start = 0;
+		group->pending_num--;
+
+		pthread_mutex_unlock(&group->mutex);
+
+		scale_group_output(group, &qf);
+		cached_frame_release(video, qf.cfi);
+	}
+}
+
+static void *scale_thread(void *param)
+{
+	struct video_output *video = param;
+
+	os_set_thread_name("video-io: scale thread");
+
+	while (os_sem_wait(video->scale_semaphore) == 0) {
+		struct video_scale_group *group = NULL;
+
+		if (video->scale_stop)
+			break;
+
+		pthread_mutex_lock(&video->scale_mutex);
+		if (video->scale_ready.num) {
+			group = video->scale_ready.array[0];
+			da_erase(video->scale_ready, 0);
+		}
+		pthread_mutex_unlock(&video->scale_mutex);
+
+		if (group) {
+			scale_group_process(group);
+			scale_group_release(group);
+		}
+
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
+/* called with scale_thread_mutex held */
+static void start_scale_threads(struct video_output *video)
+{
+	video->scale_stop = false;
+
+	for (size_t i = 0; i < video->num_scale_threads; i++) {
+		pthread_t *thread =
+			&video->scale_threads[video->active_scale_threads];
+
+		if (pthread_create(thread, NULL, scale_thread, video) != 0) {
+			blog(LOG_ERROR, "video-io: Failed to create scale "
+			                "thread");
+			break;
+		}
+
+		video->active_scale_threads++;
+	}
+}
+
+/* called with scale_thread_mutex held */
+static void stop_scale_threads(struct video_output *video)
+{
+	video->scale_stop = true;
+
+	for (size_t i = 0; i < video->active_scale_threads; i++)
+		os_sem_post(video->scale_semaphore);
+	for (size_t i = 0; i < video->active_scale_threads; i++)
+		pthread_join(video->scale_threads[i], NULL);
+
+	video->active_scale_threads = 0;
 }
 
 static inline bool video_output_cur_frame(struct video_output *video)
 {
-	struct cached_frame_info *frame_info;
+	struct queued_frame *qf;
+	struct cached_frame_info *cfi;
+	uint64_t timestamp;
 	bool complete;
 
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	frame_info = &video->cache[video->first_added];
+	qf = &video->queue[video->queue_start];
+	cfi = qf->cfi;
+	timestamp = qf->timestamp;
 
 	pthread_mutex_unlock(&video->data_mutex);
 
@@ -128,34 +553,37 @@ static inline bool video_output_cur_frame(struct video_output *video)
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
-		struct video_data frame = frame_info->frame;
-
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+		struct video_input *input = video->inputs.array[i];
+		if (!input->group)
+			video_input_push_frame(input, cfi, timestamp);
 	}
 
+	for (size_t i = 0; i < video->scale_groups.num; i++)
+		scale_group_push_frame(video->scale_groups.array[i], cfi,
+				timestamp);
+
 	pthread_mutex_unlock(&video->input_mutex);
 
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
+	qf->timestamp += video->frame_time;
+	complete = --qf->count == 0;
 
 	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
-
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+		if (++video->queue_start == MAX_CACHE_SIZE)
+			video->queue_start = 0;
+		video->queue_num--;
 	}
 
 	pthread_mutex_unlock(&video->data_mutex);
 
 	/* -------------------------------- */
 
+	if (complete)
+		cached_frame_release(video, cfi);
+
 	return complete;
 }
 
@@ -207,9 +635,17 @@ static inline void init_cache(struct video_output *video)
 
 		video_frame_init(frame, video->info.format,
 				video->info.width, video->info.height);
+
+		video->free_frames[i] = video->info.cache_size - i - 1;
 	}
 
 	video->available_frames = video->info.cache_size;
+
+	/* a stalled input holds its queued frames plus the one it's working
+	 * on, which leaves at least half of the cache for everything else */
+	video->input_queue_size = video->info.cache_size / 3;
+	if (!video->input_queue_size)
+		video->input_queue_size = 1;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -228,6 +664,7 @@ int video_output_open(video_t **video, struct video_output_info *info)
 	out->frame_time = (uint64_t)(1000000000.0 * (double)info->fps_den /
 		(double)info->fps_num);
 	out->initialized = false;
+	out->num_scale_threads = DEFAULT_SCALE_THREADS;
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		goto fail;
@@ -237,8 +674,14 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_mutex_init(&out->scale_mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&out->scale_thread_mutex, NULL) != 0)
+		goto fail;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail;
+	if (os_sem_init(&out->scale_semaphore, 0) != 0)
+		goto fail;
 	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
 		goto fail;
 
@@ -253,6 +696,30 @@ fail:
 	return VIDEO_OUTPUT_FAIL;
 }
 
+static void video_input_free(struct video_input *input)
+{
+	struct queued_frame qf;
+
+	if (input->thread_active)
+		pthread_join(input->thread, NULL);
+
+	while (video_input_pop_frame(input, &qf))
+		cached_frame_release(input->video, qf.cfi);
+
+	if (input->group)
+		scale_group_release(input->group);
+
+	os_sem_destroy(input->semaphore);
+	pthread_mutex_destroy(&input->queue_mutex);
+	bfree(input);
+}
+
+static inline void video_input_stop(struct video_input *input)
+{
+	input->stop = true;
+	os_sem_post(input->semaphore);
+}
+
 void video_output_close(video_t *video)
 {
 	if (!video)
@@ -260,16 +727,35 @@ void video_output_close(video_t *video)
 
 	video_output_stop(video);
 
-	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+	pthread_mutex_lock(&video->scale_thread_mutex);
+	stop_scale_threads(video);
+	pthread_mutex_unlock(&video->scale_thread_mutex);
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		video_input_stop(video->inputs.array[i]);
+		video_input_free(video->inputs.array[i]);
+	}
+	for (size_t i = 0; i < video->stopped_inputs.num; i++)
+		video_input_free(video->stopped_inputs.array[i]);
 	da_free(video->inputs);
+	da_free(video->stopped_inputs);
+
+	for (size_t i = 0; i < video->scale_ready.num; i++)
+		scale_group_release(video->scale_ready.array[i]);
+	for (size_t i = 0; i < video->scale_groups.num; i++)
+		scale_group_release(video->scale_groups.array[i]);
+	da_free(video->scale_ready);
+	da_free(video->scale_groups);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame*)&video->cache[i]);
 
 	os_sem_destroy(video->update_semaphore);
+	os_sem_destroy(video->scale_semaphore);
 	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
+	pthread_mutex_destroy(&video->scale_mutex);
+	pthread_mutex_destroy(&video->scale_thread_mutex);
 	bfree(video);
 }
 
@@ -278,7 +764,7 @@ static size_t video_get_input_idx(const video_t *video,
 		void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -286,39 +772,106 @@ static size_t video_get_input_idx(const video_t *video,
 	return DARRAY_INVALID;
 }
 
+static inline bool scale_info_equal(const struct video_scale_info *a,
+		const struct video_scale_info *b)
+{
+	return a->format == b->format && a->width == b->width &&
+	       a->height == b->height && a->range == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+/* returns a referenced scale group for the conversion, creating it if no
+ * other input has requested the same one; called with input_mutex held */
+static struct video_scale_group *get_scale_group(struct video_output *video,
+		const struct video_scale_info *conversion)
+{
+	struct video_scale_group *group;
+
+	for (size_t i = 0; i < video->scale_groups.num; i++) {
+		group = video->scale_groups.array[i];
+
+		if (scale_info_equal(&group->conversion, conversion)) {
+			os_atomic_inc_long(&group->refs);
+			return group;
+		}
+	}
+
+	struct video_scale_info from = {
+		.format = video->info.format,
+		.width  = video->info.width,
+		.height = video->info.height,
+	};
+
+	group = bzalloc(sizeof(struct video_scale_group));
+	group->video      = video;
+	group->conversion = *conversion;
+
+	int ret = video_scaler_create(&group->scaler, conversion, &from,
+			VIDEO_SCALE_FAST_BILINEAR);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+			                "scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+			                "create scaler");
+
+		bfree(group);
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&group->mutex, NULL) != 0) {
+		video_scaler_destroy(group->scaler);
+		bfree(group);
+		return NULL;
+	}
+
+	group->profile_name = profile_store_name(obs_get_profiler_name_store(),
+			"scale_video_output(%s, %s %ux%u)", video->info.name,
+			get_video_format_name(conversion->format),
+			conversion->width, conversion->height);
+
+	/* one reference for the group list and one for the caller */
+	group->refs = 2;
+	da_push_back(video->scale_groups, &group);
+	return group;
+}
+
+static inline void remove_unused_scale_group(struct video_output *video,
+		struct video_scale_group *group)
+{
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		if (video->inputs.array[i]->group == group)
+			return;
+	}
+
+	da_erase_item(video->scale_groups, &group);
+	scale_group_release(group);
+}
+
 static inline bool video_input_init(struct video_input *input,
 		struct video_output *video)
 {
+	if (pthread_mutex_init(&input->queue_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&input->semaphore, 0) != 0)
+		return false;
+
 	if (input->conversion.width  != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {
-			.format = video->info.format,
-			.width  = video->info.width,
-			.height = video->info.height,
-		};
-
-		int ret = video_scaler_create(&input->scaler,
-				&input->conversion, &from,
-				VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-				                "scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-				                "create scaler");
-
+		input->group = get_scale_group(video, &input->conversion);
+		if (!input->group)
 			return false;
-		}
+	}
 
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					input->conversion.format,
-					input->conversion.width,
-					input->conversion.height);
+	if (pthread_create(&input->thread, NULL, video_input_thread,
+				input) != 0) {
+		blog(LOG_ERROR, "video_input_init: Failed to create thread");
+		return false;
 	}
 
+	input->thread_active = true;
 	return true;
 }
 
@@ -328,6 +881,7 @@ bool video_output_connect(video_t *video,
 		void *param)
 {
 	bool success = false;
+	bool scaled = false;
 
 	if (!video || !callback)
 		return false;
@@ -335,32 +889,43 @@ bool video_output_connect(video_t *video,
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param    = param;
+		input->video    = video;
+		input->callback = callback;
+		input->param    = param;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format    = video->info.format;
-			input.conversion.width     = video->info.width;
-			input.conversion.height    = video->info.height;
+			input->conversion.format    = video->info.format;
+			input->conversion.width     = video->info.width;
+			input->conversion.height    = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
-		if (success)
+		success = video_input_init(input, video);
+		if (success) {
 			da_push_back(video->inputs, &input);
+			scaled = input->group != NULL;
+		} else {
+			video_input_free(input);
+		}
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
 
+	if (scaled) {
+		pthread_mutex_lock(&video->scale_thread_mutex);
+		if (!video->active_scale_threads)
+			start_scale_threads(video);
+		pthread_mutex_unlock(&video->scale_thread_mutex);
+	}
+
 	return success;
 }
 
@@ -368,18 +933,43 @@ void video_output_disconnect(video_t *video,
 		void (*callback)(void *param, struct video_data *frame),
 		void *param)
 {
+	DARRAY(struct video_input*) stopped;
+	pthread_t self = pthread_self();
+
 	if (!video || !callback)
 		return;
 
+	da_init(stopped);
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array+idx);
+		struct video_input *input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
+
+		if (input->group)
+			remove_unused_scale_group(video, input->group);
+
+		video_input_stop(input);
+		da_push_back(video->stopped_inputs, &input);
+	}
+
+	/* an input disconnecting itself from its own callback can't be joined
+	 * here, so it's left to be freed by a later disconnect or on close */
+	for (size_t i = video->stopped_inputs.num; i > 0; i--) {
+		struct video_input *input = video->stopped_inputs.array[i-1];
+		if (!pthread_equal(input->thread, self)) {
+			da_push_back(stopped, &input);
+			da_erase(video->stopped_inputs, i-1);
+		}
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	for (size_t i = 0; i < stopped.num; i++)
+		video_input_free(stopped.array[i]);
+	da_free(stopped);
 }
 
 bool video_output_active(const video_t *video)
@@ -397,6 +987,7 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
+	struct queued_frame *qf;
 	bool locked;
 
 	if (!video) return false;
@@ -404,18 +995,34 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 	pthread_mutex_lock(&video->data_mutex);
 
 	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
+		if (video->queue_num) {
+			qf = queue_back(video->queue, video->queue_start,
+					video->queue_num);
+			qf->count += count;
+
+		} else {
+			/* every frame is held by the inputs, so repeat the
+			 * last one that was sent */
+			qf = queue_back(video->queue, video->queue_start,
+					++video->queue_num);
+			qf->cfi       = &video->cache[video->last_added];
+			qf->timestamp = timestamp;
+			qf->count     = count;
+
+			cached_frame_addref(qf->cfi);
+			os_sem_post(video->update_semaphore);
+		}
+
 		locked = false;
 
 	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
-		}
+		video->locked_frame =
+			video->free_frames[--video->available_frames];
+		video->locked_count = count;
 
-		cfi = &video->cache[video->last_added];
+		cfi = &video->cache[video->locked_frame];
 		cfi->frame.timestamp = timestamp;
-		cfi->count = count;
+		cfi->refs = 1;
 
 		memcpy(frame, &cfi->frame, sizeof(*frame));
 
@@ -429,11 +1036,21 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 
 void video_output_unlock_frame(video_t *video)
 {
+	struct cached_frame_info *cfi;
+	struct queued_frame *qf;
+
 	if (!video) return;
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	video->available_frames--;
+	cfi = &video->cache[video->locked_frame];
+
+	qf = queue_back(video->queue, video->queue_start, ++video->queue_num);
+	qf->cfi       = cfi;
+	qf->timestamp = cfi->frame.timestamp;
+	qf->count     = video->locked_count;
+
+	video->last_added = video->locked_frame;
 	os_sem_post(video->update_semaphore);
 
 	pthread_mutex_unlock(&video->data_mutex);
@@ -499,3 +1116,83 @@ uint32_t video_output_get_total_frames(const video_t *video)
 {
 	return video->total_frames;
 }
+
+uint32_t video_output_get_input_skipped_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	uint32_t skipped = 0;
+
+	if (!video)
+		return 0;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		struct video_input *input = video->inputs.array[idx];
+
+		pthread_mutex_lock(&input->queue_mutex);
+		skipped = input->skipped_frames;
+		pthread_mutex_unlock(&input->queue_mutex);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return skipped;
+}
+
+size_t video_output_get_input_queued_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	size_t queued = 0;
+
+	if (!video)
+		return 0;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		struct video_input *input = video->inputs.array[idx];
+
+		pthread_mutex_lock(&input->queue_mutex);
+		queued = input->queue_num;
+		pthread_mutex_unlock(&input->queue_mutex);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return queued;
+}
+
+void video_output_set_scale_threads(video_t *video, uint32_t threads)
+{
+	if (!video)
+		return;
+
+	if (threads < 1)
+		threads = 1;
+	else if (threads > MAX_SCALE_THREADS)
+		threads = MAX_SCALE_THREADS;
+
+	pthread_mutex_lock(&video->scale_thread_mutex);
+
+	if (video->num_scale_threads != threads) {
+		bool restart = video->active_scale_threads != 0;
+
+		if (restart)
+			stop_scale_threads(video);
+
+		video->num_scale_threads = threads;
+
+		if (restart)
+			start_scale_threads(video);
+	}
+
+	pthread_mutex_unlock(&video->scale_thread_mutex);
+}
+
+uint32_t video_output_get_scale_threads(const video_t *video)
+{
+	return video ? (uint32_t)video->num_scale_threads : 0;
+}
@@ -177,6 +177,27 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/**
+ * Each input receives frames on its own thread.  When an input can't keep up,
+ * its newest queued frame is repeated rather than holding up the other
+ * inputs; these return how many frames were repeated that way and how many
+ * frames the input currently has queued.
+ */
+EXPORT uint32_t video_output_get_input_skipped_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param);
+EXPORT size_t video_output_get_input_queued_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param);
+
+/**
+ * Sets the number of threads used to scale frames for inputs that request a
+ * conversion (1 to 8, default 2).  Inputs requesting the same conversion
+ * share a single scaled frame.  libobs uses half the logical cores.
+ */
+EXPORT void video_output_set_scale_threads(video_t *video, uint32_t threads);
+EXPORT uint32_t video_output_get_scale_threads(const video_t *video);
+
 
 #ifdef __cplusplus
 }
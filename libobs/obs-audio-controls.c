@@ -191,19 +191,29 @@ static float log_db_to_def(const float db)
 			/ (LOG_OFFSET_VAL - LOG_RANGE_VAL);
 }
 
+/* parameters of the signals sent for every audio packet and volume change */
+static const struct calldata_key key_fader     = CALLDATA_KEY("fader");
+static const struct calldata_key key_db        = CALLDATA_KEY("db");
+static const struct calldata_key key_volmeter  = CALLDATA_KEY("volmeter");
+static const struct calldata_key key_level     = CALLDATA_KEY("level");
+static const struct calldata_key key_magnitude = CALLDATA_KEY("magnitude");
+static const struct calldata_key key_peak      = CALLDATA_KEY("peak");
+static const struct calldata_key key_muted     = CALLDATA_KEY("muted");
+static const struct calldata_key key_volume    = CALLDATA_KEY("volume");
+static const struct calldata_key key_data      = CALLDATA_KEY("data");
+
 static void signal_volume_changed(signal_handler_t *sh,
 		struct obs_fader *fader, const float db)
 {
 	struct calldata data;
+	uint8_t stack[128];
 
-	calldata_init(&data);
+	calldata_init_fixed(&data, stack, sizeof(stack));
 
-	calldata_set_ptr  (&data, "fader", fader);
-	calldata_set_float(&data, "db",    db);
+	calldata_set_ptr_key  (&data, &key_fader, fader);
+	calldata_set_float_key(&data, &key_db,    db);
 
 	signal_handler_signal(sh, "volume_changed", &data);
-
-	calldata_free(&data);
 }
 
 static void signal_levels_updated(signal_handler_t *sh,
@@ -212,18 +222,17 @@ static void signal_levels_updated(signal_handler_t *sh,
 		bool muted)
 {
 	struct calldata data;
+	uint8_t stack[256];
 
-	calldata_init(&data);
+	calldata_init_fixed(&data, stack, sizeof(stack));
 
-	calldata_set_ptr  (&data, "volmeter",  volmeter);
-	calldata_set_float(&data, "level",     level);
-	calldata_set_float(&data, "magnitude", magnitude);
-	calldata_set_float(&data, "peak",      peak);
-	calldata_set_bool (&data, "muted",     muted);
+	calldata_set_ptr_key  (&data, &key_volmeter,  volmeter);
+	calldata_set_float_key(&data, &key_level,     level);
+	calldata_set_float_key(&data, &key_magnitude, magnitude);
+	calldata_set_float_key(&data, &key_peak,      peak);
+	calldata_set_bool_key (&data, &key_muted,     muted);
 
 	signal_handler_signal(sh, "levels_updated", &data);
-
-	calldata_free(&data);
 }
 
 static void fader_source_volume_changed(void *vptr, calldata_t *calldata)
@@ -239,7 +248,8 @@ static void fader_source_volume_changed(void *vptr, calldata_t *calldata)
 	}
 
 	signal_handler_t *sh = fader->signals;
-	const float mul      = (float)calldata_float(calldata, "volume");
+	const float mul      = (float)calldata_float_key(calldata,
+			&key_volume);
 	const float db       = mul_to_db(mul);
 	fader->cur_db        = db;
 
@@ -254,7 +264,7 @@ static void volmeter_source_volume_changed(void *vptr, calldata_t *calldata)
 
 	pthread_mutex_lock(&volmeter->mutex);
 
-	float mul = (float) calldata_float(calldata, "volume");
+	float mul = (float) calldata_float_key(calldata, &key_volume);
 	volmeter->cur_db = mul_to_db(mul);
 
 	pthread_mutex_unlock(&volmeter->mutex);
@@ -383,7 +393,7 @@ static void volmeter_source_data_received(void *vptr, calldata_t *calldata)
 
 	pthread_mutex_lock(&volmeter->mutex);
 
-	struct audio_data *data = calldata_ptr(calldata, "data");
+	struct audio_data *data = calldata_ptr_key(calldata, &key_data);
 	updated = volmeter_process_audio_data(volmeter, data);
 
 	if (updated) {
@@ -400,7 +410,7 @@ static void volmeter_source_data_received(void *vptr, calldata_t *calldata)
 
 	if (updated)
 		signal_levels_updated(sh, volmeter, level, mag, peak,
-				calldata_bool(calldata, "muted"));
+				calldata_bool_key(calldata, &key_muted));
 }
 
 static void volmeter_update_audio_settings(obs_volmeter_t *volmeter)
@@ -15,6 +15,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <string.h>
+
 #include "obs.h"
 #include "obs-avc.h"
 #include "util/array-serializer.h"
@@ -44,50 +46,34 @@ bool obs_avc_keyframe(const uint8_t *data, size_t size)
 	return false;
 }
 
-/* NOTE: I noticed that FFmpeg does some unusual special handling of certain
- * scenarios that I was unaware of, so instead of just searching for {0, 0, 1}
- * we'll just use the code from FFmpeg - http://www.ffmpeg.org/ */
-static const uint8_t *ff_avc_find_startcode_internal(const uint8_t *p,
+/* searches for the first {0, 0, 1} sequence that is followed by at least one
+ * byte of data.  the byte following the two zeroes is rare in compressed
+ * data, so memchr (which is vectorized by the C runtime) is used to jump
+ * between candidate 1 bytes, and any candidate that isn't a start code lets
+ * us skip ahead three bytes. */
+static const uint8_t *find_startcode_internal(const uint8_t *p,
 		const uint8_t *end)
 {
-	const uint8_t *a = p + 4 - ((intptr_t)p & 3);
+	const uint8_t *last = end - 1;
+	const uint8_t *cur  = p + 2;
 
-	for (end -= 3; p < a && p < end; p++) {
-		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
-			return p;
-	}
+	while (cur < last) {
+		cur = memchr(cur, 1, last - cur);
+		if (!cur)
+			break;
 
-	for (end -= 3; p < end; p += 4) {
-		uint32_t x = *(const uint32_t*)p;
-
-		if ((x - 0x01010101) & (~x) & 0x80808080) {
-			if (p[1] == 0) {
-				if (p[0] == 0 && p[2] == 1)
-					return p;
-				if (p[2] == 0 && p[3] == 1)
-					return p+1;
-			}
-
-			if (p[3] == 0) {
-				if (p[2] == 0 && p[4] == 1)
-					return p+2;
-				if (p[4] == 0 && p[5] == 1)
-					return p+3;
-			}
-		}
-	}
+		if (cur[-1] == 0 && cur[-2] == 0)
+			return cur - 2;
 
-	for (end += 3; p < end; p++) {
-		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
-			return p;
+		cur += 3;
 	}
 
-	return end + 3;
+	return end;
 }
 
 const uint8_t *obs_avc_find_startcode(const uint8_t *p, const uint8_t *end)
 {
-	const uint8_t *out= ff_avc_find_startcode_internal(p, end);
+	const uint8_t *out = find_startcode_internal(p, end);
 	if (p < out && out < end && !out[-1]) out--;
 	return out;
 }
@@ -102,11 +88,13 @@ static inline int get_drop_priority(int priority)
 	return OBS_NAL_PRIORITY_HIGHEST;
 }
 
-static void serialize_avc_data(struct serializer *s, const uint8_t *data,
-		size_t size, bool *is_keyframe, int *priority)
+static size_t write_avc_data(uint8_t *out, const uint8_t *data, size_t size,
+		bool *is_keyframe, int *priority)
 {
 	const uint8_t *nal_start, *nal_end;
 	const uint8_t *end = data+size;
+	uint8_t *cur = out;
+	size_t nal_size;
 	int type;
 
 	nal_start = obs_avc_find_startcode(data, end);
@@ -126,29 +114,46 @@ static void serialize_avc_data(struct serializer *s, const uint8_t *data,
 		}
 
 		nal_end = obs_avc_find_startcode(nal_start, end);
-		s_wb32(s, (uint32_t)(nal_end - nal_start));
-		s_write(s, nal_start, nal_end - nal_start);
+		nal_size = nal_end - nal_start;
+
+		cur[0] = (uint8_t)(nal_size >> 24);
+		cur[1] = (uint8_t)(nal_size >> 16);
+		cur[2] = (uint8_t)(nal_size >> 8);
+		cur[3] = (uint8_t)nal_size;
+		memcpy(cur + 4, nal_start, nal_size);
+
+		cur += 4 + nal_size;
 		nal_start = nal_end;
 	}
+
+	return cur - out;
 }
 
-void obs_parse_avc_packet(struct encoder_packet *avc_packet,
-		const struct encoder_packet *src)
+size_t obs_avc_get_parsed_size_max(size_t size)
 {
-	struct array_output_data output;
-	struct serializer s;
+	/* every NAL is preceded by a start code of at least three bytes, which
+	 * is replaced by a four byte length */
+	return size + size / 3 + 4;
+}
 
-	array_output_serializer_init(&s, &output);
+void obs_parse_avc_packet_to(struct encoder_packet *avc_packet,
+		const struct encoder_packet *src, uint8_t *buf)
+{
 	*avc_packet = *src;
 
-	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe,
-			&avc_packet->priority);
-
-	avc_packet->data          = output.bytes.array;
-	avc_packet->size          = output.bytes.num;
+	avc_packet->data          = buf;
+	avc_packet->size          = write_avc_data(buf, src->data, src->size,
+			&avc_packet->keyframe, &avc_packet->priority);
 	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
 }
 
+void obs_parse_avc_packet(struct encoder_packet *avc_packet,
+		const struct encoder_packet *src)
+{
+	uint8_t *buf = bmalloc(obs_avc_get_parsed_size_max(src->size));
+	obs_parse_avc_packet_to(avc_packet, src, buf);
+}
+
 static inline bool has_start_code(const uint8_t *data)
 {
 	if (data[0] != 0 || data[1] != 0)
@@ -53,6 +53,14 @@ EXPORT const uint8_t *obs_avc_find_startcode(const uint8_t *p,
 		const uint8_t *end);
 EXPORT void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 		const struct encoder_packet *src);
+
+/**
+ * Parses an AVC packet into a caller-provided buffer, which must be at least
+ * obs_avc_get_parsed_size_max(src->size) bytes.
+ */
+EXPORT void obs_parse_avc_packet_to(struct encoder_packet *avc_packet,
+		const struct encoder_packet *src, uint8_t *buf);
+EXPORT size_t obs_avc_get_parsed_size_max(size_t size);
 EXPORT size_t obs_parse_avc_header(uint8_t **header, const uint8_t *data,
 		size_t size);
 
@@ -20,6 +20,7 @@
 #include "util/dstr.h"
 #include "util/darray.h"
 #include "util/platform.h"
+#include "util/array-serializer.h"
 #include "graphics/vec2.h"
 #include "graphics/vec3.h"
 #include "graphics/vec4.h"
@@ -40,12 +41,19 @@ struct obs_data_item {
 	size_t               default_size;
 	size_t               autoselect_size;
 	size_t               capacity;
+	uint32_t             name_hash;
 };
 
 struct obs_data {
 	volatile long        ref;
 	char                 *json;
 	struct obs_data_item *first_item;
+	struct obs_data_item *last_item;
+	size_t               num_items;
+
+	/* name index, only built for objects with many items */
+	struct obs_data_item **index;
+	size_t               index_size;
 };
 
 struct obs_data_array {
@@ -254,6 +262,118 @@ static inline void item_autoselect_data_addref(struct obs_data_item *item)
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* Name index (open addressing, linear probing) */
+
+#define INDEX_MIN_ITEMS 32
+
+static inline uint32_t get_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static inline void index_insert(struct obs_data *data,
+		struct obs_data_item *item)
+{
+	size_t mask = data->index_size - 1;
+	size_t i    = item->name_hash & mask;
+
+	while (data->index[i])
+		i = (i + 1) & mask;
+
+	data->index[i] = item;
+}
+
+static void index_build(struct obs_data *data)
+{
+	struct obs_data_item *item = data->first_item;
+	size_t size = INDEX_MIN_ITEMS * 2;
+
+	while (size < data->num_items * 2)
+		size *= 2;
+
+	bfree(data->index);
+	data->index      = bzalloc(size * sizeof(struct obs_data_item*));
+	data->index_size = size;
+
+	while (item) {
+		index_insert(data, item);
+		item = item->next;
+	}
+}
+
+static inline bool index_find_slot(struct obs_data *data,
+		struct obs_data_item *item, uint32_t hash, size_t *slot)
+{
+	size_t mask = data->index_size - 1;
+	size_t i    = hash & mask;
+
+	while (data->index[i]) {
+		if (data->index[i] == item) {
+			*slot = i;
+			return true;
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	return false;
+}
+
+static void index_remove(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t mask = data->index_size - 1;
+	size_t i, j;
+
+	if (!index_find_slot(data, item, item->name_hash, &i))
+		return;
+
+	data->index[i] = NULL;
+
+	/* move back any following entries that would otherwise no longer be
+	 * reachable from their home slot */
+	for (j = (i + 1) & mask; data->index[j]; j = (j + 1) & mask) {
+		size_t home = data->index[j]->name_hash & mask;
+		bool reachable = (i <= j) ?
+			(home > i && home <= j) :
+			(home > i || home <= j);
+
+		if (!reachable) {
+			data->index[i] = data->index[j];
+			data->index[j] = NULL;
+			i = j;
+		}
+	}
+}
+
+static inline void index_add_item(struct obs_data *data,
+		struct obs_data_item *item)
+{
+	data->num_items++;
+
+	/* built here rather than on lookup, so that getting values never
+	 * modifies the object and can be done from several threads */
+	if (!data->index) {
+		if (data->num_items >= INDEX_MIN_ITEMS)
+			index_build(data);
+		return;
+	}
+
+	if (data->num_items * 2 > data->index_size)
+		index_build(data);
+	else
+		index_insert(data, item);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static struct obs_data_item *obs_data_item_create(const char *name,
 		const void *data, size_t size, enum obs_data_type type,
 		bool default_data, bool autoselect_data)
@@ -286,6 +406,8 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 		item->data_size = size;
 	}
 
+	item->name_hash = get_name_hash(name);
+
 	strcpy(get_item_name(item), name);
 	memcpy(get_item_data(item), data, size);
 
@@ -315,23 +437,41 @@ static struct obs_data_item **get_item_prev_next(struct obs_data *data,
 
 static inline void obs_data_item_detach(struct obs_data_item *item)
 {
-	struct obs_data_item **prev_next = get_item_prev_next(item->parent,
-			item);
+	struct obs_data *data = item->parent;
+	struct obs_data_item **prev_next = get_item_prev_next(data, item);
 
 	if (prev_next) {
+		if (data->last_item == item)
+			data->last_item = (prev_next == &data->first_item) ?
+				NULL :
+				(struct obs_data_item*)((uint8_t*)prev_next -
+					offsetof(struct obs_data_item, next));
+
 		*prev_next = item->next;
 		item->next = NULL;
+
+		data->num_items--;
+		if (data->index)
+			index_remove(data, item);
 	}
 }
 
 static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 		struct obs_data_item *new_ptr)
 {
-	struct obs_data_item **prev_next = get_item_prev_next(new_ptr->parent,
-			old_ptr);
+	struct obs_data *data = new_ptr->parent;
+	struct obs_data_item **prev_next = get_item_prev_next(data, old_ptr);
+	size_t slot;
 
-	if (prev_next)
+	if (prev_next) {
 		*prev_next = new_ptr;
+
+		if (data->last_item == old_ptr)
+			data->last_item = new_ptr;
+		if (data->index && index_find_slot(data, old_ptr,
+					new_ptr->name_hash, &slot))
+			data->index[slot] = new_ptr;
+	}
 }
 
 static struct obs_data_item *obs_data_item_ensure_capacity(
@@ -697,6 +837,9 @@ static inline void obs_data_destroy(struct obs_data *data)
 {
 	struct obs_data_item *item = data->first_item;
 
+	bfree(data->index);
+	data->index = NULL;
+
 	while (item) {
 		struct obs_data_item *next = item->next;
 		obs_data_item_release(&item);
@@ -756,10 +899,553 @@ bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 	return false;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Binary format
+ *
+ * Compact alternative to JSON for large files.  "var" is an unsigned LEB128
+ * varint, fixed size values are little-endian:
+ *
+ *   header:       "OBSB", uint32 version, var string count,
+ *                 var string table size in bytes
+ *   string table: per string var length, bytes, '\0'
+ *   object:       var item count, items
+ *   item:         var name (string index), uint8 obs_data_type, value
+ *     string:     var string index
+ *     number:     uint8 obs_data_number_type, then a zigzag encoded var
+ *                 for integers or a little-endian double
+ *     boolean:    uint8
+ *     object:     object
+ *     array:      var object count, objects
+ *
+ * Names and string values are interned, and strings are NUL terminated so
+ * they are used in place from the loaded (or mapped) buffer.  Like JSON,
+ * only user values are stored. */
+
+#define BINARY_MAGIC     "OBSB"
+#define BINARY_VERSION   1
+#define BINARY_MAX_DEPTH 128
+
+struct binary_string {
+	const char *str;
+	uint32_t   hash;
+	uint32_t   idx;
+};
+
+struct binary_writer {
+	struct serializer        s;
+	struct array_output_data body;
+
+	DARRAY(const char*)      strings;
+	size_t                   strings_size;
+	struct binary_string     *table;
+	size_t                   table_size;
+};
+
+static inline void s_wvar(struct serializer *s, uint64_t val)
+{
+	while (val >= 0x80) {
+		s_w8(s, (uint8_t)(val | 0x80));
+		val >>= 7;
+	}
+
+	s_w8(s, (uint8_t)val);
+}
+
+static inline size_t var_size(uint64_t val)
+{
+	size_t size = 1;
+
+	while (val >= 0x80) {
+		val >>= 7;
+		size++;
+	}
+
+	return size;
+}
+
+static void binary_grow_table(struct binary_writer *w)
+{
+	size_t new_size = w->table_size ? w->table_size * 2 : 256;
+	size_t mask     = new_size - 1;
+	struct binary_string *table =
+		bzalloc(new_size * sizeof(struct binary_string));
+
+	for (size_t i = 0; i < w->table_size; i++) {
+		struct binary_string *str = &w->table[i];
+		size_t idx;
+
+		if (!str->str)
+			continue;
+
+		idx = str->hash & mask;
+		while (table[idx].str)
+			idx = (idx + 1) & mask;
+		table[idx] = *str;
+	}
+
+	bfree(w->table);
+	w->table      = table;
+	w->table_size = new_size;
+}
+
+static uint32_t binary_intern(struct binary_writer *w, const char *str)
+{
+	uint32_t hash = get_name_hash(str);
+	size_t mask, i, len;
+
+	if ((w->strings.num + 1) * 2 > w->table_size)
+		binary_grow_table(w);
+
+	mask = w->table_size - 1;
+	i    = hash & mask;
+
+	while (w->table[i].str) {
+		if (w->table[i].hash == hash &&
+		    strcmp(w->table[i].str, str) == 0)
+			return w->table[i].idx;
+
+		i = (i + 1) & mask;
+	}
+
+	w->table[i].str  = str;
+	w->table[i].hash = hash;
+	w->table[i].idx  = (uint32_t)w->strings.num;
+
+	len = strlen(str);
+	da_push_back(w->strings, &str);
+	w->strings_size += var_size(len) + len + 1;
+	return w->table[i].idx;
+}
+
+static void binary_write_obj(struct binary_writer *w, obs_data_t *data);
+
+static void binary_write_array(struct binary_writer *w,
+		obs_data_array_t *array)
+{
+	size_t count = obs_data_array_count(array);
+
+	s_wvar(&w->s, count);
+	for (size_t i = 0; i < count; i++)
+		binary_write_obj(w, array->objects.array[i]);
+}
+
+static void binary_write_item(struct binary_writer *w,
+		struct obs_data_item *item)
+{
+	void *ptr = get_item_data(item);
+
+	s_wvar(&w->s, binary_intern(w, get_item_name(item)));
+	s_w8(&w->s, (uint8_t)item->type);
+
+	if (item->type == OBS_DATA_STRING) {
+		s_wvar(&w->s, binary_intern(w, ptr));
+
+	} else if (item->type == OBS_DATA_NUMBER) {
+		struct obs_data_number *num = ptr;
+
+		s_w8(&w->s, (uint8_t)num->type);
+		if (num->type == OBS_DATA_NUM_INT)
+			s_wvar(&w->s, ((uint64_t)num->int_val << 1) ^
+					(uint64_t)(num->int_val >> 63));
+		else
+			s_wld(&w->s, num->double_val);
+
+	} else if (item->type == OBS_DATA_BOOLEAN) {
+		s_w8(&w->s, *(bool*)ptr);
+
+	} else if (item->type == OBS_DATA_OBJECT) {
+		binary_write_obj(w, get_item_obj(item));
+
+	} else if (item->type == OBS_DATA_ARRAY) {
+		binary_write_array(w, get_item_array(item));
+	}
+}
+
+static inline bool binary_has_value(struct obs_data_item *item)
+{
+	return obs_data_item_has_user_value(item) &&
+		item->type != OBS_DATA_NULL;
+}
+
+static void binary_write_obj(struct binary_writer *w, obs_data_t *data)
+{
+	struct obs_data_item *item;
+	size_t count = 0;
+
+	for (item = data ? data->first_item : NULL; item; item = item->next)
+		if (binary_has_value(item))
+			count++;
+
+	s_wvar(&w->s, count);
+
+	for (item = data ? data->first_item : NULL; item; item = item->next)
+		if (binary_has_value(item))
+			binary_write_item(w, item);
+}
+
+uint8_t *obs_data_to_binary(obs_data_t *data, size_t *size)
+{
+	struct binary_writer w = {0};
+	struct array_output_data output;
+	struct serializer s;
+
+	if (!data || !size)
+		return NULL;
+
+	array_output_serializer_init(&w.s, &w.body);
+	binary_write_obj(&w, data);
+
+	array_output_serializer_init(&s, &output);
+	da_reserve(output.bytes, 16 + w.strings_size + w.body.bytes.num);
+
+	s_write(&s, BINARY_MAGIC, 4);
+	s_wl32(&s, BINARY_VERSION);
+	s_wvar(&s, w.strings.num);
+	s_wvar(&s, w.strings_size);
+
+	for (size_t i = 0; i < w.strings.num; i++) {
+		const char *str = w.strings.array[i];
+		size_t len = strlen(str);
+
+		s_wvar(&s, len);
+		s_write(&s, str, len + 1);
+	}
+
+	s_write(&s, w.body.bytes.array, w.body.bytes.num);
+
+	array_output_serializer_free(&w.body);
+	da_free(w.strings);
+	bfree(w.table);
+
+	*size = output.bytes.num;
+	return output.bytes.array;
+}
+
+bool obs_data_save_binary(obs_data_t *data, const char *file)
+{
+	size_t size;
+	uint8_t *buf = obs_data_to_binary(data, &size);
+	bool success = false;
+
+	if (buf) {
+		success = os_quick_write_utf8_file(file, (const char*)buf,
+				size, false);
+		bfree(buf);
+	}
+
+	return success;
+}
+
+bool obs_data_save_binary_safe(obs_data_t *data, const char *file,
+		const char *temp_ext, const char *backup_ext)
+{
+	size_t size;
+	uint8_t *buf = obs_data_to_binary(data, &size);
+	bool success = false;
+
+	if (buf) {
+		success = os_quick_write_utf8_file_safe(file, (const char*)buf,
+				size, false, temp_ext, backup_ext);
+		bfree(buf);
+	}
+
+	return success;
+}
+
+struct binary_reader {
+	const uint8_t *data;
+	size_t        size;
+	size_t        pos;
+	bool          error;
+
+	const char    **strings;
+	uint32_t      num_strings;
+};
+
+static inline size_t r_left(struct binary_reader *r)
+{
+	return r->size - r->pos;
+}
+
+static inline uint8_t r_u8(struct binary_reader *r)
+{
+	if (r_left(r) < 1) {
+		r->error = true;
+		return 0;
+	}
+
+	return r->data[r->pos++];
+}
+
+static inline uint32_t r_u32(struct binary_reader *r)
+{
+	const uint8_t *p = r->data + r->pos;
+
+	if (r_left(r) < 4) {
+		r->error = true;
+		return 0;
+	}
+
+	r->pos += 4;
+	return (uint32_t)p[0]         | ((uint32_t)p[1] << 8) |
+	      ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t r_u64(struct binary_reader *r)
+{
+	uint64_t lo = r_u32(r);
+	uint64_t hi = r_u32(r);
+	return lo | (hi << 32);
+}
+
+static inline uint64_t r_var(struct binary_reader *r)
+{
+	uint64_t val = 0;
+
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		uint8_t byte = r_u8(r);
+
+		val |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return val;
+	}
+
+	r->error = true;
+	return 0;
+}
+
+/* counts and sizes, which can never exceed the data that is left */
+static inline size_t r_count(struct binary_reader *r, size_t min_size)
+{
+	uint64_t count = r_var(r);
+
+	if (count > r_left(r) / min_size) {
+		r->error = true;
+		return 0;
+	}
+
+	return (size_t)count;
+}
+
+static inline const char *r_string(struct binary_reader *r)
+{
+	uint64_t idx = r_var(r);
+
+	if (r->error || idx >= r->num_strings) {
+		r->error = true;
+		return NULL;
+	}
+
+	return r->strings[idx];
+}
+
+static bool binary_read_strings(struct binary_reader *r)
+{
+	size_t num  = r_count(r, 2);
+	size_t size = r_count(r, 1);
+	size_t end;
+
+	if (r->error || num > size / 2 || num > UINT32_MAX)
+		return false;
+
+	end            = r->pos + size;
+	r->num_strings = (uint32_t)num;
+	r->strings     = num ? bmalloc(num * sizeof(const char*)) : NULL;
+
+	for (size_t i = 0; i < num; i++) {
+		uint64_t len = r_var(r);
+
+		/* the length itself can run past the end of the block */
+		if (r->error || r->pos >= end)
+			return false;
+		if (len >= end - r->pos || r->data[r->pos + len] != 0)
+			return false;
+
+		r->strings[i] = (const char*)r->data + r->pos;
+		r->pos += (size_t)len + 1;
+	}
+
+	return r->pos == end;
+}
+
+static bool binary_read_obj(struct binary_reader *r, obs_data_t *data,
+		int depth);
+
+static obs_data_array_t *binary_read_array(struct binary_reader *r,
+		int depth)
+{
+	size_t count = r_count(r, 1);
+	obs_data_array_t *array = obs_data_array_create();
+
+	da_reserve(array->objects, count);
+
+	for (size_t i = 0; i < count && !r->error; i++) {
+		obs_data_t *obj = obs_data_create();
+		binary_read_obj(r, obj, depth + 1);
+		obs_data_array_push_back(array, obj);
+		obs_data_release(obj);
+	}
+
+	return array;
+}
+
+static void binary_read_item(struct binary_reader *r, obs_data_t *data,
+		int depth)
+{
+	const char *name = r_string(r);
+	uint8_t    type  = r_u8(r);
+
+	if (r->error)
+		return;
+
+	if (type == OBS_DATA_STRING) {
+		const char *val = r_string(r);
+		if (val)
+			obs_data_set_string(data, name, val);
+
+	} else if (type == OBS_DATA_NUMBER) {
+		uint8_t  num_type = r_u8(r);
+		uint64_t val;
+		double   d_val;
+
+		if (num_type == OBS_DATA_NUM_INT) {
+			val = r_var(r);
+			if (!r->error)
+				obs_data_set_int(data, name,
+						(long long)((val >> 1) ^
+						(~(val & 1) + 1)));
+
+		} else if (num_type == OBS_DATA_NUM_DOUBLE) {
+			val = r_u64(r);
+			memcpy(&d_val, &val, sizeof(d_val));
+			if (!r->error)
+				obs_data_set_double(data, name, d_val);
+
+		} else {
+			r->error = true;
+		}
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		uint8_t val = r_u8(r);
+		if (!r->error)
+			obs_data_set_bool(data, name, val != 0);
+
+	} else if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj = obs_data_create();
+		binary_read_obj(r, obj, depth + 1);
+		obs_data_set_obj(data, name, obj);
+		obs_data_release(obj);
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array = binary_read_array(r, depth);
+		obs_data_set_array(data, name, array);
+		obs_data_array_release(array);
+
+	} else {
+		r->error = true;
+	}
+}
+
+static bool binary_read_obj(struct binary_reader *r, obs_data_t *data,
+		int depth)
+{
+	/* every item takes at least three bytes */
+	size_t count = r_count(r, 3);
+
+	if (depth > BINARY_MAX_DEPTH)
+		r->error = true;
+
+	for (size_t i = 0; i < count && !r->error; i++)
+		binary_read_item(r, data, depth);
+
+	return !r->error;
+}
+
+obs_data_t *obs_data_create_from_binary(const void *buf, size_t size)
+{
+	struct binary_reader r = {0};
+	obs_data_t *data = NULL;
+	uint32_t version;
+
+	if (!buf || size < 8 || memcmp(buf, BINARY_MAGIC, 4) != 0) {
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+		                "Not obs_data binary data");
+		return NULL;
+	}
+
+	r.data = buf;
+	r.size = size;
+	r.pos  = 4;
+
+	version = r_u32(&r);
+	if (version != BINARY_VERSION) {
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+		                "Unsupported version %u", version);
+		return NULL;
+	}
+
+	if (binary_read_strings(&r)) {
+		data = obs_data_create();
+
+		if (!binary_read_obj(&r, data, 0)) {
+			obs_data_release(data);
+			data = NULL;
+		}
+	}
+
+	if (!data)
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+		                "Invalid or truncated data");
+
+	bfree(r.strings);
+	return data;
+}
+
+obs_data_t *obs_data_create_from_binary_file(const char *file)
+{
+	FILE *f = os_fopen(file, "rb");
+	obs_data_t *data = NULL;
+	uint8_t *buf;
+	int64_t size;
+
+	if (!f)
+		return NULL;
+
+	size = os_fgetsize(f);
+	if (size > 0) {
+		buf = bmalloc((size_t)size);
+
+		if (fread(buf, 1, (size_t)size, f) == (size_t)size)
+			data = obs_data_create_from_binary(buf, (size_t)size);
+
+		bfree(buf);
+	}
+
+	fclose(f);
+	return data;
+}
+
 static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 {
 	if (!data) return NULL;
 
+	if (data->index) {
+		uint32_t hash = get_name_hash(name);
+		size_t   mask = data->index_size - 1;
+		size_t   i    = hash & mask;
+		struct obs_data_item *item;
+
+		while ((item = data->index[i]) != NULL) {
+			if (item->name_hash == hash &&
+			    strcmp(get_item_name(item), name) == 0)
+				return item;
+
+			i = (i + 1) & mask;
+		}
+
+		return NULL;
+	}
+
 	struct obs_data_item *item = data->first_item;
 
 	while (item) {
@@ -782,17 +1468,25 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 	if ((!item || (item && !*item)) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type,
 				default_data, autoselect_data);
+		new_item->parent = data;
 
-		obs_data_item_t *prev = obs_data_first(data);
-		obs_data_item_t *next = obs_data_first(data);
-		obs_data_item_next(&next);
-		for (; prev && next; obs_data_item_next(&prev),
-				obs_data_item_next(&next)) {
-			if (strcmp(get_item_name(next), name) > 0)
-				break;
+		/* items are kept sorted, and are usually added in order */
+		if (data->last_item &&
+		    strcmp(get_item_name(data->last_item), name) < 0) {
+			data->last_item->next = new_item;
+			data->last_item       = new_item;
+			index_add_item(data, new_item);
+			return;
+		}
+
+		obs_data_item_t *prev = data->first_item;
+		obs_data_item_t *next = prev ? prev->next : NULL;
+
+		while (next && strcmp(get_item_name(next), name) < 0) {
+			prev = next;
+			next = next->next;
 		}
 
-		new_item->parent = data;
 		if (prev && strcmp(get_item_name(prev), name) < 0) {
 			prev->next     = new_item;
 			new_item->next = next;
@@ -804,9 +1498,10 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 
 		if (!prev)
 			data->first_item = new_item;
+		if (!new_item->next)
+			data->last_item = new_item;
 
-		obs_data_item_release(&prev);
-		obs_data_item_release(&next);
+		index_add_item(data, new_item);
 
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
@@ -17,6 +17,7 @@
 
 #include "obs.h"
 #include "obs-internal.h"
+#include "obs-avc.h"
 
 struct obs_encoder_info *find_encoder(const char *id)
 {
@@ -98,7 +99,8 @@ static struct obs_encoder *create_encoder(const char *id,
 
 	obs_context_data_insert(&encoder->context,
 			&obs->data.encoders_mutex,
-			&obs->data.first_encoder);
+			&obs->data.first_encoder,
+			&obs->data.encoder_names);
 
 	blog(LOG_INFO, "encoder '%s' (%s) created", name, id);
 	return encoder;
@@ -169,6 +171,29 @@ static inline bool has_scaling(const struct obs_encoder *encoder)
 		 video_height != encoder->scaled_height);
 }
 
+/* have the audio thread output blocks of the encoder's frame size so they
+ * can be encoded without being re-buffered.  the first encoder to start gets
+ * its frame size, encoders with other frame sizes still work but buffer */
+static void set_audio_block_frames(struct obs_encoder *encoder)
+{
+	audio_t *audio = encoder->media;
+
+	if (encoder->samplerate != audio_output_get_sample_rate(audio))
+		return;
+
+	if (!audio_output_get_block_frames(audio))
+		audio_output_set_block_frames(audio,
+				(uint32_t)encoder->framesize);
+}
+
+static void reset_audio_block_frames(struct obs_encoder *encoder)
+{
+	audio_t *audio = encoder->media;
+
+	if (!audio_output_active(audio))
+		audio_output_set_block_frames(audio, 0);
+}
+
 static void add_connection(struct obs_encoder *encoder)
 {
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
@@ -177,6 +202,7 @@ static void add_connection(struct obs_encoder *encoder)
 
 		audio_output_connect(encoder->media, encoder->mixer_idx,
 				&audio_info, receive_audio, encoder);
+		set_audio_block_frames(encoder);
 	} else {
 		struct video_scale_info info = {0};
 		get_video_info(encoder, &info);
@@ -188,14 +214,28 @@ static void add_connection(struct obs_encoder *encoder)
 	encoder->active = true;
 }
 
+static void remove_video_connection(struct obs_encoder *encoder)
+{
+	uint32_t skipped = video_output_get_input_skipped_frames(
+			encoder->media, receive_video, encoder);
+
+	if (skipped)
+		blog(LOG_INFO, "Encoder '%s': %u frames were repeated "
+				"because encoding could not keep up",
+				encoder->context.name, skipped);
+
+	video_output_disconnect(encoder->media, receive_video, encoder);
+}
+
 static void remove_connection(struct obs_encoder *encoder)
 {
-	if (encoder->info.type == OBS_ENCODER_AUDIO)
+	if (encoder->info.type == OBS_ENCODER_AUDIO) {
 		audio_output_disconnect(encoder->media, encoder->mixer_idx,
 				receive_audio, encoder);
-	else
-		video_output_disconnect(encoder->media, receive_video,
-				encoder);
+		reset_audio_block_frames(encoder);
+	} else {
+		remove_video_connection(encoder);
+	}
 
 	obs_encoder_shutdown(encoder);
 	encoder->active = false;
@@ -584,11 +624,128 @@ static inline bool get_sei(const struct obs_encoder *encoder,
 	return false;
 }
 
+/* packet payloads sent to outputs are refcounted: the reference count is
+ * stored in a small header in front of the data, along with the AVCC form of
+ * the packet once an output has asked for it.  avc_ready is only set once
+ * avc is filled in; the first output to ask parses the packet with
+ * avc_mutex held, and any others asking at the same time wait on it */
+struct packet_header {
+	volatile long         refs;
+	volatile long         avc_ready;
+	pthread_mutex_t       avc_mutex;
+	struct encoder_packet avc;
+};
+
+#define PACKET_HEADER_SIZE ((sizeof(struct packet_header) + 15) & ~(size_t)15)
+
+static volatile long packet_allocs = 0;
+static volatile long packet_dups   = 0;
+static volatile long packet_refs   = 0;
+
+static inline struct packet_header *get_packet_header(
+		const struct encoder_packet *packet)
+{
+	return (struct packet_header*)(packet->data - PACKET_HEADER_SIZE);
+}
+
+static uint8_t *alloc_packet_data(size_t size)
+{
+	uint8_t *buf = bmalloc(size + PACKET_HEADER_SIZE);
+	struct packet_header *header = (struct packet_header*)buf;
+
+	header->refs      = 1;
+	header->avc_ready = false;
+	pthread_mutex_init(&header->avc_mutex, NULL);
+
+	os_atomic_inc_long(&packet_allocs);
+	return buf + PACKET_HEADER_SIZE;
+}
+
+void obs_encoder_packet_create_instance(struct encoder_packet *dst,
+		const struct encoder_packet *src)
+{
+	*dst = *src;
+	dst->data = alloc_packet_data(src->size);
+	memcpy(dst->data, src->data, src->size);
+}
+
+void obs_encoder_packet_ref(struct encoder_packet *dst,
+		const struct encoder_packet *src)
+{
+	if (src->data) {
+		os_atomic_inc_long(&get_packet_header(src)->refs);
+		os_atomic_inc_long(&packet_refs);
+	}
+
+	*dst = *src;
+}
+
+void obs_encoder_packet_release(struct encoder_packet *packet)
+{
+	struct packet_header *header;
+
+	if (!packet)
+		return;
+
+	if (packet->data) {
+		header = get_packet_header(packet);
+
+		if (os_atomic_dec_long(&header->refs) == 0) {
+			if (header->avc_ready)
+				obs_encoder_packet_release(&header->avc);
+			pthread_mutex_destroy(&header->avc_mutex);
+			bfree(header);
+		}
+	}
+
+	memset(packet, 0, sizeof(struct encoder_packet));
+}
+
+static void parse_avc(struct packet_header *header,
+		const struct encoder_packet *src)
+{
+	size_t max_size = obs_avc_get_parsed_size_max(src->size);
+	obs_parse_avc_packet_to(&header->avc, src, alloc_packet_data(max_size));
+}
+
+void obs_encoder_packet_parse_avc(struct encoder_packet *avc_packet,
+		const struct encoder_packet *src)
+{
+	struct packet_header *header = get_packet_header(src);
+	struct encoder_packet shared;
+
+	if (!os_atomic_load_long(&header->avc_ready)) {
+		pthread_mutex_lock(&header->avc_mutex);
+		if (!header->avc_ready) {
+			parse_avc(header, src);
+			os_atomic_set_long(&header->avc_ready, true);
+		}
+		pthread_mutex_unlock(&header->avc_mutex);
+	}
+
+	/* timestamps are adjusted per output, so only the payload and the
+	 * values parsed from it are taken from the shared packet */
+	obs_encoder_packet_ref(&shared, &header->avc);
+
+	*avc_packet               = *src;
+	avc_packet->data          = shared.data;
+	avc_packet->size          = shared.size;
+	avc_packet->keyframe      = shared.keyframe;
+	avc_packet->priority      = shared.priority;
+	avc_packet->drop_priority = shared.drop_priority;
+}
+
+void obs_encoder_packet_get_stats(long *allocs, long *dups, long *refs)
+{
+	if (allocs) *allocs = os_atomic_load_long(&packet_allocs);
+	if (dups)   *dups   = os_atomic_load_long(&packet_dups);
+	if (refs)   *refs   = os_atomic_load_long(&packet_refs);
+}
+
 static void send_first_video_packet(struct obs_encoder *encoder,
 		struct encoder_callback *cb, struct encoder_packet *packet)
 {
 	struct encoder_packet first_packet;
-	DARRAY(uint8_t)       data;
 	uint8_t               *sei;
 	size_t                size;
 
@@ -596,25 +753,22 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	if (!packet->keyframe)
 		return;
 
-	da_init(data);
-
 	if (!get_sei(encoder, &sei, &size)) {
 		cb->new_packet(cb->param, packet);
 		cb->sent_first_packet = true;
 		return;
 	}
 
-	da_push_back_array(data, sei, size);
-	da_push_back_array(data, packet->data, packet->size);
-
 	first_packet      = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	first_packet.data = alloc_packet_data(size + packet->size);
+	first_packet.size = size + packet->size;
+	memcpy(first_packet.data, sei, size);
+	memcpy(first_packet.data + size, packet->data, packet->size);
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static inline void send_packet(struct obs_encoder *encoder,
@@ -667,19 +821,26 @@ static inline void do_encode(struct obs_encoder *encoder,
 	}
 
 	if (received) {
+		struct encoder_packet shared_pkt;
+
 		/* we use system time here to ensure sync with other encoders,
 		 * you do not want to use relative timestamps here */
 		pkt.dts_usec = encoder->start_ts / 1000 + packet_dts_usec(&pkt);
 
+		/* copy the payload once; outputs take references to it */
+		obs_encoder_packet_create_instance(&shared_pkt, &pkt);
+
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
 			struct encoder_callback *cb;
 			cb = encoder->callbacks.array+(i-1);
-			send_packet(encoder, cb, &pkt);
+			send_packet(encoder, cb, &shared_pkt);
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+		obs_encoder_packet_release(&shared_pkt);
 	}
 
 	profile_end(do_encode_name);
@@ -713,6 +874,36 @@ static void receive_video(void *param, struct video_data *frame)
 	profile_end(receive_video_name);
 }
 
+static void send_audio_frame(struct obs_encoder *encoder, uint8_t **data,
+		size_t offset)
+{
+	struct encoder_frame  enc_frame;
+
+	memset(&enc_frame, 0, sizeof(struct encoder_frame));
+
+	for (size_t i = 0; i < encoder->planes; i++) {
+		enc_frame.data[i]     = data[i] + offset;
+		enc_frame.linesize[i] = (uint32_t)encoder->framesize_bytes;
+	}
+
+	enc_frame.frames = (uint32_t)encoder->framesize;
+	enc_frame.pts    = encoder->cur_pts;
+
+	do_encode(encoder, &enc_frame);
+
+	encoder->cur_pts += encoder->framesize;
+}
+
+static void send_audio_data(struct obs_encoder *encoder)
+{
+	for (size_t i = 0; i < encoder->planes; i++)
+		circlebuf_pop_front(&encoder->audio_input_buffer[i],
+				encoder->audio_output_buffer[i],
+				encoder->framesize_bytes);
+
+	send_audio_frame(encoder, encoder->audio_output_buffer, 0);
+}
+
 static const char *buffer_audio_name = "buffer_audio";
 static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
 {
@@ -751,6 +942,16 @@ static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
 
 	size -= offset_size;
 
+	/* fixed-size blocks that match the encoder frame size (see
+	 * set_audio_block_frames) can be encoded straight from the mix
+	 * without being copied through the circular buffer */
+	if (size == encoder->framesize_bytes &&
+	    !encoder->audio_input_buffer[0].size) {
+		send_audio_frame(encoder, data->data, offset_size);
+		profile_end(buffer_audio_name);
+		return true;
+	}
+
 	/* push in to the circular buffer */
 	if (size)
 		for (size_t i = 0; i < encoder->planes; i++)
@@ -765,29 +966,6 @@ fail:
 	return false;
 }
 
-static void send_audio_data(struct obs_encoder *encoder)
-{
-	struct encoder_frame  enc_frame;
-
-	memset(&enc_frame, 0, sizeof(struct encoder_frame));
-
-	for (size_t i = 0; i < encoder->planes; i++) {
-		circlebuf_pop_front(&encoder->audio_input_buffer[i],
-				encoder->audio_output_buffer[i],
-				encoder->framesize_bytes);
-
-		enc_frame.data[i]     = encoder->audio_output_buffer[i];
-		enc_frame.linesize[i] = (uint32_t)encoder->framesize_bytes;
-	}
-
-	enc_frame.frames = (uint32_t)encoder->framesize;
-	enc_frame.pts    = encoder->cur_pts;
-
-	do_encode(encoder, &enc_frame);
-
-	encoder->cur_pts += encoder->framesize;
-}
-
 static const char *receive_audio_name = "receive_audio";
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
 {
@@ -832,6 +1010,7 @@ void obs_duplicate_encoder_packet(struct encoder_packet *dst,
 {
 	*dst = *src;
 	dst->data = bmemdup(src->data, src->size);
+	os_atomic_inc_long(&packet_dups);
 }
 
 void obs_free_encoder_packet(struct encoder_packet *packet)
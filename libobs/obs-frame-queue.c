@@ -0,0 +1,238 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+
+#include "obs-frame-queue.h"
+
+/* #define DEBUG_ASYNC_FRAMES 1 */
+
+void obs_frame_queue_init(struct obs_frame_queue *queue,
+		obs_frame_queue_release_t release, void *param)
+{
+	memset(queue, 0, sizeof(*queue));
+	queue->release = release;
+	queue->param   = param;
+}
+
+static inline void release_frame(struct obs_frame_queue *queue,
+		struct obs_source_frame *frame)
+{
+	if (frame)
+		queue->release(queue->param, frame);
+}
+
+static inline bool frames_jump(const struct obs_source_frame *prev,
+		const struct obs_source_frame *next)
+{
+	return (next->timestamp - prev->timestamp) > MAX_TS_VAR;
+}
+
+void obs_frame_queue_push(struct obs_frame_queue *queue,
+		struct obs_source_frame *frame)
+{
+	size_t idx = queue->start + queue->num;
+	if (idx >= MAX_ASYNC_FRAMES)
+		idx -= MAX_ASYNC_FRAMES;
+
+	if (queue->num &&
+	    frames_jump(obs_frame_queue_peek(queue, queue->num - 1), frame))
+		queue->jumps++;
+
+	queue->frames[idx] = frame;
+	queue->num++;
+}
+
+struct obs_source_frame *obs_frame_queue_pop(struct obs_frame_queue *queue)
+{
+	struct obs_source_frame *frame = obs_frame_queue_peek(queue, 0);
+
+	if (queue->num > 1 &&
+	    frames_jump(frame, obs_frame_queue_peek(queue, 1)))
+		queue->jumps--;
+
+	if (++queue->start == MAX_ASYNC_FRAMES)
+		queue->start = 0;
+	queue->num--;
+
+	return frame;
+}
+
+static inline bool frame_out_of_bounds(const struct obs_frame_queue *queue,
+		uint64_t ts)
+{
+	if (ts < queue->last_frame_ts)
+		return ((queue->last_frame_ts - ts) > MAX_TS_VAR);
+	else
+		return ((ts - queue->last_frame_ts) > MAX_TS_VAR);
+}
+
+/* a frame can be skipped if it is at least 2ms older than the current frame
+ * time.  this tries to reduce the needless frame duplication, also helps
+ * smooth out async rendering to frame boundaries.  In other words, tries to
+ * keep the framerate as smooth as possible */
+static inline bool frame_expired(const struct obs_frame_queue *queue,
+		const struct obs_source_frame *frame)
+{
+	return queue->last_frame_ts > frame->timestamp &&
+		(queue->last_frame_ts - frame->timestamp) >= 2000000;
+}
+
+/* gets the number of leading frames that have expired.  only valid when the
+ * queue has no timestamp jumps, as the queue is then sorted */
+static size_t find_expired_frames(const struct obs_frame_queue *queue)
+{
+	size_t lo = 0;
+	size_t hi = queue->num;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (frame_expired(queue, obs_frame_queue_peek(queue, mid)))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* skips all but the newest expired frame */
+static bool skip_expired_frames(struct obs_frame_queue *queue)
+{
+	size_t expired = find_expired_frames(queue);
+
+	if (!expired)
+		return false;
+
+	while (--expired && queue->num > 1)
+		release_frame(queue, obs_frame_queue_pop(queue));
+
+	return true;
+}
+
+static bool ready_frame(struct obs_frame_queue *queue, uint64_t sys_time,
+		bool unbuffered)
+{
+	struct obs_source_frame *next_frame = obs_frame_queue_peek(queue, 0);
+	struct obs_source_frame *frame      = NULL;
+	uint64_t sys_offset = sys_time - queue->last_sys_timestamp;
+	uint64_t frame_time = next_frame->timestamp;
+	uint64_t frame_offset = 0;
+
+	if (unbuffered) {
+		while (queue->num > 1)
+			release_frame(queue, obs_frame_queue_pop(queue));
+
+		return true;
+	}
+
+#if DEBUG_ASYNC_FRAMES
+	blog(LOG_DEBUG, "queue->last_frame_ts: %llu, frame_time: %llu, "
+			"sys_offset: %llu, frame_offset: %llu, "
+			"number of frames: %lu",
+			queue->last_frame_ts, frame_time, sys_offset,
+			frame_time - queue->last_frame_ts,
+			(unsigned long)queue->num);
+#endif
+
+	/* account for timestamp invalidation */
+	if (frame_out_of_bounds(queue, frame_time)) {
+#if DEBUG_ASYNC_FRAMES
+		blog(LOG_DEBUG, "timing jump");
+#endif
+		queue->last_frame_ts = next_frame->timestamp;
+		return true;
+	} else {
+		frame_offset = frame_time - queue->last_frame_ts;
+		queue->last_frame_ts += sys_offset;
+	}
+
+	if (!queue->jumps)
+		return skip_expired_frames(queue);
+
+	while (frame_expired(queue, next_frame)) {
+		if (frame)
+			obs_frame_queue_pop(queue);
+
+#if DEBUG_ASYNC_FRAMES
+		blog(LOG_DEBUG, "new frame, "
+				"queue->last_frame_ts: %llu, "
+				"next_frame->timestamp: %llu",
+				queue->last_frame_ts,
+				next_frame->timestamp);
+#endif
+
+		release_frame(queue, frame);
+
+		if (queue->num == 1)
+			return true;
+
+		frame = next_frame;
+		next_frame = obs_frame_queue_peek(queue, 1);
+
+		/* more timestamp checking and compensating */
+		if ((next_frame->timestamp - frame_time) > MAX_TS_VAR) {
+#if DEBUG_ASYNC_FRAMES
+			blog(LOG_DEBUG, "timing jump");
+#endif
+			queue->last_frame_ts =
+				next_frame->timestamp - frame_offset;
+		}
+
+		frame_time   = next_frame->timestamp;
+		frame_offset = frame_time - queue->last_frame_ts;
+	}
+
+#if DEBUG_ASYNC_FRAMES
+	if (!frame)
+		blog(LOG_DEBUG, "no frame!");
+#endif
+
+	return frame != NULL;
+}
+
+static inline struct obs_source_frame *get_closest_frame(
+		struct obs_frame_queue *queue, uint64_t sys_time,
+		bool unbuffered)
+{
+	if (!queue->num)
+		return NULL;
+
+	if (!queue->last_frame_ts ||
+	    ready_frame(queue, sys_time, unbuffered)) {
+		struct obs_source_frame *frame = obs_frame_queue_pop(queue);
+
+		if (!queue->last_frame_ts)
+			queue->last_frame_ts = frame->timestamp;
+
+		return frame;
+	}
+
+	return NULL;
+}
+
+struct obs_source_frame *obs_frame_queue_get_closest(
+		struct obs_frame_queue *queue, uint64_t sys_time,
+		bool unbuffered)
+{
+	struct obs_source_frame *frame;
+
+	frame = get_closest_frame(queue, sys_time, unbuffered);
+	queue->last_sys_timestamp = sys_time;
+	return frame;
+}
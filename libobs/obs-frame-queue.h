@@ -0,0 +1,88 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "obs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_ASYNC_FRAMES 30
+
+/* maximum timestamp variance in nanoseconds */
+#define MAX_TS_VAR       2000000000ULL
+
+typedef void (*obs_frame_queue_release_t)(void *param,
+		struct obs_source_frame *frame);
+
+/*
+ * Frames an async source has output but not yet shown, along with the timing
+ * used to pick which of them to show.
+ *
+ * Frames are kept in a fixed ring so that consuming frames from the front is
+ * O(1).  'jumps' counts adjacent frames whose timestamps go backwards or jump
+ * forward by more than MAX_TS_VAR; while it is zero the queue is sorted and
+ * can be searched by timestamp.
+ *
+ * Not thread safe, the owner has to lock around every call.
+ */
+struct obs_frame_queue {
+	struct obs_source_frame   *frames[MAX_ASYNC_FRAMES];
+	size_t                    start;
+	size_t                    num;
+	size_t                    jumps;
+
+	uint64_t                  last_frame_ts;
+	uint64_t                  last_sys_timestamp;
+
+	/* called for frames that are skipped */
+	obs_frame_queue_release_t release;
+	void                      *param;
+};
+
+extern void obs_frame_queue_init(struct obs_frame_queue *queue,
+		obs_frame_queue_release_t release, void *param);
+
+extern void obs_frame_queue_push(struct obs_frame_queue *queue,
+		struct obs_source_frame *frame);
+extern struct obs_source_frame *obs_frame_queue_pop(
+		struct obs_frame_queue *queue);
+
+static inline struct obs_source_frame *obs_frame_queue_peek(
+		const struct obs_frame_queue *queue, size_t idx)
+{
+	idx += queue->start;
+	if (idx >= MAX_ASYNC_FRAMES)
+		idx -= MAX_ASYNC_FRAMES;
+	return queue->frames[idx];
+}
+
+/**
+ * Called once per video tick.  Releases frames that are too old to be shown
+ * and returns the frame that should be shown for sys_time, or NULL if the
+ * current frame should stay up.  When unbuffered, always returns the newest
+ * frame.
+ */
+extern struct obs_source_frame *obs_frame_queue_get_closest(
+		struct obs_frame_queue *queue, uint64_t sys_time,
+		bool unbuffered);
+
+#ifdef __cplusplus
+}
+#endif
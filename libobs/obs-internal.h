@@ -34,8 +34,11 @@
 #include "media-io/audio-io.h"
 
 #include "obs.h"
+#include "obs-frame-queue.h"
 
 #define NUM_TEXTURES 2
+#define MAX_CONVERT_THREADS 3
+#define MAX_TICK_THREADS 4
 #define MICROSECOND_DEN 1000000
 
 static inline int64_t packet_dts_usec(struct encoder_packet *packet)
@@ -231,6 +234,11 @@ struct obs_vframe_info {
 	int count;
 };
 
+struct obs_tick_range {
+	volatile long next;
+	long          end;
+};
+
 struct obs_core_video {
 	graphics_t                      *graphics;
 	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
@@ -271,8 +279,50 @@ struct obs_core_video {
 	uint32_t                        base_height;
 	float                           color_matrix[16];
 	enum obs_scale_type             scale_type;
+
+	pthread_t                       convert_threads[MAX_CONVERT_THREADS];
+	size_t                          num_convert_threads;
+	os_sem_t                        *convert_start_sem;
+	os_sem_t                        *convert_done_sem;
+	volatile long                   convert_next_slice;
+	bool                            convert_stop;
+	struct video_frame              *convert_output;
+	const struct video_data         *convert_input;
+	const struct video_output_info  *convert_info;
+
+	/* mapped frames are copied/converted to the video output on a separate
+	 * thread; the graphics thread unmaps them once they've been copied */
+	pthread_t                       output_thread;
+	bool                            output_thread_initialized;
+	bool                            output_thread_stop;
+	os_sem_t                        *output_sem;
+	os_event_t                      *output_copied_event;
+	pthread_mutex_t                 output_mutex;
+	struct circlebuf                output_queue;
+	long                            output_frames_queued;
+	volatile long                   output_frames_copied;
+
+	/* input sources can be ticked in parallel; each worker has a range of
+	 * tick_sources and steals from the other ranges once it's done */
+	volatile bool                   parallel_tick;
+	bool                            tick_threads_initialized;
+	pthread_t                       tick_threads[MAX_TICK_THREADS];
+	size_t                          num_tick_threads;
+	os_sem_t                        *tick_start_sem;
+	os_sem_t                        *tick_done_sem;
+	bool                            tick_stop;
+	float                           tick_seconds;
+	DARRAY(struct obs_source*)      tick_sources;
+	struct obs_tick_range           tick_ranges[MAX_TICK_THREADS + 1];
 };
 
+extern void obs_init_convert_threads(struct obs_core_video *video,
+		const struct video_output_info *info);
+extern void obs_free_convert_threads(struct obs_core_video *video);
+extern bool obs_init_output_thread(struct obs_core_video *video);
+extern void obs_free_output_thread(struct obs_core_video *video);
+extern void obs_free_tick_threads(struct obs_core_video *video);
+
 struct obs_core_audio {
 	/* TODO: sound output subsystem */
 	audio_t                         *audio;
@@ -281,6 +331,18 @@ struct obs_core_audio {
 	float                           present_volume;
 };
 
+/* hash index of context names.  Has its own mutex so that lookups don't
+ * wait on the list mutexes, which the video thread holds while ticking */
+struct obs_name_index {
+	pthread_mutex_t                 mutex;
+	struct obs_context_data         **buckets;
+	size_t                          num_buckets;
+	size_t                          num;
+};
+
+extern bool obs_name_index_init(struct obs_name_index *index);
+extern void obs_name_index_free(struct obs_name_index *index);
+
 /* user sources, output channels, and displays */
 struct obs_core_data {
 	pthread_mutex_t                 user_sources_mutex;
@@ -298,6 +360,12 @@ struct obs_core_data {
 	pthread_mutex_t                 encoders_mutex;
 	pthread_mutex_t                 services_mutex;
 
+	/* sources are only indexed while they're user sources */
+	struct obs_name_index           source_names;
+	struct obs_name_index           output_names;
+	struct obs_name_index           encoder_names;
+	struct obs_name_index           service_names;
+
 	struct obs_view                 main_view;
 
 	volatile long                   active_transitions;
@@ -396,6 +464,12 @@ struct obs_context_data {
 	pthread_mutex_t                 *mutex;
 	struct obs_context_data         *next;
 	struct obs_context_data         **prev_next;
+
+	/* set and cleared with both rename_cache_mutex and the index mutex
+	 * held, so either one is enough to read it */
+	struct obs_name_index           *name_index;
+	struct obs_context_data         *name_next;
+	uint32_t                        name_hash;
 };
 
 extern bool obs_context_data_init(
@@ -406,9 +480,14 @@ extern bool obs_context_data_init(
 extern void obs_context_data_free(struct obs_context_data *context);
 
 extern void obs_context_data_insert(struct obs_context_data *context,
-		pthread_mutex_t *mutex, void *first);
+		pthread_mutex_t *mutex, void *first,
+		struct obs_name_index *index);
 extern void obs_context_data_remove(struct obs_context_data *context);
 
+extern void obs_name_index_add(struct obs_name_index *index,
+		struct obs_context_data *context);
+extern void obs_name_index_remove(struct obs_context_data *context);
+
 extern void obs_context_data_setname(struct obs_context_data *context,
 		const char *name);
 
@@ -458,10 +537,13 @@ static inline bool obs_weak_ref_get_ref(struct obs_weak_ref *ref)
 /* ------------------------------------------------------------------------- */
 /* sources  */
 
+#define ASYNC_POOL_SIZE  (MAX_ASYNC_FRAMES + 4)
+
+/* slot of the fixed-size per-source async frame pool.  the frame is
+ * embedded so that a frame pointer can be mapped back to its slot */
 struct async_frame {
-	struct obs_source_frame *frame;
-	long unused_count;
-	bool used;
+	struct obs_source_frame frame;
+	volatile long           used;
 };
 
 struct obs_weak_source {
@@ -505,10 +587,11 @@ struct obs_source {
 	volatile bool                   timing_set;
 	volatile uint64_t               timing_adjust;
 	uint64_t                        next_audio_ts_min;
-	uint64_t                        last_frame_ts;
-	uint64_t                        last_sys_timestamp;
 	bool                            async_rendered;
 
+	/* average tick duration in nanoseconds */
+	uint64_t                        tick_time;
+
 	/* audio */
 	bool                            audio_failed;
 	bool                            muted;
@@ -529,7 +612,6 @@ struct obs_source {
 	struct obs_source_frame         *cur_async_frame;
 	bool                            async_gpu_conversion;
 	enum video_format               async_format;
-	enum video_format               async_cache_format;
 	enum gs_color_format            async_texture_format;
 	float                           async_color_matrix[16];
 	bool                            async_full_range;
@@ -538,13 +620,14 @@ struct obs_source {
 	int                             async_plane_offset[2];
 	bool                            async_flip;
 	bool                            async_active;
-	DARRAY(struct async_frame)      async_cache;
-	DARRAY(struct obs_source_frame*)async_frames;
+	struct async_frame              *async_pool;
+	DARRAY(struct obs_source_frame*)async_overflow;
+	struct obs_frame_queue          async_frames;
 	pthread_mutex_t                 async_mutex;
+	volatile long                   async_pool_exhausted;
+	volatile long                   async_frames_dropped;
 	uint32_t                        async_width;
 	uint32_t                        async_height;
-	uint32_t                        async_cache_width;
-	uint32_t                        async_cache_height;
 	uint32_t                        async_convert_width;
 	uint32_t                        async_convert_height;
 
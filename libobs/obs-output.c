@@ -112,7 +112,8 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 
 	obs_context_data_insert(&output->context,
 			&obs->data.outputs_mutex,
-			&obs->data.first_output);
+			&obs->data.first_output,
+			&obs->data.output_names);
 
 	blog(LOG_INFO, "output '%s' (%s) created", name, id);
 	return output;
@@ -125,7 +126,7 @@ fail:
 static inline void free_packets(struct obs_output *output)
 {
 	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_free_encoder_packet(output->interleaved_packets.array+i);
+		obs_encoder_packet_release(output->interleaved_packets.array+i);
 	da_free(output->interleaved_packets);
 }
 
@@ -812,7 +813,7 @@ static inline void send_interleaved(struct obs_output *output)
 	da_erase(output->interleaved_packets, 0);
 	if (!output->stopped)
 		output->info.encoded_packet(output->context.data, &out);
-	obs_free_encoder_packet(&out);
+	obs_encoder_packet_release(&out);
 }
 
 static inline void set_higher_ts(struct obs_output *output,
@@ -862,7 +863,7 @@ static void prune_interleaved_packets(struct obs_output *output)
 		for (size_t i = 0; i < start_idx; i++) {
 			struct encoder_packet *packet =
 				&output->interleaved_packets.array[i];
-			obs_free_encoder_packet(packet);
+			obs_encoder_packet_release(packet);
 		}
 
 		da_erase_range(output->interleaved_packets, 0, start_idx);
@@ -975,7 +976,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_duplicate_encoder_packet(&out, packet);
+		obs_encoder_packet_ref(&out, packet);
 
 	if (was_started)
 		apply_interleaved_packet_offset(output, &out);
@@ -1012,7 +1013,7 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 	if (!output->stopped)
 		output->info.encoded_packet(output->context.data, packet);
 	if (output->active_delay_ns)
-		obs_free_encoder_packet(packet);
+		obs_encoder_packet_release(packet);
 
 	if (packet->type == OBS_ENCODER_VIDEO)
 		output->total_frames++;
@@ -223,6 +223,10 @@ static void calculate_bounds_data(struct obs_scene_item *item,
 			(int)-width_diff, (int)-height_diff);
 }
 
+/* sent whenever an item moves, so potentially every frame */
+static const struct calldata_key key_scene = CALLDATA_KEY("scene");
+static const struct calldata_key key_item  = CALLDATA_KEY("item");
+
 static void update_item_transform(struct obs_scene_item *item)
 {
 	uint32_t        width         = obs_source_get_width(item->source);
@@ -232,7 +236,8 @@ static void update_item_transform(struct obs_scene_item *item)
 	struct vec2     base_origin;
 	struct vec2     origin;
 	struct vec2     scale         = item->scale;
-	struct calldata params        = {0};
+	struct calldata params;
+	uint8_t         stack[128];
 
 	vec2_zero(&base_origin);
 	vec2_zero(&origin);
@@ -284,11 +289,11 @@ static void update_item_transform(struct obs_scene_item *item)
 	item->last_width  = width;
 	item->last_height = height;
 
-	calldata_set_ptr(&params, "scene", item->parent);
-	calldata_set_ptr(&params, "item", item);
+	calldata_init_fixed(&params, stack, sizeof(stack));
+	calldata_set_ptr_key(&params, &key_scene, item->parent);
+	calldata_set_ptr_key(&params, &key_item, item);
 	signal_handler_signal(item->parent->source->context.signals,
 			"item_transform", &params);
-	calldata_free(&params);
 }
 
 static inline bool source_size_changed(struct obs_scene_item *item)
@@ -115,6 +115,9 @@ const char *obs_source_get_display_name(enum obs_source_type type,
 	return (info != NULL) ? info->get_name(info->type_data) : NULL;
 }
 
+static void release_async_frame(void *source,
+		struct obs_source_frame *frame);
+
 /* internal initialization */
 bool obs_source_init(struct obs_source *source,
 		const struct obs_source_info *info)
@@ -140,6 +143,18 @@ bool obs_source_init(struct obs_source *source,
 	if (pthread_mutex_init(&source->async_mutex, NULL) != 0)
 		return false;
 
+	if (info && info->output_flags & OBS_SOURCE_ASYNC) {
+		source->async_pool = bzalloc(sizeof(struct async_frame) *
+				ASYNC_POOL_SIZE);
+
+		/* the pool holds a permanent reference to its frames */
+		for (size_t i = 0; i < ASYNC_POOL_SIZE; i++)
+			source->async_pool[i].frame.refs = 1;
+
+		obs_frame_queue_init(&source->async_frames,
+				release_async_frame, source);
+	}
+
 	if (info && info->output_flags & OBS_SOURCE_AUDIO) {
 		source->audio_line = audio_output_create_line(obs->audio.audio,
 				source->context.name, 0xF);
@@ -155,7 +170,8 @@ bool obs_source_init(struct obs_source *source,
 
 	obs_context_data_insert(&source->context,
 			&obs->data.sources_mutex,
-			&obs->data.first_source);
+			&obs->data.first_source,
+			NULL);
 	return true;
 }
 
@@ -366,8 +382,21 @@ void obs_source_destroy(struct obs_source *source)
 	obs_hotkey_unregister(source->push_to_mute_key);
 	obs_hotkey_pair_unregister(source->mute_unmute_key);
 
-	for (i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+	if (source->async_pool) {
+		for (i = 0; i < ASYNC_POOL_SIZE; i++)
+			obs_source_frame_free(&source->async_pool[i].frame);
+		bfree(source->async_pool);
+	}
+
+	for (i = 0; i < source->async_overflow.num; i++)
+		obs_source_frame_decref(source->async_overflow.array[i]);
+
+	if (source->async_pool_exhausted || source->async_frames_dropped)
+		blog(LOG_INFO, "source '%s': async frame pool was exhausted "
+				"%ld times, %ld frames were dropped",
+				source->context.name,
+				source->async_pool_exhausted,
+				source->async_frames_dropped);
 
 	gs_enter_context(obs->video.graphics);
 	gs_texrender_destroy(source->async_convert_texrender);
@@ -381,8 +410,7 @@ void obs_source_destroy(struct obs_source *source)
 	audio_line_destroy(source->audio_line);
 	audio_resampler_destroy(source->resampler);
 
-	da_free(source->async_cache);
-	da_free(source->async_frames);
+	da_free(source->async_overflow);
 	da_free(source->filters);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_mutex);
@@ -494,6 +522,7 @@ void obs_source_remove(obs_source_t *source)
 	exists = (id != DARRAY_INVALID);
 	if (exists) {
 		da_erase(data->user_sources, id);
+		obs_name_index_remove(&source->context);
 		obs_source_release(source);
 	}
 
@@ -771,19 +800,28 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 	}
 }
 
-static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
-		uint64_t sys_time);
 static void remove_async_frame(obs_source_t *source,
 		struct obs_source_frame *frame);
 
+static inline void update_tick_time(obs_source_t *source, uint64_t elapsed)
+{
+	/* smoothed over roughly the last 16 frames */
+	source->tick_time = (source->tick_time * 15 + elapsed) / 16;
+}
+
 void obs_source_video_tick(obs_source_t *source, float seconds)
 {
 	bool now_showing, now_active;
+	uint64_t start_time;
 
 	if (!source) return;
 
+	start_time = os_gettime_ns();
+
 	if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0) {
 		uint64_t sys_time = obs->video.video_time;
+		bool unbuffered =
+			(source->flags & OBS_SOURCE_FLAG_UNBUFFERED) != 0;
 
 		pthread_mutex_lock(&source->async_mutex);
 		if (source->cur_async_frame) {
@@ -791,8 +829,8 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 			source->cur_async_frame = NULL;
 		}
 
-		source->cur_async_frame = get_closest_frame(source, sys_time);
-		source->last_sys_timestamp = sys_time;
+		source->cur_async_frame = obs_frame_queue_get_closest(
+				&source->async_frames, sys_time, unbuffered);
 		pthread_mutex_unlock(&source->async_mutex);
 	}
 
@@ -831,6 +869,13 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 		source->info.video_tick(source->context.data, seconds);
 
 	source->async_rendered = false;
+
+	update_tick_time(source, os_gettime_ns() - start_time);
+}
+
+uint64_t obs_source_get_tick_time(const obs_source_t *source)
+{
+	return source ? source->tick_time : 0;
 }
 
 /* unless the value is 3+ hours worth of frames, this won't overflow */
@@ -843,9 +888,6 @@ static inline uint64_t conv_frames_to_time(size_t frames)
 		(uint64_t)info->samples_per_sec;
 }
 
-/* maximum timestamp variance in nanoseconds */
-#define MAX_TS_VAR          2000000000ULL
-
 static inline void reset_audio_timing(obs_source_t *source, uint64_t timestamp,
 		uint64_t os_time)
 {
@@ -863,20 +905,25 @@ static inline void handle_ts_jump(obs_source_t *source, uint64_t expected,
 	reset_audio_timing(source, ts, os_time);
 }
 
+/* parameters of the signals sent for every audio packet and volume change */
+static const struct calldata_key key_source = CALLDATA_KEY("source");
+static const struct calldata_key key_data   = CALLDATA_KEY("data");
+static const struct calldata_key key_muted  = CALLDATA_KEY("muted");
+static const struct calldata_key key_volume = CALLDATA_KEY("volume");
+
 static void source_signal_audio_data(obs_source_t *source,
 		struct audio_data *in, bool muted)
 {
 	struct calldata data;
+	uint8_t stack[128];
 
-	calldata_init(&data);
+	calldata_init_fixed(&data, stack, sizeof(stack));
 
-	calldata_set_ptr(&data, "source", source);
-	calldata_set_ptr(&data, "data",   in);
-	calldata_set_bool(&data, "muted", muted);
+	calldata_set_ptr_key(&data, &key_source, source);
+	calldata_set_ptr_key(&data, &key_data,   in);
+	calldata_set_bool_key(&data, &key_muted, muted);
 
 	signal_handler_signal(source->context.signals, "audio_data", &data);
-
-	calldata_free(&data);
 }
 
 static inline uint64_t uint64_diff(uint64_t ts1, uint64_t ts2)
@@ -1391,8 +1438,6 @@ static inline void obs_source_main_render(obs_source_t *source)
 				custom_draw ? NULL : gs_get_effect());
 }
 
-static bool ready_async_frame(obs_source_t *source, uint64_t sys_time);
-
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!source) return;
@@ -1795,110 +1840,136 @@ static void copy_frame_data(struct obs_source_frame *dst,
 	}
 }
 
-static inline bool async_texture_changed(struct obs_source *source,
+static inline struct async_frame *get_pool_slot(obs_source_t *source,
 		const struct obs_source_frame *frame)
 {
-	enum convert_type prev, cur;
-	prev = get_convert_type(source->async_cache_format);
-	cur  = get_convert_type(frame->format);
+	uintptr_t start = (uintptr_t)source->async_pool;
+	uintptr_t pos   = (uintptr_t)frame;
 
-	return source->async_cache_width  != frame->width ||
-	       source->async_cache_height != frame->height ||
-	       prev != cur;
+	if (!start || pos < start ||
+	    pos >= start + sizeof(struct async_frame) * ASYNC_POOL_SIZE)
+		return NULL;
+
+	return &source->async_pool[(pos - start) / sizeof(struct async_frame)];
 }
 
-static inline void free_async_cache(struct obs_source *source)
+/* makes a frame that was acquired from the pool (or the overflow list)
+ * available again.  must be called with async_mutex held when the frame may
+ * be an overflow frame */
+static void remove_async_frame(obs_source_t *source,
+		struct obs_source_frame *frame)
 {
-	for (size_t i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+	struct async_frame *slot;
 
-	da_resize(source->async_cache, 0);
-	da_resize(source->async_frames, 0);
-	source->cur_async_frame = NULL;
-}
+	if (!frame)
+		return;
 
-#define MAX_UNUSED_FRAME_DURATION 5
+	slot = get_pool_slot(source, frame);
+	if (slot) {
+		os_atomic_set_long(&slot->used, 0);
+		return;
+	}
 
-/* frees frame allocations if they haven't been used for a specific period
- * of time */
-static void clean_cache(obs_source_t *source)
-{
-	for (size_t i = source->async_cache.num; i > 0; i--) {
-		struct async_frame *af = &source->async_cache.array[i - 1];
-		if (!af->used) {
-			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
-				da_erase(source->async_cache, i - 1);
-			}
+	for (size_t i = 0; i < source->async_overflow.num; i++) {
+		if (source->async_overflow.array[i] == frame) {
+			da_erase(source->async_overflow, i);
+			obs_source_frame_decref(frame);
+			break;
 		}
 	}
 }
 
-#define MAX_ASYNC_FRAMES 30
-
-static inline struct obs_source_frame *cache_video(struct obs_source *source,
-		const struct obs_source_frame *frame)
+/* frames skipped by the queue, which is only used under async_mutex */
+static void release_async_frame(void *source,
+		struct obs_source_frame *frame)
 {
-	struct obs_source_frame *new_frame = NULL;
+	remove_async_frame(source, frame);
+}
 
-	pthread_mutex_lock(&source->async_mutex);
+static inline struct obs_source_frame *acquire_pool_frame(
+		obs_source_t *source)
+{
+	struct async_frame *pool = source->async_pool;
 
-	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
-		free_async_cache(source);
-		source->last_frame_ts = 0;
-		pthread_mutex_unlock(&source->async_mutex);
-		return NULL;
+	if (pool) {
+		for (size_t i = 0; i < ASYNC_POOL_SIZE; i++) {
+			if (os_atomic_compare_swap_long(&pool[i].used, 0, 1))
+				return &pool[i].frame;
+		}
 	}
 
-	if (async_texture_changed(source, frame)) {
-		free_async_cache(source);
-		source->async_cache_width  = frame->width;
-		source->async_cache_height = frame->height;
-		source->async_cache_format = frame->format;
-	}
+	return NULL;
+}
 
-	for (size_t i = 0; i < source->async_cache.num; i++) {
-		struct async_frame *af = &source->async_cache.array[i];
-		if (!af->used) {
-			new_frame = af->frame;
-			af->used = true;
-			af->unused_count = 0;
-			break;
-		}
+/* called when every pool slot is in use: recycles the oldest queued frame,
+ * or if nothing is queued (all frames are held by the renderer or filters),
+ * allocates a frame outside of the pool */
+static struct obs_source_frame *acquire_overflow_frame(obs_source_t *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame = NULL;
+
+	os_atomic_inc_long(&source->async_pool_exhausted);
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (source->async_frames.num) {
+		frame = obs_frame_queue_pop(&source->async_frames);
+		os_atomic_inc_long(&source->async_frames_dropped);
+	} else {
+		frame = obs_source_frame_create(format, width, height);
+		frame->refs = 1;
+		da_push_back(source->async_overflow, &frame);
 	}
 
-	clean_cache(source);
+	pthread_mutex_unlock(&source->async_mutex);
+	return frame;
+}
 
-	if (!new_frame) {
-		struct async_frame new_af;
+static struct obs_source_frame *acquire_async_frame(obs_source_t *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame = acquire_pool_frame(source);
 
-		new_frame = obs_source_frame_create(frame->format,
-				frame->width, frame->height);
-		new_af.frame = new_frame;
-		new_af.used = true;
-		new_af.unused_count = 0;
-		new_frame->refs = 1;
+	if (!frame)
+		frame = acquire_overflow_frame(source, format, width, height);
 
-		da_push_back(source->async_cache, &new_af);
+	/* only the owner of a frame can get here, so its planes can be
+	 * reallocated without locking */
+	if (!frame->data[0] || frame->format != format ||
+	    frame->width != width || frame->height != height) {
+		bfree(frame->data[0]);
+		obs_source_frame_init(frame, format, width, height);
 	}
 
-	os_atomic_inc_long(&new_frame->refs);
-
-	pthread_mutex_unlock(&source->async_mutex);
+	return frame;
+}
 
-	copy_frame_data(new_frame, frame);
+static void queue_async_frame(obs_source_t *source,
+		struct obs_source_frame *frame)
+{
+	pthread_mutex_lock(&source->async_mutex);
 
-	if (os_atomic_dec_long(&new_frame->refs) == 0) {
-		obs_source_frame_destroy(new_frame);
-		new_frame = NULL;
+	/* the renderer is not keeping up or timestamps are off; drop the
+	 * oldest frame and resynchronize */
+	if (source->async_frames.num == MAX_ASYNC_FRAMES) {
+		remove_async_frame(source,
+				obs_frame_queue_pop(&source->async_frames));
+		source->async_frames.last_frame_ts = 0;
+		os_atomic_inc_long(&source->async_frames_dropped);
 	}
 
-	return new_frame;
+	obs_frame_queue_push(&source->async_frames, frame);
+	pthread_mutex_unlock(&source->async_mutex);
+
+	source->async_active = true;
 }
 
 void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame)
 {
+	struct obs_source_frame *output;
+
 	if (!source)
 		return;
 
@@ -1907,17 +1978,64 @@ void obs_source_output_video(obs_source_t *source,
 		return;
 	}
 
-	struct obs_source_frame *output = !!frame ?
-		cache_video(source, frame) : NULL;
+	output = acquire_async_frame(source, frame->format,
+			frame->width, frame->height);
+	copy_frame_data(output, frame);
+	queue_async_frame(source, output);
+}
+
+struct obs_source_frame *obs_source_acquire_frame(obs_source_t *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame;
+
+	if (!source || !width || !height)
+		return NULL;
 
-	/* ------------------------------------------- */
+	frame = acquire_async_frame(source, format, width, height);
+	frame->timestamp  = 0;
+	frame->flip       = false;
+	frame->full_range = false;
+	memset(frame->color_matrix, 0, sizeof(frame->color_matrix));
+	memset(frame->color_range_min, 0, sizeof(frame->color_range_min));
+	memset(frame->color_range_max, 0, sizeof(frame->color_range_max));
+	return frame;
+}
 
-	if (output) {
-		pthread_mutex_lock(&source->async_mutex);
-		da_push_back(source->async_frames, &output);
-		pthread_mutex_unlock(&source->async_mutex);
-		source->async_active = true;
-	}
+void obs_source_output_acquired_frame(obs_source_t *source,
+		struct obs_source_frame *frame)
+{
+	if (!source || !frame)
+		return;
+
+	queue_async_frame(source, frame);
+}
+
+void obs_source_cancel_acquired_frame(obs_source_t *source,
+		struct obs_source_frame *frame)
+{
+	if (!source || !frame)
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+	remove_async_frame(source, frame);
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+uint32_t obs_source_get_async_frames_dropped(const obs_source_t *source)
+{
+	return source ?
+		(uint32_t)os_atomic_load_long(
+				(volatile long*)&source->async_frames_dropped) :
+		0;
+}
+
+uint32_t obs_source_get_async_pool_exhausted(const obs_source_t *source)
+{
+	return source ?
+		(uint32_t)os_atomic_load_long(
+				(volatile long*)&source->async_pool_exhausted) :
+		0;
 }
 
 static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
@@ -2089,136 +2207,6 @@ void obs_source_output_audio(obs_source_t *source,
 	pthread_mutex_unlock(&source->filter_mutex);
 }
 
-static inline bool frame_out_of_bounds(const obs_source_t *source, uint64_t ts)
-{
-	if (ts < source->last_frame_ts)
-		return ((source->last_frame_ts - ts) > MAX_TS_VAR);
-	else
-		return ((ts - source->last_frame_ts) > MAX_TS_VAR);
-}
-
-static void remove_async_frame(obs_source_t *source,
-		struct obs_source_frame *frame)
-{
-	for (size_t i = 0; i < source->async_cache.num; i++) {
-		struct async_frame *f = &source->async_cache.array[i];
-
-		if (f->frame == frame) {
-			f->used = false;
-			break;
-		}
-	}
-}
-
-/* #define DEBUG_ASYNC_FRAMES 1 */
-
-static bool ready_async_frame(obs_source_t *source, uint64_t sys_time)
-{
-	struct obs_source_frame *next_frame = source->async_frames.array[0];
-	struct obs_source_frame *frame      = NULL;
-	uint64_t sys_offset = sys_time - source->last_sys_timestamp;
-	uint64_t frame_time = next_frame->timestamp;
-	uint64_t frame_offset = 0;
-
-	if ((source->flags & OBS_SOURCE_FLAG_UNBUFFERED) != 0) {
-		while (source->async_frames.num > 1) {
-			da_erase(source->async_frames, 0);
-			remove_async_frame(source, next_frame);
-			next_frame = source->async_frames.array[0];
-		}
-
-		return true;
-	}
-
-#if DEBUG_ASYNC_FRAMES
-	blog(LOG_DEBUG, "source->last_frame_ts: %llu, frame_time: %llu, "
-			"sys_offset: %llu, frame_offset: %llu, "
-			"number of frames: %lu",
-			source->last_frame_ts, frame_time, sys_offset,
-			frame_time - source->last_frame_ts,
-			(unsigned long)source->async_frames.num);
-#endif
-
-	/* account for timestamp invalidation */
-	if (frame_out_of_bounds(source, frame_time)) {
-#if DEBUG_ASYNC_FRAMES
-		blog(LOG_DEBUG, "timing jump");
-#endif
-		source->last_frame_ts = next_frame->timestamp;
-		return true;
-	} else {
-		frame_offset = frame_time - source->last_frame_ts;
-		source->last_frame_ts += sys_offset;
-	}
-
-	while (source->last_frame_ts > next_frame->timestamp) {
-
-		/* this tries to reduce the needless frame duplication, also
-		 * helps smooth out async rendering to frame boundaries.  In
-		 * other words, tries to keep the framerate as smooth as
-		 * possible */
-		if ((source->last_frame_ts - next_frame->timestamp) < 2000000)
-			break;
-
-		if (frame)
-			da_erase(source->async_frames, 0);
-
-#if DEBUG_ASYNC_FRAMES
-		blog(LOG_DEBUG, "new frame, "
-				"source->last_frame_ts: %llu, "
-				"next_frame->timestamp: %llu",
-				source->last_frame_ts,
-				next_frame->timestamp);
-#endif
-
-		remove_async_frame(source, frame);
-
-		if (source->async_frames.num == 1)
-			return true;
-
-		frame = next_frame;
-		next_frame = source->async_frames.array[1];
-
-		/* more timestamp checking and compensating */
-		if ((next_frame->timestamp - frame_time) > MAX_TS_VAR) {
-#if DEBUG_ASYNC_FRAMES
-			blog(LOG_DEBUG, "timing jump");
-#endif
-			source->last_frame_ts =
-				next_frame->timestamp - frame_offset;
-		}
-
-		frame_time   = next_frame->timestamp;
-		frame_offset = frame_time - source->last_frame_ts;
-	}
-
-#if DEBUG_ASYNC_FRAMES
-	if (!frame)
-		blog(LOG_DEBUG, "no frame!");
-#endif
-
-	return frame != NULL;
-}
-
-static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
-		uint64_t sys_time)
-{
-	if (!source->async_frames.num)
-		return NULL;
-
-	if (!source->last_frame_ts || ready_async_frame(source, sys_time)) {
-		struct obs_source_frame *frame = source->async_frames.array[0];
-		da_erase(source->async_frames, 0);
-
-		if (!source->last_frame_ts)
-			source->last_frame_ts = frame->timestamp;
-
-		return frame;
-	}
-
-	return NULL;
-}
-
 /*
  * Ensures that cached frames are displayed on time.  If multiple frames
  * were cached between renders, then releases the unnecessary frames and uses
@@ -2468,15 +2456,17 @@ proc_handler_t *obs_source_get_proc_handler(const obs_source_t *source)
 void obs_source_set_volume(obs_source_t *source, float volume)
 {
 	if (source) {
-		struct calldata data = {0};
-		calldata_set_ptr(&data, "source", source);
-		calldata_set_float(&data, "volume", volume);
+		struct calldata data;
+		uint8_t stack[128];
+
+		calldata_init_fixed(&data, stack, sizeof(stack));
+		calldata_set_ptr_key(&data, &key_source, source);
+		calldata_set_float_key(&data, &key_volume, volume);
 
 		signal_handler_signal(source->context.signals, "volume", &data);
 		signal_handler_signal(obs->signals, "source_volume", &data);
 
-		volume = (float)calldata_float(&data, "volume");
-		calldata_free(&data);
+		volume = (float)calldata_float_key(&data, &key_volume);
 
 		source->user_volume = volume;
 	}
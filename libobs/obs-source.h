@@ -103,6 +103,17 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_INTERACTION (1<<5)
 
+/**
+ * Source must be ticked serially on the graphics thread
+ *
+ * When parallel source ticking is enabled, input sources are ticked on a
+ * pool of threads.  Sources whose video_tick callback is not safe to run
+ * alongside other sources should set this flag; they are then ticked on the
+ * graphics thread after the parallel sources, along with scenes,
+ * transitions and filters.
+ */
+#define OBS_SOURCE_SERIAL_TICK (1<<6)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -50,13 +50,150 @@ static inline void calculate_base_volume(struct obs_core_data *data,
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* parallel source ticking: the graphics thread and the tick threads each get
+ * a range of the sources to tick, and steal from the other ranges once their
+ * own range is done */
+
+static inline bool tick_in_parallel(struct obs_source *source)
+{
+	return source->info.type == OBS_SOURCE_TYPE_INPUT &&
+		(source->info.output_flags & OBS_SOURCE_SERIAL_TICK) == 0;
+}
+
+static void tick_source_ranges(struct obs_core_video *video, size_t worker)
+{
+	size_t workers = video->num_tick_threads + 1;
+
+	for (size_t i = 0; i < workers; i++) {
+		struct obs_tick_range *range =
+			&video->tick_ranges[(worker + i) % workers];
+		long idx;
+
+		while ((idx = os_atomic_inc_long(&range->next) - 1) <
+				range->end)
+			obs_source_video_tick(video->tick_sources.array[idx],
+					video->tick_seconds);
+	}
+}
+
+static void *tick_thread(void *param)
+{
+	struct obs_core_video *video = &obs->video;
+	size_t worker = (size_t)(uintptr_t)param;
+
+	os_set_thread_name("libobs: tick thread");
+
+	while (os_sem_wait(video->tick_start_sem) == 0) {
+		if (video->tick_stop)
+			break;
+
+		tick_source_ranges(video, worker);
+		os_sem_post(video->tick_done_sem);
+	}
+
+	return NULL;
+}
+
+static void init_tick_threads(struct obs_core_video *video)
+{
+	int threads = os_get_logical_cores() - 1;
+
+	video->tick_threads_initialized = true;
+
+	if (threads < 1)
+		return;
+	if (threads > MAX_TICK_THREADS)
+		threads = MAX_TICK_THREADS;
+
+	if (os_sem_init(&video->tick_start_sem, 0) != 0)
+		return;
+	if (os_sem_init(&video->tick_done_sem, 0) != 0)
+		return;
+
+	video->tick_stop = false;
+
+	for (int i = 0; i < threads; i++) {
+		if (pthread_create(&video->tick_threads[i], NULL, tick_thread,
+					(void*)(uintptr_t)(i + 1)) != 0)
+			break;
+		video->num_tick_threads++;
+	}
+
+	blog(LOG_INFO, "Ticking sources on %d threads",
+			(int)video->num_tick_threads + 1);
+}
+
+void obs_free_tick_threads(struct obs_core_video *video)
+{
+	video->tick_stop = true;
+
+	for (size_t i = 0; i < video->num_tick_threads; i++)
+		os_sem_post(video->tick_start_sem);
+	for (size_t i = 0; i < video->num_tick_threads; i++)
+		pthread_join(video->tick_threads[i], NULL);
+
+	os_sem_destroy(video->tick_start_sem);
+	os_sem_destroy(video->tick_done_sem);
+	da_free(video->tick_sources);
+
+	video->tick_start_sem           = NULL;
+	video->tick_done_sem            = NULL;
+	video->num_tick_threads         = 0;
+	video->tick_threads_initialized = false;
+}
+
+/* sources ticked in parallel are referenced rather than ticked with the
+ * sources mutex held, so that ticks on other threads can still use it */
+static void tick_sources_parallel(struct obs_core_data *data,
+		struct obs_core_video *video, float seconds)
+{
+	struct obs_source *source;
+	size_t workers = video->num_tick_threads + 1;
+	size_t count;
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	source = data->first_source;
+	while (source) {
+		if (tick_in_parallel(source) &&
+		    obs_weak_ref_get_ref(&source->control->ref))
+			da_push_back(video->tick_sources, &source);
+		source = (struct obs_source*)source->context.next;
+	}
+
+	pthread_mutex_unlock(&data->sources_mutex);
+
+	count = video->tick_sources.num;
+	for (size_t i = 0; i < workers; i++) {
+		video->tick_ranges[i].next = (long)(count * i / workers);
+		video->tick_ranges[i].end  = (long)(count * (i + 1) / workers);
+	}
+
+	video->tick_seconds = seconds;
+
+	for (size_t i = 0; i < video->num_tick_threads; i++)
+		os_sem_post(video->tick_start_sem);
+
+	tick_source_ranges(video, 0);
+
+	for (size_t i = 0; i < video->num_tick_threads; i++)
+		os_sem_wait(video->tick_done_sem);
+
+	for (size_t i = 0; i < count; i++)
+		obs_source_release(video->tick_sources.array[i]);
+	da_resize(video->tick_sources, 0);
+}
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
-	struct obs_core_data *data = &obs->data;
-	struct obs_view      *view = &data->main_view;
-	struct obs_source    *source;
-	uint64_t             delta_time;
-	float                seconds;
+	struct obs_core_data  *data  = &obs->data;
+	struct obs_core_video *video = &obs->video;
+	struct obs_view       *view  = &data->main_view;
+	struct obs_source     *source;
+	uint64_t              delta_time;
+	float                 seconds;
+	bool                  parallel;
 
 	if (!last_time)
 		last_time = cur_time -
@@ -65,12 +202,22 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	delta_time = cur_time - last_time;
 	seconds = (float)((double)delta_time / 1000000000.0);
 
+	parallel = video->parallel_tick;
+	if (parallel && !video->tick_threads_initialized)
+		init_tick_threads(video);
+	if (!video->num_tick_threads)
+		parallel = false;
+
+	if (parallel)
+		tick_sources_parallel(data, video, seconds);
+
 	pthread_mutex_lock(&data->sources_mutex);
 
 	/* call the tick function of each source */
 	source = data->first_source;
 	while (source) {
-		obs_source_video_tick(source, seconds);
+		if (!parallel || !tick_in_parallel(source))
+			obs_source_video_tick(source, seconds);
 		source = (struct obs_source*)source->context.next;
 	}
 
@@ -125,12 +272,32 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_set_viewport(0, 0, width, height);
 }
 
-static inline void unmap_last_surface(struct obs_core_video *video)
+static inline bool output_frame_copied(struct obs_core_video *video)
 {
-	if (video->mapped_surface) {
-		gs_stagesurface_unmap(video->mapped_surface);
-		video->mapped_surface = NULL;
+	return os_atomic_load_long(&video->output_frames_copied) ==
+		video->output_frames_queued;
+}
+
+/* the mapped surface can only be unmapped once the output thread is done
+ * copying from it; if wait is false it is left mapped until then */
+static const char *wait_for_output_copy_name = "wait_for_output_copy";
+static inline void unmap_last_surface(struct obs_core_video *video, bool wait)
+{
+	if (!video->mapped_surface)
+		return;
+
+	if (!output_frame_copied(video)) {
+		if (!wait)
+			return;
+
+		profile_start(wait_for_output_copy_name);
+		while (!output_frame_copied(video))
+			os_event_wait(video->output_copied_event);
+		profile_end(wait_for_output_copy_name);
 	}
+
+	gs_stagesurface_unmap(video->mapped_surface);
+	video->mapped_surface = NULL;
 }
 
 static const char *render_main_texture_name = "render_main_texture";
@@ -330,7 +497,7 @@ static inline void stage_output_texture(struct obs_core_video *video,
 		texture_ready = video->output_textures[prev_texture];
 	}
 
-	unmap_last_surface(video);
+	unmap_last_surface(video, true);
 
 	if (!texture_ready)
 		goto end;
@@ -459,26 +626,27 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 	}
 }
 
-static void convert_frame(
+static void convert_frame_rows(
 		struct video_frame *output, const struct video_data *input,
-		const struct video_output_info *info)
+		const struct video_output_info *info,
+		uint32_t start_y, uint32_t end_y)
 {
 	if (info->format == VIDEO_FORMAT_I420) {
 		compress_uyvx_to_i420(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else if (info->format == VIDEO_FORMAT_NV12) {
 		compress_uyvx_to_nv12(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else if (info->format == VIDEO_FORMAT_I444) {
 		convert_uyvx_to_i444(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else {
@@ -486,6 +654,134 @@ static void convert_frame(
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* large frames are converted in horizontal slices across the graphics thread
+ * and a few helper threads */
+
+#define CONVERT_SLICES 8
+#define PARALLEL_CONVERT_MIN_HEIGHT 1440
+
+static inline uint32_t convert_slice_height(uint32_t height)
+{
+	uint32_t slice_height = (height + CONVERT_SLICES - 1) / CONVERT_SLICES;
+
+	/* slices have to start on even lines for 4:2:0 chroma */
+	return (slice_height + 1) & ~1U;
+}
+
+static void convert_slices(struct obs_core_video *video)
+{
+	const struct video_output_info *info = video->convert_info;
+	uint32_t slice_height = convert_slice_height(info->height);
+	long slice;
+
+	while ((slice = os_atomic_inc_long(&video->convert_next_slice) - 1) <
+			CONVERT_SLICES) {
+		uint32_t start_y = (uint32_t)slice * slice_height;
+		uint32_t end_y   = start_y + slice_height;
+
+		if (end_y > info->height)
+			end_y = info->height;
+		if (start_y < end_y)
+			convert_frame_rows(video->convert_output,
+					video->convert_input, info,
+					start_y, end_y);
+	}
+}
+
+static void *convert_thread(void *param)
+{
+	struct obs_core_video *video = param;
+
+	os_set_thread_name("libobs: convert thread");
+
+	while (os_sem_wait(video->convert_start_sem) == 0) {
+		if (video->convert_stop)
+			break;
+
+		convert_slices(video);
+		os_sem_post(video->convert_done_sem);
+	}
+
+	return NULL;
+}
+
+void obs_init_convert_threads(struct obs_core_video *video,
+		const struct video_output_info *info)
+{
+	int threads = os_get_logical_cores() - 1;
+
+	if (info->height < PARALLEL_CONVERT_MIN_HEIGHT || threads < 1)
+		return;
+	if (threads > MAX_CONVERT_THREADS)
+		threads = MAX_CONVERT_THREADS;
+
+	if (os_sem_init(&video->convert_start_sem, 0) != 0)
+		return;
+	if (os_sem_init(&video->convert_done_sem, 0) != 0) {
+		os_sem_destroy(video->convert_start_sem);
+		video->convert_start_sem = NULL;
+		return;
+	}
+
+	video->convert_stop = false;
+
+	for (int i = 0; i < threads; i++) {
+		if (pthread_create(&video->convert_threads[i], NULL,
+					convert_thread, video) != 0)
+			break;
+		video->num_convert_threads++;
+	}
+
+	blog(LOG_INFO, "Converting frames on %d threads using %s",
+			(int)video->num_convert_threads + 1,
+			format_conversion_get_kernels());
+}
+
+void obs_free_convert_threads(struct obs_core_video *video)
+{
+	video->convert_stop = true;
+
+	for (size_t i = 0; i < video->num_convert_threads; i++)
+		os_sem_post(video->convert_start_sem);
+	for (size_t i = 0; i < video->num_convert_threads; i++)
+		pthread_join(video->convert_threads[i], NULL);
+
+	os_sem_destroy(video->convert_start_sem);
+	os_sem_destroy(video->convert_done_sem);
+	video->convert_start_sem   = NULL;
+	video->convert_done_sem    = NULL;
+	video->num_convert_threads = 0;
+}
+
+static const char *convert_frame_name = "convert_frame";
+static void convert_frame(struct obs_core_video *video,
+		struct video_frame *output, const struct video_data *input,
+		const struct video_output_info *info)
+{
+	profile_start(convert_frame_name);
+
+	if (!video->num_convert_threads) {
+		convert_frame_rows(output, input, info, 0, info->height);
+
+	} else {
+		video->convert_output     = output;
+		video->convert_input      = input;
+		video->convert_info       = info;
+		video->convert_next_slice = 0;
+
+		for (size_t i = 0; i < video->num_convert_threads; i++)
+			os_sem_post(video->convert_start_sem);
+
+		convert_slices(video);
+
+		for (size_t i = 0; i < video->num_convert_threads; i++)
+			os_sem_wait(video->convert_done_sem);
+	}
+
+	profile_end(convert_frame_name);
+}
+
 static inline void copy_rgbx_frame(
 		struct video_frame *output, const struct video_data *input,
 		const struct video_output_info *info)
@@ -522,7 +818,8 @@ static inline void output_video_data(struct obs_core_video *video,
 					input_frame, info);
 
 		} else if (format_is_yuv(info->format)) {
-			convert_frame(&output_frame, input_frame, info);
+			convert_frame(video, &output_frame, input_frame,
+					info);
 		} else {
 			copy_rgbx_frame(&output_frame, input_frame, info);
 		}
@@ -531,6 +828,115 @@ static inline void output_video_data(struct obs_core_video *video,
 	}
 }
 
+struct obs_vframe_output {
+	struct video_data frame;
+	int               count;
+};
+
+static const char *output_video_data_name = "output_video_data";
+static void *output_thread(void *param)
+{
+	struct obs_core_video *video = param;
+	uint64_t interval = video_output_get_frame_time(video->video);
+
+	os_set_thread_name("libobs: video output thread");
+
+	const char *output_thread_name =
+		profile_store_name(obs_get_profiler_name_store(),
+			"obs_output_thread(%g ms)", interval / 1000000.);
+	profile_register_root(output_thread_name, interval);
+
+	while (os_sem_wait(video->output_sem) == 0) {
+		struct obs_vframe_output output;
+
+		if (video->output_thread_stop)
+			break;
+
+		pthread_mutex_lock(&video->output_mutex);
+		circlebuf_pop_front(&video->output_queue, &output,
+				sizeof(output));
+		pthread_mutex_unlock(&video->output_mutex);
+
+		profile_start(output_thread_name);
+		profile_start(output_video_data_name);
+		output_video_data(video, &output.frame, output.count);
+		profile_end(output_video_data_name);
+		profile_end(output_thread_name);
+
+		profile_reenable_thread();
+
+		os_atomic_inc_long(&video->output_frames_copied);
+		os_event_signal(video->output_copied_event);
+	}
+
+	return NULL;
+}
+
+bool obs_init_output_thread(struct obs_core_video *video)
+{
+	video->output_thread_stop   = false;
+	video->output_frames_queued = 0;
+	video->output_frames_copied = 0;
+
+	pthread_mutex_init_value(&video->output_mutex);
+	if (pthread_mutex_init(&video->output_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&video->output_sem, 0) != 0)
+		return false;
+	if (os_event_init(&video->output_copied_event,
+				OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+	if (pthread_create(&video->output_thread, NULL, output_thread,
+				video) != 0)
+		return false;
+
+	video->output_thread_initialized = true;
+	return true;
+}
+
+void obs_free_output_thread(struct obs_core_video *video)
+{
+	if (video->output_thread_initialized) {
+		video->output_thread_stop = true;
+		os_sem_post(video->output_sem);
+		pthread_join(video->output_thread, NULL);
+		video->output_thread_initialized = false;
+	}
+
+	os_event_destroy(video->output_copied_event);
+	os_sem_destroy(video->output_sem);
+	pthread_mutex_destroy(&video->output_mutex);
+	circlebuf_free(&video->output_queue);
+
+	video->output_copied_event  = NULL;
+	video->output_sem           = NULL;
+	video->output_frames_queued = 0;
+	video->output_frames_copied = 0;
+}
+
+static inline void queue_output_frame(struct obs_core_video *video,
+		struct video_data *frame, int count)
+{
+	struct obs_vframe_output output = {*frame, count};
+
+	video->output_frames_queued++;
+
+	if (!video->output_thread_initialized) {
+		profile_start(output_video_data_name);
+		output_video_data(video, frame, count);
+		profile_end(output_video_data_name);
+
+		os_atomic_inc_long(&video->output_frames_copied);
+		return;
+	}
+
+	pthread_mutex_lock(&video->output_mutex);
+	circlebuf_push_back(&video->output_queue, &output, sizeof(output));
+	pthread_mutex_unlock(&video->output_mutex);
+
+	os_sem_post(video->output_sem);
+}
+
 static inline void video_sleep(struct obs_core_video *video,
 		uint64_t *p_time, uint64_t interval_ns)
 {
@@ -557,7 +963,6 @@ static const char *output_frame_gs_context_name = "gs_context(video->graphics)";
 static const char *output_frame_render_video_name = "render_video";
 static const char *output_frame_download_frame_name = "download_frame";
 static const char *output_frame_gs_flush_name = "gs_flush";
-static const char *output_frame_output_video_data_name = "output_video_data";
 static inline void output_frame(void)
 {
 	struct obs_core_video *video = &obs->video;
@@ -571,6 +976,9 @@ static inline void output_frame(void)
 	profile_start(output_frame_gs_context_name);
 	gs_enter_context(video->graphics);
 
+	/* release the previous frame as early as possible */
+	unmap_last_surface(video, false);
+
 	profile_start(output_frame_render_video_name);
 	render_video(video, cur_texture, prev_texture);
 	profile_end(output_frame_render_video_name);
@@ -592,9 +1000,7 @@ static inline void output_frame(void)
 				sizeof(vframe_info));
 
 		frame.timestamp = vframe_info.timestamp;
-		profile_start(output_frame_output_video_data_name);
-		output_video_data(video, &frame, vframe_info.count);
-		profile_end(output_frame_output_video_data_name);
+		queue_output_frame(video, &frame, vframe_info.count);
 	}
 
 	if (++video->cur_texture == NUM_TEXTURES)
@@ -345,6 +345,18 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	}
 
+	/* the scale threads only run while an encoder wants a scaled frame
+	 * and share the cores with the convert and tick threads */
+	video_output_set_scale_threads(video->video,
+			(uint32_t)os_get_logical_cores() / 2);
+
+	if (!ovi->gpu_conversion && format_is_yuv(ovi->output_format))
+		obs_init_convert_threads(video, &vi);
+
+	if (!obs_init_output_thread(video))
+		blog(LOG_WARNING, "Failed to create video output thread, "
+				"frames will be copied on the graphics thread");
+
 	gs_enter_context(video->graphics);
 
 	if (ovi->gpu_conversion && !obs_init_gpu_conversion(ovi))
@@ -374,6 +386,9 @@ static void stop_video(void)
 			pthread_join(video->video_thread, &thread_retval);
 			video->thread_initialized = false;
 		}
+
+		obs_free_output_thread(video);
+		obs_free_tick_threads(video);
 	}
 
 }
@@ -386,6 +401,8 @@ static void obs_free_video(void)
 		video_output_close(video->video);
 		video->video = NULL;
 
+		obs_free_convert_threads(video);
+
 		if (!video->graphics)
 			return;
 
@@ -460,9 +477,13 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	audio->present_volume = 1.0f;
 
 	errorcode = audio_output_open(&audio->audio, ai);
-	if (errorcode == AUDIO_OUTPUT_SUCCESS)
+	if (errorcode == AUDIO_OUTPUT_SUCCESS) {
+		/* only takes effect while more than one mix is in use, e.g.
+		 * when recording multiple audio tracks */
+		audio_output_set_parallel_output(audio->audio,
+				os_get_logical_cores() > 1);
 		return true;
-	else if (errorcode == AUDIO_OUTPUT_INVALIDPARAM)
+	} else if (errorcode == AUDIO_OUTPUT_INVALIDPARAM)
 		blog(LOG_ERROR, "Invalid audio parameters specified");
 	else
 		blog(LOG_ERROR, "Could not open audio output");
@@ -504,6 +525,14 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&data->services_mutex, &attr) != 0)
 		goto fail;
+	if (!obs_name_index_init(&data->source_names))
+		goto fail;
+	if (!obs_name_index_init(&data->output_names))
+		goto fail;
+	if (!obs_name_index_init(&data->encoder_names))
+		goto fail;
+	if (!obs_name_index_init(&data->service_names))
+		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
 
@@ -567,6 +596,10 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->outputs_mutex);
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
+	obs_name_index_free(&data->source_names);
+	obs_name_index_free(&data->output_names);
+	obs_name_index_free(&data->encoder_names);
+	obs_name_index_free(&data->service_names);
 }
 
 static const char *obs_signals[] = {
@@ -751,6 +784,7 @@ bool obs_startup(const char *locale, const char *module_config_path,
 void obs_shutdown(void)
 {
 	struct obs_module *module;
+	long packet_allocs, packet_dups, packet_refs;
 
 	if (!obs)
 		return;
@@ -779,6 +813,13 @@ void obs_shutdown(void)
 	stop_video();
 	stop_hotkeys();
 
+	obs_encoder_packet_get_stats(&packet_allocs, &packet_dups,
+			&packet_refs);
+	if (packet_allocs || packet_dups)
+		blog(LOG_INFO, "Encoder packets: %ld allocated, "
+				"%ld duplicated, %ld shared by reference",
+				packet_allocs, packet_dups, packet_refs);
+
 	obs_free_data();
 	obs_free_video();
 	obs_free_hotkeys();
@@ -979,6 +1020,17 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 	return true;
 }
 
+void obs_set_parallel_tick(bool enable)
+{
+	if (!obs) return;
+	obs->video.parallel_tick = enable;
+}
+
+bool obs_parallel_tick_enabled(void)
+{
+	return obs ? obs->video.parallel_tick : false;
+}
+
 bool obs_enum_input_types(size_t idx, const char **id)
 {
 	if (!obs) return false;
@@ -1131,6 +1183,7 @@ bool obs_add_source(obs_source_t *source)
 	pthread_mutex_lock(&obs->data.sources_mutex);
 	da_push_back(obs->data.user_sources, &source);
 	obs_source_addref(source);
+	obs_name_index_add(&obs->data.source_names, &source->context);
 	pthread_mutex_unlock(&obs->data.sources_mutex);
 
 	calldata_set_ptr(&params, "source", source);
@@ -1251,48 +1304,36 @@ void obs_enum_services(bool (*enum_proc)(void*, obs_service_t*), void *param)
 			enum_proc, param);
 }
 
-obs_source_t *obs_get_source_by_name(const char *name)
-{
-	struct obs_core_data *data = &obs->data;
-	struct obs_source *source = NULL;
-	size_t i;
+static struct obs_context_data *obs_name_index_find(
+		struct obs_name_index *index, const char *name);
 
-	if (!obs) return NULL;
+static inline void *get_context_by_name(struct obs_name_index *index,
+		const char *name, void *(*addref)(void*))
+{
+	struct obs_context_data *context;
 
-	pthread_mutex_lock(&data->user_sources_mutex);
+	pthread_mutex_lock(&index->mutex);
 
-	for (i = 0; i < data->user_sources.num; i++) {
-		struct obs_source *cur_source = data->user_sources.array[i];
-		if (strcmp(cur_source->context.name, name) == 0) {
-			source = cur_source;
-			obs_source_addref(source);
-			break;
-		}
-	}
+	context = obs_name_index_find(index, name);
+	if (context)
+		context = addref(context);
 
-	pthread_mutex_unlock(&data->user_sources_mutex);
-	return source;
+	pthread_mutex_unlock(&index->mutex);
+	return context;
 }
 
-static inline void *get_context_by_name(void *vfirst, const char *name,
-		pthread_mutex_t *mutex, void *(*addref)(void*))
+static inline void *obs_source_addref_safe_(void *ref)
 {
-	struct obs_context_data **first = vfirst;
-	struct obs_context_data *context;
-
-	pthread_mutex_lock(mutex);
-
-	context = *first;
-	while (context) {
-		if (strcmp(context->name, name) == 0) {
-			context = addref(context);
-			break;
-		}
-		context = context->next;
-	}
+	/* user sources hold a reference for as long as they're indexed */
+	obs_source_addref(ref);
+	return ref;
+}
 
-	pthread_mutex_unlock(mutex);
-	return context;
+obs_source_t *obs_get_source_by_name(const char *name)
+{
+	if (!obs) return NULL;
+	return get_context_by_name(&obs->data.source_names, name,
+			obs_source_addref_safe_);
 }
 
 static inline void *obs_output_addref_safe_(void *ref)
@@ -1318,22 +1359,22 @@ static inline void *obs_id_(void *data)
 obs_output_t *obs_get_output_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_output, name,
-			&obs->data.outputs_mutex, obs_output_addref_safe_);
+	return get_context_by_name(&obs->data.output_names, name,
+			obs_output_addref_safe_);
 }
 
 obs_encoder_t *obs_get_encoder_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_encoder, name,
-			&obs->data.encoders_mutex, obs_encoder_addref_safe_);
+	return get_context_by_name(&obs->data.encoder_names, name,
+			obs_encoder_addref_safe_);
 }
 
 obs_service_t *obs_get_service_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_service, name,
-			&obs->data.services_mutex, obs_service_addref_safe_);
+	return get_context_by_name(&obs->data.service_names, name,
+			obs_service_addref_safe_);
 }
 
 gs_effect_t *obs_get_default_effect(void)
@@ -1629,6 +1670,144 @@ obs_data_array_t *obs_save_sources(void)
 	return array;
 }
 
+static inline uint32_t get_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+bool obs_name_index_init(struct obs_name_index *index)
+{
+	memset(index, 0, sizeof(*index));
+	return pthread_mutex_init(&index->mutex, NULL) == 0;
+}
+
+void obs_name_index_free(struct obs_name_index *index)
+{
+	pthread_mutex_destroy(&index->mutex);
+	bfree(index->buckets);
+	memset(index, 0, sizeof(*index));
+}
+
+/* call with the index locked */
+static void name_index_grow(struct obs_name_index *index)
+{
+	size_t num_buckets = index->num_buckets ? index->num_buckets * 2 : 64;
+	struct obs_context_data **buckets =
+		bzalloc(sizeof(struct obs_context_data*) * num_buckets);
+
+	for (size_t i = 0; i < index->num_buckets; i++) {
+		struct obs_context_data *context = index->buckets[i];
+
+		while (context) {
+			struct obs_context_data *next = context->name_next;
+			size_t j = context->name_hash & (num_buckets - 1);
+
+			context->name_next = buckets[j];
+			buckets[j] = context;
+			context = next;
+		}
+	}
+
+	bfree(index->buckets);
+	index->buckets     = buckets;
+	index->num_buckets = num_buckets;
+}
+
+/* call with the index locked */
+static void name_index_link(struct obs_name_index *index,
+		struct obs_context_data *context)
+{
+	size_t i;
+
+	if (index->num >= index->num_buckets)
+		name_index_grow(index);
+
+	context->name_hash = get_name_hash(context->name);
+	i = context->name_hash & (index->num_buckets - 1);
+
+	context->name_next = index->buckets[i];
+	index->buckets[i]  = context;
+	index->num++;
+}
+
+/* call with the index locked */
+static void name_index_unlink(struct obs_name_index *index,
+		struct obs_context_data *context)
+{
+	struct obs_context_data **prev;
+
+	prev = &index->buckets[context->name_hash & (index->num_buckets - 1)];
+	while (*prev && *prev != context)
+		prev = &(*prev)->name_next;
+
+	if (*prev) {
+		*prev = context->name_next;
+		index->num--;
+	}
+
+	context->name_next = NULL;
+}
+
+/* call with the index locked; if several contexts share the name, any one of
+ * them may be returned */
+static struct obs_context_data *obs_name_index_find(
+		struct obs_name_index *index, const char *name)
+{
+	struct obs_context_data *context;
+	uint32_t hash;
+
+	if (!name || !index->num)
+		return NULL;
+
+	hash = get_name_hash(name);
+	context = index->buckets[hash & (index->num_buckets - 1)];
+
+	for (; context; context = context->name_next) {
+		if (context->name_hash == hash &&
+		    strcmp(context->name, name) == 0)
+			return context;
+	}
+
+	return NULL;
+}
+
+void obs_name_index_add(struct obs_name_index *index,
+		struct obs_context_data *context)
+{
+	pthread_mutex_lock(&context->rename_cache_mutex);
+	pthread_mutex_lock(&index->mutex);
+	if (!context->name_index) {
+		name_index_link(index, context);
+		context->name_index = index;
+	}
+	pthread_mutex_unlock(&index->mutex);
+	pthread_mutex_unlock(&context->rename_cache_mutex);
+}
+
+void obs_name_index_remove(struct obs_context_data *context)
+{
+	struct obs_name_index *index;
+
+	pthread_mutex_lock(&context->rename_cache_mutex);
+
+	index = context->name_index;
+	if (index) {
+		pthread_mutex_lock(&index->mutex);
+		name_index_unlink(index, context);
+		context->name_index = NULL;
+		pthread_mutex_unlock(&index->mutex);
+	}
+
+	pthread_mutex_unlock(&context->rename_cache_mutex);
+}
+
 /* ensures that names are never blank */
 static inline char *dup_name(const char *name)
 {
@@ -1702,7 +1881,8 @@ void obs_context_data_free(struct obs_context_data *context)
 }
 
 void obs_context_data_insert(struct obs_context_data *context,
-		pthread_mutex_t *mutex, void *pfirst)
+		pthread_mutex_t *mutex, void *pfirst,
+		struct obs_name_index *index)
 {
 	struct obs_context_data **first = pfirst;
 
@@ -1719,10 +1899,16 @@ void obs_context_data_insert(struct obs_context_data *context,
 	if (context->next)
 		context->next->prev_next = &context->next;
 	pthread_mutex_unlock(mutex);
+
+	if (index)
+		obs_name_index_add(index, context);
 }
 
 void obs_context_data_remove(struct obs_context_data *context)
 {
+	if (context)
+		obs_name_index_remove(context);
+
 	if (context && context->mutex) {
 		pthread_mutex_lock(context->mutex);
 		if (context->prev_next)
@@ -1738,12 +1924,28 @@ void obs_context_data_remove(struct obs_context_data *context)
 void obs_context_data_setname(struct obs_context_data *context,
 		const char *name)
 {
+	struct obs_name_index *index;
+
 	pthread_mutex_lock(&context->rename_cache_mutex);
 
+	/* name_index can't change while rename_cache_mutex is held.  the
+	 * context is relinked under the index mutex so lookups never see it
+	 * under its new name in the old bucket */
+	index = context->name_index;
+	if (index) {
+		pthread_mutex_lock(&index->mutex);
+		name_index_unlink(index, context);
+	}
+
 	if (context->name)
 		da_push_back(context->rename_cache, &context->name);
 	context->name = dup_name(name);
 
+	if (index) {
+		name_index_link(index, context);
+		pthread_mutex_unlock(&index->mutex);
+	}
+
 	pthread_mutex_unlock(&context->rename_cache_mutex);
 }
 
@@ -307,6 +307,15 @@ EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 /** Gets the current audio settings, returns false if no audio */
 EXPORT bool obs_get_audio_info(struct obs_audio_info *oai);
 
+/**
+ * Enables or disables ticking input sources in parallel.  Sources with the
+ * OBS_SOURCE_SERIAL_TICK flag, scenes, transitions and filters are always
+ * ticked serially on the graphics thread.  Disabled by default; the frontend
+ * turns it on with the Video "ParallelTick" setting.
+ */
+EXPORT void obs_set_parallel_tick(bool enable);
+EXPORT bool obs_parallel_tick_enabled(void);
+
 /**
  * Opens a plugin module directly from a specific path.
  *
@@ -923,6 +932,39 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y,
 EXPORT void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
 
+/**
+ * Acquires a frame from the source's async frame pool so that video can be
+ * written directly into it instead of being copied by
+ * obs_source_output_video.  The planes are allocated for the given format
+ * and size; all other frame fields (timestamp, color information, flip) are
+ * reset and must be set by the caller.  The frame must be passed to either
+ * obs_source_output_acquired_frame or obs_source_cancel_acquired_frame.
+ */
+EXPORT struct obs_source_frame *obs_source_acquire_frame(obs_source_t *source,
+		enum video_format format, uint32_t width, uint32_t height);
+
+/** Outputs a frame acquired with obs_source_acquire_frame */
+EXPORT void obs_source_output_acquired_frame(obs_source_t *source,
+		struct obs_source_frame *frame);
+
+/** Returns a frame acquired with obs_source_acquire_frame without output */
+EXPORT void obs_source_cancel_acquired_frame(obs_source_t *source,
+		struct obs_source_frame *frame);
+
+/** Gets the number of async video frames dropped because of backlog */
+EXPORT uint32_t obs_source_get_async_frames_dropped(
+		const obs_source_t *source);
+
+/** Gets the number of times the async frame pool had no free frames */
+EXPORT uint32_t obs_source_get_async_pool_exhausted(
+		const obs_source_t *source);
+
+/**
+ * Gets the average time spent ticking the source each frame, in
+ * nanoseconds.  Does not include the time spent ticking its children.
+ */
+EXPORT uint64_t obs_source_get_tick_time(const obs_source_t *source);
+
 /** Outputs audio data (always asynchronous) */
 EXPORT void obs_source_output_audio(obs_source_t *source,
 		const struct obs_source_audio *audio);
@@ -1497,6 +1539,34 @@ EXPORT void obs_duplicate_encoder_packet(struct encoder_packet *dst,
 
 EXPORT void obs_free_encoder_packet(struct encoder_packet *packet);
 
+/**
+ * Packets passed to encoded_packet callbacks have refcounted, immutable
+ * payloads.  Outputs that keep a packet should take a reference with
+ * obs_encoder_packet_ref instead of duplicating it, and must release it with
+ * obs_encoder_packet_release (not obs_free_encoder_packet).
+ */
+EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
+		const struct encoder_packet *src);
+EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
+
+/** Copies a packet's payload into a new refcounted packet */
+EXPORT void obs_encoder_packet_create_instance(struct encoder_packet *dst,
+		const struct encoder_packet *src);
+
+/**
+ * Gets the length-prefixed (AVCC) form of a refcounted H.264 packet.  The
+ * conversion is done only once per packet and shared by every output that
+ * asks for it.  The result must be released with obs_encoder_packet_release.
+ */
+EXPORT void obs_encoder_packet_parse_avc(struct encoder_packet *avc_packet,
+		const struct encoder_packet *src);
+
+/**
+ * Gets the number of refcounted packet buffers allocated, legacy packet
+ * duplications, and references taken instead of copies
+ */
+EXPORT void obs_encoder_packet_get_stats(long *allocs, long *dups, long *refs);
+
 
 /* ------------------------------------------------------------------------- */
 /* Stream Services */
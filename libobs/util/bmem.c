@@ -20,6 +20,10 @@
 #include "bmem.h"
 #include "threading.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 /*
  * NOTE: totally jacked the mem alignment trick from ffmpeg, credit to them:
  *   http://www.ffmpeg.org/
@@ -92,6 +96,479 @@ void base_set_allocator(struct base_allocator *defs)
 	memcpy(&alloc, defs, sizeof(struct base_allocator));
 }
 
+/* ------------------------------------------------------------------------- */
+/*
+ *   Pooled allocator.  Requests are rounded up to size classes (four per power
+ * of two, 32 bytes to 32 megabytes) and freed blocks are kept for reuse
+ * instead of going back to the system.  Each thread keeps a small free list
+ * per class for blocks up to POOL_THREAD_MAX; it exchanges blocks with a
+ * shared pool in batches, which is also where larger blocks (packets, frame
+ * copies) are recycled.  Anything bigger than the largest class goes
+ * straight to the system.
+ *
+ *   Every block is preceded by a header of ALIGNMENT bytes so the returned
+ * pointers keep the usual alignment.
+ */
+
+#define POOL_MIN_SIZE       32
+#define POOL_NUM_CLASSES    81
+#define POOL_HUGE           POOL_NUM_CLASSES
+#define POOL_THREAD_MAX     (64 * 1024)
+#define POOL_THREAD_BUDGET  (128 * 1024)
+#define POOL_SHARED_BUDGET  (16 * 1024 * 1024)
+#define POOL_SHARED_MAX     (256 * 1024 * 1024)
+
+struct pool_header {
+	struct pool_header *next;
+	size_t             size;
+	uint32_t           idx;
+};
+
+struct pool_list {
+	struct pool_header *first;
+	size_t             num;
+};
+
+struct pool_thread {
+	struct pool_list       cache[POOL_NUM_CLASSES];
+	struct base_pool_stats stats[POOL_NUM_CLASSES + 1];
+	struct pool_thread     *next;
+	struct pool_thread     **prev_next;
+};
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pool_list pool_shared[POOL_NUM_CLASSES];
+static size_t pool_shared_bytes = 0;
+static struct pool_thread *pool_threads = NULL;
+static bool pool_key_created = false;
+static pthread_key_t pool_key;
+static bool pool_active = false;
+
+/* stats of exited threads, and of threads freeing after their cache is gone */
+static struct base_pool_stats pool_retired[POOL_NUM_CLASSES + 1];
+
+#ifdef _MSC_VER
+static __declspec(thread) struct pool_thread *pool_thread_data = NULL;
+static __declspec(thread) bool pool_thread_exited = false;
+#else
+static __thread struct pool_thread *pool_thread_data = NULL;
+static __thread bool pool_thread_exited = false;
+#endif
+
+static inline uint32_t pool_highest_bit(size_t val)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanReverse(&idx, (unsigned long)val);
+	return (uint32_t)idx;
+#else
+	return (uint32_t)(sizeof(unsigned long) * 8 - 1 -
+			__builtin_clzl((unsigned long)val));
+#endif
+}
+
+static inline size_t pool_class_size(uint32_t idx)
+{
+	if (!idx)
+		return POOL_MIN_SIZE;
+
+	idx--;
+	return (size_t)(5 + (idx & 3)) << (idx / 4 + 3);
+}
+
+static inline uint32_t pool_class(size_t size)
+{
+	uint32_t bit;
+
+	if (size <= POOL_MIN_SIZE)
+		return 0;
+	if (size > pool_class_size(POOL_NUM_CLASSES - 1))
+		return POOL_HUGE;
+
+	bit = pool_highest_bit(--size);
+	return 1 + (bit - 5) * 4 + (uint32_t)((size >> (bit - 2)) & 3);
+}
+
+static inline size_t pool_thread_cap(uint32_t idx)
+{
+	size_t size = pool_class_size(idx);
+	size_t cap;
+
+	if (size > POOL_THREAD_MAX)
+		return 0;
+
+	cap = POOL_THREAD_BUDGET / size;
+	return cap < 2 ? 2 : (cap > 64 ? 64 : cap);
+}
+
+static inline size_t pool_shared_cap(uint32_t idx)
+{
+	size_t cap = POOL_SHARED_BUDGET / pool_class_size(idx);
+	return cap < 4 ? 4 : (cap > 256 ? 256 : cap);
+}
+
+static inline void pool_push(struct pool_list *list, struct pool_header *block)
+{
+	block->next = list->first;
+	list->first = block;
+	list->num++;
+}
+
+static inline struct pool_header *pool_pop(struct pool_list *list)
+{
+	struct pool_header *block = list->first;
+	list->first = block->next;
+	list->num--;
+	return block;
+}
+
+static inline void *pool_data(struct pool_header *block)
+{
+	return (uint8_t*)block + ALIGNMENT;
+}
+
+static inline struct pool_header *pool_block(void *ptr)
+{
+	return (struct pool_header*)((uint8_t*)ptr - ALIGNMENT);
+}
+
+static struct pool_header *pool_sys_alloc(uint32_t idx, size_t size,
+		struct base_pool_stats *stats)
+{
+	size_t block_size = idx == POOL_HUGE ? size : pool_class_size(idx);
+	struct pool_header *block = a_malloc(ALIGNMENT + block_size);
+
+	if (block) {
+		block->idx  = idx;
+		block->size = block_size;
+		stats->sys_allocs++;
+	}
+
+	return block;
+}
+
+/* call with pool_mutex held */
+static void pool_release_locked(struct pool_header *block,
+		struct base_pool_stats *stats)
+{
+	struct pool_list *list = &pool_shared[block->idx];
+
+	if (list->num < pool_shared_cap(block->idx) &&
+	    pool_shared_bytes + block->size <= POOL_SHARED_MAX) {
+		pool_push(list, block);
+		pool_shared_bytes += block->size;
+	} else {
+		a_free(block);
+		stats->sys_frees++;
+	}
+}
+
+static void pool_thread_exit(void *data)
+{
+	struct pool_thread *thread = data;
+
+	pthread_mutex_lock(&pool_mutex);
+
+	for (uint32_t i = 0; i < POOL_NUM_CLASSES; i++) {
+		while (thread->cache[i].num)
+			pool_release_locked(pool_pop(&thread->cache[i]),
+					&thread->stats[i]);
+	}
+
+	for (uint32_t i = 0; i <= POOL_NUM_CLASSES; i++) {
+		struct base_pool_stats *dst = &pool_retired[i];
+		struct base_pool_stats *src = &thread->stats[i];
+
+		dst->allocs      += src->allocs;
+		dst->frees       += src->frees;
+		dst->thread_hits += src->thread_hits;
+		dst->shared_hits += src->shared_hits;
+		dst->sys_allocs  += src->sys_allocs;
+		dst->sys_frees   += src->sys_frees;
+	}
+
+	*thread->prev_next = thread->next;
+	if (thread->next)
+		thread->next->prev_next = thread->prev_next;
+
+	pthread_mutex_unlock(&pool_mutex);
+
+	pool_thread_data   = NULL;
+	pool_thread_exited = true;
+	a_free(thread);
+}
+
+static struct pool_thread *pool_get_thread(void)
+{
+	struct pool_thread *thread = pool_thread_data;
+
+	if (thread || pool_thread_exited)
+		return thread;
+
+	thread = a_malloc(sizeof(struct pool_thread));
+	if (!thread)
+		return NULL;
+	memset(thread, 0, sizeof(struct pool_thread));
+
+	pthread_mutex_lock(&pool_mutex);
+
+	if (!pool_key_created)
+		pool_key_created = pthread_key_create(&pool_key,
+				pool_thread_exit) == 0;
+
+	thread->next      = pool_threads;
+	thread->prev_next = &pool_threads;
+	if (pool_threads)
+		pool_threads->prev_next = &thread->next;
+	pool_threads = thread;
+
+	pthread_mutex_unlock(&pool_mutex);
+
+	if (pool_key_created)
+		pthread_setspecific(pool_key, thread);
+
+	pool_thread_data = thread;
+	return thread;
+}
+
+/* takes a block from the shared pool, moving up to half a cache worth of
+ * extra blocks into the thread's cache while the lock is held */
+static struct pool_header *pool_refill(struct pool_thread *thread,
+		uint32_t idx)
+{
+	struct pool_list   *list  = &pool_shared[idx];
+	struct pool_header *block = NULL;
+
+	pthread_mutex_lock(&pool_mutex);
+
+	if (list->num) {
+		size_t extra = pool_thread_cap(idx) / 2;
+
+		block = pool_pop(list);
+		pool_shared_bytes -= block->size;
+
+		while (extra-- && list->num) {
+			struct pool_header *cached = pool_pop(list);
+			pool_shared_bytes -= cached->size;
+			pool_push(&thread->cache[idx], cached);
+		}
+	}
+
+	pthread_mutex_unlock(&pool_mutex);
+	return block;
+}
+
+/* hands the block and half of the thread's cache back to the shared pool */
+static void pool_spill(struct pool_thread *thread, struct pool_header *block)
+{
+	uint32_t               idx   = block->idx;
+	struct pool_list       *cache = &thread->cache[idx];
+	struct base_pool_stats *stats = &thread->stats[idx];
+	size_t                 keep  = pool_thread_cap(idx) / 2;
+
+	pthread_mutex_lock(&pool_mutex);
+
+	pool_release_locked(block, stats);
+	while (cache->num > keep)
+		pool_release_locked(pool_pop(cache), stats);
+
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+static void *pool_malloc_shared(uint32_t idx, size_t size)
+{
+	struct base_pool_stats *stats = &pool_retired[idx];
+	struct pool_header     *block = NULL;
+
+	pthread_mutex_lock(&pool_mutex);
+
+	if (idx != POOL_HUGE && pool_shared[idx].num) {
+		block = pool_pop(&pool_shared[idx]);
+		pool_shared_bytes -= block->size;
+		stats->shared_hits++;
+	} else {
+		block = pool_sys_alloc(idx, size, stats);
+	}
+
+	if (block)
+		stats->allocs++;
+
+	pthread_mutex_unlock(&pool_mutex);
+	return block ? pool_data(block) : NULL;
+}
+
+static void *pool_malloc(size_t size)
+{
+	struct pool_thread     *thread = pool_get_thread();
+	uint32_t               idx     = pool_class(size);
+	struct base_pool_stats *stats;
+	struct pool_header     *block  = NULL;
+
+	if (!thread)
+		return pool_malloc_shared(idx, size);
+
+	stats = &thread->stats[idx];
+
+	if (idx != POOL_HUGE) {
+		if (thread->cache[idx].num) {
+			block = pool_pop(&thread->cache[idx]);
+			stats->thread_hits++;
+
+		/* unlocked peek, a stale count only costs a lock or a
+		 * system allocation */
+		} else if (pool_shared[idx].num) {
+			block = pool_refill(thread, idx);
+			if (block)
+				stats->shared_hits++;
+		}
+	}
+
+	if (!block)
+		block = pool_sys_alloc(idx, size, stats);
+	if (!block)
+		return NULL;
+
+	stats->allocs++;
+	return pool_data(block);
+}
+
+static void pool_free(void *ptr)
+{
+	struct pool_thread *thread;
+	struct pool_header *block;
+	uint32_t           idx;
+
+	if (!ptr)
+		return;
+
+	thread = pool_get_thread();
+	block  = pool_block(ptr);
+	idx    = block->idx;
+
+	if (!thread) {
+		pthread_mutex_lock(&pool_mutex);
+		pool_retired[idx].frees++;
+		if (idx == POOL_HUGE) {
+			a_free(block);
+			pool_retired[idx].sys_frees++;
+		} else {
+			pool_release_locked(block, &pool_retired[idx]);
+		}
+		pthread_mutex_unlock(&pool_mutex);
+		return;
+	}
+
+	thread->stats[idx].frees++;
+
+	if (idx == POOL_HUGE) {
+		a_free(block);
+		thread->stats[idx].sys_frees++;
+
+	} else if (thread->cache[idx].num < pool_thread_cap(idx)) {
+		pool_push(&thread->cache[idx], block);
+
+	} else {
+		pool_spill(thread, block);
+	}
+}
+
+static void *pool_realloc(void *ptr, size_t size)
+{
+	struct pool_header *block;
+	void               *new_ptr;
+
+	if (!ptr)
+		return pool_malloc(size);
+
+	block = pool_block(ptr);
+
+	if (block->idx == POOL_HUGE && pool_class(size) == POOL_HUGE) {
+		block = a_realloc(block, ALIGNMENT + size);
+		if (!block)
+			return NULL;
+
+		block->size = size;
+		return pool_data(block);
+	}
+
+	/* growing within the class (or shrinking a little) keeps the block */
+	if (size <= block->size && size > block->size / 2)
+		return ptr;
+
+	new_ptr = pool_malloc(size);
+	if (!new_ptr)
+		return NULL;
+
+	memcpy(new_ptr, ptr, size < block->size ? size : block->size);
+	pool_free(ptr);
+	return new_ptr;
+}
+
+static struct base_allocator pool_allocator = {
+	pool_malloc, pool_realloc, pool_free
+};
+
+bool base_use_pooled_allocator(void)
+{
+	long allocs;
+
+	if (pool_active)
+		return true;
+
+	allocs = os_atomic_load_long(&num_allocs);
+	if (allocs != 0) {
+		blog(LOG_WARNING, "base_use_pooled_allocator: %ld blocks are "
+		                  "already allocated, the pooled allocator "
+		                  "must be enabled before anything else is "
+		                  "allocated", allocs);
+		return false;
+	}
+
+	base_set_allocator(&pool_allocator);
+	pool_active = true;
+	return true;
+}
+
+bool base_pooled_allocator_active(void)
+{
+	return pool_active;
+}
+
+size_t base_pool_num_classes(void)
+{
+	return POOL_NUM_CLASSES + 1;
+}
+
+bool base_pool_get_stats(size_t idx, struct base_pool_stats *stats)
+{
+	struct pool_thread *thread;
+
+	if (!pool_active || idx > POOL_NUM_CLASSES || !stats)
+		return false;
+
+	pthread_mutex_lock(&pool_mutex);
+
+	*stats = pool_retired[idx];
+	stats->size = idx < POOL_NUM_CLASSES ?
+		pool_class_size((uint32_t)idx) : 0;
+
+	/* live threads update their counters without locking, so these are
+	 * approximate while those threads are allocating */
+	for (thread = pool_threads; thread; thread = thread->next) {
+		struct base_pool_stats *src = &thread->stats[idx];
+
+		stats->allocs      += src->allocs;
+		stats->frees       += src->frees;
+		stats->thread_hits += src->thread_hits;
+		stats->shared_hits += src->shared_hits;
+		stats->sys_allocs  += src->sys_allocs;
+		stats->sys_frees   += src->sys_frees;
+	}
+
+	pthread_mutex_unlock(&pool_mutex);
+	return true;
+}
+
 void *bmalloc(size_t size)
 {
 	void *ptr = alloc.malloc(size);
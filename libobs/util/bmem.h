@@ -33,6 +33,34 @@ struct base_allocator {
 
 EXPORT void base_set_allocator(struct base_allocator *defs);
 
+/*
+ * Pooled allocator mode
+ *
+ *   Switches bmalloc/brealloc/bfree to an allocator that rounds requests up to
+ * size classes and recycles freed blocks through per-thread caches and a
+ * shared pool, so steady-state packet and frame allocations stop hitting the
+ * system allocator.  Must be called before anything is allocated with bmalloc
+ * (it fails and returns false otherwise).
+ */
+
+struct base_pool_stats {
+	size_t   size;        /* block size of the class, 0 if not pooled */
+	uint64_t allocs;      /* blocks handed out */
+	uint64_t frees;       /* blocks freed */
+	uint64_t thread_hits; /* allocations served from a thread cache */
+	uint64_t shared_hits; /* allocations served from the shared pool */
+	uint64_t sys_allocs;  /* allocations passed on to the system */
+	uint64_t sys_frees;   /* blocks released back to the system */
+};
+
+EXPORT bool base_use_pooled_allocator(void);
+EXPORT bool base_pooled_allocator_active(void);
+
+/** Returns the number of size classes, the last one being unpooled sizes */
+EXPORT size_t base_pool_num_classes(void);
+/** Sums the allocation statistics of a size class over all threads */
+EXPORT bool base_pool_get_stats(size_t idx, struct base_pool_stats *stats);
+
 EXPORT void *bmalloc(size_t size);
 EXPORT void *brealloc(void *ptr, size_t size);
 EXPORT void bfree(void *ptr);
@@ -188,6 +188,26 @@ static inline void circlebuf_peek_front(struct circlebuf *cb, void *data,
 	}
 }
 
+/**
+ * Gets the front of the buffer as (up to) two contiguous spans without
+ * copying.  The second span is only set if the data wraps around the end of
+ * the buffer, otherwise it is NULL with a size of 0.
+ */
+static inline void circlebuf_peek_front_spans(struct circlebuf *cb,
+		size_t size, void **span1, size_t *size1,
+		void **span2, size_t *size2)
+{
+	size_t start_size;
+	assert(size <= cb->size);
+
+	start_size = cb->capacity - cb->start_pos;
+
+	*span1 = size ? (uint8_t*)cb->data + cb->start_pos : NULL;
+	*size1 = start_size < size ? start_size : size;
+	*size2 = size - *size1;
+	*span2 = *size2 ? cb->data : NULL;
+}
+
 static inline void circlebuf_pop_front(struct circlebuf *cb, void *data,
 		size_t size)
 {
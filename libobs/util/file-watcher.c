@@ -0,0 +1,484 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string.h>
+
+#include "file-watcher.h"
+#include "platform.h"
+#include "threading.h"
+#include "bmem.h"
+#include "base.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#define INOTIFY_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | \
+		IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+#endif
+
+#define POLL_INTERVAL_MS 1000
+
+struct os_file_watch {
+	char                  *path;
+	char                  *dir;
+	const char            *name;
+	os_file_watch_cb      callback;
+	void                  *param;
+
+	/* inotify watch descriptor of the directory, -1 if polled */
+	int                   wd;
+	bool                  changed;
+
+	int64_t               mtime;
+	int64_t               size;
+
+	struct os_file_watch  *next;
+	struct os_file_watch  **prev_next;
+};
+
+struct file_watcher {
+	/* serializes starting and stopping the thread */
+	pthread_mutex_t       thread_mutex;
+	pthread_t             thread;
+	bool                  thread_active;
+	volatile long         stop;
+
+	/* protects the watch list, held while calling callbacks */
+	pthread_mutex_t       mutex;
+	struct os_file_watch  *first;
+	uint64_t              last_poll;
+
+#ifdef __linux__
+	int                   inotify_fd;
+	int                   wake_fd;
+#else
+	os_event_t            *wake;
+#endif
+};
+
+static struct file_watcher watcher = {
+	.thread_mutex = PTHREAD_MUTEX_INITIALIZER,
+	.mutex        = PTHREAD_MUTEX_INITIALIZER,
+#ifdef __linux__
+	.inotify_fd   = -1,
+	.wake_fd      = -1,
+#endif
+};
+
+static void get_file_stats(const char *path, int64_t *mtime, int64_t *size)
+{
+	struct stat stats;
+
+	if (stat(path, &stats) == 0) {
+		*mtime = (int64_t)stats.st_mtime;
+		*size  = (int64_t)stats.st_size;
+	} else {
+		*mtime = -1;
+		*size  = -1;
+	}
+}
+
+/* call with the watcher locked */
+static void poll_watches_locked(void)
+{
+	struct os_file_watch *watch = watcher.first;
+
+	for (; watch; watch = watch->next) {
+		int64_t mtime, size;
+
+		if (watch->wd != -1)
+			continue;
+
+		get_file_stats(watch->path, &mtime, &size);
+		if (mtime != watch->mtime || size != watch->size) {
+			watch->mtime   = mtime;
+			watch->size    = size;
+			watch->changed = true;
+		}
+	}
+}
+
+/* call with the watcher locked */
+static void dispatch_locked(void)
+{
+	struct os_file_watch *watch = watcher.first;
+
+	for (; watch; watch = watch->next) {
+		if (watch->changed) {
+			watch->changed = false;
+			watch->callback(watch->param);
+		}
+	}
+}
+
+#ifdef __linux__
+
+/* call with the watcher locked */
+static void add_inotify_watch_locked(struct os_file_watch *watch)
+{
+	if (watcher.inotify_fd == -1)
+		return;
+
+	watch->wd = inotify_add_watch(watcher.inotify_fd, watch->dir,
+			INOTIFY_MASK);
+}
+
+/* call with the watcher locked, after unlinking the watch */
+static void remove_inotify_watch_locked(struct os_file_watch *watch)
+{
+	struct os_file_watch *other = watcher.first;
+
+	if (watch->wd == -1)
+		return;
+
+	/* every file in the same directory shares the watch descriptor */
+	for (; other; other = other->next) {
+		if (other->wd == watch->wd)
+			return;
+	}
+
+	inotify_rm_watch(watcher.inotify_fd, watch->wd);
+}
+
+/* call with the watcher locked */
+static void mark_changed_locked(int wd, const char *name, bool all)
+{
+	struct os_file_watch *watch = watcher.first;
+
+	for (; watch; watch = watch->next) {
+		if (all || (watch->wd == wd && strcmp(watch->name, name) == 0))
+			watch->changed = true;
+	}
+}
+
+/* call with the watcher locked */
+static void fall_back_to_polling_locked(int wd)
+{
+	struct os_file_watch *watch = watcher.first;
+
+	for (; watch; watch = watch->next) {
+		if (watch->wd == wd) {
+			watch->wd = -1;
+			get_file_stats(watch->path, &watch->mtime,
+					&watch->size);
+			watch->changed = true;
+		}
+	}
+}
+
+/* call with the watcher locked */
+static void read_events_locked(void)
+{
+	char buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+
+	while ((len = read(watcher.inotify_fd, buf, sizeof(buf))) > 0) {
+		const struct inotify_event *event;
+
+		for (char *ptr = buf; ptr < buf + len;
+		     ptr += sizeof(struct inotify_event) + event->len) {
+			event = (const struct inotify_event*)ptr;
+
+			if (event->mask & IN_Q_OVERFLOW)
+				mark_changed_locked(-1, NULL, true);
+			else if (event->mask & IN_IGNORED)
+				fall_back_to_polling_locked(event->wd);
+			else if (event->len)
+				mark_changed_locked(event->wd, event->name,
+						false);
+		}
+	}
+}
+
+/* call with the watcher locked; directories that couldn't be watched (for
+ * example because they didn't exist yet) are retried on every poll */
+static void retry_inotify_locked(void)
+{
+	struct os_file_watch *watch = watcher.first;
+
+	for (; watch; watch = watch->next) {
+		if (watch->wd == -1)
+			add_inotify_watch_locked(watch);
+	}
+}
+
+static bool any_polled_locked(void)
+{
+	struct os_file_watch *watch = watcher.first;
+
+	for (; watch; watch = watch->next) {
+		if (watch->wd == -1)
+			return true;
+	}
+
+	return false;
+}
+
+static void *file_watcher_thread(void *unused)
+{
+	os_set_thread_name("file watcher");
+
+	while (!os_atomic_load_long(&watcher.stop)) {
+		struct pollfd fds[2] = {
+			{.fd = watcher.inotify_fd, .events = POLLIN},
+			{.fd = watcher.wake_fd,    .events = POLLIN}
+		};
+		uint64_t now;
+		int timeout;
+
+		pthread_mutex_lock(&watcher.mutex);
+		timeout = any_polled_locked() ? POLL_INTERVAL_MS : -1;
+		pthread_mutex_unlock(&watcher.mutex);
+
+		if (poll(fds, 2, timeout) < 0 && errno != EINTR)
+			break;
+
+		if (fds[1].revents & POLLIN) {
+			uint64_t val;
+			if (read(watcher.wake_fd, &val, sizeof(val)) < 0)
+				continue;
+		}
+
+		pthread_mutex_lock(&watcher.mutex);
+
+		if (fds[0].revents & POLLIN)
+			read_events_locked();
+
+		now = os_gettime_ns();
+		if (now - watcher.last_poll >= POLL_INTERVAL_MS * 1000000ULL) {
+			watcher.last_poll = now;
+			poll_watches_locked();
+			retry_inotify_locked();
+		}
+
+		dispatch_locked();
+		pthread_mutex_unlock(&watcher.mutex);
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+static bool init_wakeup(void)
+{
+	watcher.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watcher.inotify_fd == -1)
+		blog(LOG_WARNING, "file watcher: inotify unavailable (%d), "
+		                  "polling files instead", errno);
+
+	watcher.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	return watcher.wake_fd != -1;
+}
+
+static void wake_thread(void)
+{
+	uint64_t val = 1;
+	if (write(watcher.wake_fd, &val, sizeof(val)) < 0)
+		blog(LOG_WARNING, "file watcher: failed to wake thread");
+}
+
+static void free_wakeup(void)
+{
+	if (watcher.inotify_fd != -1)
+		close(watcher.inotify_fd);
+	if (watcher.wake_fd != -1)
+		close(watcher.wake_fd);
+	watcher.inotify_fd = -1;
+	watcher.wake_fd    = -1;
+}
+
+#else
+
+static inline void add_inotify_watch_locked(struct os_file_watch *watch)
+{
+	UNUSED_PARAMETER(watch);
+}
+
+static inline void remove_inotify_watch_locked(struct os_file_watch *watch)
+{
+	UNUSED_PARAMETER(watch);
+}
+
+static void *file_watcher_thread(void *unused)
+{
+	os_set_thread_name("file watcher");
+
+	while (!os_atomic_load_long(&watcher.stop)) {
+		os_event_timedwait(watcher.wake, POLL_INTERVAL_MS);
+		if (os_atomic_load_long(&watcher.stop))
+			break;
+
+		pthread_mutex_lock(&watcher.mutex);
+		poll_watches_locked();
+		dispatch_locked();
+		pthread_mutex_unlock(&watcher.mutex);
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+static bool init_wakeup(void)
+{
+	return os_event_init(&watcher.wake, OS_EVENT_TYPE_AUTO) == 0;
+}
+
+static void wake_thread(void)
+{
+	os_event_signal(watcher.wake);
+}
+
+static void free_wakeup(void)
+{
+	os_event_destroy(watcher.wake);
+	watcher.wake = NULL;
+}
+
+#endif
+
+/* call with the thread mutex held */
+static bool start_thread(void)
+{
+	if (watcher.thread_active)
+		return true;
+
+	if (!init_wakeup()) {
+		free_wakeup();
+		return false;
+	}
+
+	os_atomic_set_long(&watcher.stop, 0);
+	watcher.last_poll = os_gettime_ns();
+	watcher.thread_active = pthread_create(&watcher.thread, NULL,
+			file_watcher_thread, NULL) == 0;
+
+	if (!watcher.thread_active)
+		free_wakeup();
+	return watcher.thread_active;
+}
+
+/* call with the thread mutex held */
+static void stop_thread(void)
+{
+	if (!watcher.thread_active)
+		return;
+
+	os_atomic_set_long(&watcher.stop, 1);
+	wake_thread();
+	pthread_join(watcher.thread, NULL);
+
+	watcher.thread_active = false;
+	free_wakeup();
+}
+
+static char *get_dir(const char *path, const char **name)
+{
+	const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+	const char *backslash = strrchr(path, '\\');
+	if (backslash > slash)
+		slash = backslash;
+#endif
+
+	if (!slash) {
+		*name = path;
+		return bstrdup(".");
+	}
+
+	*name = slash + 1;
+	return slash == path ? bstrdup("/") : bstrdup_n(path, slash - path);
+}
+
+os_file_watch_t *os_file_watch_add(const char *path,
+		os_file_watch_cb callback, void *param)
+{
+	struct os_file_watch *watch;
+
+	if (!path || !*path || !callback)
+		return NULL;
+
+	watch           = bzalloc(sizeof(struct os_file_watch));
+	watch->path     = bstrdup(path);
+	watch->dir      = get_dir(watch->path, &watch->name);
+	watch->callback = callback;
+	watch->param    = param;
+	watch->wd       = -1;
+	get_file_stats(path, &watch->mtime, &watch->size);
+
+	pthread_mutex_lock(&watcher.thread_mutex);
+
+	if (!start_thread()) {
+		pthread_mutex_unlock(&watcher.thread_mutex);
+		blog(LOG_WARNING, "file watcher: failed to start thread, "
+		                  "not watching '%s'", path);
+		bfree(watch->dir);
+		bfree(watch->path);
+		bfree(watch);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&watcher.mutex);
+	add_inotify_watch_locked(watch);
+
+	watch->next      = watcher.first;
+	watch->prev_next = &watcher.first;
+	if (watcher.first)
+		watcher.first->prev_next = &watch->next;
+	watcher.first = watch;
+	pthread_mutex_unlock(&watcher.mutex);
+
+	/* the thread may be waiting without a timeout */
+	if (watch->wd == -1)
+		wake_thread();
+
+	pthread_mutex_unlock(&watcher.thread_mutex);
+	return watch;
+}
+
+void os_file_watch_remove(os_file_watch_t *watch)
+{
+	bool last;
+
+	if (!watch)
+		return;
+
+	pthread_mutex_lock(&watcher.thread_mutex);
+
+	pthread_mutex_lock(&watcher.mutex);
+	*watch->prev_next = watch->next;
+	if (watch->next)
+		watch->next->prev_next = watch->prev_next;
+	remove_inotify_watch_locked(watch);
+	last = watcher.first == NULL;
+	pthread_mutex_unlock(&watcher.mutex);
+
+	if (last)
+		stop_thread();
+
+	pthread_mutex_unlock(&watcher.thread_mutex);
+
+	bfree(watch->dir);
+	bfree(watch->path);
+	bfree(watch);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Process-wide file change notifications.
+ *
+ * Watches are serviced by a single background thread which is started with
+ * the first watch and stopped when the last one is removed.  On Linux the
+ * directory containing each file is watched with inotify, so files which are
+ * replaced by renaming or which don't exist yet are picked up too; everywhere
+ * else, and for any file inotify can't watch, the file's size and
+ * modification time are polled once a second.
+ */
+
+struct os_file_watch;
+typedef struct os_file_watch os_file_watch_t;
+
+/** Called from the watcher thread when the file was written to, created,
+ * replaced or removed.  Runs with the watcher locked, so it must not add or
+ * remove watches. */
+typedef void (*os_file_watch_cb)(void *param);
+
+EXPORT os_file_watch_t *os_file_watch_add(const char *path,
+		os_file_watch_cb callback, void *param);
+
+/** Once this returns the callback is not running and won't be called again */
+EXPORT void os_file_watch_remove(os_file_watch_t *watch);
+
+#ifdef __cplusplus
+}
+#endif
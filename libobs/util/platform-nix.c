@@ -69,6 +69,12 @@ void os_dlclose(void *module)
 	dlclose(module);
 }
 
+int os_get_logical_cores(void)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+}
+
 #if !defined(__APPLE__)
 
 struct os_cpu_usage_info {
@@ -25,6 +25,14 @@
 #include "utf8.h"
 #include "dstr.h"
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#define OS_CPU_X86
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#define OS_CPU_X86
+#endif
+
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
 	FILE *file = NULL;
@@ -590,3 +598,87 @@ int os_mkdirs(const char *dir)
 	dstr_free(&dir_str);
 	return ret;
 }
+
+#ifdef OS_CPU_X86
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t get_xcr0(void)
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static uint32_t query_cpu_features(void)
+{
+	uint32_t regs[4];
+	uint32_t max_leaf;
+	uint32_t features = 0;
+	bool     avx_state = false;
+
+	cpuid(0, 0, regs);
+	max_leaf = regs[0];
+	if (max_leaf < 1)
+		return 0;
+
+	cpuid(1, 0, regs);
+	if (regs[3] & (1 << 26))
+		features |= OS_CPU_SSE2;
+	if (regs[2] & (1 << 9))
+		features |= OS_CPU_SSSE3;
+	if (regs[2] & (1 << 19))
+		features |= OS_CPU_SSE41;
+
+	/* AVX requires OSXSAVE, and the OS must preserve XMM/YMM state */
+	if ((regs[2] & (1 << 27)) && (regs[2] & (1 << 28)))
+		avx_state = (get_xcr0() & 0x6) == 0x6;
+	if (avx_state)
+		features |= OS_CPU_AVX;
+
+	if (avx_state && max_leaf >= 7) {
+		cpuid(7, 0, regs);
+		if (regs[1] & (1 << 5))
+			features |= OS_CPU_AVX2;
+	}
+
+	return features;
+}
+#else
+static uint32_t query_cpu_features(void)
+{
+	return 0;
+}
+#endif
+
+static volatile uint32_t cpu_features_mask = 0xFFFFFFFF;
+
+uint32_t os_get_cpu_features(void)
+{
+	/* the query is cheap and deterministic, so a benign race on first
+	 * use is harmless */
+	static volatile bool     queried  = false;
+	static volatile uint32_t features = 0;
+
+	if (!queried) {
+		features = query_cpu_features();
+		queried  = true;
+	}
+
+	return features & cpu_features_mask;
+}
+
+void os_set_cpu_features_mask(uint32_t mask)
+{
+	cpu_features_mask = mask;
+}
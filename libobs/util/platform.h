@@ -152,6 +152,26 @@ EXPORT os_inhibit_t *os_inhibit_sleep_create(const char *reason);
 EXPORT bool os_inhibit_sleep_set_active(os_inhibit_t *info, bool active);
 EXPORT void os_inhibit_sleep_destroy(os_inhibit_t *info);
 
+enum os_cpu_feature {
+	OS_CPU_SSE2  = 1<<0,
+	OS_CPU_SSSE3 = 1<<1,
+	OS_CPU_SSE41 = 1<<2,
+	OS_CPU_AVX   = 1<<3,
+	OS_CPU_AVX2  = 1<<4
+};
+
+/** Returns a combination of os_cpu_feature flags supported by the CPU and
+ * the operating system (AVX state must be enabled by the OS as well) */
+EXPORT uint32_t os_get_cpu_features(void);
+
+/** Limits os_get_cpu_features to the flags in mask, to test or benchmark the
+ * fallback code paths.  Code that already picked its implementation isn't
+ * affected. */
+EXPORT void os_set_cpu_features_mask(uint32_t mask);
+
+/** Returns the number of logical processors available (at least 1) */
+EXPORT int os_get_logical_cores(void);
+
 #ifdef _MSC_VER
 #define strtoll _strtoi64
 #if _MSC_VER < 1900
@@ -43,11 +43,11 @@ struct profile_call {
 #ifdef TRACK_OVERHEAD
 	uint64_t overhead_end;
 #endif
-	uint64_t expected_time_between_calls;
-	DARRAY(profile_call) children;
-	profile_call *parent;
+	size_t parent;
 };
 
+#define NO_CALL ((size_t)-1)
+
 typedef struct profile_times_table_entry profile_times_table_entry;
 struct profile_times_table_entry {
 	size_t probes;
@@ -80,10 +80,27 @@ struct profile_entry {
 
 typedef struct profile_root_entry profile_root_entry;
 struct profile_root_entry {
-	pthread_mutex_t *mutex;
 	const char *name;
 	profile_entry *entry;
-	profile_call *prev_call;
+	uint64_t prev_start_time;
+};
+
+typedef DARRAY(profile_root_entry) profile_root_entries;
+
+/* Per-thread profiler state.  Calls of the current root are recorded into a
+ * flat array (in the order they were started) that keeps its memory between
+ * roots, and are then merged into tables only this thread writes to.  The
+ * mutex is only ever contended while a snapshot folds the tables together. */
+typedef struct profile_thread profile_thread;
+struct profile_thread {
+	pthread_mutex_t mutex;
+	volatile long refs;
+	bool detached;
+	profile_root_entries roots;
+
+	DARRAY(profile_call) calls;
+	DARRAY(profile_entry*) call_entries;
+	size_t current;
 };
 
 static inline uint64_t diff_ns_to_usec(uint64_t prev, uint64_t next)
@@ -228,22 +245,84 @@ static profile_entry *get_child(profile_entry *parent, const char *name)
 	return init_entry(da_push_back_new(parent->children), name);
 }
 
-static void merge_call(profile_entry *entry, profile_call *call,
-		profile_call *prev_call)
+static void free_profile_entry(profile_entry *entry);
+
+static profile_root_entry *get_root_entry(profile_root_entries *roots,
+		const char *name)
 {
-	const size_t num = call->children.num;
-	for (size_t i = 0; i < num; i++) {
-		profile_call *child = &call->children.array[i];
-		merge_call(get_child(entry, child->name), child, NULL);
+	profile_root_entry *r_entry = NULL;
+
+	for (size_t i = 0; i < roots->num; i++) {
+		if (roots->array[i].name == name) {
+			r_entry = &roots->array[i];
+			break;
+		}
 	}
 
-	if (entry->expected_time_between_calls != 0 && prev_call) {
-		migrate_old_entries(&entry->times_between_calls, true);
-		uint64_t usec = diff_ns_to_usec(prev_call->start_time,
-				call->start_time);
-		add_hashmap_entry(&entry->times_between_calls, usec, 1);
+	if (!r_entry) {
+		r_entry = da_push_back_new((*roots));
+		r_entry->name = name;
+		r_entry->entry = bzalloc(sizeof(profile_entry));
+		init_entry(r_entry->entry, name);
 	}
 
+	return r_entry;
+}
+
+static void free_root_entries(profile_root_entries *roots)
+{
+	for (size_t i = 0; i < roots->num; i++) {
+		free_profile_entry(roots->array[i].entry);
+		bfree(roots->array[i].entry);
+	}
+
+	da_free((*roots));
+}
+
+static void fold_hashmap(profile_times_table *dst, profile_times_table *src)
+{
+	migrate_old_entries(src, false);
+
+	for (size_t i = 0; i < src->size; i++) {
+		profile_times_table_entry *entry = &src->entries[i];
+		if (!entry->probes)
+			continue;
+
+		migrate_old_entries(dst, true);
+		add_hashmap_entry(dst, entry->entry.time_delta,
+				entry->entry.count);
+	}
+}
+
+static void fold_entry(profile_entry *dst, profile_entry *src)
+{
+	fold_hashmap(&dst->times, &src->times);
+#ifdef TRACK_OVERHEAD
+	fold_hashmap(&dst->overhead, &src->overhead);
+#endif
+	fold_hashmap(&dst->times_between_calls, &src->times_between_calls);
+
+	if (src->expected_time_between_calls > dst->expected_time_between_calls)
+		dst->expected_time_between_calls =
+			src->expected_time_between_calls;
+
+	for (size_t i = 0; i < src->children.num; i++) {
+		profile_entry *child = &src->children.array[i];
+		fold_entry(get_child(dst, child->name), child);
+	}
+}
+
+static void fold_roots(profile_root_entries *dst, profile_root_entries *src)
+{
+	for (size_t i = 0; i < src->num; i++) {
+		profile_root_entry *r_entry = &src->array[i];
+		fold_entry(get_root_entry(dst, r_entry->name)->entry,
+				r_entry->entry);
+	}
+}
+
+static void merge_call_time(profile_entry *entry, profile_call *call)
+{
 	migrate_old_entries(&entry->times, true);
 	uint64_t usec = diff_ns_to_usec(call->start_time, call->end_time);
 	add_hashmap_entry(&entry->times, usec, 1);
@@ -256,29 +335,64 @@ static void merge_call(profile_entry *entry, profile_call *call,
 #endif
 }
 
-static bool enabled = false;
+static void merge_calls(profile_root_entry *r_entry, profile_call *calls,
+		size_t num, profile_entry **entries)
+{
+	profile_entry *entry = r_entry->entry;
+
+	if (r_entry->prev_start_time) {
+		migrate_old_entries(&entry->times_between_calls, true);
+		uint64_t usec = diff_ns_to_usec(r_entry->prev_start_time,
+				calls[0].start_time);
+		add_hashmap_entry(&entry->times_between_calls, usec, 1);
+	}
+
+	r_entry->prev_start_time = calls[0].start_time;
+
+	/* a call's parent always precedes it, and once a sibling is started
+	 * no earlier sibling (whose entry may move here) is referenced again */
+	for (size_t i = 0; i < num; i++) {
+		if (i)
+			entry = get_child(entries[calls[i].parent],
+					calls[i].name);
+
+		entries[i] = entry;
+		merge_call_time(entry, &calls[i]);
+	}
+}
+
+static volatile long enabled = false;
 static pthread_mutex_t root_mutex = PTHREAD_MUTEX_INITIALIZER;
-static DARRAY(profile_root_entry) root_entries;
+
+/* registered roots and the data of threads that have exited */
+static profile_root_entries root_entries;
+static DARRAY(profile_thread*) threads;
+static bool thread_key_created = false;
+static pthread_key_t thread_key;
 
 #ifdef _MSC_VER
-static __declspec(thread) profile_call *thread_context = NULL;
+static __declspec(thread) profile_thread *thread_data = NULL;
 static __declspec(thread) bool thread_enabled = true;
+static __declspec(thread) long thread_timeline_id = 0;
 #else
-static __thread profile_call *thread_context = NULL;
+static __thread profile_thread *thread_data = NULL;
 static __thread bool thread_enabled = true;
+static __thread long thread_timeline_id = 0;
 #endif
 
+static void timeline_record(profile_thread *thread);
+
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
-	enabled = true;
+	os_atomic_set_long(&enabled, true);
 	pthread_mutex_unlock(&root_mutex);
 }
 
 void profiler_stop(void)
 {
 	pthread_mutex_lock(&root_mutex);
-	enabled = false;
+	os_atomic_set_long(&enabled, false);
 	pthread_mutex_unlock(&root_mutex);
 }
 
@@ -287,9 +401,7 @@ void profile_reenable_thread(void)
 	if (thread_enabled)
 		return;
 
-	pthread_mutex_lock(&root_mutex);
-	thread_enabled = enabled;
-	pthread_mutex_unlock(&root_mutex);
+	thread_enabled = os_atomic_load_long(&enabled) != 0;
 }
 
 static bool lock_root(void)
@@ -304,70 +416,118 @@ static bool lock_root(void)
 	return true;
 }
 
-static profile_root_entry *get_root_entry(const char *name)
+static void free_thread(profile_thread *thread)
 {
-	profile_root_entry *r_entry = NULL;
+	free_root_entries(&thread->roots);
+	da_free(thread->calls);
+	da_free(thread->call_entries);
+	pthread_mutex_destroy(&thread->mutex);
+	bfree(thread);
+}
 
-	for (size_t i = 0; i < root_entries.num; i++) {
-		if (root_entries.array[i].name == name) {
-			r_entry = &root_entries.array[i];
-			break;
-		}
-	}
+static inline void release_thread(profile_thread *thread)
+{
+	if (os_atomic_dec_long(&thread->refs) == 0)
+		free_thread(thread);
+}
 
-	if (!r_entry) {
-		r_entry = da_push_back_new(root_entries);
-		r_entry->mutex = bmalloc(sizeof(pthread_mutex_t));
-		pthread_mutex_init(r_entry->mutex, NULL);
+/* thread exit: keep the thread's data by folding it into the shared roots */
+static void thread_exit(void *data)
+{
+	profile_thread *thread = data;
 
-		r_entry->name = name;
-		r_entry->entry = bzalloc(sizeof(profile_entry));
-		init_entry(r_entry->entry, name);
+	pthread_mutex_lock(&root_mutex);
+	if (!thread->detached) {
+		pthread_mutex_lock(&thread->mutex);
+		fold_roots(&root_entries, &thread->roots);
+		thread->detached = true;
+		pthread_mutex_unlock(&thread->mutex);
+
+		da_erase_item(threads, &thread);
+		release_thread(thread);
 	}
+	pthread_mutex_unlock(&root_mutex);
 
-	return r_entry;
+	release_thread(thread);
+}
+
+static profile_thread *init_thread_data(void)
+{
+	profile_thread *thread;
+
+	if (!lock_root())
+		return NULL;
+
+	if (!thread_key_created)
+		thread_key_created =
+			pthread_key_create(&thread_key, thread_exit) == 0;
+
+	thread = bzalloc(sizeof(profile_thread));
+	pthread_mutex_init(&thread->mutex, NULL);
+	thread->refs    = 2;
+	thread->current = NO_CALL;
+
+	da_push_back(threads, &thread);
+	pthread_mutex_unlock(&root_mutex);
+
+	if (thread_key_created)
+		pthread_setspecific(thread_key, thread);
+
+	thread_data = thread;
+	return thread;
+}
+
+static void drop_thread_data(void)
+{
+	profile_thread *thread = thread_data;
+
+	if (thread_key_created)
+		pthread_setspecific(thread_key, NULL);
+
+	thread_data = NULL;
+	release_thread(thread);
 }
 
 void profile_register_root(const char *name,
 		uint64_t expected_time_between_calls)
 {
+	profile_root_entry *root_entry;
+
 	if (!lock_root())
 		return;
 
-	get_root_entry(name)->entry->expected_time_between_calls =
+	root_entry = get_root_entry(&root_entries, name);
+	root_entry->entry->expected_time_between_calls =
 		(expected_time_between_calls + 500) / 1000;
 	pthread_mutex_unlock(&root_mutex);
 }
 
-static void free_call_context(profile_call *context);
-
-static void merge_context(profile_call *context)
+static void merge_thread_calls(profile_thread *thread)
 {
-	pthread_mutex_t *mutex = NULL;
-	profile_entry *entry = NULL;
-	profile_call *prev_call = NULL;
+	bool detached;
 
-	if (!lock_root()) {
-		free_call_context(context);
+	if (!os_atomic_load_long(&enabled)) {
+		thread_enabled = false;
+		da_resize(thread->calls, 0);
 		return;
 	}
 
-	profile_root_entry *r_entry = get_root_entry(context->name);
-
-	mutex     = r_entry->mutex;
-	entry     = r_entry->entry;
-	prev_call = r_entry->prev_call;
-
-	r_entry->prev_call = context;
+	da_resize(thread->call_entries, thread->calls.num);
 
-	pthread_mutex_lock(mutex);
-	pthread_mutex_unlock(&root_mutex);
-
-	merge_call(entry, context, prev_call);
+	pthread_mutex_lock(&thread->mutex);
+	detached = thread->detached;
+	if (!detached)
+		merge_calls(get_root_entry(&thread->roots,
+					thread->calls.array[0].name),
+				thread->calls.array, thread->calls.num,
+				thread->call_entries.array);
+	pthread_mutex_unlock(&thread->mutex);
 
-	pthread_mutex_unlock(mutex);
+	da_resize(thread->calls, 0);
 
-	free_call_context(prev_call);
+	/* the profiler was freed since this thread started using it */
+	if (detached)
+		drop_thread_data();
 }
 
 void profile_start(const char *name)
@@ -375,26 +535,20 @@ void profile_start(const char *name)
 	if (!thread_enabled)
 		return;
 
+	profile_thread *thread = thread_data;
+	if (!thread && !(thread = init_thread_data()))
+		return;
+
 	profile_call new_call = {
 		.name = name,
 #ifdef TRACK_OVERHEAD
 		.overhead_start = os_gettime_ns(),
 #endif
-		.parent = thread_context,
+		.parent = thread->current,
 	};
 
-	profile_call *call = NULL;
-
-	if (new_call.parent) {
-		size_t idx = da_push_back(new_call.parent->children, &new_call);
-		call = &new_call.parent->children.array[idx];
-	} else {
-		call = bmalloc(sizeof(profile_call));
-		memcpy(call, &new_call, sizeof(profile_call));
-	}
-
-	thread_context = call;
-	call->start_time = os_gettime_ns();
+	thread->current = da_push_back(thread->calls, &new_call);
+	thread->calls.array[thread->current].start_time = os_gettime_ns();
 }
 
 void profile_end(const char *name)
@@ -403,12 +557,15 @@ void profile_end(const char *name)
 	if (!thread_enabled)
 		return;
 
-	profile_call *call = thread_context;
-	if (!call) {
+	profile_thread *thread = thread_data;
+	if (!thread || thread->current == NO_CALL) {
 		blog(LOG_ERROR, "Called profile end with no active profile");
 		return;
 	}
 
+	profile_call *calls = thread->calls.array;
+	profile_call *call = &calls[thread->current];
+
 	if (!call->name)
 		call->name = name;
 
@@ -417,30 +574,247 @@ void profile_end(const char *name)
 				"start(\"%s\"[%p]) <-> end(\"%s\"[%p])",
 				call->name, call->name, name, name);
 
-		profile_call *parent = call->parent;
-		while (parent && parent->parent &&  parent->name != name)
-			parent = parent->parent;
+		size_t parent = call->parent;
+		while (parent != NO_CALL && calls[parent].parent != NO_CALL &&
+				calls[parent].name != name)
+			parent = calls[parent].parent;
 
-		if (!parent || parent->name != name)
+		if (parent == NO_CALL || calls[parent].name != name)
 			return;
 
 		while (call->name != name) {
 			profile_end(call->name);
-			call = call->parent;
+			call = &calls[thread->current];
 		}
 	}
 
-	thread_context = call->parent;
+	thread->current = call->parent;
 
 	call->end_time = end;
 #ifdef TRACK_OVERHEAD
 	call->overhead_end = os_gettime_ns();
 #endif
 
-	if (call->parent)
+	if (call->parent != NO_CALL)
 		return;
 
-	merge_context(call);
+	timeline_record(thread);
+	merge_thread_calls(thread);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Timeline recording */
+
+typedef struct timeline_event timeline_event;
+struct timeline_event {
+	const char *name;
+	uint64_t start_time;
+	uint64_t end_time;
+	long thread_id;
+	bool root;
+};
+
+static pthread_mutex_t timeline_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile long timeline_active = 0;
+static volatile long timeline_next_thread_id = 0;
+static timeline_event *timeline_events = NULL;
+static size_t timeline_capacity = 0;
+static size_t timeline_head = 0;
+static size_t timeline_count = 0;
+static uint64_t timeline_overwritten = 0;
+
+static void timeline_push(const char *name, uint64_t start_time,
+		uint64_t end_time, bool root)
+{
+	timeline_event *event = &timeline_events[timeline_head];
+
+	event->name       = name;
+	event->start_time = start_time;
+	event->end_time   = end_time;
+	event->thread_id  = thread_timeline_id;
+	event->root       = root;
+
+	if (++timeline_head == timeline_capacity)
+		timeline_head = 0;
+
+	if (timeline_count < timeline_capacity)
+		timeline_count++;
+	else
+		timeline_overwritten++;
+}
+
+/* called when a root call has finished, all calls of the root are written
+ * out at once so profile_start/profile_end stay as cheap as before */
+static void timeline_record(profile_thread *thread)
+{
+	if (!os_atomic_load_long(&timeline_active))
+		return;
+
+	if (!thread_timeline_id)
+		thread_timeline_id = os_atomic_inc_long(
+				&timeline_next_thread_id);
+
+	pthread_mutex_lock(&timeline_mutex);
+	for (size_t i = 0; timeline_events && i < thread->calls.num; i++) {
+		profile_call *call = &thread->calls.array[i];
+		timeline_push(call->name, call->start_time, call->end_time,
+				call->parent == NO_CALL);
+	}
+	pthread_mutex_unlock(&timeline_mutex);
+}
+
+void profiler_timeline_start(size_t max_events)
+{
+	if (!max_events)
+		return;
+
+	pthread_mutex_lock(&timeline_mutex);
+
+	if (max_events != timeline_capacity) {
+		bfree(timeline_events);
+		timeline_events = bmalloc(sizeof(timeline_event) * max_events);
+		timeline_capacity = max_events;
+	}
+
+	timeline_head        = 0;
+	timeline_count       = 0;
+	timeline_overwritten = 0;
+
+	os_atomic_set_long(&timeline_active, 1);
+	pthread_mutex_unlock(&timeline_mutex);
+}
+
+void profiler_timeline_stop(void)
+{
+	os_atomic_set_long(&timeline_active, 0);
+}
+
+bool profiler_timeline_active(void)
+{
+	return os_atomic_load_long(&timeline_active) != 0;
+}
+
+static void timeline_free(void)
+{
+	os_atomic_set_long(&timeline_active, 0);
+
+	pthread_mutex_lock(&timeline_mutex);
+	bfree(timeline_events);
+	timeline_events      = NULL;
+	timeline_capacity    = 0;
+	timeline_head        = 0;
+	timeline_count       = 0;
+	timeline_overwritten = 0;
+	pthread_mutex_unlock(&timeline_mutex);
+}
+
+static void json_cat_escaped(struct dstr *buffer, const char *str)
+{
+	for (; *str; str++) {
+		unsigned char ch = (unsigned char)*str;
+
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(buffer, '\\');
+			dstr_cat_ch(buffer, (char)ch);
+		} else if (ch < 0x20) {
+			dstr_catf(buffer, "\\u%04x", ch);
+		} else {
+			dstr_cat_ch(buffer, (char)ch);
+		}
+	}
+}
+
+typedef struct timeline_thread timeline_thread;
+struct timeline_thread {
+	long id;
+	const char *name;
+};
+
+typedef DARRAY(timeline_thread) timeline_threads;
+
+static void add_timeline_thread(timeline_threads *threads,
+		const timeline_event *event)
+{
+	for (size_t i = 0; i < threads->num; i++) {
+		if (threads->array[i].id == event->thread_id)
+			return;
+	}
+
+	timeline_thread thread = {event->thread_id, event->name};
+	da_push_back((*threads), &thread);
+}
+
+bool profiler_timeline_dump_json(const char *filename)
+{
+	DARRAY(timeline_event) events = {0};
+	timeline_threads threads = {0};
+	struct dstr buffer = {0};
+	uint64_t base_time = 0;
+	uint64_t overwritten;
+	FILE *f;
+
+	/* copy the events out so recording threads aren't blocked while the
+	 * file is written */
+	pthread_mutex_lock(&timeline_mutex);
+	da_resize(events, timeline_count);
+	for (size_t i = 0; i < timeline_count; i++) {
+		size_t idx = (timeline_head + timeline_capacity -
+				timeline_count + i) % timeline_capacity;
+		events.array[i] = timeline_events[idx];
+	}
+	overwritten = timeline_overwritten;
+	pthread_mutex_unlock(&timeline_mutex);
+
+	f = os_fopen(filename, "wb");
+	if (!f) {
+		da_free(events);
+		return false;
+	}
+
+	for (size_t i = 0; i < events.num; i++) {
+		timeline_event *event = &events.array[i];
+
+		if (!base_time || event->start_time < base_time)
+			base_time = event->start_time;
+		if (event->root)
+			add_timeline_thread(&threads, event);
+	}
+
+	dstr_printf(&buffer, "{\"otherData\":{\"overwrittenEvents\":"
+			"%"PRIu64"},\"traceEvents\":[", overwritten);
+	fwrite(buffer.array, 1, buffer.len, f);
+
+	for (size_t i = 0; i < threads.num; i++) {
+		dstr_printf(&buffer, "%s\n{\"name\":\"thread_name\","
+				"\"ph\":\"M\",\"pid\":1,\"tid\":%ld,"
+				"\"args\":{\"name\":\"",
+				i ? "," : "", threads.array[i].id);
+		json_cat_escaped(&buffer, threads.array[i].name);
+		dstr_cat(&buffer, "\"}}");
+		fwrite(buffer.array, 1, buffer.len, f);
+	}
+
+	for (size_t i = 0; i < events.num; i++) {
+		timeline_event *event = &events.array[i];
+
+		dstr_printf(&buffer, "%s\n{\"name\":\"",
+				(i || threads.num) ? "," : "");
+		json_cat_escaped(&buffer, event->name);
+		dstr_catf(&buffer, "\",\"ph\":\"X\",\"pid\":1,"
+				"\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f}",
+				event->thread_id,
+				(event->start_time - base_time) / 1000.,
+				(event->end_time - event->start_time) / 1000.);
+		fwrite(buffer.array, 1, buffer.len, f);
+	}
+
+	fwrite("\n]}\n", 1, 4, f);
+	fclose(f);
+
+	dstr_free(&buffer);
+	da_free(threads);
+	da_free(events);
+	return true;
 }
 
 static int profiler_time_entry_compare(const void *first, const void *second)
@@ -760,24 +1134,6 @@ void profiler_print_time_between_calls(profiler_snapshot_t *snap)
 			profile_print_entry_expected, snap);
 }
 
-static void free_call_children(profile_call *call)
-{
-	if (!call)
-		return;
-
-	const size_t num = call->children.num;
-	for (size_t i = 0; i < num; i++)
-		free_call_children(&call->children.array[i]);
-
-	da_free(call->children);
-}
-
-static void free_call_context(profile_call *context)
-{
-	free_call_children(context);
-	bfree(context);
-}
-
 static void free_hashmap(profile_times_table *map)
 {
 	map->size = 0;
@@ -802,30 +1158,34 @@ static void free_profile_entry(profile_entry *entry)
 
 void profiler_free(void)
 {
-	DARRAY(profile_root_entry) old_root_entries = {0};
+	profile_root_entries old_root_entries = {0};
+	DARRAY(profile_thread*) old_threads = {0};
 
 	pthread_mutex_lock(&root_mutex);
-	enabled = false;
+	os_atomic_set_long(&enabled, false);
 	da_move(old_root_entries, root_entries);
-	pthread_mutex_unlock(&root_mutex);
+	da_move(old_threads, threads);
 
-	for (size_t i = 0; i < old_root_entries.num; i++) {
-		profile_root_entry *entry = &old_root_entries.array[i];
+	for (size_t i = 0; i < old_threads.num; i++) {
+		profile_thread *thread = old_threads.array[i];
 
-		pthread_mutex_lock(entry->mutex);
-		pthread_mutex_unlock(entry->mutex);
+		pthread_mutex_lock(&thread->mutex);
+		thread->detached = true;
+		pthread_mutex_unlock(&thread->mutex);
+	}
+	pthread_mutex_unlock(&root_mutex);
 
-		pthread_mutex_destroy(entry->mutex);
-		bfree(entry->mutex);
-		entry->mutex = NULL;
+	/* threads that are still running release their data themselves */
+	for (size_t i = 0; i < old_threads.num; i++)
+		release_thread(old_threads.array[i]);
 
-		free_call_context(entry->prev_call);
+	if (thread_data && thread_data->detached)
+		drop_thread_data();
 
-		free_profile_entry(entry->entry);
-		bfree(entry->entry);
-	}
+	free_root_entries(&old_root_entries);
+	da_free(old_threads);
 
-	da_free(old_root_entries);
+	timeline_free();
 }
 
 
@@ -930,17 +1290,27 @@ static void sort_snapshot_entry(profiler_snapshot_entry_t *entry)
 profiler_snapshot_t *profile_snapshot_create(void)
 {
 	profiler_snapshot_t *snap = bzalloc(sizeof(profiler_snapshot_t));
+	profile_root_entries roots = {0};
 
 	pthread_mutex_lock(&root_mutex);
-	da_reserve(snap->roots, root_entries.num);
-	for (size_t i = 0; i < root_entries.num; i++) {
-		pthread_mutex_lock(root_entries.array[i].mutex);
-		add_entry_to_snapshot(root_entries.array[i].entry,
-				da_push_back_new(snap->roots));
-		pthread_mutex_unlock(root_entries.array[i].mutex);
+	fold_roots(&roots, &root_entries);
+
+	for (size_t i = 0; i < threads.num; i++) {
+		profile_thread *thread = threads.array[i];
+
+		pthread_mutex_lock(&thread->mutex);
+		fold_roots(&roots, &thread->roots);
+		pthread_mutex_unlock(&thread->mutex);
 	}
 	pthread_mutex_unlock(&root_mutex);
 
+	da_reserve(snap->roots, roots.num);
+	for (size_t i = 0; i < roots.num; i++)
+		add_entry_to_snapshot(roots.array[i].entry,
+				da_push_back_new(snap->roots));
+
+	free_root_entries(&roots);
+
 	for (size_t i = 0; i < snap->roots.num; i++)
 		sort_snapshot_entry(&snap->roots.array[i]);
 
@@ -33,6 +33,20 @@ EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
 EXPORT void profiler_free(void);
 
+/* ------------------------------------------------------------------------- */
+/* Profiler timeline
+ *
+ * Records every finished call with its start/end time and thread into a
+ * ring buffer of max_events entries; once the buffer is full the oldest
+ * events are overwritten.  The timeline can be started and stopped at any
+ * time and dumped as Chrome trace event JSON (chrome://tracing, Perfetto). */
+
+EXPORT void profiler_timeline_start(size_t max_events);
+EXPORT void profiler_timeline_stop(void);
+EXPORT bool profiler_timeline_active(void);
+
+EXPORT bool profiler_timeline_dump_json(const char *filename);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler name storage */
 
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "bmem.h"
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed-size lock-free single-producer/single-consumer byte ring.
+ *
+ * One thread may write and one thread may read at the same time without any
+ * locking.  The producer writes data with spscbuf_write and makes it visible
+ * to the consumer with spscbuf_commit, so multi-part records can be published
+ * atomically.  The consumer reads with spscbuf_peek/spscbuf_peek_spans and
+ * releases the space with spscbuf_pop.
+ *
+ * Positions run over [0, capacity*2) so that a full buffer can be told apart
+ * from an empty one without leaving any bytes unused; the offset into the
+ * data is the position modulo the capacity.  The capacity is exactly the size
+ * given on init, so alignment of records within the buffer is preserved.
+ */
+
+struct spscbuf {
+	uint8_t       *data;
+	size_t        capacity;
+
+	volatile long read_pos;
+	volatile long write_pos;
+};
+
+static inline void spscbuf_init(struct spscbuf *buf, size_t size)
+{
+	assert(size <= LONG_MAX / 2);
+
+	memset(buf, 0, sizeof(struct spscbuf));
+	buf->capacity = size;
+	buf->data     = bmalloc(size);
+}
+
+static inline void spscbuf_free(struct spscbuf *buf)
+{
+	bfree(buf->data);
+	memset(buf, 0, sizeof(struct spscbuf));
+}
+
+static inline size_t spscbuf_used(const struct spscbuf *buf,
+		size_t read_pos, size_t write_pos)
+{
+	return (write_pos >= read_pos) ?
+		(write_pos - read_pos) :
+		(buf->capacity * 2 - read_pos + write_pos);
+}
+
+/** Number of bytes available for reading (consumer side) */
+static inline size_t spscbuf_size(struct spscbuf *buf)
+{
+	size_t write_pos = (size_t)os_atomic_load_long(&buf->write_pos);
+	return spscbuf_used(buf, (size_t)buf->read_pos, write_pos);
+}
+
+/** Number of bytes available for writing (producer side) */
+static inline size_t spscbuf_space(struct spscbuf *buf)
+{
+	size_t read_pos = (size_t)os_atomic_load_long(&buf->read_pos);
+	return buf->capacity -
+		spscbuf_used(buf, read_pos, (size_t)buf->write_pos);
+}
+
+static inline size_t spscbuf_advance(const struct spscbuf *buf, size_t pos,
+		size_t size)
+{
+	pos += size;
+	return (pos >= buf->capacity * 2) ? (pos - buf->capacity * 2) : pos;
+}
+
+static inline size_t spscbuf_offset(const struct spscbuf *buf, size_t pos)
+{
+	return (pos >= buf->capacity) ? (pos - buf->capacity) : pos;
+}
+
+static inline void spscbuf_get_spans(struct spscbuf *buf, size_t pos,
+		size_t size, uint8_t **span1, size_t *size1,
+		uint8_t **span2, size_t *size2)
+{
+	size_t back_size;
+
+	pos       = spscbuf_offset(buf, pos);
+	back_size = buf->capacity - pos;
+
+	*span1 = buf->data + pos;
+	*size1 = (back_size < size) ? back_size : size;
+	*size2 = size - *size1;
+	*span2 = *size2 ? buf->data : NULL;
+}
+
+/**
+ * Gets uncommitted writable space at offset bytes past the current write
+ * position as (up to) two contiguous spans.  The caller must have checked
+ * spscbuf_space.
+ */
+static inline void spscbuf_write_spans(struct spscbuf *buf, size_t offset,
+		size_t size, uint8_t **span1, size_t *size1,
+		uint8_t **span2, size_t *size2)
+{
+	size_t pos = spscbuf_advance(buf, (size_t)buf->write_pos, offset);
+	spscbuf_get_spans(buf, pos, size, span1, size1, span2, size2);
+}
+
+static inline void spscbuf_write(struct spscbuf *buf, size_t offset,
+		const void *data, size_t size)
+{
+	uint8_t *span1, *span2;
+	size_t size1, size2;
+
+	spscbuf_write_spans(buf, offset, size, &span1, &size1, &span2, &size2);
+	memcpy(span1, data, size1);
+	if (size2)
+		memcpy(span2, (const uint8_t*)data + size1, size2);
+}
+
+/** Makes size bytes written past the write position visible to readers */
+static inline void spscbuf_commit(struct spscbuf *buf, size_t size)
+{
+	size_t pos = spscbuf_advance(buf, (size_t)buf->write_pos, size);
+	os_atomic_set_long(&buf->write_pos, (long)pos);
+}
+
+/** Gets readable data at offset bytes past the read position as spans */
+static inline void spscbuf_peek_spans(struct spscbuf *buf, size_t offset,
+		size_t size, uint8_t **span1, size_t *size1,
+		uint8_t **span2, size_t *size2)
+{
+	size_t pos = spscbuf_advance(buf, (size_t)buf->read_pos, offset);
+	spscbuf_get_spans(buf, pos, size, span1, size1, span2, size2);
+}
+
+static inline void spscbuf_peek(struct spscbuf *buf, size_t offset,
+		void *data, size_t size)
+{
+	uint8_t *span1, *span2;
+	size_t size1, size2;
+
+	spscbuf_peek_spans(buf, offset, size, &span1, &size1, &span2, &size2);
+	memcpy(data, span1, size1);
+	if (size2)
+		memcpy((uint8_t*)data + size1, span2, size2);
+}
+
+/** Releases size bytes at the read position back to the producer */
+static inline void spscbuf_pop(struct spscbuf *buf, size_t size)
+{
+	size_t pos = spscbuf_advance(buf, (size_t)buf->read_pos, size);
+	os_atomic_set_long(&buf->read_pos, (long)pos);
+}
+
+#ifdef __cplusplus
+}
+#endif
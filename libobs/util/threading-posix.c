@@ -261,6 +261,16 @@ bool os_atomic_compare_swap_long(volatile long *val, long old_val, long new_val)
 	return __sync_bool_compare_and_swap(val, old_val, new_val);
 }
 
+long os_atomic_load_long(volatile long *val)
+{
+	return __atomic_load_n(val, __ATOMIC_SEQ_CST);
+}
+
+void os_atomic_set_long(volatile long *val, long new_val)
+{
+	__atomic_store_n(val, new_val, __ATOMIC_SEQ_CST);
+}
+
 void os_set_thread_name(const char *name)
 {
 #if defined(__APPLE__)
@@ -181,6 +181,16 @@ bool os_atomic_compare_swap_long(volatile long *val, long old_val, long new_val)
 	return InterlockedCompareExchange(val, new_val, old_val) == old_val;
 }
 
+long os_atomic_load_long(volatile long *val)
+{
+	return InterlockedOr(val, 0);
+}
+
+void os_atomic_set_long(volatile long *val, long new_val)
+{
+	InterlockedExchange(val, new_val);
+}
+
 #define VC_EXCEPTION 0x406D1388
 
 #pragma pack(push,8)
@@ -76,6 +76,11 @@ EXPORT long os_atomic_dec_long(volatile long *val);
 EXPORT bool os_atomic_compare_swap_long(volatile long *val,
 		long old_val, long new_val);
 
+/* full barrier load/store, for publishing values between threads without a
+ * lock */
+EXPORT long os_atomic_load_long(volatile long *val);
+EXPORT void os_atomic_set_long(volatile long *val, long new_val);
+
 EXPORT void os_set_thread_name(const char *name);
 
 
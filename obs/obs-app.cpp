@@ -1428,6 +1428,9 @@ int main(int argc, char *argv[])
 	for (int i = 1; i < argc; i++) {
 		if (arg_is(argv[i], "--portable", "-p")) {
 			portable_mode = true;
+
+		} else if (arg_is(argv[i], "--mem-pool", nullptr)) {
+			base_use_pooled_allocator();
 		}
 	}
 
@@ -712,6 +712,7 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_string(basicConfig, "Video", "ColorSpace", "601");
 	config_set_default_string(basicConfig, "Video", "ColorRange",
 			"Partial");
+	config_set_default_bool  (basicConfig, "Video", "ParallelTick", false);
 
 	config_set_default_uint  (basicConfig, "Audio", "SampleRate", 44100);
 	config_set_default_string(basicConfig, "Audio", "ChannelSetup",
@@ -2165,6 +2166,10 @@ int OBSBasic::ResetVideo()
 		ResizePreview(ovi.base_width, ovi.base_height);
 	}
 
+	if (ret == OBS_VIDEO_SUCCESS)
+		obs_set_parallel_tick(config_get_bool(basicConfig, "Video",
+					"ParallelTick"));
+
 	return ret;
 }
 
@@ -0,0 +1,328 @@
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/darray.h>
+#include <sys/stat.h>
+
+#include "image-cache.h"
+
+enum image_state {
+	IMAGE_DECODING,
+	IMAGE_DECODED,
+	IMAGE_UPLOADED,
+	IMAGE_FAILED
+};
+
+struct image_cache_entry {
+	char                     *file;
+	int64_t                  mtime;
+	long                     refs;
+
+	enum image_state         state;
+	uint8_t                  *data;
+	enum gs_color_format     format;
+	uint32_t                 cx;
+	uint32_t                 cy;
+	size_t                   size;
+	gs_texture_t             *tex;
+
+	struct image_cache_entry *next;
+	struct image_cache_entry **prev_next;
+};
+
+struct image_cache {
+	pthread_mutex_t          mutex;
+	struct image_cache_entry *first;
+
+	DARRAY(struct image_cache_entry*) queue;
+	pthread_t                thread;
+	os_sem_t                 *sem;
+	bool                     thread_active;
+	bool                     stop;
+
+	size_t                   texture_bytes;
+	size_t                   pending_bytes;
+	size_t                   num_textures;
+};
+
+static struct image_cache cache = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER
+};
+
+static int64_t get_modified_time(const char *file)
+{
+	struct stat stats;
+	if (stat(file, &stats) != 0)
+		return -1;
+	return (int64_t)stats.st_mtime;
+}
+
+static inline void log_usage_locked(const char *action, const char *file)
+{
+	blog(LOG_DEBUG, "[image_source] %s '%s', image cache holds "
+	                "%.1f MB in %u texture(s), %.1f MB waiting for upload",
+	                action, file,
+	                (double)cache.texture_bytes / (1024.0 * 1024.0),
+	                (unsigned)cache.num_textures,
+	                (double)cache.pending_bytes / (1024.0 * 1024.0));
+}
+
+static void decode_entry(struct image_cache_entry *entry)
+{
+	enum gs_color_format format = GS_BGRA;
+	uint32_t             cx     = 0;
+	uint32_t             cy     = 0;
+	uint8_t              *data  = NULL;
+	bool                 wanted;
+
+	/* skip the decode if every source let go while it was queued */
+	pthread_mutex_lock(&cache.mutex);
+	wanted = entry->refs > 1;
+	pthread_mutex_unlock(&cache.mutex);
+
+	if (wanted)
+		data = gs_create_texture_file_data(entry->file, &format,
+				&cx, &cy);
+
+	pthread_mutex_lock(&cache.mutex);
+	if (data) {
+		entry->data   = data;
+		entry->format = format;
+		entry->cx     = cx;
+		entry->cy     = cy;
+		entry->size   = (size_t)cx * cy * 4;
+		entry->state  = IMAGE_DECODED;
+		cache.pending_bytes += entry->size;
+	} else {
+		entry->state  = IMAGE_FAILED;
+		if (wanted)
+			blog(LOG_WARNING, "[image_source] failed to load "
+			                  "texture '%s'", entry->file);
+	}
+	pthread_mutex_unlock(&cache.mutex);
+}
+
+static void *image_cache_thread(void *unused)
+{
+	os_set_thread_name("image-source: decode thread");
+
+	while (os_sem_wait(cache.sem) == 0) {
+		struct image_cache_entry *entry = NULL;
+
+		pthread_mutex_lock(&cache.mutex);
+		if (cache.stop) {
+			pthread_mutex_unlock(&cache.mutex);
+			break;
+		}
+		if (cache.queue.num) {
+			entry = cache.queue.array[0];
+			da_erase(cache.queue, 0);
+		}
+		pthread_mutex_unlock(&cache.mutex);
+
+		if (entry) {
+			decode_entry(entry);
+			image_cache_release(entry);
+		}
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+/* call with the cache mutex held */
+static bool start_thread_locked(void)
+{
+	if (cache.thread_active)
+		return true;
+
+	if (!cache.sem && os_sem_init(&cache.sem, 0) != 0) {
+		cache.sem = NULL;
+		return false;
+	}
+
+	cache.stop = false;
+	cache.thread_active = pthread_create(&cache.thread, NULL,
+			image_cache_thread, NULL) == 0;
+	return cache.thread_active;
+}
+
+struct image_cache_entry *image_cache_acquire(const char *file)
+{
+	struct image_cache_entry *entry;
+	int64_t                  mtime;
+
+	if (!file || !*file)
+		return NULL;
+
+	mtime = get_modified_time(file);
+
+	pthread_mutex_lock(&cache.mutex);
+
+	for (entry = cache.first; entry; entry = entry->next) {
+		if (entry->mtime == mtime && strcmp(entry->file, file) == 0) {
+			entry->refs++;
+			pthread_mutex_unlock(&cache.mutex);
+			return entry;
+		}
+	}
+
+	entry            = bzalloc(sizeof(struct image_cache_entry));
+	entry->file      = bstrdup(file);
+	entry->mtime     = mtime;
+	entry->refs      = 1;
+	entry->state     = IMAGE_DECODING;
+
+	entry->next      = cache.first;
+	entry->prev_next = &cache.first;
+	if (cache.first)
+		cache.first->prev_next = &entry->next;
+	cache.first = entry;
+
+	/* the decoder holds a reference until it's done */
+	entry->refs++;
+
+	if (start_thread_locked()) {
+		da_push_back(cache.queue, &entry);
+		pthread_mutex_unlock(&cache.mutex);
+		os_sem_post(cache.sem);
+		return entry;
+	}
+
+	pthread_mutex_unlock(&cache.mutex);
+
+	blog(LOG_WARNING, "[image_source] failed to start the decode thread, "
+	                  "loading '%s' synchronously", file);
+	decode_entry(entry);
+	image_cache_release(entry);
+	return entry;
+}
+
+void image_cache_release(struct image_cache_entry *entry)
+{
+	if (!entry)
+		return;
+
+	pthread_mutex_lock(&cache.mutex);
+
+	if (--entry->refs > 0) {
+		pthread_mutex_unlock(&cache.mutex);
+		return;
+	}
+
+	*entry->prev_next = entry->next;
+	if (entry->next)
+		entry->next->prev_next = entry->prev_next;
+
+	if (entry->state == IMAGE_DECODED)
+		cache.pending_bytes -= entry->size;
+	if (entry->tex) {
+		cache.texture_bytes -= entry->size;
+		cache.num_textures--;
+	}
+
+	log_usage_locked("released", entry->file);
+	pthread_mutex_unlock(&cache.mutex);
+
+	if (entry->tex) {
+		obs_enter_graphics();
+		gs_texture_destroy(entry->tex);
+		obs_leave_graphics();
+	}
+
+	bfree(entry->data);
+	bfree(entry->file);
+	bfree(entry);
+}
+
+gs_texture_t *image_cache_get_texture(struct image_cache_entry *entry)
+{
+	gs_texture_t *tex;
+	uint8_t      *data;
+
+	if (!entry)
+		return NULL;
+
+	pthread_mutex_lock(&cache.mutex);
+
+	if (entry->state != IMAGE_DECODED) {
+		tex = entry->tex;
+		pthread_mutex_unlock(&cache.mutex);
+		return tex;
+	}
+
+	data = entry->data;
+	entry->data  = NULL;
+	entry->state = IMAGE_UPLOADED;
+	cache.pending_bytes -= entry->size;
+	pthread_mutex_unlock(&cache.mutex);
+
+	tex = gs_texture_create(entry->cx, entry->cy, entry->format, 1,
+			(const uint8_t**)&data, 0);
+	bfree(data);
+
+	pthread_mutex_lock(&cache.mutex);
+	entry->tex = tex;
+	if (tex) {
+		cache.texture_bytes += entry->size;
+		cache.num_textures++;
+		log_usage_locked("loaded", entry->file);
+	} else {
+		entry->state = IMAGE_FAILED;
+	}
+	pthread_mutex_unlock(&cache.mutex);
+
+	return tex;
+}
+
+bool image_cache_get_size(struct image_cache_entry *entry,
+		uint32_t *cx, uint32_t *cy)
+{
+	bool success;
+
+	if (!entry)
+		return false;
+
+	pthread_mutex_lock(&cache.mutex);
+	success = entry->state == IMAGE_DECODED ||
+	          entry->state == IMAGE_UPLOADED;
+	*cx = entry->cx;
+	*cy = entry->cy;
+	pthread_mutex_unlock(&cache.mutex);
+
+	return success;
+}
+
+size_t image_cache_get_bytes(void)
+{
+	size_t bytes;
+
+	pthread_mutex_lock(&cache.mutex);
+	bytes = cache.texture_bytes + cache.pending_bytes;
+	pthread_mutex_unlock(&cache.mutex);
+
+	return bytes;
+}
+
+void image_cache_free(void)
+{
+	pthread_mutex_lock(&cache.mutex);
+	cache.stop = true;
+	pthread_mutex_unlock(&cache.mutex);
+
+	if (cache.thread_active) {
+		os_sem_post(cache.sem);
+		pthread_join(cache.thread, NULL);
+		cache.thread_active = false;
+	}
+
+	/* drop the references the decode thread never got to */
+	while (cache.queue.num) {
+		struct image_cache_entry *entry = cache.queue.array[0];
+		da_erase(cache.queue, 0);
+		image_cache_release(entry);
+	}
+
+	da_free(cache.queue);
+	os_sem_destroy(cache.sem);
+	cache.sem = NULL;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <obs-module.h>
+
+/*
+ * Process-wide cache of image textures, keyed by file path and modification
+ * time and shared by reference between image sources.  Files are decoded on
+ * a background thread; the texture is uploaded the first time it's requested
+ * from the graphics thread after decoding has finished.
+ */
+
+struct image_cache_entry;
+
+/** Gets a reference to the image for a file, queueing it for decoding if it
+ * isn't already cached */
+extern struct image_cache_entry *image_cache_acquire(const char *file);
+extern void image_cache_release(struct image_cache_entry *entry);
+
+/** Returns the texture, or NULL if still decoding (or failed).  Must be
+ * called from within the graphics context */
+extern gs_texture_t *image_cache_get_texture(struct image_cache_entry *entry);
+
+/** Returns false if the image hasn't been decoded yet */
+extern bool image_cache_get_size(struct image_cache_entry *entry,
+		uint32_t *cx, uint32_t *cy);
+
+/** Bytes held by the cache: uploaded textures plus decoded images that are
+ * waiting to be uploaded */
+extern size_t image_cache_get_bytes(void);
+
+extern void image_cache_free(void);
@@ -1,4 +1,7 @@
 #include <obs-module.h>
+#include <util/threading.h>
+
+#include "image-cache.h"
 
 #define blog(log_level, format, ...) \
 	blog(log_level, "[image_source: '%s'] " format, \
@@ -17,9 +20,10 @@ struct image_source {
 	char         *file;
 	bool         persistent;
 
-	gs_texture_t *tex;
-	uint32_t     cx;
-	uint32_t     cy;
+	/* swapped with both the graphics context and image_mutex held, so
+	 * the size can be read without entering graphics */
+	pthread_mutex_t          image_mutex;
+	struct image_cache_entry *image;
 };
 
 static const char *image_source_get_name(void *unused)
@@ -28,42 +32,36 @@ static const char *image_source_get_name(void *unused)
 	return obs_module_text("ImageInput");
 }
 
-static void image_source_load(struct image_source *context)
+/* swaps the image under the graphics lock so a render in progress never sees
+ * it released, the decoding itself happens on the image cache thread */
+static void image_source_set_image(struct image_source *context,
+		struct image_cache_entry *image)
 {
-	char *file = context->file;
+	struct image_cache_entry *prev;
 
 	obs_enter_graphics();
+	pthread_mutex_lock(&context->image_mutex);
+	prev = context->image;
+	context->image = image;
+	pthread_mutex_unlock(&context->image_mutex);
+	obs_leave_graphics();
 
-	if (context->tex)
-		gs_texture_destroy(context->tex);
-	context->tex = NULL;
+	image_cache_release(prev);
+}
 
-	if (file && *file) {
-		debug("loading texture '%s'", file);
+static void image_source_load(struct image_source *context)
+{
+	char *file = context->file;
 
-		context->tex = gs_texture_create_from_file(file);
-		if (context->tex) {
-			context->cx = gs_texture_get_width(context->tex);
-			context->cy = gs_texture_get_height(context->tex);
-		} else {
-			warn("failed to load texture '%s'", file);
-			context->cx = 0;
-			context->cy = 0;
-		}
-	}
+	if (file && *file)
+		debug("loading texture '%s'", file);
 
-	obs_leave_graphics();
+	image_source_set_image(context, image_cache_acquire(file));
 }
 
 static void image_source_unload(struct image_source *context)
 {
-	obs_enter_graphics();
-
-	if (context->tex)
-		gs_texture_destroy(context->tex);
-	context->tex = NULL;
-
-	obs_leave_graphics();
+	image_source_set_image(context, NULL);
 }
 
 static void image_source_update(void *data, obs_data_t *settings)
@@ -110,6 +108,11 @@ static void *image_source_create(obs_data_t *settings, obs_source_t *source)
 	struct image_source *context = bzalloc(sizeof(struct image_source));
 	context->source = source;
 
+	if (pthread_mutex_init(&context->image_mutex, NULL) != 0) {
+		bfree(context);
+		return NULL;
+	}
+
 	image_source_update(context, settings);
 	return context;
 }
@@ -119,35 +122,53 @@ static void image_source_destroy(void *data)
 	struct image_source *context = data;
 
 	image_source_unload(context);
+	pthread_mutex_destroy(&context->image_mutex);
 
 	if (context->file)
 		bfree(context->file);
 	bfree(context);
 }
 
+static void image_source_get_size(struct image_source *context,
+		uint32_t *cx, uint32_t *cy)
+{
+	*cx = 0;
+	*cy = 0;
+
+	pthread_mutex_lock(&context->image_mutex);
+	image_cache_get_size(context->image, cx, cy);
+	pthread_mutex_unlock(&context->image_mutex);
+}
+
 static uint32_t image_source_getwidth(void *data)
 {
-	struct image_source *context = data;
-	return context->cx;
+	uint32_t cx, cy;
+
+	image_source_get_size(data, &cx, &cy);
+	return cx;
 }
 
 static uint32_t image_source_getheight(void *data)
 {
-	struct image_source *context = data;
-	return context->cy;
+	uint32_t cx, cy;
+
+	image_source_get_size(data, &cx, &cy);
+	return cy;
 }
 
 static void image_source_render(void *data, gs_effect_t *effect)
 {
 	struct image_source *context = data;
+	gs_texture_t *tex = image_cache_get_texture(context->image);
 
-	if (!context->tex)
+	if (!tex)
 		return;
 
 	gs_reset_blend_state();
 	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
-			context->tex);
-	gs_draw_sprite(context->tex, 0, context->cx, context->cy);
+			tex);
+	gs_draw_sprite(tex, 0, gs_texture_get_width(tex),
+			gs_texture_get_height(tex));
 }
 
 static const char *image_filter =
@@ -198,3 +219,8 @@ bool obs_module_load(void)
 	obs_register_source(&image_source_info);
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	image_cache_free();
+}
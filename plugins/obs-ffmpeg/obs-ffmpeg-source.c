@@ -41,8 +41,6 @@ struct ffmpeg_source {
 	int sws_width;
 	int sws_height;
 	enum AVPixelFormat sws_format;
-	uint8_t *sws_data;
-	int sws_linesize;
 	obs_source_t *source;
 	bool is_forcing_scale;
 	bool is_hw_decoding;
@@ -123,17 +121,6 @@ bool update_sws_context(struct ffmpeg_source *s, AVFrame *frame)
 
 		}
 
-		if (s->sws_data != NULL)
-			bfree(s->sws_data);
-		s->sws_data = bzalloc(frame->width * frame->height * 4);
-		if (s->sws_data == NULL) {
-			FF_BLOG(LOG_ERROR, "unable to allocate sws "
-					"pixel data with size %d",
-					frame->width * frame->height * 4);
-			goto fail;
-		}
-
-		s->sws_linesize = frame->width * 4;
 		s->sws_width = frame->width;
 		s->sws_height = frame->height;
 		s->sws_format = frame->format;
@@ -146,11 +133,6 @@ fail:
 		sws_freeContext(s->sws_ctx);
 	s->sws_ctx = NULL;
 
-	if (s->sws_data)
-		bfree(s->sws_data);
-	s->sws_data = NULL;
-
-	s->sws_linesize = 0;
 	s->sws_width = 0;
 	s->sws_height = 0;
 	s->sws_format = 0;
@@ -161,24 +143,33 @@ fail:
 static bool video_frame_scale(struct ff_frame *frame,
 		struct ffmpeg_source *s, struct obs_source_frame *obs_frame)
 {
+	struct obs_source_frame *out;
+	int linesize[MAX_AV_PLANES] = {0};
+
 	if (!update_sws_context(s, frame->frame))
 		return false;
 
+	/* scale straight into a frame from the source's frame pool */
+	out = obs_source_acquire_frame(s->source, VIDEO_FORMAT_BGRA,
+			obs_frame->width, obs_frame->height);
+	if (!out)
+		return false;
+
+	linesize[0] = (int)out->linesize[0];
+
 	sws_scale(
 		s->sws_ctx,
 		(uint8_t const *const *)frame->frame->data,
 		frame->frame->linesize,
 		0,
 		frame->frame->height,
-		&s->sws_data,
-		&s->sws_linesize
+		out->data,
+		linesize
 	);
 
-	obs_frame->data[0]     = s->sws_data;
-	obs_frame->linesize[0] = s->sws_linesize;
-	obs_frame->format      = VIDEO_FORMAT_BGRA;
+	out->timestamp = obs_frame->timestamp;
 
-	obs_source_output_video(s->source, obs_frame);
+	obs_source_output_acquired_frame(s->source, out);
 
 	return true;
 }
@@ -542,8 +533,6 @@ static void ffmpeg_source_destroy(void *data)
 
 	if (s->sws_ctx != NULL)
 		sws_freeContext(s->sws_ctx);
-	if (s->sws_data != NULL)
-		bfree(s->sws_data);
 
 	bfree(s);
 }
@@ -177,68 +177,61 @@ bool flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 static int32_t last_time = 0;
 #endif
 
-static void flv_video(struct serializer *s, struct encoder_packet *packet,
-		bool is_header)
+void flv_packet_tag(struct encoder_packet *packet, bool is_header,
+		struct flv_tag *tag)
 {
-	int64_t offset  = packet->pts - packet->dts;
 	int32_t time_ms = get_ms_time(packet, packet->dts);
 
-	if (!packet->data || !packet->size)
-		return;
-
-	s_w8(s, RTMP_PACKET_TYPE_VIDEO);
-
-#ifdef DEBUG_TIMESTAMPS
-	blog(LOG_DEBUG, "Video: %lu", time_ms);
-
-	if (last_time > time_ms)
-		blog(LOG_DEBUG, "Non-monotonic");
-
-	last_time = time_ms;
-#endif
-
-	s_wb24(s, (uint32_t)packet->size + 5);
-	s_wb24(s, time_ms);
-	s_w8(s, (time_ms >> 24) & 0x7F);
-	s_wb24(s, 0);
-
-	/* these are the 5 extra bytes mentioned above */
-	s_w8(s, packet->keyframe ? 0x17 : 0x27);
-	s_w8(s, is_header ? 0 : 1);
-	s_wb24(s, get_ms_time(packet, offset));
-	s_write(s, packet->data, packet->size);
-
-	/* write tag size (starting byte doesnt count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) + 4 - 1);
+	/* the upper timestamp byte is stored as 7 bits in the tag */
+	tag->timestamp = (uint32_t)time_ms & 0x7FFFFFFF;
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		uint32_t offset = get_ms_time(packet,
+				packet->pts - packet->dts);
+
+		tag->type        = RTMP_PACKET_TYPE_VIDEO;
+		tag->prefix[0]   = packet->keyframe ? 0x17 : 0x27;
+		tag->prefix[1]   = is_header ? 0 : 1;
+		tag->prefix[2]   = (offset >> 16) & 0xFF;
+		tag->prefix[3]   = (offset >> 8) & 0xFF;
+		tag->prefix[4]   = offset & 0xFF;
+		tag->prefix_size = 5;
+	} else {
+		tag->type        = RTMP_PACKET_TYPE_AUDIO;
+		tag->prefix[0]   = 0xaf;
+		tag->prefix[1]   = is_header ? 0 : 1;
+		tag->prefix_size = 2;
+	}
 }
 
-static void flv_audio(struct serializer *s, struct encoder_packet *packet,
+static void flv_packet(struct serializer *s, struct encoder_packet *packet,
 		bool is_header)
 {
-	int32_t time_ms = get_ms_time(packet, packet->dts);
+	struct flv_tag tag;
 
 	if (!packet->data || !packet->size)
 		return;
 
-	s_w8(s, RTMP_PACKET_TYPE_AUDIO);
+	flv_packet_tag(packet, is_header, &tag);
 
 #ifdef DEBUG_TIMESTAMPS
-	blog(LOG_DEBUG, "Audio: %lu", time_ms);
+	blog(LOG_DEBUG, "%s: %lu",
+			packet->type == OBS_ENCODER_VIDEO ? "Video" : "Audio",
+			tag.timestamp);
 
-	if (last_time > time_ms)
+	if (last_time > (int32_t)tag.timestamp)
 		blog(LOG_DEBUG, "Non-monotonic");
 
-	last_time = time_ms;
+	last_time = (int32_t)tag.timestamp;
 #endif
 
-	s_wb24(s, (uint32_t)packet->size + 2);
-	s_wb24(s, time_ms);
-	s_w8(s, (time_ms >> 24) & 0x7F);
+	s_w8(s, tag.type);
+	s_wb24(s, (uint32_t)(packet->size + tag.prefix_size));
+	s_wb24(s, tag.timestamp);
+	s_w8(s, (tag.timestamp >> 24) & 0x7F);
 	s_wb24(s, 0);
 
-	/* these are the two extra bytes mentioned above */
-	s_w8(s, 0xaf);
-	s_w8(s, is_header ? 0 : 1);
+	s_write(s, tag.prefix, tag.prefix_size);
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesnt count) */
@@ -253,10 +246,7 @@ void flv_packet_mux(struct encoder_packet *packet,
 
 	array_output_serializer_init(&s, &data);
 
-	if (packet->type == OBS_ENCODER_VIDEO)
-		flv_video(&s, packet, is_header);
-	else
-		flv_audio(&s, packet, is_header);
+	flv_packet(&s, packet, is_header);
 
 	*output = data.bytes.array;
 	*size   = data.bytes.num;
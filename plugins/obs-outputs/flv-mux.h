@@ -26,9 +26,19 @@ static uint32_t get_ms_time(struct encoder_packet *packet, int64_t val)
 	return (uint32_t)(val * MILLISECOND_DEN / packet->timebase_den);
 }
 
+/* FLV tag fields of a packet, excluding the payload */
+struct flv_tag {
+	uint8_t  type;
+	uint32_t timestamp;
+	uint8_t  prefix[5];
+	size_t   prefix_size;
+};
+
 extern void write_file_info(FILE *file, int64_t duration_ms, int64_t size);
 
 extern bool flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 		bool write_header, size_t audio_idx);
 extern void flv_packet_mux(struct encoder_packet *packet,
 		uint8_t **output, size_t *size, bool is_header);
+extern void flv_packet_tag(struct encoder_packet *packet, bool is_header,
+		struct flv_tag *tag);
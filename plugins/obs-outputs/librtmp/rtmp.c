@@ -1434,6 +1434,110 @@ WriteN(RTMP *r, const char *buffer, int n)
     return n == 0;
 }
 
+#ifdef _WIN32
+typedef WSABUF RTMPIov;
+#define IOV_BASE(v) ((v).buf)
+#define IOV_LEN(v)  ((v).len)
+#else
+typedef struct iovec RTMPIov;
+#define IOV_BASE(v) ((v).iov_base)
+#define IOV_LEN(v)  ((v).iov_len)
+#endif
+
+#define RTMP_MAX_IOV 64
+
+static int
+CanWriteV(RTMP *r)
+{
+    if (r->Link.protocol & RTMP_FEATURE_HTTP)
+        return FALSE;
+    if (r->m_bCustomSend && r->m_customSendFunc)
+        return FALSE;
+#ifdef CRYPTO
+    if (r->Link.rc4keyOut || r->m_sb.sb_ssl)
+        return FALSE;
+#endif
+    return TRUE;
+}
+
+/* writes a list of buffers with a single gathering send where possible,
+ * otherwise coalesces them and falls back to WriteN */
+static int
+WriteV(RTMP *r, RTMPIov *iov, int count, int n)
+{
+    if (!CanWriteV(r))
+    {
+        char *buf = malloc(n), *ptr = buf;
+        int i, wrote;
+
+        if (!buf)
+            return FALSE;
+
+        for (i = 0; i < count; i++)
+        {
+            memcpy(ptr, IOV_BASE(iov[i]), IOV_LEN(iov[i]));
+            ptr += IOV_LEN(iov[i]);
+        }
+
+        r->m_nBytesCopied += n;
+        wrote = WriteN(r, buf, n);
+        free(buf);
+        return wrote;
+    }
+
+#if defined(RTMP_NETSTACK_DUMP)
+    {
+        int i;
+        for (i = 0; i < count; i++)
+            fwrite(IOV_BASE(iov[i]), 1, IOV_LEN(iov[i]), netstackdump);
+    }
+#endif
+
+    while (count > 0)
+    {
+#ifdef _WIN32
+        DWORD nBytes = 0;
+        int ret = WSASend(r->m_sb.sb_socket, iov, (DWORD)count, &nBytes, 0,
+                          NULL, NULL);
+        if (ret == SOCKET_ERROR)
+#else
+        ssize_t nBytes = writev(r->m_sb.sb_socket, iov, count);
+        if (nBytes < 0)
+#endif
+        {
+            int sockerr = GetSockError();
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d (%d bytes)", __FUNCTION__,
+                     sockerr, n);
+
+            if (sockerr == EINTR && !RTMP_ctrlC)
+                continue;
+
+            RTMP_Close(r);
+            return FALSE;
+        }
+
+        if (nBytes == 0)
+            return FALSE;
+
+        n -= (int)nBytes;
+
+        /* skip what was written, resuming within a partially sent buffer */
+        while (count > 0 && (size_t)nBytes >= (size_t)IOV_LEN(*iov))
+        {
+            nBytes -= IOV_LEN(*iov);
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            IOV_BASE(*iov) = (char *)IOV_BASE(*iov) + nBytes;
+            IOV_LEN(*iov) -= nBytes;
+        }
+    }
+
+    return TRUE;
+}
+
 #define SAVC(x)	static const AVal av_##x = AVC(#x)
 
 SAVC(app);
@@ -3905,18 +4009,19 @@ RTMP_SendChunk(RTMP *r, RTMPChunk *chunk)
     return wrote;
 }
 
-int
-RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+/* Encodes the chunk basic header and message header of a packet so that the
+ * header ends at hend, compressing it against the previous packet on the same
+ * channel.  Returns the header size, or 0 on failure. */
+static int
+EncodePacketHeader(RTMP *r, RTMPPacket *packet, char *hend, char **header_out,
+                   char *basic_out, int *cSize_out)
 {
     const RTMPPacket *prevPacket;
     uint32_t last = 0;
     int nSize;
     int hSize, cSize;
-    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    char *header, *hptr, c;
     uint32_t t;
-    char *buffer, *tbuf = NULL, *toff = NULL;
-    int nChunkSize;
-    int tlen;
 
     if (packet->m_nChannel >= r->m_channelsAllocatedOut)
     {
@@ -3927,7 +4032,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
             free(r->m_vecChannelsOut);
             r->m_vecChannelsOut = NULL;
             r->m_channelsAllocatedOut = 0;
-            return FALSE;
+            return 0;
         }
         r->m_vecChannelsOut = packets;
         memset(r->m_vecChannelsOut + r->m_channelsAllocatedOut, 0, sizeof(RTMPPacket*) * (n - r->m_channelsAllocatedOut));
@@ -3953,7 +4058,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     {
         RTMP_Log(RTMP_LOGERROR, "sanity failed!! trying to send header of type: 0x%02x.",
                  (unsigned char)packet->m_headerType);
-        return FALSE;
+        return 0;
     }
 
     nSize = packetSize[packet->m_headerType];
@@ -3961,16 +4066,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     cSize = 0;
     t = packet->m_nTimeStamp - last;
 
-    if (packet->m_body)
-    {
-        header = packet->m_body - nSize;
-        hend = packet->m_body;
-    }
-    else
-    {
-        header = hbuf + 6;
-        hend = hbuf + sizeof(hbuf);
-    }
+    header = hend - nSize;
 
     if (packet->m_nChannel > 319)
         cSize = 2;
@@ -4027,6 +4123,31 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     if (nSize > 1 && t >= 0xffffff)
         hptr = AMF_EncodeInt32(hptr, hend, t);
 
+    *header_out = header;
+    *basic_out = c;
+    *cSize_out = cSize;
+    return hSize;
+}
+
+int
+RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+{
+    int nSize;
+    int hSize, cSize;
+    char *header, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    char *buffer, *tbuf = NULL, *toff = NULL;
+    int nChunkSize;
+    int tlen;
+
+    if (packet->m_body)
+        hend = packet->m_body;
+    else
+        hend = hbuf + sizeof(hbuf);
+
+    hSize = EncodePacketHeader(r, packet, hend, &header, &c, &cSize);
+    if (!hSize)
+        return FALSE;
+
     nSize = packet->m_nBodySize;
     buffer = packet->m_body;
     nChunkSize = r->m_outChunkSize;
@@ -4058,6 +4179,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         if (tbuf)
         {
             memcpy(toff, header, nChunkSize + hSize);
+            r->m_nBytesCopied += nChunkSize;
             toff += nChunkSize + hSize;
         }
         else
@@ -4122,6 +4244,99 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     return TRUE;
 }
 
+static int
+AddIov(RTMP *r, RTMPIov *iov, int *count, int *bytes, const char *data,
+       int len)
+{
+    if (*count == RTMP_MAX_IOV)
+    {
+        if (!WriteV(r, iov, *count, *bytes))
+            return FALSE;
+        *count = 0;
+        *bytes = 0;
+    }
+
+    IOV_BASE(iov[*count]) = (char *)data;
+    IOV_LEN(iov[*count]) = len;
+    (*count)++;
+    *bytes += len;
+    return TRUE;
+}
+
+int
+RTMP_SendPacketV(RTMP *r, RTMPPacket *packet, const AVal *bufs, int count)
+{
+    RTMPIov iov[RTMP_MAX_IOV];
+    int iovCount = 0, iovBytes = 0;
+    char hbuf[RTMP_MAX_HEADER_SIZE], chdr[3];
+    char *header, c;
+    int hSize, cSize;
+    int nSize = 0, nChunkSize = r->m_outChunkSize;
+    int i = 0, offset = 0;
+
+    for (i = 0; i < count; i++)
+        nSize += bufs[i].av_len;
+
+    packet->m_body = NULL;
+    packet->m_nBodySize = nSize;
+
+    hSize = EncodePacketHeader(r, packet, hbuf + sizeof(hbuf), &header, &c,
+                               &cSize);
+    if (!hSize)
+        return FALSE;
+
+    /* header of the continuation chunks */
+    chdr[0] = (0xc0 | c);
+    if (cSize)
+    {
+        int tmp = packet->m_nChannel - 64;
+        chdr[1] = tmp & 0xff;
+        if (cSize == 2)
+            chdr[2] = tmp >> 8;
+    }
+
+    if (!AddIov(r, iov, &iovCount, &iovBytes, header, hSize))
+        return FALSE;
+
+    i = 0;
+    while (nSize > 0)
+    {
+        int chunk = nSize < nChunkSize ? nSize : nChunkSize;
+        nSize -= chunk;
+
+        while (chunk > 0)
+        {
+            int len = bufs[i].av_len - offset;
+            if (len > chunk)
+                len = chunk;
+
+            if (len > 0 && !AddIov(r, iov, &iovCount, &iovBytes,
+                                   bufs[i].av_val + offset, len))
+                return FALSE;
+
+            offset += len;
+            chunk -= len;
+            if (offset == bufs[i].av_len)
+            {
+                i++;
+                offset = 0;
+            }
+        }
+
+        if (nSize > 0 && !AddIov(r, iov, &iovCount, &iovBytes, chdr,
+                                 cSize + 1))
+            return FALSE;
+    }
+
+    if (iovCount && !WriteV(r, iov, iovCount, iovBytes))
+        return FALSE;
+
+    if (!r->m_vecChannelsOut[packet->m_nChannel])
+        r->m_vecChannelsOut[packet->m_nChannel] = malloc(sizeof(RTMPPacket));
+    memcpy(r->m_vecChannelsOut[packet->m_nChannel], packet, sizeof(RTMPPacket));
+    return TRUE;
+}
+
 int
 RTMP_Serve(RTMP *r)
 {
@@ -5204,6 +5419,7 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
         if (num > s2)
             num = s2;
         memcpy(enc, buf, num);
+        r->m_nBytesCopied += num;
         pkt->m_nBytesRead += num;
         s2 -= num;
         buf += num;
@@ -296,6 +296,8 @@ extern "C"
         void*   m_customSendParam;
         CUSTOMSEND m_customSendFunc;
 
+        uint64_t m_nBytesCopied;	/* payload bytes copied while sending */
+
         RTMP_BINDINFO m_bindIP;
 
         uint8_t m_bSendChunkSizeInfo;
@@ -414,6 +416,11 @@ extern "C"
     int RTMP_Read(RTMP *r, char *buf, int size);
     int RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx);
 
+    /* sends a packet whose body is the concatenation of bufs without copying
+     * it; packet->m_body is ignored and m_nBodySize is set from bufs */
+    int RTMP_SendPacketV(RTMP *r, RTMPPacket *packet, const AVal *bufs,
+                         int count);
+
     /* hashswf.c */
     int RTMP_HashSWF(const char *url, unsigned int *size, unsigned char *hash,
                      int age);
@@ -66,6 +66,8 @@ struct rtmp_stream {
 	int64_t          last_dts_usec;
 
 	uint64_t         total_bytes_sent;
+	uint64_t         total_bytes_copied;
+	uint64_t         total_packets_sent;
 	int              dropped_frames;
 
 	RTMP             rtmp;
@@ -90,7 +92,7 @@ static inline void free_packets(struct rtmp_stream *stream)
 	while (stream->packets.size) {
 		struct encoder_packet packet;
 		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
-		obs_free_encoder_packet(&packet);
+		obs_encoder_packet_release(&packet);
 	}
 }
 
@@ -118,12 +120,26 @@ static void rtmp_stream_destroy(void *data)
 	}
 }
 
+static void get_bytes_copied_proc(void *data, calldata_t *cd)
+{
+	struct rtmp_stream *stream = data;
+	calldata_set_int(cd, "bytes_copied",
+			(long long)stream->total_bytes_copied);
+	calldata_set_int(cd, "packets_sent",
+			(long long)stream->total_packets_sent);
+}
+
 static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 {
 	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
 	stream->output = output;
 	pthread_mutex_init_value(&stream->packets_mutex);
 
+	proc_handler_add(ph, "void get_bytes_copied(out int bytes_copied, "
+			"out int packets_sent)", get_bytes_copied_proc, stream);
+
 	RTMP_Init(&stream->rtmp);
 	RTMP_LogSetCallback(log_rtmp);
 	RTMP_LogSetLevel(RTMP_LOGWARNING);
@@ -193,23 +209,55 @@ static inline bool get_next_packet(struct rtmp_stream *stream,
 	return new_packet;
 }
 
+/* sends the FLV tag body prefix and the encoder payload as one RTMP message
+ * with scatter-gather I/O, without serializing the packet first */
 static int send_packet(struct rtmp_stream *stream,
 		struct encoder_packet *packet, bool is_header, size_t idx)
 {
-	uint8_t *data;
-	size_t  size;
-	int     ret = 0;
+	RTMP          *rtmp        = &stream->rtmp;
+	uint64_t      prev_copied  = rtmp->m_nBytesCopied;
+	RTMPPacket    rtmp_packet  = {0};
+	struct flv_tag tag;
+	AVal          bufs[2];
+	int           ret          = 0;
+
+	if (!packet->data || !packet->size) {
+		if (is_header)
+			bfree(packet->data);
+		else
+			obs_encoder_packet_release(packet);
+		return 0;
+	}
+
+	flv_packet_tag(packet, is_header, &tag);
+
+	rtmp_packet.m_nChannel    = 0x04; /* source channel */
+	rtmp_packet.m_nInfoField2 = rtmp->Link.streams[idx].id;
+	rtmp_packet.m_packetType  = tag.type;
+	rtmp_packet.m_nTimeStamp  = tag.timestamp;
+	rtmp_packet.m_headerType  = tag.timestamp ?
+		RTMP_PACKET_SIZE_MEDIUM : RTMP_PACKET_SIZE_LARGE;
+
+	bufs[0].av_val = (char*)tag.prefix;
+	bufs[0].av_len = (int)tag.prefix_size;
+	bufs[1].av_val = (char*)packet->data;
+	bufs[1].av_len = (int)packet->size;
 
-	flv_packet_mux(packet, &data, &size, is_header);
 #ifdef TEST_FRAMEDROPS
 	os_sleep_ms(rand() % 40);
 #endif
-	ret = RTMP_Write(&stream->rtmp, (char*)data, (int)size, (int)idx);
-	bfree(data);
+	if (!RTMP_SendPacketV(rtmp, &rtmp_packet, bufs, 2))
+		ret = -1;
 
-	obs_free_encoder_packet(packet);
+	/* counted as the size of the FLV tag, like the file output does */
+	stream->total_bytes_sent   += 11 + tag.prefix_size + packet->size + 4;
+	stream->total_bytes_copied += rtmp->m_nBytesCopied - prev_copied;
+	stream->total_packets_sent++;
 
-	stream->total_bytes_sent += size;
+	if (is_header)
+		bfree(packet->data);
+	else
+		obs_encoder_packet_release(packet);
 	return ret;
 }
 
@@ -254,6 +302,14 @@ static void *send_thread(void *data)
 	if (!disconnected && !send_remaining_packets(stream))
 		disconnected = true;
 
+	if (stream->total_packets_sent)
+		info("Sent %"PRIu64" packets, %"PRIu64" payload bytes copied "
+				"(%.1f per packet)",
+				stream->total_packets_sent,
+				stream->total_bytes_copied,
+				(double)stream->total_bytes_copied /
+				(double)stream->total_packets_sent);
+
 	if (disconnected) {
 		info("Disconnected from %s", stream->path.array);
 		free_packets(stream);
@@ -478,6 +534,8 @@ static bool rtmp_stream_start(void *data)
 		return false;
 
 	stream->total_bytes_sent = 0;
+	stream->total_bytes_copied = 0;
+	stream->total_packets_sent = 0;
 	stream->dropped_frames   = 0;
 	stream->min_drop_dts_usec= 0;
 	stream->min_priority     = 0;
@@ -536,7 +594,7 @@ static void drop_frames(struct rtmp_stream *stream)
 				drop_priority = packet.drop_priority;
 
 			num_frames_dropped++;
-			obs_free_encoder_packet(&packet);
+			obs_encoder_packet_release(&packet);
 		}
 	}
 
@@ -598,9 +656,9 @@ static void rtmp_stream_data(void *data, struct encoder_packet *packet)
 	bool                  added_packet;
 
 	if (packet->type == OBS_ENCODER_VIDEO)
-		obs_parse_avc_packet(&new_packet, packet);
+		obs_encoder_packet_parse_avc(&new_packet, packet);
 	else
-		obs_duplicate_encoder_packet(&new_packet, packet);
+		obs_encoder_packet_ref(&new_packet, packet);
 
 	pthread_mutex_lock(&stream->packets_mutex);
 
@@ -613,7 +671,7 @@ static void rtmp_stream_data(void *data, struct encoder_packet *packet)
 	if (added_packet)
 		os_sem_post(stream->send_sem);
 	else
-		obs_free_encoder_packet(&new_packet);
+		obs_encoder_packet_release(&new_packet);
 }
 
 static void rtmp_stream_defaults(obs_data_t *defaults)
@@ -0,0 +1,209 @@
+/******************************************************************************
+Copyright (C) 2014 by Nibbles
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "glyph-atlas.h"
+
+extern FT_Library ft2_lib;
+extern uint32_t texbuf_w, texbuf_h;
+
+/* protects the atlas list and ft2_lib, which FT_New_Face/FT_Done_Face use */
+static pthread_mutex_t atlas_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct glyph_atlas *first_atlas = NULL;
+
+static const wchar_t *standard_glyphs =
+	L"abcdefghijklmnopqrstuvwxyz"
+	L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
+	L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"";
+
+static void glyph_atlas_destroy(struct glyph_atlas *atlas)
+{
+	for (uint32_t i = 0; i < num_cache_slots; i++)
+		bfree(atlas->glyphs[i]);
+
+	if (atlas->tex) {
+		obs_enter_graphics();
+		gs_texture_destroy(atlas->tex);
+		obs_leave_graphics();
+	}
+
+	if (atlas->face)
+		FT_Done_Face(atlas->face);
+
+	pthread_mutex_destroy(&atlas->mutex);
+	bfree(atlas->texbuf);
+	bfree(atlas->path);
+	bfree(atlas);
+}
+
+struct glyph_atlas *glyph_atlas_acquire(const char *path, FT_Long index,
+		uint16_t size)
+{
+	struct glyph_atlas *atlas;
+
+	if (!path || !ft2_lib)
+		return NULL;
+
+	pthread_mutex_lock(&atlas_mutex);
+
+	for (atlas = first_atlas; atlas; atlas = atlas->next) {
+		if (atlas->index == index && atlas->size == size &&
+		    strcmp(atlas->path, path) == 0) {
+			atlas->refs++;
+			pthread_mutex_unlock(&atlas_mutex);
+			return atlas;
+		}
+	}
+
+	atlas = bzalloc(sizeof(struct glyph_atlas));
+	atlas->path  = bstrdup(path);
+	atlas->index = index;
+	atlas->size  = size;
+	atlas->refs  = 1;
+	pthread_mutex_init(&atlas->mutex, NULL);
+
+	if (FT_New_Face(ft2_lib, path, index, &atlas->face) != 0) {
+		pthread_mutex_unlock(&atlas_mutex);
+		atlas->face = NULL;
+		glyph_atlas_destroy(atlas);
+		return NULL;
+	}
+
+	FT_Set_Pixel_Sizes(atlas->face, 0, size);
+	FT_Select_Charmap(atlas->face, FT_ENCODING_UNICODE);
+
+	atlas->next      = first_atlas;
+	atlas->prev_next = &first_atlas;
+	if (first_atlas)
+		first_atlas->prev_next = &atlas->next;
+	first_atlas = atlas;
+
+	/* other sources can find the atlas from here on, keep it locked until
+	 * the standard glyphs are in */
+	glyph_atlas_lock(atlas);
+	pthread_mutex_unlock(&atlas_mutex);
+
+	atlas->texbuf = bzalloc(texbuf_w * texbuf_h * 4);
+	glyph_atlas_cache(atlas, standard_glyphs, wcslen(standard_glyphs));
+	glyph_atlas_unlock(atlas);
+
+	return atlas;
+}
+
+void glyph_atlas_release(struct glyph_atlas *atlas)
+{
+	if (!atlas)
+		return;
+
+	pthread_mutex_lock(&atlas_mutex);
+
+	if (--atlas->refs > 0) {
+		pthread_mutex_unlock(&atlas_mutex);
+		return;
+	}
+
+	*atlas->prev_next = atlas->next;
+	if (atlas->next)
+		atlas->next->prev_next = atlas->prev_next;
+
+	glyph_atlas_destroy(atlas);
+	pthread_mutex_unlock(&atlas_mutex);
+}
+
+#define glyph_pos x + (y*slot->bitmap.pitch)
+#define buf_pos (dx + x) + ((dy + y) * texbuf_w)
+
+void glyph_atlas_cache(struct glyph_atlas *atlas, const wchar_t *text,
+		size_t len)
+{
+	FT_GlyphSlot slot = atlas->face->glyph;
+	uint32_t dx = atlas->texbuf_x, dy = atlas->texbuf_y;
+	int32_t cached_glyphs = 0;
+	uint8_t alpha;
+
+	for (size_t i = 0; i < len && !atlas->full; i++) {
+		FT_UInt glyph_index = FT_Get_Char_Index(atlas->face, text[i]);
+		struct glyph_info *glyph;
+
+		if (glyph_index >= num_cache_slots ||
+		    atlas->glyphs[glyph_index] != NULL)
+			continue;
+
+		FT_Load_Glyph(atlas->face, glyph_index, FT_LOAD_DEFAULT);
+		FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL);
+
+		uint32_t g_w = slot->bitmap.width;
+		uint32_t g_h = slot->bitmap.rows;
+
+		if (atlas->max_h < g_h) atlas->max_h = g_h;
+
+		if (dx + g_w >= texbuf_w) {
+			dx = 0;
+			dy += atlas->max_h + 1;
+		}
+
+		if (dy + g_h >= texbuf_h) {
+			blog(LOG_WARNING, "FT2-text: Glyph atlas for %s (%u) "
+			                  "is full", atlas->path,
+			                  (unsigned)atlas->size);
+			atlas->full = true;
+			break;
+		}
+
+		glyph = bzalloc(sizeof(struct glyph_info));
+		glyph->u = (float)dx / (float)texbuf_w;
+		glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
+		glyph->v = (float)dy / (float)texbuf_h;
+		glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
+		glyph->w = g_w;
+		glyph->h = g_h;
+		glyph->yoff = slot->bitmap_top;
+		glyph->xoff = slot->bitmap_left;
+		glyph->xadv = slot->advance.x >> 6;
+		atlas->glyphs[glyph_index] = glyph;
+
+		for (uint32_t y = 0; y < g_h; y++) {
+			for (uint32_t x = 0; x < g_w; x++) {
+				alpha = slot->bitmap.buffer[glyph_pos];
+				atlas->texbuf[buf_pos] =
+					0x00FFFFFF ^ ((uint32_t)alpha << 24);
+			}
+		}
+
+		dx += (g_w + 1);
+		if (dx >= texbuf_w) {
+			dx = 0;
+			dy += atlas->max_h;
+		}
+
+		cached_glyphs++;
+	}
+
+	atlas->texbuf_x = dx;
+	atlas->texbuf_y = dy;
+
+	if (cached_glyphs > 0) {
+		gs_texture_t *tex;
+
+		obs_enter_graphics();
+		tex = atlas->tex;
+		atlas->tex = gs_texture_create(texbuf_w, texbuf_h, GS_RGBA, 1,
+				(const uint8_t **)&atlas->texbuf, 0);
+		if (tex)
+			gs_texture_destroy(tex);
+		obs_leave_graphics();
+	}
+}
@@ -0,0 +1,85 @@
+/******************************************************************************
+Copyright (C) 2014 by Nibbles
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs-module.h>
+#include <util/threading.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#define num_cache_slots 65535
+
+struct glyph_info {
+	float u, v, u2, v2;
+	int32_t w, h, xoff, yoff;
+	int32_t xadv;
+};
+
+/*
+ * Glyph atlas shared by every source using the same font file, face index
+ * and size.  The face, glyph cache and texture are only touched with the
+ * atlas locked, except for the texture pointer, which is only replaced
+ * within the graphics context and so can be read while rendering.
+ */
+struct glyph_atlas {
+	char               *path;
+	FT_Long            index;
+	uint16_t           size;
+	long               refs;
+
+	pthread_mutex_t    mutex;
+	FT_Face            face;
+	struct glyph_info  *glyphs[num_cache_slots];
+
+	uint32_t           *texbuf;
+	uint32_t           texbuf_x, texbuf_y;
+	uint32_t           max_h;
+	bool               full;
+	gs_texture_t       *tex;
+
+	struct glyph_atlas *next;
+	struct glyph_atlas **prev_next;
+};
+
+extern struct glyph_atlas *glyph_atlas_acquire(const char *path,
+		FT_Long index, uint16_t size);
+extern void glyph_atlas_release(struct glyph_atlas *atlas);
+
+/* call with the atlas locked; renders any glyphs of the text that aren't in
+ * the atlas yet and uploads the texture if anything was added */
+extern void glyph_atlas_cache(struct glyph_atlas *atlas, const wchar_t *text,
+		size_t len);
+
+static inline void glyph_atlas_lock(struct glyph_atlas *atlas)
+{
+	pthread_mutex_lock(&atlas->mutex);
+}
+
+static inline void glyph_atlas_unlock(struct glyph_atlas *atlas)
+{
+	pthread_mutex_unlock(&atlas->mutex);
+}
+
+/* call with the atlas locked */
+static inline struct glyph_info *glyph_atlas_get(struct glyph_atlas *atlas,
+		wchar_t ch)
+{
+	FT_UInt glyph_index = FT_Get_Char_Index(atlas->face, ch);
+	return glyph_index < num_cache_slots ?
+		atlas->glyphs[glyph_index] : NULL;
+}
@@ -19,7 +19,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <util/platform.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include <sys/stat.h>
 #include "text-freetype2.h"
 #include "obs-convenience.h"
 #include "find-font.h"
@@ -142,17 +141,11 @@ static void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
-	
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	os_file_watch_remove(srcdata->watch);
+	srcdata->watch = NULL;
+
+	glyph_atlas_release(srcdata->atlas);
+	srcdata->atlas = NULL;
 
 	if (srcdata->font_name != NULL)
 		bfree(srcdata->font_name);
@@ -160,19 +153,20 @@ static void ft2_source_destroy(void *data)
 		bfree(srcdata->font_style);
 	if (srcdata->text != NULL)
 		bfree(srcdata->text);
-	if (srcdata->texbuf != NULL)
-		bfree(srcdata->texbuf);
 	if (srcdata->colorbuf != NULL)
 		bfree(srcdata->colorbuf);
 	if (srcdata->text_file != NULL)
 		bfree(srcdata->text_file);
 
+	bfree(srcdata->file_text);
+	dstr_free(&srcdata->log_tail);
+	pthread_mutex_destroy(&srcdata->file_mutex);
+
+	da_free(srcdata->layout_text);
+	da_free(srcdata->lines);
+
 	obs_enter_graphics();
 
-	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
-		srcdata->tex = NULL;
-	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
@@ -192,14 +186,15 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	struct ft2_source *srcdata = data;
 	if (srcdata == NULL) return;
 
-	if (srcdata->tex == NULL || srcdata->vbuf == NULL) return;
+	if (srcdata->atlas == NULL || srcdata->atlas->tex == NULL ||
+	    srcdata->vbuf == NULL || srcdata->num_glyphs == 0) return;
 
 	gs_reset_blend_state();
 	if (srcdata->outline_text) draw_outlines(srcdata);
 	if (srcdata->drop_shadow) draw_drop_shadow(srcdata);
 
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
-		srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6);
+	draw_uv_vbuffer(srcdata->vbuf, srcdata->atlas->tex,
+		srcdata->draw_effect, srcdata->num_glyphs * 6);
 
 	UNUSED_PARAMETER(effect);
 }
@@ -207,40 +202,76 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 static void ft2_video_tick(void *data, float seconds)
 {
 	struct ft2_source *srcdata = data;
+	wchar_t *file_text;
 	if (srcdata == NULL) return;
-	if (!srcdata->from_file || !srcdata->text_file) return;
 
-	if (os_gettime_ns() - srcdata->last_checked >= 1000000000) {
-		time_t t = get_modified_timestamp(srcdata->text_file);
-		srcdata->last_checked = os_gettime_ns();
+	pthread_mutex_lock(&srcdata->file_mutex);
+	file_text = srcdata->file_text;
+	srcdata->file_text = NULL;
+	pthread_mutex_unlock(&srcdata->file_mutex);
 
-		if (srcdata->m_timestamp != t) {
-			if (srcdata->log_mode)
-				read_from_end(srcdata, srcdata->text_file);
-			else
-				load_text_from_file(srcdata,
-					srcdata->text_file);
-			set_up_vertex_buffer(srcdata);
-		}
+	if (file_text) {
+		bfree(srcdata->text);
+		srcdata->text = file_text;
+		set_up_vertex_buffer(srcdata);
+
+	/* another source sharing the atlas cached a taller glyph */
+	} else if (layout_outdated(srcdata)) {
+		set_up_vertex_buffer(srcdata);
 	}
 
 	UNUSED_PARAMETER(seconds);
 }
 
+/* called on the file watcher thread, which is the only thread reading the
+ * file while the watch exists */
+static void ft2_file_changed(void *data)
+{
+	struct ft2_source *srcdata = data;
+	wchar_t *text;
+
+	if (srcdata->log_mode)
+		text = read_new_lines(srcdata, srcdata->text_file);
+	else
+		text = load_text_from_file(srcdata, srcdata->text_file);
+	if (!text)
+		return;
+
+	pthread_mutex_lock(&srcdata->file_mutex);
+	bfree(srcdata->file_text);
+	srcdata->file_text = text;
+	pthread_mutex_unlock(&srcdata->file_mutex);
+}
+
+static void discard_file_text(struct ft2_source *srcdata)
+{
+	pthread_mutex_lock(&srcdata->file_mutex);
+	bfree(srcdata->file_text);
+	srcdata->file_text = NULL;
+	pthread_mutex_unlock(&srcdata->file_mutex);
+}
+
 static bool init_font(struct ft2_source *srcdata)
 {
+	struct glyph_atlas *atlas, *prev;
 	FT_Long index;
 	const char *path = get_font_path(srcdata->font_name, srcdata->font_size,
 			srcdata->font_style, srcdata->font_flags, &index);
 	if (!path)
 		return false;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
+	atlas = glyph_atlas_acquire(path, index, srcdata->font_size);
+	if (!atlas)
+		return false;
+
+	obs_enter_graphics();
+	prev = srcdata->atlas;
+	srcdata->atlas = atlas;
+	srcdata->layout_dirty = true;
+	obs_leave_graphics();
 
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	glyph_atlas_release(prev);
+	return true;
 }
 
 static void ft2_source_update(void *data, obs_data_t *settings)
@@ -294,6 +325,12 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	bool from_file = obs_data_get_bool(settings, "from_file");
 	bool chat_log_mode = obs_data_get_bool(settings, "log_mode");
 
+	/* the watch callback uses the file settings below */
+	os_file_watch_remove(srcdata->watch);
+	srcdata->watch = NULL;
+
+	if (chat_log_mode != srcdata->log_mode)
+		vbuf_needs_update = true;
 	srcdata->log_mode = chat_log_mode;
 
 	if (ft2_lib == NULL) goto error;
@@ -321,6 +358,9 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	    srcdata->from_file != from_file)
 		vbuf_needs_update = true;
 
+	if (vbuf_needs_update)
+		srcdata->layout_dirty = true;
+
 	srcdata->file_load_failed = false;
 	srcdata->from_file = from_file;
 
@@ -335,7 +375,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 		bfree(srcdata->font_style);
 		srcdata->font_name = NULL;
 		srcdata->font_style = NULL;
-		srcdata->max_h = 0;
 	}
 
 	srcdata->font_name  = bstrdup(font_name);
@@ -343,24 +382,11 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	srcdata->font_size  = font_size;
 	srcdata->font_flags = font_flags;
 
-	if (!init_font(srcdata) || srcdata->font_face == NULL) {
+	if (!init_font(srcdata)) {
 		blog(LOG_WARNING, "FT2-text: Failed to load font %s",
 			srcdata->font_name);
 		goto error;
 	}
-	else {
-		FT_Set_Pixel_Sizes(srcdata->font_face, 0, srcdata->font_size); 
-		FT_Select_Charmap(srcdata->font_face, FT_ENCODING_UNICODE);
-	}
-
-	if (srcdata->texbuf != NULL) {
-		bfree(srcdata->texbuf);
-		srcdata->texbuf = NULL;
-	}
-	srcdata->texbuf = bzalloc(texbuf_w * texbuf_h * 4);
-
-	if (srcdata->font_face)
-		cache_standard_glyphs(srcdata);
 
 skip_font_load:
 	if (from_file) {
@@ -369,6 +395,14 @@ skip_font_load:
 		if (!tmp || !*tmp || !os_file_exists(tmp)) {
 			const char *emptystr = " ";
 
+			/* keep watching the path, the text is loaded as soon
+			 * as the file is created */
+			bfree(srcdata->text_file);
+			srcdata->text_file = tmp && *tmp ? bstrdup(tmp) : NULL;
+			srcdata->log_offset = 0;
+			dstr_free(&srcdata->log_tail);
+			discard_file_text(srcdata);
+
 			bfree(srcdata->text);
 			srcdata->text = NULL;
 
@@ -378,25 +412,34 @@ skip_font_load:
 			                  "reading", tmp);
 		}
 		else {
+			wchar_t *text;
+
 			if (srcdata->text_file != NULL &&
 				strcmp(srcdata->text_file, tmp) == 0 &&
 				!vbuf_needs_update)
 				goto error;
 
 			bfree(srcdata->text_file);
+			discard_file_text(srcdata);
 
 			srcdata->text_file = bstrdup(tmp);
 			if (chat_log_mode)
-				read_from_end(srcdata, tmp);
+				text = read_from_end(srcdata, tmp);
 			else
-				load_text_from_file(srcdata, tmp);
-			srcdata->last_checked = os_gettime_ns();
+				text = load_text_from_file(srcdata, tmp);
+
+			if (text) {
+				bfree(srcdata->text);
+				srcdata->text = text;
+			}
 		}
 	}
 	else {
 		const char *tmp = obs_data_get_string(settings, "text");
 		if (!tmp || !*tmp) goto error;
 
+		discard_file_text(srcdata);
+
 		if (srcdata->text != NULL) {
 			bfree(srcdata->text);
 			srcdata->text = NULL;
@@ -405,12 +448,14 @@ skip_font_load:
 		os_utf8_to_wcs_ptr(tmp, strlen(tmp), &srcdata->text);
 	}
 
-	if (srcdata->font_face) {
-		cache_glyphs(srcdata, srcdata->text);
+	if (srcdata->atlas)
 		set_up_vertex_buffer(srcdata);
-	}
 
 error:
+	if (srcdata->from_file && srcdata->text_file)
+		srcdata->watch = os_file_watch_add(srcdata->text_file,
+				ft2_file_changed, srcdata);
+
 	obs_data_release(font_obj);
 }
 
@@ -428,6 +473,8 @@ static void *ft2_source_create(obs_data_t *settings, obs_source_t *source)
 	obs_data_t *font_obj = obs_data_create();
 	srcdata->src = source;
 
+	pthread_mutex_init(&srcdata->file_mutex, NULL);
+
 	srcdata->font_size = 32;
 
 	obs_data_set_default_string(font_obj, "face", DEFAULT_FACE);
@@ -16,15 +16,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
 #include <obs-module.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <util/file-watcher.h>
 #include <ft2build.h>
-
-#define num_cache_slots 65535
-#define src_glyph srcdata->cacheglyphs[glyph_index]
-
-struct glyph_info {
-	float u, v, u2, v2;
-	int32_t w, h, xoff, yoff;
-	int32_t xadv;
+#include "glyph-atlas.h"
+
+/* layout state at the start of a line of the source text */
+struct ft2_line {
+	size_t   pos;
+	uint32_t glyph;
+	uint32_t dy;
+	uint32_t max_x;
+	uint32_t max_y;
 };
 
 struct ft2_source {
@@ -37,24 +42,33 @@ struct ft2_source {
 	bool from_file;
 	char *text_file;
 	wchar_t *text;
-	time_t m_timestamp;
-	uint64_t last_checked;
 
-	uint32_t cx, cy, max_h, custom_width;
-	uint32_t texbuf_x, texbuf_y;
+	/* the file is read on the file watcher thread, the new text is picked
+	 * up on the next tick */
+	os_file_watch_t *watch;
+	pthread_mutex_t file_mutex;
+	wchar_t *file_text;
+	uint64_t log_offset;
+	struct dstr log_tail;
+
+	uint32_t cx, cy, custom_width;
 	uint32_t color[2];
 	uint32_t *colorbuf;
 
 	int32_t cur_scroll, scroll_speed;
 
-	gs_texture_t *tex;
-
-	struct glyph_info *cacheglyphs[num_cache_slots];
+	struct glyph_atlas *atlas;
 
-	FT_Face	font_face;
-
-	uint32_t *texbuf;
 	gs_vertbuffer_t *vbuf;
+	uint32_t vbuf_glyphs;
+	uint32_t num_glyphs;
+
+	/* what the vertex buffer was last laid out from, so that updates only
+	 * lay out again from the first line that changed */
+	DARRAY(wchar_t) layout_text;
+	DARRAY(struct ft2_line) lines;
+	uint32_t layout_max_h;
+	bool layout_dirty;
 
 	gs_effect_t *draw_effect;
 	bool outline_text, drop_shadow;
@@ -81,14 +95,11 @@ static obs_properties_t *ft2_source_properties(void *unused);
 
 static const char *ft2_source_get_name(void *unused);
 
-uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata);
-
-time_t get_modified_timestamp(char *filename);
-void load_text_from_file(struct ft2_source *srcdata, const char *filename);
-void read_from_end(struct ft2_source *srcdata, const char *filename);
+#define log_lines 6
 
-void cache_standard_glyphs(struct ft2_source *srcdata);
-void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs);
+wchar_t *load_text_from_file(struct ft2_source *srcdata, const char *filename);
+wchar_t *read_from_end(struct ft2_source *srcdata, const char *filename);
+wchar_t *read_new_lines(struct ft2_source *srcdata, const char *filename);
 
 void set_up_vertex_buffer(struct ft2_source *srcdata);
-void fill_vertex_buffer(struct ft2_source *srcdata);
+bool layout_outdated(struct ft2_source *srcdata);
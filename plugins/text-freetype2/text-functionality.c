@@ -17,16 +17,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/profiler.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include <sys/stat.h>
 #include "text-freetype2.h"
 #include "obs-convenience.h"
 
 float offsets[16] = { -2.0f, 0.0f, 0.0f, -2.0f, 2.0f, 0.0f, 2.0f, 0.0f,
 	0.0f, 2.0f, 0.0f, 2.0f, -2.0f, 0.0f, -2.0f, 0.0f };
 
-extern uint32_t texbuf_w, texbuf_h;
+static const char *layout_name = "ft2_source_layout";
+static const char *cache_glyphs_name = "ft2_cache_glyphs";
 
 void draw_outlines(struct ft2_source *srcdata)
 {
@@ -35,7 +36,7 @@ void draw_outlines(struct ft2_source *srcdata)
 
 	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
 
-	if (!srcdata->text)
+	if (!srcdata->num_glyphs)
 		return;
 
 	tmp = vdata->colors;
@@ -45,9 +46,8 @@ void draw_outlines(struct ft2_source *srcdata)
 	for (int32_t i = 0; i < 8; i++) {
 		gs_matrix_translate3f(offsets[i * 2], offsets[(i * 2) + 1],
 			0.0f);
-		draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
-			srcdata->draw_effect,
-			(uint32_t)wcslen(srcdata->text) * 6);
+		draw_uv_vbuffer(srcdata->vbuf, srcdata->atlas->tex,
+			srcdata->draw_effect, srcdata->num_glyphs * 6);
 	}
 	gs_matrix_identity();
 	gs_matrix_pop();
@@ -62,7 +62,7 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
 
-	if (!srcdata->text)
+	if (!srcdata->num_glyphs)
 		return;
 
 	tmp = vdata->colors;
@@ -70,261 +70,238 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	gs_matrix_push();
 	gs_matrix_translate3f(4.0f, 4.0f, 0.0f);
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
-		srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6);
+	draw_uv_vbuffer(srcdata->vbuf, srcdata->atlas->tex,
+		srcdata->draw_effect, srcdata->num_glyphs * 6);
 	gs_matrix_identity();
 	gs_matrix_pop();
 
 	vdata->colors = tmp;
 }
 
-void set_up_vertex_buffer(struct ft2_source *srcdata)
+/* call within the graphics context; returns false if the buffer had to be
+ * recreated, in which case everything has to be laid out again */
+static bool reserve_vertex_buffer(struct ft2_source *srcdata, size_t len)
 {
-	FT_UInt glyph_index = 0;
-	uint32_t x = 0, space_pos = 0, word_width = 0;
-	size_t len;
+	uint32_t glyphs;
 
-	if (!srcdata->text)
-		return;
+	if (srcdata->vbuf && len <= srcdata->vbuf_glyphs)
+		return true;
 
-	if (srcdata->custom_width >= 100)
-		srcdata->cx = srcdata->custom_width;
-	else
-		srcdata->cx = get_ft2_text_width(srcdata->text, srcdata);
-	srcdata->cy = srcdata->max_h;
+	glyphs = len < 64 ? 64 : (uint32_t)(len + len / 2);
 
-	obs_enter_graphics();
-	if (srcdata->vbuf != NULL) {
-		gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
-		srcdata->vbuf = NULL;
-		gs_vertexbuffer_destroy(tmpvbuf);
-	}
-	srcdata->vbuf = create_uv_vbuffer((uint32_t)wcslen(srcdata->text) * 6,
-			true);
+	if (srcdata->vbuf)
+		gs_vertexbuffer_destroy(srcdata->vbuf);
+	srcdata->vbuf = create_uv_vbuffer(glyphs * 6, true);
+	srcdata->vbuf_glyphs = srcdata->vbuf ? glyphs : 0;
 
-	if (srcdata->custom_width <= 100) goto skip_word_wrap;
-	if (!srcdata->word_wrap) goto skip_word_wrap;
+	bfree(srcdata->colorbuf);
+	srcdata->colorbuf = bmalloc(sizeof(uint32_t) * glyphs * 6);
+	for (size_t i = 0; i < glyphs * 6; i++)
+		srcdata->colorbuf[i] = 0xFF000000;
 
-	len = wcslen(srcdata->text);
+	return false;
+}
 
-	for (uint32_t i = 0; i <= len; i++) {
-		if (i == wcslen(srcdata->text)) goto eos_check;
+/* finds the last line that starts before the first changed character,
+ * returns false if the text is the same as last time */
+static bool find_changed_line(struct ft2_source *srcdata, size_t len,
+		size_t *line)
+{
+	const wchar_t *old_text = srcdata->layout_text.array;
+	size_t old_len = srcdata->layout_text.num;
+	size_t same = 0;
+	size_t idx = srcdata->lines.num;
 
-		if (srcdata->text[i] != L' ' && srcdata->text[i] != L'\n')
-			goto next_char;
+	while (same < len && same < old_len &&
+	       srcdata->text[same] == old_text[same])
+		same++;
 
-	eos_check:;
-		if (x + word_width > srcdata->custom_width) {
-			if (space_pos != 0)
-				srcdata->text[space_pos] = L'\n';
-			x = 0;
-		}
-		if (i == wcslen(srcdata->text)) goto eos_skip;
-
-		x += word_width;
-		word_width = 0;
-		if (srcdata->text[i] == L'\n')
-			x = 0;
-		if (srcdata->text[i] == L' ')
-			space_pos = i;
-	next_char:;
-		glyph_index = FT_Get_Char_Index(srcdata->font_face,
-			srcdata->text[i]);
-		word_width += src_glyph->xadv;
-	eos_skip:;
+	if (same == len && same == old_len)
+		return false;
+
+	while (idx > 1 && srcdata->lines.array[idx - 1].pos > same)
+		idx--;
+
+	*line = idx - 1;
+	return true;
+}
+
+static inline uint32_t get_word_width(struct glyph_atlas *atlas,
+		const wchar_t *text, size_t i, size_t len)
+{
+	uint32_t w = 0;
+
+	for (; i < len && text[i] != L' ' && text[i] != L'\n'; i++) {
+		struct glyph_info *glyph = glyph_atlas_get(atlas, text[i]);
+		if (glyph)
+			w += glyph->xadv;
 	}
 
-skip_word_wrap:;
-	fill_vertex_buffer(srcdata);
-	obs_leave_graphics();
+	return w;
 }
 
-void fill_vertex_buffer(struct ft2_source *srcdata)
+#define line_spacing 4
+
+/* call with the atlas locked and within the graphics context */
+static void fill_vertex_buffer(struct ft2_source *srcdata, size_t line_idx,
+		size_t len)
 {
+	struct glyph_atlas *atlas = srcdata->atlas;
 	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
-	if (vdata == NULL || !srcdata->text) return;
-
 	struct vec2 *tvarray = (struct vec2 *)vdata->tvarray[0].array;
 	uint32_t *col = (uint32_t *)vdata->colors;
+	const wchar_t *text = srcdata->text;
+	uint32_t max_h = atlas->max_h;
+	bool wrap = srcdata->custom_width >= 100;
+	bool word_wrap = srcdata->custom_width > 100 && srcdata->word_wrap;
 
-	FT_UInt glyph_index = 0;
+	struct ft2_line line = srcdata->lines.array[line_idx];
+	uint32_t dx = 0, dy = line.dy;
+	uint32_t max_x = line.max_x, max_y = line.max_y;
+	uint32_t cur_glyph = line.glyph;
 
-	uint32_t dx = 0, dy = srcdata->max_h, max_y = dy;
-	uint32_t cur_glyph = 0;
-	size_t len = wcslen(srcdata->text);
+	da_resize(srcdata->lines, line_idx + 1);
 
-	if (srcdata->colorbuf != NULL) {
-		bfree(srcdata->colorbuf);
-		srcdata->colorbuf = NULL;
-	}
-	srcdata->colorbuf = bzalloc(sizeof(uint32_t)*wcslen(srcdata->text) * 6);
-	for (size_t i = 0; i < len * 6; i++) {
-		srcdata->colorbuf[i] = 0xFF000000;
-	}
+	for (size_t i = line.pos; i < len; i++) {
+		struct glyph_info *glyph;
+		wchar_t ch = text[i];
 
-	for (size_t i = 0; i < len; i++) {
-	add_linebreak:;
-		if (srcdata->text[i] != L'\n') goto draw_glyph;
-		dx = 0; i++;
-		dy += srcdata->max_h + 4;
-		if (i == wcslen(srcdata->text)) goto skip_glyph;
-		if (srcdata->text[i] == L'\n') goto add_linebreak;
-	draw_glyph:;
-		// Skip filthy dual byte Windows line breaks
-		if (srcdata->text[i] == L'\r') goto skip_glyph;
+		if (ch == L'\n') {
+			struct ft2_line *next;
+
+			dx = 0;
+			dy += max_h + line_spacing;
+
+			next = da_push_back_new(srcdata->lines);
+			next->pos   = i + 1;
+			next->glyph = cur_glyph;
+			next->dy    = dy;
+			next->max_x = max_x;
+			next->max_y = max_y;
+			continue;
+		}
 
-		glyph_index = FT_Get_Char_Index(srcdata->font_face,
-			srcdata->text[i]);
-		if (src_glyph == NULL)
-			goto skip_glyph;
+		// Skip filthy dual byte Windows line breaks
+		if (ch == L'\r')
+			continue;
 
-		if (srcdata->custom_width < 100) goto skip_custom_width;
+		glyph = glyph_atlas_get(atlas, ch);
+		if (!glyph)
+			continue;
 
-		if (dx + src_glyph->xadv > srcdata->custom_width) {
+		if (word_wrap && dx > 0 && ch != L' ' && text[i - 1] == L' ' &&
+		    dx + get_word_width(atlas, text, i, len) >
+		    srcdata->custom_width) {
 			dx = 0;
-			dy += srcdata->max_h + 4;
+			dy += max_h + line_spacing;
 		}
 
-	skip_custom_width:;
+		if (wrap && dx + glyph->xadv > srcdata->custom_width) {
+			/* don't start a word wrapped line with a space */
+			if (word_wrap && ch == L' ')
+				continue;
+
+			dx = 0;
+			dy += max_h + line_spacing;
+		}
 
 		set_v3_rect(vdata->points + (cur_glyph * 6),
-			(float)dx + (float)src_glyph->xoff,
-			(float)dy - (float)src_glyph->yoff,
-			(float)src_glyph->w,
-			(float)src_glyph->h);
+			(float)dx + (float)glyph->xoff,
+			(float)dy - (float)glyph->yoff,
+			(float)glyph->w,
+			(float)glyph->h);
 		set_v2_uv(tvarray + (cur_glyph * 6),
-			src_glyph->u,
-			src_glyph->v,
-			src_glyph->u2,
-			src_glyph->v2);
+			glyph->u,
+			glyph->v,
+			glyph->u2,
+			glyph->v2);
 		set_rect_colors2(col + (cur_glyph * 6),
 			srcdata->color[0],
 			srcdata->color[1]);
-		dx += src_glyph->xadv;
-		if (dy - (float)src_glyph->yoff + src_glyph->h > max_y)
-			max_y = dy - src_glyph->yoff + src_glyph->h;
+
+		dx += glyph->xadv;
+		if (dx > max_x)
+			max_x = dx;
+		if ((int64_t)dy - glyph->yoff + glyph->h > (int64_t)max_y)
+			max_y = dy - glyph->yoff + glyph->h;
 		cur_glyph++;
-	skip_glyph:;
 	}
 
+	srcdata->num_glyphs = cur_glyph;
+	srcdata->cx = wrap ? srcdata->custom_width : max_x;
 	srcdata->cy = max_y;
 }
 
-void cache_standard_glyphs(struct ft2_source *srcdata)
-{
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
-
-	srcdata->texbuf_x = 0;
-	srcdata->texbuf_y = 0;
-
-	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz" \
-		L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890" \
-		L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
-}
-
-#define glyph_pos x + (y*slot->bitmap.pitch)
-#define buf_pos (dx + x) + ((dy + y) * texbuf_w)
-
-void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
+void set_up_vertex_buffer(struct ft2_source *srcdata)
 {
-	FT_GlyphSlot slot;
-	FT_UInt glyph_index = 0;
+	struct glyph_atlas *atlas = srcdata->atlas;
+	size_t line = 0;
+	size_t len;
 
-	if (!srcdata->font_face || !cache_glyphs)
+	if (!srcdata->text || !atlas)
 		return;
 
-	slot = srcdata->font_face->glyph;
+	profile_start(layout_name);
 
-	uint32_t dx = srcdata->texbuf_x, dy = srcdata->texbuf_y;
-	uint8_t alpha;
+	len = wcslen(srcdata->text);
 
-	int32_t cached_glyphs = 0;
-	size_t len = wcslen(cache_glyphs);
+	glyph_atlas_lock(atlas);
 
-	for (size_t i = 0; i < len; i++) {
-		glyph_index = FT_Get_Char_Index(srcdata->font_face,
-			cache_glyphs[i]);
+	profile_start(cache_glyphs_name);
+	glyph_atlas_cache(atlas, srcdata->text, len);
+	profile_end(cache_glyphs_name);
 
-		if (src_glyph != NULL)
-			goto skip_glyph;
+	/* the line height is shared with every other source using the atlas
+	 * and grows when any of them caches a taller glyph */
+	if (atlas->max_h != srcdata->layout_max_h)
+		srcdata->layout_dirty = true;
 
-		FT_Load_Glyph(srcdata->font_face, glyph_index, FT_LOAD_DEFAULT);
-		FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL);
+	obs_enter_graphics();
 
-		uint32_t g_w = slot->bitmap.width;
-		uint32_t g_h = slot->bitmap.rows;
+	if (!reserve_vertex_buffer(srcdata, len))
+		srcdata->layout_dirty = true;
+	if (!srcdata->vbuf)
+		goto fail;
 
-		if (srcdata->max_h < g_h) srcdata->max_h = g_h;
+	if (srcdata->layout_dirty || !srcdata->lines.num) {
+		struct ft2_line *first;
 
-		if (dx + g_w >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h + 1;
-		}
+		da_resize(srcdata->lines, 0);
+		first = da_push_back_new(srcdata->lines);
+		first->dy    = atlas->max_h;
+		first->max_y = atlas->max_h;
 
-		src_glyph = bzalloc(sizeof(struct glyph_info));
-		src_glyph->u = (float)dx / (float)texbuf_w;
-		src_glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
-		src_glyph->v = (float)dy / (float)texbuf_h;
-		src_glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
-		src_glyph->w = g_w;
-		src_glyph->h = g_h;
-		src_glyph->yoff = slot->bitmap_top;
-		src_glyph->xoff = slot->bitmap_left;
-		src_glyph->xadv = slot->advance.x >> 6;
-
-		for (uint32_t y = 0; y < g_h; y++) {
-			for (uint32_t x = 0; x < g_w; x++) {
-				alpha = slot->bitmap.buffer[glyph_pos];
-				srcdata->texbuf[buf_pos] =
-					0x00FFFFFF ^ ((uint32_t)alpha << 24);
-			}
-		}
-
-		dx += (g_w + 1);
-		if (dx >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h;
-		}
-
-		cached_glyphs++;
-	skip_glyph:;
+	} else if (!find_changed_line(srcdata, len, &line)) {
+		goto fail;
 	}
 
-	srcdata->texbuf_x = dx;
-	srcdata->texbuf_y = dy;
-
-	if (cached_glyphs > 0) {
+	fill_vertex_buffer(srcdata, line, len);
 
-		obs_enter_graphics();
+	da_resize(srcdata->layout_text, len);
+	memcpy(srcdata->layout_text.array, srcdata->text,
+			len * sizeof(wchar_t));
+	srcdata->layout_max_h = atlas->max_h;
+	srcdata->layout_dirty = false;
 
-		if (srcdata->tex != NULL) {
-			gs_texture_t *tmp_texture = NULL;
-			tmp_texture = srcdata->tex;
-			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
-		}
-
-		srcdata->tex = gs_texture_create(texbuf_w, texbuf_h,
-			GS_RGBA, 1, (const uint8_t **)&srcdata->texbuf, 0);
+fail:
+	obs_leave_graphics();
+	glyph_atlas_unlock(atlas);
 
-		obs_leave_graphics();
-	}
+	profile_end(layout_name);
 }
 
-time_t get_modified_timestamp(char *filename)
+bool layout_outdated(struct ft2_source *srcdata)
 {
-	struct stat stats;
+	bool outdated;
+
+	if (!srcdata->atlas)
+		return false;
 
-	// stat is apparently terrifying and horrible, but we only call it once
-	// every second at most.
-	stat(filename, &stats);
+	glyph_atlas_lock(srcdata->atlas);
+	outdated = srcdata->atlas->max_h != srcdata->layout_max_h;
+	glyph_atlas_unlock(srcdata->atlas);
 
-	return stats.st_mtime;
+	return outdated;
 }
 
 static void remove_cr(wchar_t* source)
@@ -338,13 +315,57 @@ static void remove_cr(wchar_t* source)
 	source[j] = '\0';
 }
 
-void load_text_from_file(struct ft2_source *srcdata, const char *filename)
+/* length of the utf-8 string without a partly written last character */
+static size_t utf8_complete_len(const char *str, size_t len)
+{
+	size_t start = len;
+	size_t needed;
+	uint8_t lead;
+
+	while (start > 0 && len - start < 4 &&
+	       ((uint8_t)str[start - 1] & 0xC0) == 0x80)
+		start--;
+	if (start == 0)
+		return len;
+
+	lead = (uint8_t)str[--start];
+	needed = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+	return len - start < needed ? start : len;
+}
+
+/* keeps the text after the last log_lines line breaks */
+static void trim_log_tail(struct dstr *tail)
+{
+	uint32_t line_breaks = 0;
+
+	for (size_t i = tail->len; i > 0; i--) {
+		if (tail->array[i - 1] == '\n' && ++line_breaks > log_lines) {
+			dstr_remove(tail, 0, i);
+			return;
+		}
+	}
+}
+
+static wchar_t *utf8_to_text(const char *str)
+{
+	wchar_t *text = NULL;
+
+	os_utf8_to_wcs_ptr(str, strlen(str), &text);
+	if (!text)
+		text = bzalloc(sizeof(wchar_t));
+
+	remove_cr(text);
+	return text;
+}
+
+wchar_t *load_text_from_file(struct ft2_source *srcdata, const char *filename)
 {
 	FILE *tmp_file = NULL;
 	uint32_t filesize = 0;
 	char *tmp_read = NULL;
 	uint16_t header = 0;
 	size_t bytes_read;
+	wchar_t *text;
 
 	tmp_file = fopen(filename, "rb");
 	if (tmp_file == NULL) {
@@ -352,8 +373,10 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 			blog(LOG_WARNING, "Failed to open file %s", filename);
 			srcdata->file_load_failed = true;
 		}
-		return;
+		return NULL;
 	}
+	srcdata->file_load_failed = false;
+
 	fseek(tmp_file, 0, SEEK_END);
 	filesize = (uint32_t)ftell(tmp_file);
 	fseek(tmp_file, 0, SEEK_SET);
@@ -361,41 +384,25 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 
 	if (bytes_read == 2 && header == 0xFEFF) {
 		// File is already in UTF-16 format
-		if (srcdata->text != NULL) {
-			bfree(srcdata->text);
-			srcdata->text = NULL;
-		}
-		srcdata->text = bzalloc(filesize);
-		bytes_read = fread(srcdata->text, filesize - 2, 1, tmp_file);
-
-		srcdata->m_timestamp =
-			get_modified_timestamp(srcdata->text_file);
-		bfree(tmp_read);
+		text = bzalloc(filesize);
+		bytes_read = fread(text, filesize - 2, 1, tmp_file);
 		fclose(tmp_file);
 
-		return;
+		return text;
 	}
 
 	fseek(tmp_file, 0, SEEK_SET);
-	srcdata->m_timestamp = get_modified_timestamp(srcdata->text_file);
 
 	tmp_read = bzalloc(filesize + 1);
 	bytes_read = fread(tmp_read, filesize, 1, tmp_file);
 	fclose(tmp_file);
 
-	if (srcdata->text != NULL) {
-		bfree(srcdata->text);
-		srcdata->text = NULL;
-	}
-	srcdata->text = bzalloc((strlen(tmp_read) + 1)*sizeof(wchar_t));
-	os_utf8_to_wcs(tmp_read, strlen(tmp_read),
-		srcdata->text, (strlen(tmp_read) + 1));
-
-	remove_cr(srcdata->text);
+	text = utf8_to_text(tmp_read);
 	bfree(tmp_read);
+	return text;
 }
 
-void read_from_end(struct ft2_source *srcdata, const char *filename)
+wchar_t *read_from_end(struct ft2_source *srcdata, const char *filename)
 {
 	FILE *tmp_file = NULL;
 	uint32_t filesize = 0, cur_pos = 0;
@@ -403,17 +410,23 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	uint16_t value = 0, line_breaks = 0;
 	size_t bytes_read;
 	char bvalue;
+	wchar_t *text;
 
 	bool utf16 = false;
 
+	dstr_free(&srcdata->log_tail);
+	srcdata->log_offset = 0;
+
 	tmp_file = fopen(filename, "rb");
 	if (tmp_file == NULL) {
 		if (!srcdata->file_load_failed) {
 			blog(LOG_WARNING, "Failed to open file %s", filename);
 			srcdata->file_load_failed = true;
 		}
-		return;
+		return NULL;
 	}
+	srcdata->file_load_failed = false;
+
 	bytes_read = fread(&value, 2, 1, tmp_file);
 
 	if (bytes_read == 2 && value == 0xFEFF)
@@ -423,7 +436,7 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	filesize = (uint32_t)ftell(tmp_file);
 	cur_pos = filesize;
 
-	while (line_breaks <= 6 && cur_pos != 0) {
+	while (line_breaks <= log_lines && cur_pos != 0) {
 		if (!utf16) cur_pos--;
 		else cur_pos -= 2;
 		fseek(tmp_file, cur_pos, SEEK_SET);
@@ -446,61 +459,77 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	fseek(tmp_file, cur_pos, SEEK_SET);
 
 	if (utf16) {
-		if (srcdata->text != NULL) {
-			bfree(srcdata->text);
-			srcdata->text = NULL;
-		}
-		srcdata->text = bzalloc(filesize - cur_pos);
-		bytes_read = fread(srcdata->text, (filesize - cur_pos), 1,
+		// Appended text isn't tracked for UTF-16 files, every change
+		// reads the end of the file again
+		text = bzalloc(filesize - cur_pos);
+		bytes_read = fread(text, (filesize - cur_pos), 1,
 				tmp_file);
 
-		remove_cr(srcdata->text);
-		srcdata->m_timestamp =
-			get_modified_timestamp(srcdata->text_file);
-		bfree(tmp_read);
+		remove_cr(text);
 		fclose(tmp_file);
 
-		return;
+		return text;
 	}
 
 	tmp_read = bzalloc((filesize - cur_pos) + 1);
-	bytes_read = fread(tmp_read, filesize - cur_pos, 1, tmp_file);
+	bytes_read = fread(tmp_read, 1, filesize - cur_pos, tmp_file);
 	fclose(tmp_file);
 
-	if (srcdata->text != NULL) {
-		bfree(srcdata->text);
-		srcdata->text = NULL;
-	}
-	srcdata->text = bzalloc((strlen(tmp_read) + 1)*sizeof(wchar_t));
-	os_utf8_to_wcs(tmp_read, strlen(tmp_read),
-		srcdata->text, (strlen(tmp_read) + 1));
+	bytes_read = utf8_complete_len(tmp_read, bytes_read);
+	tmp_read[bytes_read] = 0;
+
+	dstr_copy(&srcdata->log_tail, tmp_read);
+	srcdata->log_offset = cur_pos + bytes_read;
 
-	remove_cr(srcdata->text);
-	srcdata->m_timestamp = get_modified_timestamp(srcdata->text_file);
+	text = utf8_to_text(tmp_read);
 	bfree(tmp_read);
+	return text;
 }
 
-uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
+wchar_t *read_new_lines(struct ft2_source *srcdata, const char *filename)
 {
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
-	FT_UInt glyph_index = 0;
-	uint32_t w = 0, max_w = 0;
-	size_t len;
+	FILE *tmp_file = NULL;
+	int64_t filesize;
+	char *tmp_read = NULL;
+	size_t bytes_read;
+	wchar_t *text;
 
-	if (!text)
-		return 0;
+	if (!srcdata->log_offset)
+		return read_from_end(srcdata, filename);
 
-	len = wcslen(text);
-	for (size_t i = 0; i < len; i++) {
-		glyph_index = FT_Get_Char_Index(srcdata->font_face, text[i]);
-		FT_Load_Glyph(srcdata->font_face, glyph_index, FT_LOAD_DEFAULT);
+	tmp_file = fopen(filename, "rb");
+	if (tmp_file == NULL)
+		return read_from_end(srcdata, filename);
 
-		if (text[i] == L'\n') w = 0;
-		else {
-			w += slot->advance.x >> 6;
-			if (w > max_w) max_w = w;
-		}
+	filesize = os_fgetsize(tmp_file);
+
+	// Truncated or replaced, start over
+	if (filesize < (int64_t)srcdata->log_offset) {
+		fclose(tmp_file);
+		return read_from_end(srcdata, filename);
+	}
+
+	if (filesize == (int64_t)srcdata->log_offset) {
+		fclose(tmp_file);
+		return NULL;
 	}
 
-	return max_w;
+	tmp_read = bzalloc((size_t)(filesize - srcdata->log_offset) + 1);
+	os_fseeki64(tmp_file, (int64_t)srcdata->log_offset, SEEK_SET);
+	bytes_read = fread(tmp_read, 1,
+			(size_t)(filesize - srcdata->log_offset), tmp_file);
+	fclose(tmp_file);
+
+	// Leave a partly written character for the next change
+	bytes_read = utf8_complete_len(tmp_read, bytes_read);
+	tmp_read[bytes_read] = 0;
+	srcdata->log_offset += bytes_read;
+
+	dstr_cat(&srcdata->log_tail, tmp_read);
+	trim_log_tail(&srcdata->log_tail);
+	bfree(tmp_read);
+
+	text = utf8_to_text(srcdata->log_tail.array ?
+			srcdata->log_tail.array : "");
+	return text;
 }
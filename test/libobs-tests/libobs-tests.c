@@ -0,0 +1,81 @@
+/*
+ * Self-contained checks of libobs internals that don't need a graphics
+ * device or any modules.
+ *
+ * usage: libobs-tests [test name...]
+ *
+ * Runs the named tests, or all of them, and exits with a non-zero status if
+ * any of them failed.  Each test is also registered with CTest.
+ */
+
+#include <string.h>
+#include <util/base.h>
+#include <util/bmem.h>
+
+#include "libobs-tests.h"
+
+static const struct {
+	const char         *name;
+	libobs_test_func_t func;
+} tests[] = {
+	{"frame-queue", test_frame_queue},
+	{"data-binary", test_data_binary},
+};
+
+#define NUM_TESTS (sizeof(tests) / sizeof(tests[0]))
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fprintf(stderr, "\n");
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+static bool run_test(size_t idx)
+{
+	int failures = tests[idx].func();
+
+	printf("%-20s %s", tests[idx].name, failures ? "FAILED" : "ok");
+	if (failures)
+		printf(" (%d failures)", failures);
+	printf("\n");
+
+	return failures == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	bool success = true;
+
+	base_set_log_handler(do_log, NULL);
+
+	if (argc < 2) {
+		for (size_t i = 0; i < NUM_TESTS; i++)
+			success = run_test(i) && success;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		size_t idx = 0;
+
+		while (idx < NUM_TESTS && strcmp(tests[idx].name, argv[i]) != 0)
+			idx++;
+
+		if (idx == NUM_TESTS) {
+			fprintf(stderr, "unknown test '%s'\n", argv[i]);
+			success = false;
+			continue;
+		}
+
+		success = run_test(idx) && success;
+	}
+
+	if (bnum_allocs() != 0) {
+		fprintf(stderr, "Number of memory leaks: %ld\n", bnum_allocs());
+		success = false;
+	}
+
+	return success ? 0 : 1;
+}
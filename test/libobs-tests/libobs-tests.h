@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdio.h>
+#include <util/c99defs.h>
+
+/* each test returns the number of failures it found */
+typedef int (*libobs_test_func_t)(void);
+
+extern int test_frame_queue(void);
+extern int test_data_binary(void);
+
+#define test_fail(format, ...) \
+	fprintf(stderr, "%s:%d: " format "\n", __FILE__, __LINE__, \
+			##__VA_ARGS__)
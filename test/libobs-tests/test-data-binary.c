@@ -0,0 +1,215 @@
+/*
+ * Round trips obs_data through the binary format, and makes sure malformed
+ * or truncated binary data is rejected without reading out of bounds.  Run
+ * under AddressSanitizer to catch reads that don't crash.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <obs-data.h>
+#include <util/base.h>
+#include <util/bmem.h>
+
+#include "libobs-tests.h"
+
+static obs_data_t *create_test_data(void)
+{
+	obs_data_t       *data    = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+	obs_data_t       *empty   = obs_data_create();
+
+	obs_data_set_string(data, "current_scene", "Scene");
+	obs_data_set_int(data, "neg", -1234567890123LL);
+	obs_data_set_double(data, "pi", 3.14159265358979);
+	obs_data_set_bool(data, "enabled", true);
+	obs_data_set_obj(data, "empty", empty);
+	obs_data_set_default_int(data, "default_only", 5);
+
+	for (int i = 0; i < 20; i++) {
+		obs_data_t *source   = obs_data_create();
+		obs_data_t *settings = obs_data_create();
+		char       name[32];
+
+		snprintf(name, sizeof(name), "source %d", i);
+		obs_data_set_string(settings, "file", "/tmp/image.png");
+		obs_data_set_bool(settings, "unload", i & 1);
+
+		obs_data_set_string(source, "name", name);
+		obs_data_set_string(source, "id", "image_source");
+		obs_data_set_double(source, "volume", i * 0.5);
+		obs_data_set_obj(source, "settings", settings);
+
+		obs_data_array_push_back(sources, source);
+		obs_data_release(settings);
+		obs_data_release(source);
+	}
+
+	obs_data_set_array(data, "sources", sources);
+	obs_data_array_release(sources);
+	obs_data_release(empty);
+	return data;
+}
+
+static int test_round_trip(const uint8_t *bin, size_t size, const char *json)
+{
+	obs_data_t *data = obs_data_create_from_binary(bin, size);
+	int failures = 0;
+
+	if (!data) {
+		test_fail("valid binary data was rejected");
+		return 1;
+	}
+
+	if (strcmp(obs_data_get_json(data), json) != 0) {
+		test_fail("round trip changed the data");
+		failures++;
+	}
+
+	obs_data_release(data);
+	return failures;
+}
+
+/* not bmemdup: bmalloc can pad the end of the block, which would hide reads
+ * past the end of the data from the sanitizers */
+static uint8_t *copy_data(const uint8_t *data, size_t size)
+{
+	uint8_t *copy = malloc(size ? size : 1);
+	memcpy(copy, data, size);
+	return copy;
+}
+
+static const struct {
+	const char *name;
+	size_t     size;
+	uint8_t    data[32];
+} malformed[] = {
+	/* the length of the only string runs past the end of the string
+	 * block, and the bytes after it are still inside the buffer */
+	{"string length past block", 15,
+		{'O','B','S','B', 1,0,0,0, 1, 2, 0x80,0x80,0x80,0x80,0x00}},
+	{"string length past buffer", 12,
+		{'O','B','S','B', 1,0,0,0, 1, 2, 0x05, 'a'}},
+	{"string without terminator", 13,
+		{'O','B','S','B', 1,0,0,0, 1, 3, 1, 'a','b'}},
+	{"string count past block", 14,
+		{'O','B','S','B', 1,0,0,0, 4, 4, 0,0,0,0}},
+	{"unterminated varint", 10,
+		{'O','B','S','B', 1,0,0,0, 0x80,0x80}},
+	{"string index out of range", 16,
+		{'O','B','S','B', 1,0,0,0, 1, 2, 1,'a',0, 1, 5, 3}},
+	{"unknown item type", 16,
+		{'O','B','S','B', 1,0,0,0, 1, 2, 1,'a',0, 1, 0, 99}},
+	{"wrong version", 10,
+		{'O','B','S','B', 2,0,0,0, 0, 0}},
+	{"wrong magic", 10,
+		{'J','S','O','N', 1,0,0,0, 0, 0}},
+};
+
+#define NUM_MALFORMED (sizeof(malformed) / sizeof(malformed[0]))
+
+static int test_malformed(void)
+{
+	int failures = 0;
+
+	for (size_t i = 0; i < NUM_MALFORMED; i++) {
+		uint8_t    *buf  = copy_data(malformed[i].data,
+				malformed[i].size);
+		obs_data_t *data = obs_data_create_from_binary(buf,
+				malformed[i].size);
+
+		if (data) {
+			test_fail("'%s' was accepted", malformed[i].name);
+			obs_data_release(data);
+			failures++;
+		}
+
+		free(buf);
+	}
+
+	return failures;
+}
+
+static int test_truncated(const uint8_t *bin, size_t size)
+{
+	int failures = 0;
+
+	for (size_t len = 0; len < size; len++) {
+		uint8_t    *buf  = copy_data(bin, len);
+		obs_data_t *data = obs_data_create_from_binary(buf, len);
+
+		if (data) {
+			test_fail("data truncated to %zu of %zu bytes was "
+					"accepted", len, size);
+			obs_data_release(data);
+			failures++;
+		}
+
+		free(buf);
+	}
+
+	return failures;
+}
+
+/* corrupted data may or may not be rejected, but must never be read out of
+ * bounds */
+static void test_corrupted(const uint8_t *bin, size_t size)
+{
+	static const uint8_t values[] = {0x00, 0x01, 0x7F, 0x80, 0xFF};
+	uint8_t *buf = copy_data(bin, size);
+
+	for (size_t pos = 0; pos < size; pos++) {
+		for (size_t i = 0; i < sizeof(values); i++) {
+			buf[pos] = values[i];
+			obs_data_release(obs_data_create_from_binary(buf,
+						size));
+		}
+
+		buf[pos] = bin[pos];
+	}
+
+	free(buf);
+}
+
+/* rejected data is logged as an error, which is expected here */
+static void quiet_log(int log_level, const char *msg, va_list args,
+		void *param)
+{
+	UNUSED_PARAMETER(log_level);
+	UNUSED_PARAMETER(msg);
+	UNUSED_PARAMETER(args);
+	UNUSED_PARAMETER(param);
+}
+
+int test_data_binary(void)
+{
+	log_handler_t prev_handler;
+	void          *prev_param;
+	obs_data_t *data = create_test_data();
+	char       *json = bstrdup(obs_data_get_json(data));
+	size_t     size;
+	uint8_t    *bin  = obs_data_to_binary(data, &size);
+	int        failures = 0;
+
+	obs_data_release(data);
+
+	if (!bin) {
+		test_fail("couldn't serialize the data");
+		bfree(json);
+		return 1;
+	}
+
+	failures += test_round_trip(bin, size, json);
+
+	base_get_log_handler(&prev_handler, &prev_param);
+	base_set_log_handler(quiet_log, NULL);
+
+	failures += test_malformed();
+	failures += test_truncated(bin, size);
+	test_corrupted(bin, size);
+
+	base_set_log_handler(prev_handler, prev_param);
+
+	bfree(bin);
+	bfree(json);
+	return failures;
+}
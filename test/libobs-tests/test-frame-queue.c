@@ -0,0 +1,257 @@
+/*
+ * Checks that the async frame queue paces frames exactly like the darray
+ * based queue it replaced.  Both are fed the same simulated producers (frame
+ * rates from 15 to 144 fps, timestamp jitter, bursts, forward/backward
+ * timestamp jumps and small reorderings) and ticked at a jittery 60 fps, and
+ * must pick the same frames, skip the same frames and keep the same timing.
+ */
+
+#include <string.h>
+#include <util/darray.h>
+#include <obs-frame-queue.h>
+
+#include "libobs-tests.h"
+
+#define NUM_RUNS   2000
+#define NUM_TICKS  3000
+#define MAX_FRAMES (NUM_TICKS * 10)
+
+/* ------------------------------------------------------------------------- */
+/* the original queue: a darray with the front erased for each frame */
+
+struct ref_queue {
+	DARRAY(struct obs_source_frame*) frames;
+	uint64_t                         last_frame_ts;
+	uint64_t                         last_sys_timestamp;
+	bool                             unbuffered;
+	size_t                           released;
+};
+
+static inline bool ref_out_of_bounds(const struct ref_queue *q, uint64_t ts)
+{
+	if (ts < q->last_frame_ts)
+		return ((q->last_frame_ts - ts) > MAX_TS_VAR);
+	else
+		return ((ts - q->last_frame_ts) > MAX_TS_VAR);
+}
+
+static inline void ref_release(struct ref_queue *q,
+		struct obs_source_frame *frame)
+{
+	if (frame)
+		q->released++;
+}
+
+static bool ref_ready_frame(struct ref_queue *q, uint64_t sys_time)
+{
+	struct obs_source_frame *next_frame = q->frames.array[0];
+	struct obs_source_frame *frame      = NULL;
+	uint64_t sys_offset = sys_time - q->last_sys_timestamp;
+	uint64_t frame_time = next_frame->timestamp;
+	uint64_t frame_offset = 0;
+
+	if (q->unbuffered) {
+		while (q->frames.num > 1) {
+			da_erase(q->frames, 0);
+			ref_release(q, next_frame);
+			next_frame = q->frames.array[0];
+		}
+
+		return true;
+	}
+
+	if (ref_out_of_bounds(q, frame_time)) {
+		q->last_frame_ts = next_frame->timestamp;
+		return true;
+	} else {
+		frame_offset = frame_time - q->last_frame_ts;
+		q->last_frame_ts += sys_offset;
+	}
+
+	while (q->last_frame_ts > next_frame->timestamp) {
+		if ((q->last_frame_ts - next_frame->timestamp) < 2000000)
+			break;
+
+		if (frame)
+			da_erase(q->frames, 0);
+
+		ref_release(q, frame);
+
+		if (q->frames.num == 1)
+			return true;
+
+		frame = next_frame;
+		next_frame = q->frames.array[1];
+
+		if ((next_frame->timestamp - frame_time) > MAX_TS_VAR)
+			q->last_frame_ts = next_frame->timestamp - frame_offset;
+
+		frame_time   = next_frame->timestamp;
+		frame_offset = frame_time - q->last_frame_ts;
+	}
+
+	return frame != NULL;
+}
+
+static struct obs_source_frame *ref_get_closest(struct ref_queue *q,
+		uint64_t sys_time)
+{
+	struct obs_source_frame *frame = NULL;
+
+	if (q->frames.num &&
+	    (!q->last_frame_ts || ref_ready_frame(q, sys_time))) {
+		frame = q->frames.array[0];
+		da_erase(q->frames, 0);
+
+		if (!q->last_frame_ts)
+			q->last_frame_ts = frame->timestamp;
+	}
+
+	q->last_sys_timestamp = sys_time;
+	return frame;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void count_release(void *param, struct obs_source_frame *frame)
+{
+	size_t *released = param;
+	(*released)++;
+
+	UNUSED_PARAMETER(frame);
+}
+
+static uint64_t rand_state = 88172645463325252ULL;
+
+static inline uint64_t rand64(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+static uint64_t next_timestamp(uint64_t *pts, uint64_t period)
+{
+	int64_t  jitter = (int64_t)(rand64() % 4000000) - 2000000;
+	uint64_t event  = rand64() % 500;
+
+	*pts += period;
+
+	if (event == 0)
+		*pts += 3000000000ULL;
+	else if (event == 1 && *pts > 4000000000ULL)
+		*pts -= 3000000000ULL;
+	else if (event == 2)
+		*pts -= period * 2;
+
+	return *pts + jitter;
+}
+
+static int check_queue_state(const struct obs_frame_queue *queue,
+		const struct ref_queue *ref)
+{
+	size_t jumps = 0;
+
+	if (queue->num != ref->frames.num)
+		return 1;
+
+	for (size_t i = 0; i < queue->num; i++) {
+		struct obs_source_frame *frame = obs_frame_queue_peek(queue, i);
+
+		if (frame != ref->frames.array[i])
+			return 1;
+		if (i && frame->timestamp -
+				obs_frame_queue_peek(queue, i - 1)->timestamp >
+				MAX_TS_VAR)
+			jumps++;
+	}
+
+	return jumps != queue->jumps;
+}
+
+static int run_producer(struct obs_source_frame *frames, bool unbuffered)
+{
+	struct obs_frame_queue queue;
+	struct ref_queue       ref = {0};
+	size_t                 released = 0;
+	size_t                 num_frames = 0;
+	uint64_t pts    = 1000000000ULL + rand64() % 1000000000ULL;
+	uint64_t sys    = 5000000000ULL;
+	uint64_t period = 1000000000ULL / (15 + rand64() % 130);
+	int      failures = 0;
+
+	obs_frame_queue_init(&queue, count_release, &released);
+	ref.unbuffered = unbuffered;
+
+	for (int tick = 0; tick < NUM_TICKS && !failures; tick++) {
+		struct obs_source_frame *a, *b;
+		int produced = (int)(rand64() % 4);
+
+		/* occasional bursts, as if the producer had stalled */
+		if (rand64() % 8 == 0)
+			produced += (int)(rand64() % 6);
+
+		for (int i = 0; i < produced && num_frames < MAX_FRAMES; i++) {
+			struct obs_source_frame *frame = &frames[num_frames++];
+			frame->timestamp = next_timestamp(&pts, period);
+
+			/* same overflow handling as queue_async_frame */
+			if (queue.num == MAX_ASYNC_FRAMES) {
+				count_release(&released,
+						obs_frame_queue_pop(&queue));
+				queue.last_frame_ts = 0;
+
+				ref_release(&ref, ref.frames.array[0]);
+				da_erase(ref.frames, 0);
+				ref.last_frame_ts = 0;
+			}
+
+			obs_frame_queue_push(&queue, frame);
+			da_push_back(ref.frames, &frame);
+		}
+
+		sys += 16666666 + (rand64() % 3000000) - 1500000;
+
+		a = obs_frame_queue_get_closest(&queue, sys, unbuffered);
+		b = ref_get_closest(&ref, sys);
+
+		if (a != b) {
+			test_fail("tick %d: picked frame %p, expected %p",
+					tick, (void*)a, (void*)b);
+			failures++;
+		} else if (queue.last_frame_ts != ref.last_frame_ts) {
+			test_fail("tick %d: last_frame_ts %llu, expected %llu",
+					tick,
+					(unsigned long long)queue.last_frame_ts,
+					(unsigned long long)ref.last_frame_ts);
+			failures++;
+		} else if (released != ref.released) {
+			test_fail("tick %d: released %zu frames, expected "
+					"%zu", tick, released, ref.released);
+			failures++;
+		} else if (check_queue_state(&queue, &ref) != 0) {
+			test_fail("tick %d: queued frames differ", tick);
+			failures++;
+		}
+	}
+
+	da_free(ref.frames);
+	return failures;
+}
+
+int test_frame_queue(void)
+{
+	struct obs_source_frame *frames;
+	int failures = 0;
+
+	frames = bzalloc(sizeof(struct obs_source_frame) * MAX_FRAMES);
+
+	for (int run = 0; run < NUM_RUNS; run++) {
+		memset(frames, 0, sizeof(struct obs_source_frame) * MAX_FRAMES);
+		failures += run_producer(frames, run % 17 == 0);
+	}
+
+	bfree(frames);
+	return failures;
+}
@@ -0,0 +1,171 @@
+/*
+ * H.264 packet parsing: the start code scan against the word-at-a-time scan
+ * it replaced, and the cost of two outputs each converting the same packets
+ * to AVCC form themselves against sharing one conversion through the
+ * refcounted packet.
+ */
+
+#include <stdlib.h>
+#include <util/bmem.h>
+#include <obs.h>
+#include <obs-avc.h>
+
+#include "micro-benchmarks.h"
+
+#define SCAN_SIZE      (256 * 1024)
+#define SCAN_PASSES    2000
+#define PACKET_SIZE    (64 * 1024)
+#define NUM_PACKETS    200
+#define NUM_OUTPUTS    2
+#define NAL_INTERVAL   (16 * 1024)
+
+/* the previous obs_avc_find_startcode */
+static const uint8_t *old_find_startcode_internal(const uint8_t *p,
+		const uint8_t *end)
+{
+	const uint8_t *a = p + 4 - ((intptr_t)p & 3);
+
+	for (end -= 3; p < a && p < end; p++) {
+		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+			return p;
+	}
+
+	for (end -= 3; p < end; p += 4) {
+		uint32_t x = *(const uint32_t*)p;
+
+		if ((x - 0x01010101) & (~x) & 0x80808080) {
+			if (p[1] == 0) {
+				if (p[0] == 0 && p[2] == 1)
+					return p;
+				if (p[2] == 0 && p[3] == 1)
+					return p+1;
+			}
+
+			if (p[3] == 0) {
+				if (p[2] == 0 && p[4] == 1)
+					return p+2;
+				if (p[4] == 0 && p[5] == 1)
+					return p+3;
+			}
+		}
+	}
+
+	for (end += 3; p < end; p++) {
+		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+			return p;
+	}
+
+	return end + 3;
+}
+
+static const uint8_t *old_find_startcode(const uint8_t *p, const uint8_t *end)
+{
+	const uint8_t *out = old_find_startcode_internal(p, end);
+	if (p < out && out < end && !out[-1]) out--;
+	return out;
+}
+
+typedef const uint8_t *(*find_startcode_t)(const uint8_t *p,
+		const uint8_t *end);
+
+/* random bytes (like compressed slice data) with a NAL every NAL_INTERVAL */
+static uint8_t *create_payload(size_t size)
+{
+	uint8_t *data = bmalloc(size);
+
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)rand();
+
+	for (size_t i = 0; i + 5 <= size; i += NAL_INTERVAL) {
+		data[i]     = 0;
+		data[i + 1] = 0;
+		data[i + 2] = 0;
+		data[i + 3] = 1;
+		data[i + 4] = i ? OBS_NAL_SLICE : OBS_NAL_SLICE_IDR;
+	}
+
+	return data;
+}
+
+static void bench_scan(const uint8_t *data, const char *name,
+		find_startcode_t find_startcode)
+{
+	uint64_t start = os_gettime_ns();
+	size_t   found = 0;
+	double   ns;
+
+	for (int pass = 0; pass < SCAN_PASSES; pass++) {
+		const uint8_t *p   = data;
+		const uint8_t *end = data + SCAN_SIZE;
+
+		while ((p = find_startcode(p, end)) < end) {
+			found++;
+			p += 3;
+		}
+	}
+
+	ns = ns_per(start, SCAN_PASSES);
+	printf("%-28s %8.1f us/pass %7.2f GB/s (%zu start codes)\n", name,
+			ns / 1000.0, SCAN_SIZE / ns, found / SCAN_PASSES);
+}
+
+/* each packet goes through what happens in the pipeline: the encoder copies
+ * it into a refcounted packet, every output gets the AVCC form, and then
+ * everything is released again */
+static void bench_parse(const struct encoder_packet *payloads, bool shared)
+{
+	uint64_t start = os_gettime_ns();
+
+	for (int i = 0; i < NUM_PACKETS; i++) {
+		struct encoder_packet packet;
+
+		obs_encoder_packet_create_instance(&packet, &payloads[i]);
+
+		for (int output = 0; output < NUM_OUTPUTS; output++) {
+			struct encoder_packet parsed;
+
+			if (shared) {
+				obs_encoder_packet_parse_avc(&parsed, &packet);
+				obs_encoder_packet_release(&parsed);
+			} else {
+				obs_parse_avc_packet(&parsed, &packet);
+				obs_free_encoder_packet(&parsed);
+			}
+		}
+
+		obs_encoder_packet_release(&packet);
+	}
+
+	printf("%-28s %8.1f us/packet\n", shared ?
+			"parsed once, shared" : "parsed by each output",
+			ns_per(start, NUM_PACKETS) / 1000.0);
+}
+
+int bench_avc(void)
+{
+	struct encoder_packet *payloads;
+	uint8_t               *data;
+
+	data = create_payload(SCAN_SIZE);
+	bench_scan(data, "word-at-a-time scan (old)", old_find_startcode);
+	bench_scan(data, "obs_avc_find_startcode", obs_avc_find_startcode);
+	bfree(data);
+
+	payloads = bzalloc(sizeof(struct encoder_packet) * NUM_PACKETS);
+
+	for (int i = 0; i < NUM_PACKETS; i++) {
+		payloads[i].type = OBS_ENCODER_VIDEO;
+		payloads[i].size = PACKET_SIZE;
+		payloads[i].data = create_payload(PACKET_SIZE);
+	}
+
+	printf("%d outputs, %d KB packets:\n", NUM_OUTPUTS,
+			PACKET_SIZE / 1024);
+	bench_parse(payloads, false);
+	bench_parse(payloads, true);
+
+	for (int i = 0; i < NUM_PACKETS; i++)
+		bfree(payloads[i].data);
+	bfree(payloads);
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Cost of emitting audio_data, the signal sent for every audio packet of
+ * every source, with 0, 1 and 10 connected handlers.  Compares calldata on
+ * the heap with parameters set by name (the old way), calldata on a stack
+ * buffer set by name, and a stack buffer with calldata_key parameters.
+ */
+
+#include <stdlib.h>
+#include <callback/signal.h>
+#include <util/bmem.h>
+
+#include "micro-benchmarks.h"
+
+#define EMITS 2000000
+
+/* the signals every source declares */
+static const char *source_signals[] = {
+	"void destroy(ptr source)",
+	"void remove(ptr source)",
+	"void activate(ptr source)",
+	"void deactivate(ptr source)",
+	"void show(ptr source)",
+	"void hide(ptr source)",
+	"void rename(ptr source, string new_name, string prev_name)",
+	"void volume(in out ptr source, in out float volume)",
+	"void update_properties(ptr source)",
+	"void audio_data(ptr source, ptr data, bool muted)",
+	NULL
+};
+
+static const struct calldata_key key_source = CALLDATA_KEY("source");
+static const struct calldata_key key_data   = CALLDATA_KEY("data");
+static const struct calldata_key key_muted  = CALLDATA_KEY("muted");
+
+enum emit_type {
+	EMIT_HEAP,
+	EMIT_FIXED,
+	EMIT_FIXED_KEYS
+};
+
+static const char *emit_type_names[] = {
+	"heap calldata",
+	"stack calldata",
+	"stack calldata, keys"
+};
+
+static volatile long sink;
+static bool          counting;
+static long          num_mallocs;
+
+/* counts the allocations made while emitting */
+static void *count_malloc(size_t size)
+{
+	num_mallocs++;
+	return malloc(size);
+}
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	num_mallocs++;
+	return realloc(ptr, size);
+}
+
+static struct base_allocator counting_allocator = {
+	count_malloc, count_realloc, free
+};
+
+static void data_received(void *param, calldata_t *cd)
+{
+	sink ^= (long)(size_t)calldata_ptr(cd, "data") +
+		calldata_bool(cd, "muted");
+
+	UNUSED_PARAMETER(param);
+}
+
+static void data_received_keys(void *param, calldata_t *cd)
+{
+	sink ^= (long)(size_t)calldata_ptr_key(cd, &key_data) +
+		calldata_bool_key(cd, &key_muted);
+
+	UNUSED_PARAMETER(param);
+}
+
+static inline void emit(signal_handler_t *sh, enum emit_type type,
+		void *source, void *audio)
+{
+	struct calldata data;
+	uint8_t         stack[128];
+
+	if (type == EMIT_HEAP) {
+		calldata_init(&data);
+		calldata_set_ptr(&data, "source", source);
+		calldata_set_ptr(&data, "data",   audio);
+		calldata_set_bool(&data, "muted", false);
+
+	} else if (type == EMIT_FIXED) {
+		calldata_init_fixed(&data, stack, sizeof(stack));
+		calldata_set_ptr(&data, "source", source);
+		calldata_set_ptr(&data, "data",   audio);
+		calldata_set_bool(&data, "muted", false);
+
+	} else {
+		calldata_init_fixed(&data, stack, sizeof(stack));
+		calldata_set_ptr_key(&data, &key_source, source);
+		calldata_set_ptr_key(&data, &key_data,   audio);
+		calldata_set_bool_key(&data, &key_muted, false);
+	}
+
+	signal_handler_signal(sh, "audio_data", &data);
+	calldata_free(&data);
+}
+
+static void run_emits(int handlers, enum emit_type type)
+{
+	signal_handler_t *sh = signal_handler_create();
+	signal_callback_t callback = type == EMIT_FIXED_KEYS ?
+		data_received_keys : data_received;
+	long     start_mallocs;
+	uint64_t start;
+
+	signal_handler_add_array(sh, source_signals);
+	for (int i = 0; i < handlers; i++)
+		signal_handler_connect(sh, "audio_data", callback,
+				(void*)(size_t)i);
+
+	start_mallocs = num_mallocs;
+	start         = os_gettime_ns();
+
+	for (int i = 0; i < EMITS; i++)
+		emit(sh, type, sh, &start);
+
+	printf("%2d handlers, %-22s %8.1f ns/emit", handlers,
+			emit_type_names[type], ns_per(start, EMITS));
+	if (counting)
+		printf(", %ld allocations", num_mallocs - start_mallocs);
+	printf("\n");
+
+	signal_handler_destroy(sh);
+}
+
+int bench_calldata(void)
+{
+	static const int handler_counts[] = {0, 1, 10};
+
+	/* blocks can only be counted if nothing was allocated before, which is
+	 * the case unless the pooled allocator is in use */
+	if (!base_pooled_allocator_active()) {
+		base_set_allocator(&counting_allocator);
+		counting = true;
+	}
+
+	for (size_t i = 0; i < sizeof(handler_counts) / sizeof(int); i++) {
+		run_emits(handler_counts[i], EMIT_HEAP);
+		run_emits(handler_counts[i], EMIT_FIXED);
+		run_emits(handler_counts[i], EMIT_FIXED_KEYS);
+	}
+
+	return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * Throughput of the format conversion functions for each set of kernels the
+ * CPU supports, at 720p, 1080p and 2160p.  GB/s counts the bytes read plus
+ * the bytes written.  Each conversion runs on a single thread; the output
+ * conversion splits large frames across threads on top of this.
+ */
+
+#include <util/bmem.h>
+#include <media-io/format-conversion.h>
+
+#include "micro-benchmarks.h"
+
+#define CONVERT_NS (500 * 1000000ULL)
+
+static const struct {
+	const char *name;
+	uint32_t   features;
+} kernel_sets[] = {
+	{"AVX2",  OS_CPU_SSE2 | OS_CPU_SSSE3 | OS_CPU_AVX | OS_CPU_AVX2},
+	{"SSSE3", OS_CPU_SSE2 | OS_CPU_SSSE3},
+	{"SSE2",  OS_CPU_SSE2},
+};
+
+#define NUM_KERNEL_SETS (sizeof(kernel_sets) / sizeof(kernel_sets[0]))
+
+static const struct {
+	const char *name;
+	uint32_t   width;
+	uint32_t   height;
+} resolutions[] = {
+	{"720p",  1280, 720},
+	{"1080p", 1920, 1080},
+	{"2160p", 3840, 2160},
+};
+
+#define NUM_RESOLUTIONS (sizeof(resolutions) / sizeof(resolutions[0]))
+
+enum conversion {
+	UYVX_TO_I420,
+	UYVX_TO_NV12,
+	UYVX_TO_I444,
+	DECOMPRESS_420,
+	DECOMPRESS_NV12,
+	DECOMPRESS_422
+};
+
+static const char *conversion_names[] = {
+	"compress_uyvx_to_i420",
+	"compress_uyvx_to_nv12",
+	"convert_uyvx_to_i444",
+	"decompress_420",
+	"decompress_nv12",
+	"decompress_422"
+};
+
+/* bytes read and written per pixel, times two */
+static const uint32_t conversion_bytes_x2[] = {11, 11, 14, 11, 11, 12};
+
+#define NUM_CONVERSIONS (sizeof(conversion_names) / sizeof(const char*))
+
+struct frame_buffers {
+	uint32_t width;
+	uint32_t height;
+	uint8_t  *packed;    /* uyvx/rgba, 4 bytes per pixel */
+	uint8_t  *packed422; /* 2 bytes per pixel */
+	uint8_t  *planes[3]; /* a full size plane each */
+	uint8_t  *output;    /* 4 bytes per pixel */
+};
+
+static void frame_buffers_init(struct frame_buffers *fb, uint32_t width,
+		uint32_t height)
+{
+	size_t pixels = (size_t)width * height;
+
+	fb->width     = width;
+	fb->height    = height;
+	fb->packed    = bmalloc(pixels * 4);
+	fb->packed422 = bmalloc(pixels * 2);
+	fb->output    = bmalloc(pixels * 4);
+
+	for (size_t i = 0; i < pixels * 4; i++)
+		fb->packed[i] = (uint8_t)(i * 7 + (i >> 9));
+	for (size_t i = 0; i < pixels * 2; i++)
+		fb->packed422[i] = (uint8_t)(i * 13 + (i >> 7));
+
+	for (int i = 0; i < 3; i++) {
+		fb->planes[i] = bmalloc(pixels);
+		for (size_t j = 0; j < pixels; j++)
+			fb->planes[i][j] = (uint8_t)(j * (i + 3) + (j >> 8));
+	}
+}
+
+static void frame_buffers_free(struct frame_buffers *fb)
+{
+	bfree(fb->packed);
+	bfree(fb->packed422);
+	bfree(fb->output);
+	for (int i = 0; i < 3; i++)
+		bfree(fb->planes[i]);
+}
+
+static void convert(struct frame_buffers *fb, enum conversion conversion)
+{
+	uint32_t width  = fb->width;
+	uint32_t height = fb->height;
+	uint32_t i420_linesize[3] = {width, width / 2, width / 2};
+	uint32_t nv12_linesize[2] = {width, width};
+	uint32_t i444_linesize[3] = {width, width, width};
+	const uint8_t *const planes[3] = {
+		fb->planes[0], fb->planes[1], fb->planes[2]
+	};
+
+	switch (conversion) {
+	case UYVX_TO_I420:
+		compress_uyvx_to_i420(fb->packed, width * 4, 0, height,
+				fb->planes, i420_linesize);
+		break;
+	case UYVX_TO_NV12:
+		compress_uyvx_to_nv12(fb->packed, width * 4, 0, height,
+				fb->planes, nv12_linesize);
+		break;
+	case UYVX_TO_I444:
+		convert_uyvx_to_i444(fb->packed, width * 4, 0, height,
+				fb->planes, i444_linesize);
+		break;
+	case DECOMPRESS_420:
+		decompress_420(planes, i420_linesize, 0, height,
+				fb->output, width * 4);
+		break;
+	case DECOMPRESS_NV12:
+		decompress_nv12(planes, nv12_linesize, 0, height,
+				fb->output, width * 4);
+		break;
+	case DECOMPRESS_422:
+		decompress_422(fb->packed422, width * 2, 0, height,
+				fb->output, width * 4, true);
+		break;
+	}
+}
+
+static void run_conversions(struct frame_buffers *fb, const char *res_name)
+{
+	for (size_t i = 0; i < NUM_CONVERSIONS; i++) {
+		uint64_t start;
+		uint64_t frames = 0;
+		double   ns, bytes;
+
+		/* warm up the caches and the kernel selection */
+		convert(fb, (enum conversion)i);
+
+		start = os_gettime_ns();
+		do {
+			convert(fb, (enum conversion)i);
+			frames++;
+		} while (os_gettime_ns() - start < CONVERT_NS);
+
+		ns    = ns_per(start, frames);
+		bytes = (double)fb->width * fb->height *
+			conversion_bytes_x2[i] / 2.0;
+
+		printf("%-6s %-6s %-22s %7.2f GB/s %8.3f ms/frame\n",
+				format_conversion_get_kernels(), res_name,
+				conversion_names[i], bytes / ns,
+				ns / 1000000.0);
+	}
+}
+
+int bench_convert(void)
+{
+	uint32_t features = os_get_cpu_features();
+
+	for (size_t r = 0; r < NUM_RESOLUTIONS; r++) {
+		struct frame_buffers fb;
+
+		frame_buffers_init(&fb, resolutions[r].width,
+				resolutions[r].height);
+
+		for (size_t k = 0; k < NUM_KERNEL_SETS; k++) {
+			if ((features & kernel_sets[k].features) !=
+					kernel_sets[k].features)
+				continue;
+
+			os_set_cpu_features_mask(kernel_sets[k].features);
+			format_conversion_reselect_kernels();
+			run_conversions(&fb, resolutions[r].name);
+		}
+
+		frame_buffers_free(&fb);
+	}
+
+	os_set_cpu_features_mask(0xFFFFFFFF);
+	format_conversion_reselect_kernels();
+	return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * obs_data on a generated scene collection with DATA_SOURCES sources and a
+ * hotkey object with one entry per source.
+ *
+ *   data:        parsing the JSON, the lookups a collection load does
+ *                afterwards, and building a large object key by key
+ *   data-binary: loading and saving the collection as JSON and in the
+ *                binary format
+ */
+
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <obs-data.h>
+
+#include "micro-benchmarks.h"
+
+#define DATA_SOURCES 5000
+#define DATA_PASSES  5
+
+static void create_collection_json(struct dstr *json)
+{
+	dstr_copy(json, "{\"current_scene\":\"Scene\",\"sources\":[");
+
+	for (int i = 0; i < DATA_SOURCES; i++)
+		dstr_catf(json, "%s{"
+				"\"name\":\"source %d\","
+				"\"id\":\"image_source\","
+				"\"enabled\":true,"
+				"\"volume\":1.0,"
+				"\"mixers\":255,"
+				"\"sync\":0,"
+				"\"flags\":0,"
+				"\"settings\":{"
+					"\"file\":\"/tmp/image%d.png\","
+					"\"unload\":false},"
+				"\"filters\":[],"
+				"\"hotkeys\":{"
+					"\"libobs.show_scene_item.%d\":[],"
+					"\"libobs.hide_scene_item.%d\":[]}"
+				"}",
+				i ? "," : "", i, i, i, i);
+
+	dstr_cat(json, "],\"hotkeys\":{");
+
+	for (int i = 0; i < DATA_SOURCES; i++)
+		dstr_catf(json, "%s\"hotkey.source %d\":"
+				"[{\"key\":\"OBS_KEY_%d\"}]",
+				i ? "," : "", i, i);
+
+	dstr_cat(json, "}}");
+}
+
+/* what loading a collection does with each source: read its settings and
+ * find its hotkeys in the collection's hotkey object */
+static long long load_sources(obs_data_t *collection)
+{
+	obs_data_array_t *sources = obs_data_get_array(collection, "sources");
+	obs_data_t       *hotkeys = obs_data_get_obj(collection, "hotkeys");
+	size_t           count    = obs_data_array_count(sources);
+	long long        sum      = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t       *source = obs_data_array_item(sources, i);
+		obs_data_array_t *source_hotkeys;
+		char             name[64];
+
+		snprintf(name, sizeof(name), "hotkey.%s",
+				obs_data_get_string(source, "name"));
+		source_hotkeys = obs_data_get_array(hotkeys, name);
+
+		sum += obs_data_get_int(source, "mixers");
+		sum += obs_data_get_bool(source, "enabled");
+		sum += source_hotkeys != NULL;
+
+		obs_data_array_release(source_hotkeys);
+		obs_data_release(source);
+	}
+
+	obs_data_release(hotkeys);
+	obs_data_array_release(sources);
+	return sum;
+}
+
+static void build_object(void)
+{
+	obs_data_t *data  = obs_data_create();
+	uint64_t   start  = os_gettime_ns();
+	char       name[32];
+
+	/* not in sorted order, so every item has to find its place */
+	for (int i = 0; i < DATA_SOURCES; i++) {
+		snprintf(name, sizeof(name), "key %d",
+				(i * 7919) % DATA_SOURCES);
+		obs_data_set_int(data, name, i);
+	}
+
+	printf("%-24s %8.2f ms\n", "set unsorted keys", ns_per(start, 1000000));
+
+	start = os_gettime_ns();
+	for (int i = 0; i < DATA_SOURCES; i++) {
+		snprintf(name, sizeof(name), "key %d", i);
+		obs_data_set_default_int(data, name, 0);
+	}
+
+	printf("%-24s %8.2f ms\n", "set defaults", ns_per(start, 1000000));
+
+	obs_data_release(data);
+}
+
+int bench_data(void)
+{
+	struct dstr json = {0};
+	obs_data_t  *collection;
+	uint64_t    start;
+	long long   sum;
+
+	create_collection_json(&json);
+	printf("%d sources, %.1f MB of JSON\n", DATA_SOURCES,
+			(double)json.len / (1024.0 * 1024.0));
+
+	start      = os_gettime_ns();
+	collection = obs_data_create_from_json(json.array);
+	printf("%-24s %8.2f ms\n", "parse JSON", ns_per(start, 1000000));
+
+	start = os_gettime_ns();
+	sum   = load_sources(collection);
+	printf("%-24s %8.2f ms (%lld)\n", "load sources",
+			ns_per(start, 1000000), sum);
+
+	obs_data_release(collection);
+	dstr_free(&json);
+
+	build_object();
+	return 0;
+}
+
+int bench_data_binary(void)
+{
+	struct dstr json = {0};
+	obs_data_t  *collection;
+	uint8_t     *bin;
+	size_t      bin_size;
+	uint64_t    start;
+
+	create_collection_json(&json);
+	collection = obs_data_create_from_json(json.array);
+	bin        = obs_data_to_binary(collection, &bin_size);
+
+	printf("%d sources, %.1f MB of JSON, %.1f MB binary\n", DATA_SOURCES,
+			(double)json.len / (1024.0 * 1024.0),
+			(double)bin_size / (1024.0 * 1024.0));
+
+	start = os_gettime_ns();
+	for (int i = 0; i < DATA_PASSES; i++)
+		obs_data_release(obs_data_create_from_json(json.array));
+	printf("%-24s %8.2f ms\n", "load JSON",
+			ns_per(start, DATA_PASSES * 1000000ULL));
+
+	start = os_gettime_ns();
+	for (int i = 0; i < DATA_PASSES; i++)
+		obs_data_release(obs_data_create_from_binary(bin, bin_size));
+	printf("%-24s %8.2f ms\n", "load binary",
+			ns_per(start, DATA_PASSES * 1000000ULL));
+
+	start = os_gettime_ns();
+	for (int i = 0; i < DATA_PASSES; i++)
+		obs_data_get_json(collection);
+	printf("%-24s %8.2f ms\n", "save JSON",
+			ns_per(start, DATA_PASSES * 1000000ULL));
+
+	start = os_gettime_ns();
+	for (int i = 0; i < DATA_PASSES; i++) {
+		size_t size;
+		bfree(obs_data_to_binary(collection, &size));
+	}
+	printf("%-24s %8.2f ms\n", "save binary",
+			ns_per(start, DATA_PASSES * 1000000ULL));
+
+	bfree(bin);
+	obs_data_release(collection);
+	dstr_free(&json);
+	return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Time the audio thread spends per tick mixing 32 audio lines into every mix,
+ * once for each set of mixing kernels the CPU supports (the C kernels are the
+ * scalar fallback).  Then, with every mix going to a callback that does about
+ * as much work as encoding the block, once with the mixes output one after
+ * the other and once with parallel output.  The lines are fed in real time,
+ * so each run takes MIX_SECONDS.
+ */
+
+#include <string.h>
+#include <util/bmem.h>
+#include <util/profiler.h>
+#include <media-io/audio-io.h>
+#include <obs.h>
+
+#include "micro-benchmarks.h"
+
+#define MIX_LINES       32
+#define MIX_SECONDS     5
+#define MIX_RATE        48000
+#define MIX_FRAMES      480
+#define MIX_BLOCK       1024
+#define ENCODE_PASSES   64
+
+static const struct {
+	const char *name;
+	uint32_t   features;
+} kernel_sets[] = {
+	{"AVX",  OS_CPU_SSE2 | OS_CPU_AVX},
+	{"SSE2", OS_CPU_SSE2},
+	{"C",    0},
+};
+
+static void discard_audio(void *param, size_t mix_idx, struct audio_data *data)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(mix_idx);
+	UNUSED_PARAMETER(data);
+}
+
+static volatile float encode_sink;
+
+/* stands in for an audio encoder running in the mix's output callback */
+static void encode_audio(void *param, size_t mix_idx, struct audio_data *data)
+{
+	const float *samples = (const float*)data->data[0];
+	float       state    = 0.0f;
+
+	for (int pass = 0; pass < ENCODE_PASSES; pass++)
+		for (uint32_t i = 0; i < data->frames; i++)
+			state = state * 0.999f + samples[i];
+
+	encode_sink = state;
+
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(mix_idx);
+}
+
+static void run_mix(const char *name, bool parallel,
+		audio_output_callback_t callback)
+{
+	struct audio_output_info info = {0};
+	audio_line_t *lines[MIX_LINES];
+	float        *samples[2];
+	audio_t      *audio;
+	uint64_t     ts;
+
+	info.name            = name;
+	info.samples_per_sec = MIX_RATE;
+	info.format          = AUDIO_FORMAT_FLOAT_PLANAR;
+	info.speakers        = SPEAKERS_STEREO;
+	info.buffer_ms       = 100;
+
+	if (audio_output_open(&audio, &info) != AUDIO_OUTPUT_SUCCESS) {
+		fprintf(stderr, "Couldn't open the audio output\n");
+		return;
+	}
+
+	audio_output_set_block_frames(audio, MIX_BLOCK);
+	audio_output_set_parallel_output(audio, parallel);
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+		audio_output_connect(audio, mix, NULL, callback, NULL);
+
+	for (int i = 0; i < MIX_LINES; i++)
+		lines[i] = audio_output_create_line(audio, "line",
+				(1 << MAX_AUDIO_MIXES) - 1);
+
+	for (int ch = 0; ch < 2; ch++) {
+		samples[ch] = bmalloc(MIX_FRAMES * sizeof(float));
+		for (int i = 0; i < MIX_FRAMES; i++)
+			samples[ch][i] = (float)(i % 97) / 97.0f - 0.5f;
+	}
+
+	ts = os_gettime_ns();
+
+	for (int packet = 0; packet < MIX_SECONDS * MIX_RATE / MIX_FRAMES;
+			packet++) {
+		struct audio_data data = {0};
+
+		data.data[0]   = (uint8_t*)samples[0];
+		data.data[1]   = (uint8_t*)samples[1];
+		data.frames    = MIX_FRAMES;
+		data.timestamp = ts;
+		data.volume    = 1.0f;
+
+		for (int i = 0; i < MIX_LINES; i++)
+			audio_line_output(lines[i], &data);
+
+		ts += (uint64_t)MIX_FRAMES * 1000000000ULL / MIX_RATE;
+		os_sleepto_ns(ts);
+	}
+
+	for (int i = 0; i < MIX_LINES; i++)
+		audio_line_destroy(lines[i]);
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+		audio_output_disconnect(audio, mix, callback, NULL);
+
+	audio_output_close(audio);
+	bfree(samples[0]);
+	bfree(samples[1]);
+}
+
+static bool only_audio_threads(void *data, const char *name, bool *remove)
+{
+	*remove = strncmp(name, "audio_thread(", 13) != 0;
+
+	UNUSED_PARAMETER(data);
+	return true;
+}
+
+int bench_mix(void)
+{
+	profiler_name_store_t *name_store = profiler_name_store_create();
+	uint32_t              features;
+	profiler_snapshot_t   *snap;
+	char                  name[32];
+
+	/* the audio thread names its profiler entries with the obs name
+	 * store */
+	profiler_start();
+	if (!obs_startup("en-US", NULL, name_store)) {
+		fprintf(stderr, "Couldn't start libobs\n");
+		return 1;
+	}
+
+	features = os_get_cpu_features();
+
+	for (size_t i = 0; i < sizeof(kernel_sets) / sizeof(kernel_sets[0]);
+			i++) {
+		if ((features & kernel_sets[i].features) !=
+				kernel_sets[i].features)
+			continue;
+
+		os_set_cpu_features_mask(kernel_sets[i].features);
+		printf("mixing with the %s kernels for %d seconds\n",
+				kernel_sets[i].name, MIX_SECONDS);
+
+		snprintf(name, sizeof(name), "%s kernels",
+				kernel_sets[i].name);
+		run_mix(name, false, discard_audio);
+	}
+
+	os_set_cpu_features_mask(0xFFFFFFFF);
+
+	printf("encoding every mix, output serially and in parallel for %d "
+			"seconds each\n", MIX_SECONDS);
+	run_mix("serial output", false, encode_audio);
+	run_mix("parallel output", true, encode_audio);
+
+	snap = profile_snapshot_create();
+	profiler_snapshot_filter_roots(snap, only_audio_threads, NULL);
+	profiler_print(snap);
+	profile_snapshot_free(snap);
+
+	obs_shutdown();
+	profiler_stop();
+	profiler_free();
+	profiler_name_store_free(name_store);
+	return 0;
+}
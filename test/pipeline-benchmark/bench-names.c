@@ -0,0 +1,220 @@
+/*
+ * Source name lookups with NAME_SOURCES user sources.  obs_get_source_by_name
+ * goes through the name index; walking the sources with obs_enum_sources and
+ * comparing names is what it did before, so that is timed next to it.  Adding,
+ * renaming and removing the sources keep the index up to date, so those are
+ * timed as well, along with obs_scene_find_source on a scene.  Removing a
+ * scene item unregisters its hotkeys, which takes time quadratic in the number
+ * of hotkeys, so the scene only holds SCENE_ITEMS of the sources.
+ */
+
+#include <string.h>
+#include <util/bmem.h>
+#include <obs.h>
+
+#include "micro-benchmarks.h"
+
+#define NAME_SOURCES    10000
+#define INDEX_LOOKUPS   100000
+#define WALK_LOOKUPS    1000
+#define SCENE_ITEMS     1000
+#define SCENE_LOOKUPS   1000
+
+static const char *name_source_get_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "Name benchmark source";
+}
+
+static void *name_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void name_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info name_source_info = {
+	.id       = "bench_name_source",
+	.type     = OBS_SOURCE_TYPE_INPUT,
+	.get_name = name_source_get_name,
+	.create   = name_source_create,
+	.destroy  = name_source_destroy
+};
+
+static log_handler_t prev_handler;
+static void          *prev_param;
+
+/* every source logs its creation and removal, so only pass on warnings */
+static void warnings_only(int log_level, const char *msg, va_list args,
+		void *param)
+{
+	if (log_level <= LOG_WARNING)
+		prev_handler(log_level, msg, args, prev_param);
+
+	UNUSED_PARAMETER(param);
+}
+
+struct find_name {
+	const char   *name;
+	obs_source_t *source;
+};
+
+static bool find_by_name(void *param, obs_source_t *source)
+{
+	struct find_name *find = param;
+
+	if (strcmp(obs_source_get_name(source), find->name) == 0) {
+		find->source = source;
+		return false;
+	}
+
+	return true;
+}
+
+/* the previous obs_get_source_by_name */
+static obs_source_t *walk_sources(const char *name)
+{
+	struct find_name find = {name, NULL};
+
+	obs_enum_sources(find_by_name, &find);
+	obs_source_addref(find.source);
+	return find.source;
+}
+
+static void bench_lookups(const char *prefix)
+{
+	char     name[64];
+	uint64_t start;
+	size_t   found;
+
+	/* not in creation order, so the walk doesn't always stop early */
+	found = 0;
+	start = os_gettime_ns();
+	for (int i = 0; i < INDEX_LOOKUPS; i++) {
+		obs_source_t *source;
+
+		snprintf(name, sizeof(name), "%s %d", prefix,
+				(i * 7919) % NAME_SOURCES);
+		source = obs_get_source_by_name(name);
+		found += source != NULL;
+		obs_source_release(source);
+	}
+	printf("%-32s %9.3f us/lookup (%zu found)\n",
+			"obs_get_source_by_name",
+			ns_per(start, INDEX_LOOKUPS) / 1000.0, found);
+
+	found = 0;
+	start = os_gettime_ns();
+	for (int i = 0; i < WALK_LOOKUPS; i++) {
+		obs_source_t *source;
+
+		snprintf(name, sizeof(name), "%s %d", prefix,
+				(i * 7919) % NAME_SOURCES);
+		source = walk_sources(name);
+		found += source != NULL;
+		obs_source_release(source);
+	}
+	printf("%-32s %9.3f us/lookup (%zu found)\n",
+			"obs_enum_sources walk (old)",
+			ns_per(start, WALK_LOOKUPS) / 1000.0, found);
+
+	/* unique name checks look up names that don't exist yet */
+	start = os_gettime_ns();
+	for (int i = 0; i < INDEX_LOOKUPS; i++)
+		obs_source_release(obs_get_source_by_name("Missing source"));
+	printf("%-32s %9.3f us/lookup\n", "obs_get_source_by_name, missing",
+			ns_per(start, INDEX_LOOKUPS) / 1000.0);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < WALK_LOOKUPS; i++)
+		obs_source_release(walk_sources("Missing source"));
+	printf("%-32s %9.3f us/lookup\n", "obs_enum_sources walk, missing",
+			ns_per(start, WALK_LOOKUPS) / 1000.0);
+}
+
+static void bench_scene(obs_source_t **sources, const char *prefix)
+{
+	obs_scene_t *scene = obs_scene_create("Name benchmark scene");
+	char        name[64];
+	uint64_t    start;
+	size_t      found = 0;
+
+	for (int i = 0; i < SCENE_ITEMS; i++)
+		obs_scene_add(scene, sources[i]);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < SCENE_LOOKUPS; i++) {
+		snprintf(name, sizeof(name), "%s %d", prefix,
+				(i * 7919) % SCENE_ITEMS);
+		found += obs_scene_find_source(scene, name) != NULL;
+	}
+	printf("%-32s %9.3f us/lookup (%zu found, %d items)\n",
+			"obs_scene_find_source",
+			ns_per(start, SCENE_LOOKUPS) / 1000.0, found,
+			SCENE_ITEMS);
+
+	obs_scene_release(scene);
+}
+
+int bench_names(void)
+{
+	obs_source_t **sources;
+	char         name[64];
+	uint64_t     start;
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "Couldn't start libobs\n");
+		return 1;
+	}
+
+	obs_register_source(&name_source_info);
+
+	base_get_log_handler(&prev_handler, &prev_param);
+	base_set_log_handler(warnings_only, NULL);
+
+	sources = bzalloc(sizeof(obs_source_t*) * NAME_SOURCES);
+
+	printf("%d sources:\n", NAME_SOURCES);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < NAME_SOURCES; i++) {
+		snprintf(name, sizeof(name), "Source %d", i);
+		sources[i] = obs_source_create(OBS_SOURCE_TYPE_INPUT,
+				name_source_info.id, name, NULL, NULL);
+		obs_add_source(sources[i]);
+	}
+	printf("%-32s %9.3f us/source\n", "create and add",
+			ns_per(start, NAME_SOURCES) / 1000.0);
+
+	bench_lookups("Source");
+
+	start = os_gettime_ns();
+	for (int i = 0; i < NAME_SOURCES; i++) {
+		snprintf(name, sizeof(name), "Renamed %d", i);
+		obs_source_set_name(sources[i], name);
+	}
+	printf("%-32s %9.3f us/source\n", "obs_source_set_name",
+			ns_per(start, NAME_SOURCES) / 1000.0);
+
+	/* the renamed sources have to be found under their new names */
+	bench_lookups("Renamed");
+	bench_scene(sources, "Renamed");
+
+	start = os_gettime_ns();
+	for (int i = 0; i < NAME_SOURCES; i++) {
+		obs_source_remove(sources[i]);
+		obs_source_release(sources[i]);
+	}
+	printf("%-32s %9.3f us/source\n", "remove and release",
+			ns_per(start, NAME_SOURCES) / 1000.0);
+
+	bfree(sources);
+
+	base_set_log_handler(prev_handler, prev_param);
+	obs_shutdown();
+	return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Cost of a profile_start/profile_end pair, for a root with four nested calls
+ * (about what the graphics and audio threads record per tick), on 1 and 4
+ * threads at once.  Two os_gettime_ns calls per pair are the floor, so their
+ * cost is printed as well.
+ */
+
+#include <util/profiler.h>
+#include <util/threading.h>
+
+#include "micro-benchmarks.h"
+
+#define PROFILER_ROOTS    200000
+#define PAIRS_PER_ROOT    5
+#define MAX_THREADS       4
+
+static const char *root_names[MAX_THREADS] = {
+	"bench_root0", "bench_root1", "bench_root2", "bench_root3"
+};
+
+static const char *child_name      = "bench_child";
+static const char *grandchild_name = "bench_grandchild";
+static const char *sibling_name    = "bench_sibling";
+
+static void *record_roots(void *param)
+{
+	const char *root_name = param;
+
+	for (int i = 0; i < PROFILER_ROOTS; i++) {
+		profile_start(root_name);
+
+		profile_start(child_name);
+		profile_start(grandchild_name);
+		profile_end(grandchild_name);
+		profile_end(child_name);
+
+		profile_start(sibling_name);
+		profile_end(sibling_name);
+		profile_start(sibling_name);
+		profile_end(sibling_name);
+
+		profile_end(root_name);
+	}
+
+	return NULL;
+}
+
+static void run_threads(int num_threads)
+{
+	pthread_t threads[MAX_THREADS];
+	uint64_t  start = os_gettime_ns();
+	int       started = 0;
+
+	for (int i = 0; i < num_threads; i++) {
+		if (pthread_create(&threads[i], NULL, record_roots,
+					(void*)root_names[i]) != 0)
+			break;
+		started++;
+	}
+
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("%d thread(s): %6.1f ns per start/end pair\n", started,
+			ns_per(start, (uint64_t)PROFILER_ROOTS *
+				PAIRS_PER_ROOT * started));
+}
+
+int bench_profiler(void)
+{
+	profiler_snapshot_t *snap;
+	volatile uint64_t   sink = 0;
+	uint64_t            start;
+
+	start = os_gettime_ns();
+	for (int i = 0; i < PROFILER_ROOTS * PAIRS_PER_ROOT; i++) {
+		sink += os_gettime_ns();
+		sink += os_gettime_ns();
+	}
+	printf("two os_gettime_ns: %6.1f ns\n",
+			ns_per(start, PROFILER_ROOTS * PAIRS_PER_ROOT));
+
+	profiler_start();
+	profile_register_root(root_names[0], 16666667);
+
+	run_threads(1);
+	run_threads(MAX_THREADS);
+
+	/* snapshots fold the per-thread tables, so time one as well */
+	start = os_gettime_ns();
+	snap  = profile_snapshot_create();
+	printf("snapshot: %.1f us\n", ns_per(start, 1) / 1000.0);
+	profile_snapshot_free(snap);
+
+	profiler_stop();
+	profiler_free();
+	return 0;
+}
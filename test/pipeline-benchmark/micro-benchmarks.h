@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdio.h>
+#include <util/c99defs.h>
+#include <util/platform.h>
+
+/*
+ * Benchmarks of single libobs functions, run with -b <name> instead of the
+ * pipeline.  Each prints its own results and returns 0 on success.
+ */
+
+typedef int (*micro_benchmark_func_t)(void);
+
+extern int bench_avc(void);
+extern int bench_calldata(void);
+extern int bench_convert(void);
+extern int bench_data(void);
+extern int bench_data_binary(void);
+extern int bench_mix(void);
+extern int bench_names(void);
+extern int bench_profiler(void);
+
+static inline double ns_per(uint64_t start_ns, uint64_t count)
+{
+	return (double)(os_gettime_ns() - start_ns) / (double)count;
+}
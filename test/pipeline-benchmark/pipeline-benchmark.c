@@ -0,0 +1,571 @@
+/*
+ * Runs the whole libobs pipeline (source ticking, rendering, output
+ * conversion, audio mixing, encoding and FLV muxing) on the null graphics
+ * module for a fixed time and prints the profiler trees along with frame
+ * statistics.  Works without a GPU.
+ *
+ * usage: pipeline-benchmark [-t seconds] [-n sources] [-o file.flv]
+ *                           [-e x264|stub] [-p] [-s threads]
+ *                           [-j trace.json] [-m]
+ *        pipeline-benchmark -b benchmark [-m]
+ *
+ *   -s scales the encoded video to 640x360 on the given number of scale
+ * threads, instead of encoding the output resolution as is.
+ *
+ *   -m enables the pooled bmem allocator and prints per size class allocation
+ * rates for the time the output was running.
+ *
+ *   -b runs one of the micro-benchmarks of individual libobs functions listed
+ * in micro_benchmarks instead of the pipeline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <obs.h>
+
+#include "micro-benchmarks.h"
+
+#define BENCHMARK_TIMELINE_EVENTS (1024 * 1024)
+
+struct benchmark_options {
+	int        seconds;
+	int        num_sources;
+	const char *path;
+	const char *encoder;
+	const char *trace_path;
+	const char *micro_benchmark;
+	bool       parallel_tick;
+	int        scale_threads;
+	bool       mem_pool;
+};
+
+/* ------------------------------------------------------------------------- */
+/* stub encoders, used when x264 isn't available or isn't wanted.  they
+ * output small well-formed packets so the muxing side still does real work */
+
+static const uint8_t stub_h264_header[] = {
+	0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xc0, 0x1f, 0xda, 0x01, 0x40,
+	0x16, 0xe8, 0x40, 0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80
+};
+
+static const uint8_t stub_aac_header[] = {0x11, 0x90};
+
+#define STUB_VIDEO_PAYLOAD 8192
+#define STUB_KEYINT        120
+
+struct stub_encoder {
+	uint8_t  *buffer;
+	size_t   size;
+	uint64_t frames;
+};
+
+static const char *stub_h264_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Stub H.264 encoder (benchmark)";
+}
+
+static const char *stub_aac_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Stub AAC encoder (benchmark)";
+}
+
+static void *stub_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	struct stub_encoder *stub = bzalloc(sizeof(struct stub_encoder));
+
+	stub->size   = STUB_VIDEO_PAYLOAD;
+	stub->buffer = bzalloc(stub->size);
+
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(encoder);
+	return stub;
+}
+
+static void stub_destroy(void *data)
+{
+	struct stub_encoder *stub = data;
+
+	bfree(stub->buffer);
+	bfree(stub);
+}
+
+static bool stub_h264_encode(void *data, struct encoder_frame *frame,
+		struct encoder_packet *packet, bool *received_packet)
+{
+	struct stub_encoder *stub = data;
+	bool keyframe = (stub->frames++ % STUB_KEYINT) == 0;
+
+	/* sample some of the frame so the payload isn't constant */
+	memcpy(stub->buffer + 5, frame->data[0], 64);
+
+	stub->buffer[0] = 0;
+	stub->buffer[1] = 0;
+	stub->buffer[2] = 0;
+	stub->buffer[3] = 1;
+	stub->buffer[4] = keyframe ? 0x65 : 0x41;
+
+	packet->data     = stub->buffer;
+	packet->size     = stub->size;
+	packet->type     = OBS_ENCODER_VIDEO;
+	packet->pts      = frame->pts;
+	packet->dts      = frame->pts;
+	packet->keyframe = keyframe;
+	*received_packet = true;
+	return true;
+}
+
+static bool stub_h264_extra_data(void *data, uint8_t **extra_data,
+		size_t *size)
+{
+	*extra_data = (uint8_t*)stub_h264_header;
+	*size       = sizeof(stub_h264_header);
+
+	UNUSED_PARAMETER(data);
+	return true;
+}
+
+static bool stub_aac_encode(void *data, struct encoder_frame *frame,
+		struct encoder_packet *packet, bool *received_packet)
+{
+	struct stub_encoder *stub = data;
+
+	stub->frames++;
+
+	packet->data     = stub->buffer;
+	packet->size     = 256;
+	packet->type     = OBS_ENCODER_AUDIO;
+	packet->pts      = frame->pts;
+	packet->dts      = frame->pts;
+	packet->keyframe = true;
+	*received_packet = true;
+	return true;
+}
+
+static bool stub_aac_extra_data(void *data, uint8_t **extra_data, size_t *size)
+{
+	*extra_data = (uint8_t*)stub_aac_header;
+	*size       = sizeof(stub_aac_header);
+
+	UNUSED_PARAMETER(data);
+	return true;
+}
+
+static size_t stub_aac_frame_size(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return 1024;
+}
+
+static void stub_aac_audio_info(void *data, struct audio_convert_info *info)
+{
+	info->format = AUDIO_FORMAT_FLOAT_PLANAR;
+	UNUSED_PARAMETER(data);
+}
+
+static void stub_h264_video_info(void *data, struct video_scale_info *info)
+{
+	info->format = VIDEO_FORMAT_NV12;
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_encoder_info stub_h264_encoder = {
+	.id             = "benchmark_stub_h264",
+	.type           = OBS_ENCODER_VIDEO,
+	.codec          = "h264",
+	.get_name       = stub_h264_name,
+	.create         = stub_create,
+	.destroy        = stub_destroy,
+	.encode         = stub_h264_encode,
+	.get_extra_data = stub_h264_extra_data,
+	.get_video_info = stub_h264_video_info
+};
+
+static struct obs_encoder_info stub_aac_encoder = {
+	.id             = "benchmark_stub_aac",
+	.type           = OBS_ENCODER_AUDIO,
+	.codec          = "AAC",
+	.get_name       = stub_aac_name,
+	.create         = stub_create,
+	.destroy        = stub_destroy,
+	.encode         = stub_aac_encode,
+	.get_frame_size = stub_aac_frame_size,
+	.get_extra_data = stub_aac_extra_data,
+	.get_audio_info = stub_aac_audio_info
+};
+
+/* ------------------------------------------------------------------------- */
+
+static const struct {
+	const char             *name;
+	micro_benchmark_func_t func;
+} micro_benchmarks[] = {
+	{"avc",         bench_avc},
+	{"calldata",    bench_calldata},
+	{"convert",     bench_convert},
+	{"data",        bench_data},
+	{"data-binary", bench_data_binary},
+	{"mix",         bench_mix},
+	{"names",       bench_names},
+	{"profiler",    bench_profiler},
+};
+
+#define NUM_MICRO_BENCHMARKS \
+	(sizeof(micro_benchmarks) / sizeof(micro_benchmarks[0]))
+
+static int run_micro_benchmark(const char *name)
+{
+	for (size_t i = 0; i < NUM_MICRO_BENCHMARKS; i++) {
+		if (strcmp(micro_benchmarks[i].name, name) == 0)
+			return micro_benchmarks[i].func();
+	}
+
+	fprintf(stderr, "unknown benchmark '%s', available:", name);
+	for (size_t i = 0; i < NUM_MICRO_BENCHMARKS; i++)
+		fprintf(stderr, " %s", micro_benchmarks[i].name);
+	fprintf(stderr, "\n");
+	return 1;
+}
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (log_level <= LOG_INFO) {
+		vfprintf(stdout, msg, args);
+		fputc('\n', stdout);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+static bool parse_args(struct benchmark_options *opts, int argc, char *argv[])
+{
+	opts->seconds         = 10;
+	opts->num_sources     = 8;
+	opts->path            = "pipeline-benchmark.flv";
+	opts->encoder         = "stub";
+	opts->trace_path      = NULL;
+	opts->micro_benchmark = NULL;
+	opts->parallel_tick   = false;
+	opts->scale_threads   = 0;
+	opts->mem_pool        = false;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg  = argv[i];
+		const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "-p") == 0) {
+			opts->parallel_tick = true;
+			continue;
+		}
+		if (strcmp(arg, "-m") == 0) {
+			opts->mem_pool = true;
+			continue;
+		}
+
+		if (!next)
+			return false;
+
+		if (strcmp(arg, "-t") == 0)
+			opts->seconds = atoi(next);
+		else if (strcmp(arg, "-n") == 0)
+			opts->num_sources = atoi(next);
+		else if (strcmp(arg, "-o") == 0)
+			opts->path = next;
+		else if (strcmp(arg, "-e") == 0)
+			opts->encoder = next;
+		else if (strcmp(arg, "-j") == 0)
+			opts->trace_path = next;
+		else if (strcmp(arg, "-b") == 0)
+			opts->micro_benchmark = next;
+		else if (strcmp(arg, "-s") == 0)
+			opts->scale_threads = atoi(next);
+		else
+			return false;
+
+		i++;
+	}
+
+	return opts->seconds > 0 && opts->num_sources >= 0 &&
+		opts->scale_threads >= 0;
+}
+
+static bool reset_av(void)
+{
+	struct obs_video_info ovi = {0};
+	struct obs_audio_info oai = {0};
+
+	ovi.graphics_module = DL_NULL;
+	ovi.fps_num         = 60;
+	ovi.fps_den         = 1;
+	ovi.base_width      = 1920;
+	ovi.base_height     = 1080;
+	ovi.output_width    = 1280;
+	ovi.output_height   = 720;
+	ovi.output_format   = VIDEO_FORMAT_NV12;
+	ovi.colorspace      = VIDEO_CS_601;
+	ovi.range           = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type      = OBS_SCALE_BICUBIC;
+
+	oai.samples_per_sec = 48000;
+	oai.speakers        = SPEAKERS_STEREO;
+	oai.buffer_ms       = 1000;
+
+	if (obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "Couldn't initialize video with '%s'\n",
+				DL_NULL);
+		return false;
+	}
+
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "Couldn't initialize audio\n");
+		return false;
+	}
+
+	return true;
+}
+
+static obs_scene_t *create_scene(int num_sources)
+{
+	obs_scene_t  *scene = obs_scene_create("benchmark scene");
+	obs_source_t *source;
+	struct vec2  scale;
+
+	vec2_set(&scale, 20.0f, 20.0f);
+
+	for (int i = 0; i < num_sources; i++) {
+		char name[32];
+		obs_sceneitem_t *item;
+
+		snprintf(name, sizeof(name), "random %d", i);
+		source = obs_source_create(OBS_SOURCE_TYPE_INPUT, "random",
+				name, NULL, NULL);
+		if (!source) {
+			fprintf(stderr, "Couldn't create test source, is "
+					"test-input loaded?\n");
+			break;
+		}
+
+		item = obs_scene_add(scene, source);
+		obs_sceneitem_set_scale(item, &scale);
+		obs_source_release(source);
+	}
+
+	source = obs_source_create(OBS_SOURCE_TYPE_INPUT, "test_sinewave",
+			"sinewave", NULL, NULL);
+	if (source) {
+		obs_scene_add(scene, source);
+		obs_source_release(source);
+	}
+
+	return scene;
+}
+
+static void print_stats(obs_output_t *output, uint64_t elapsed_ns)
+{
+	video_t *video = obs_get_video();
+
+	printf("\n=== pipeline benchmark: %.2f seconds ===\n",
+			(double)elapsed_ns / 1000000000.0);
+	printf("video frames:        %"PRIu32"\n",
+			video_output_get_total_frames(video));
+	printf("frames skipped:      %"PRIu32" (render lag)\n",
+			video_output_get_skipped_frames(video));
+	printf("output frames:       %d\n",
+			obs_output_get_total_frames(output));
+	printf("output dropped:      %d\n",
+			obs_output_get_frames_dropped(output));
+	printf("bytes written:       %"PRIu64"\n",
+			obs_output_get_total_bytes(output));
+}
+
+static struct base_pool_stats *pool_stats_snapshot(void)
+{
+	size_t                 num   = base_pool_num_classes();
+	struct base_pool_stats *stats = bzalloc(sizeof(*stats) * num);
+
+	for (size_t i = 0; i < num; i++)
+		base_pool_get_stats(i, &stats[i]);
+	return stats;
+}
+
+static void print_pool_stats(const struct base_pool_stats *start,
+		uint64_t elapsed_ns)
+{
+	struct base_pool_stats *end = pool_stats_snapshot();
+	double                 secs = (double)elapsed_ns / 1000000000.0;
+
+	printf("\n=== bmem pool, per second while running ===\n");
+	printf("%10s %12s %12s %12s\n", "class", "allocs", "cache hit %",
+			"system");
+
+	for (size_t i = 0; i < base_pool_num_classes(); i++) {
+		uint64_t allocs = end[i].allocs - start[i].allocs;
+		uint64_t hits   = end[i].thread_hits + end[i].shared_hits -
+			start[i].thread_hits - start[i].shared_hits;
+		uint64_t sys    = end[i].sys_allocs - start[i].sys_allocs;
+
+		if (!allocs)
+			continue;
+
+		if (end[i].size)
+			printf("%10zu", end[i].size);
+		else
+			printf("%10s", "unpooled");
+
+		printf(" %12.1f %12.1f %12.1f\n", (double)allocs / secs,
+				100.0 * (double)hits / (double)allocs,
+				(double)sys / secs);
+	}
+
+	bfree(end);
+}
+
+int main(int argc, char *argv[])
+{
+	struct benchmark_options opts;
+	profiler_name_store_t    *name_store;
+	profiler_snapshot_t      *snap;
+	obs_scene_t              *scene;
+	obs_encoder_t            *venc = NULL;
+	obs_encoder_t            *aenc;
+	obs_output_t             *output;
+	obs_data_t               *settings;
+	struct base_pool_stats   *pool_start = NULL;
+	uint64_t                 start_time;
+	int                      ret = 0;
+
+	if (!parse_args(&opts, argc, argv)) {
+		fprintf(stderr, "usage: %s [-t seconds] [-n sources] "
+				"[-o file.flv] [-e x264|stub] [-p] "
+				"[-s threads] [-j trace.json] [-m]\n"
+				"       %s -b benchmark [-m]\n",
+				argv[0], argv[0]);
+		return 1;
+	}
+
+	/* has to happen before anything is allocated */
+	if (opts.mem_pool && !base_use_pooled_allocator())
+		return 1;
+
+	base_set_log_handler(do_log, NULL);
+
+	if (opts.micro_benchmark)
+		return run_micro_benchmark(opts.micro_benchmark);
+
+	name_store = profiler_name_store_create();
+	profiler_start();
+
+	if (!obs_startup("en-US", NULL, name_store)) {
+		fprintf(stderr, "Couldn't start libobs\n");
+		return 1;
+	}
+
+	if (!reset_av()) {
+		ret = 1;
+		goto shutdown;
+	}
+
+	obs_load_all_modules();
+	obs_register_encoder(&stub_h264_encoder);
+	obs_register_encoder(&stub_aac_encoder);
+
+	obs_set_parallel_tick(opts.parallel_tick);
+
+	scene = create_scene(opts.num_sources);
+	obs_set_output_source(0, obs_scene_get_source(scene));
+
+	if (strcmp(opts.encoder, "x264") == 0) {
+		venc = obs_video_encoder_create("obs_x264", "video", NULL,
+				NULL);
+		if (!venc)
+			fprintf(stderr, "x264 not available, using the stub "
+					"encoder\n");
+	}
+	if (!venc)
+		venc = obs_video_encoder_create("benchmark_stub_h264",
+				"video", NULL, NULL);
+	aenc = obs_audio_encoder_create("benchmark_stub_aac", "audio", NULL,
+			0, NULL);
+
+	obs_encoder_set_video(venc, obs_get_video());
+	if (opts.scale_threads) {
+		video_output_set_scale_threads(obs_get_video(),
+				(uint32_t)opts.scale_threads);
+		obs_encoder_set_scaled_size(venc, 640, 360);
+	}
+	obs_encoder_set_audio(aenc, obs_get_audio());
+
+	settings = obs_data_create();
+	obs_data_set_string(settings, "path", opts.path);
+	output = obs_output_create("flv_output", "benchmark", settings, NULL);
+	obs_data_release(settings);
+
+	if (!output) {
+		fprintf(stderr, "Couldn't create the FLV output, is "
+				"obs-outputs loaded?\n");
+		ret = 1;
+		goto cleanup;
+	}
+
+	obs_output_set_video_encoder(output, venc);
+	obs_output_set_audio_encoder(output, aenc, 0);
+
+	if (opts.trace_path)
+		profiler_timeline_start(BENCHMARK_TIMELINE_EVENTS);
+
+	if (opts.mem_pool)
+		pool_start = pool_stats_snapshot();
+
+	start_time = os_gettime_ns();
+
+	if (!obs_output_start(output)) {
+		fprintf(stderr, "Couldn't start the output\n");
+		ret = 1;
+		goto cleanup;
+	}
+
+	os_sleep_ms((uint32_t)opts.seconds * 1000);
+	obs_output_stop(output);
+
+	print_stats(output, os_gettime_ns() - start_time);
+	if (pool_start)
+		print_pool_stats(pool_start, os_gettime_ns() - start_time);
+
+	if (opts.trace_path) {
+		profiler_timeline_stop();
+		if (!profiler_timeline_dump_json(opts.trace_path))
+			fprintf(stderr, "Couldn't write '%s'\n",
+					opts.trace_path);
+	}
+
+cleanup:
+	bfree(pool_start);
+	obs_set_output_source(0, NULL);
+	obs_output_release(output);
+	obs_encoder_release(venc);
+	obs_encoder_release(aenc);
+	obs_scene_release(scene);
+
+shutdown:
+	obs_shutdown();
+
+	snap = profile_snapshot_create();
+	profiler_print(snap);
+	profiler_print_time_between_calls(snap);
+	profile_snapshot_free(snap);
+
+	profiler_stop();
+	profiler_free();
+	profiler_name_store_free(name_store);
+
+	printf("Number of memory leaks: %ld\n", bnum_allocs());
+	return ret;
+}